@@ -0,0 +1,22 @@
+/*
+    KWin - the KDE window manager
+    This file is part of the KDE project.
+
+    SPDX-FileCopyrightText: 2022 KWin contributors
+
+    SPDX-License-Identifier: GPL-2.0-or-later
+*/
+#include "generic_compositing_benchmark.h"
+
+class OpenGLCompositingBenchmark : public GenericCompositingBenchmark
+{
+    Q_OBJECT
+public:
+    OpenGLCompositingBenchmark()
+        : GenericCompositingBenchmark(QByteArrayLiteral("O2"))
+    {
+    }
+};
+
+WAYLANDTEST_MAIN(OpenGLCompositingBenchmark)
+#include "compositing_benchmark_opengl.moc"
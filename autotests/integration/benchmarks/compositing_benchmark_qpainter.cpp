@@ -0,0 +1,22 @@
+/*
+    KWin - the KDE window manager
+    This file is part of the KDE project.
+
+    SPDX-FileCopyrightText: 2022 KWin contributors
+
+    SPDX-License-Identifier: GPL-2.0-or-later
+*/
+#include "generic_compositing_benchmark.h"
+
+class QPainterCompositingBenchmark : public GenericCompositingBenchmark
+{
+    Q_OBJECT
+public:
+    QPainterCompositingBenchmark()
+        : GenericCompositingBenchmark(QByteArrayLiteral("Q"))
+    {
+    }
+};
+
+WAYLANDTEST_MAIN(QPainterCompositingBenchmark)
+#include "compositing_benchmark_qpainter.moc"
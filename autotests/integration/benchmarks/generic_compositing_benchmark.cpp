@@ -0,0 +1,450 @@
+/*
+    KWin - the KDE window manager
+    This file is part of the KDE project.
+
+    SPDX-FileCopyrightText: 2022 KWin contributors
+
+    SPDX-License-Identifier: GPL-2.0-or-later
+*/
+#include "generic_compositing_benchmark.h"
+#include "composite.h"
+#include "effectloader.h"
+#include "effects.h"
+#include "platform.h"
+#include "renderbackend.h"
+#include "scene.h"
+#include "wayland_server.h"
+#include "window.h"
+#include "workspace.h"
+
+#include <KConfigGroup>
+
+#include <KWayland/Client/shm_pool.h>
+#include <KWayland/Client/subsurface.h>
+#include <KWayland/Client/surface.h>
+
+using namespace KWin;
+using namespace std::chrono_literals;
+static const QString s_socketName = QStringLiteral("wayland_test_kwin_compositing_benchmark-0");
+
+static const int s_frameCount = 120;
+
+/**
+ * Returns the resident set size of the process in KiB. The compositor and the test clients
+ * live in the same process, so the value covers both sides of the connection.
+ */
+static qint64 residentMemory()
+{
+    QFile file(QStringLiteral("/proc/self/status"));
+    if (!file.open(QIODevice::ReadOnly)) {
+        return 0;
+    }
+    const QList<QByteArray> lines = file.readAll().split('\n');
+    for (const QByteArray &line : lines) {
+        if (line.startsWith("VmRSS:")) {
+            return line.mid(6).simplified().split(' ').first().toLongLong();
+        }
+    }
+    return 0;
+}
+
+static void renderBuffer(KWayland::Client::Surface *surface, const QSize &size, const QColor &color)
+{
+    QImage image(size, QImage::Format_ARGB32_Premultiplied);
+    image.fill(color);
+    surface->attachBuffer(Test::waylandShmPool()->createBuffer(image));
+    surface->damage(QRect(QPoint(0, 0), size));
+}
+
+static QColor frameColor(int frame)
+{
+    return QColor::fromHsv((frame * 7) % 360, 255, 255);
+}
+
+/**
+ * An effect that is always active and doesn't change anything. If a window is provided, it
+ * restricts its window passes to that window.
+ */
+class PassThroughEffect : public Effect
+{
+public:
+    explicit PassThroughEffect(EffectWindow *window)
+    {
+        if (window) {
+            effects->setWindowPassesRestricted(this, true);
+            effects->setWindowPassesEnabled(this, window, true);
+        }
+    }
+
+    bool isActive() const override
+    {
+        return true;
+    }
+};
+
+GenericCompositingBenchmark::GenericCompositingBenchmark(const QByteArray &envVariable)
+    : QObject()
+    , m_envVariable(envVariable)
+{
+}
+
+GenericCompositingBenchmark::~GenericCompositingBenchmark()
+{
+}
+
+void GenericCompositingBenchmark::initTestCase()
+{
+    qputenv("XDG_DATA_DIRS", QCoreApplication::applicationDirPath().toUtf8());
+
+    qRegisterMetaType<KWin::Window *>();
+    QSignalSpy applicationStartedSpy(kwinApp(), &Application::started);
+    QVERIFY(applicationStartedSpy.isValid());
+    kwinApp()->platform()->setInitialWindowSize(QSize(1280, 1024));
+    QVERIFY(waylandServer()->init(s_socketName));
+
+    // effects are loaded explicitly by the scenarios that need them
+    auto config = KSharedConfig::openConfig(QString(), KConfig::SimpleConfig);
+    KConfigGroup plugins(config, QStringLiteral("Plugins"));
+    const auto builtinNames = EffectLoader().listOfKnownEffects();
+    for (const QString &name : builtinNames) {
+        plugins.writeEntry(name + QStringLiteral("Enabled"), false);
+    }
+    config->sync();
+    kwinApp()->setConfig(config);
+
+    qputenv("XCURSOR_THEME", QByteArrayLiteral("DMZ-White"));
+    qputenv("XCURSOR_SIZE", QByteArrayLiteral("24"));
+    qputenv("KWIN_COMPOSE", m_envVariable);
+    qputenv("KWIN_EFFECTS_FORCE_ANIMATIONS", QByteArrayLiteral("1"));
+
+    kwinApp()->start();
+    QVERIFY(applicationStartedSpy.wait());
+    Test::initWaylandWorkspace();
+    QVERIFY(Compositor::self());
+
+    // The OpenGL flavor relies on a software rasterizer such as llvmpipe, which is not
+    // available everywhere, so only run it if the compositor hasn't fallen back.
+    const CompositingType expectedType = m_envVariable == QByteArrayLiteral("Q") ? QPainterCompositing : OpenGLCompositing;
+    if (Compositor::self()->backend()->compositingType() != expectedType) {
+        QSKIP("The requested compositing type is not available");
+    }
+}
+
+void GenericCompositingBenchmark::init()
+{
+    QVERIFY(Test::setupWaylandConnection());
+}
+
+void GenericCompositingBenchmark::cleanup()
+{
+    stopRecording();
+
+    auto effectsImpl = qobject_cast<EffectsHandlerImpl *>(effects);
+    QVERIFY(effectsImpl);
+    effectsImpl->unloadAllEffects();
+
+    Test::destroyWaylandConnection();
+    QTRY_VERIFY(workspace()->allClientList().isEmpty());
+}
+
+void GenericCompositingBenchmark::startRecording()
+{
+    stopRecording();
+
+    m_frameTimes = FrameTimeHistory();
+    m_commitLatencies = FrameTimeHistory();
+    m_residentMemory = residentMemory();
+
+    Scene *scene = Compositor::self()->scene();
+    m_preFrameRenderConnection = connect(scene, &Scene::preFrameRender, this, [this]() {
+        m_frameTimer.start();
+    });
+    m_frameRenderedConnection = connect(scene, &Scene::frameRendered, this, [this]() {
+        if (m_frameTimer.isValid()) {
+            m_frameTimes.add(std::chrono::nanoseconds(m_frameTimer.nsecsElapsed()));
+            m_frameTimer.invalidate();
+        }
+    });
+}
+
+void GenericCompositingBenchmark::stopRecording()
+{
+    disconnect(m_preFrameRenderConnection);
+    disconnect(m_frameRenderedConnection);
+    m_frameTimer.invalidate();
+}
+
+void GenericCompositingBenchmark::renderFrames(int count)
+{
+    Scene *scene = Compositor::self()->scene();
+    QSignalSpy frameRenderedSpy(scene, &Scene::frameRendered);
+    QVERIFY(frameRenderedSpy.isValid());
+    for (int i = 0; i < count; ++i) {
+        scene->addRepaintFull();
+        QVERIFY(frameRenderedSpy.wait());
+    }
+}
+
+void GenericCompositingBenchmark::commitAndWaitForFrame(KWayland::Client::Surface *surface)
+{
+    QSignalSpy frameRenderedSpy(surface, &KWayland::Client::Surface::frameRendered);
+    QVERIFY(frameRenderedSpy.isValid());
+
+    QElapsedTimer timer;
+    timer.start();
+    surface->commit(KWayland::Client::Surface::CommitFlag::FrameCallback);
+    Test::flushWaylandConnection();
+    QVERIFY(frameRenderedSpy.wait());
+    m_commitLatencies.add(std::chrono::nanoseconds(timer.nsecsElapsed()));
+}
+
+void GenericCompositingBenchmark::report()
+{
+    stopRecording();
+
+    const auto toMicroseconds = [](std::chrono::nanoseconds value) {
+        return qlonglong(std::chrono::duration_cast<std::chrono::microseconds>(value).count());
+    };
+
+    qInfo("frame cpu time: samples %d, p50 %lld us, p90 %lld us, p99 %lld us, max %lld us",
+          m_frameTimes.count(),
+          toMicroseconds(m_frameTimes.percentile(50)),
+          toMicroseconds(m_frameTimes.percentile(90)),
+          toMicroseconds(m_frameTimes.percentile(99)),
+          toMicroseconds(m_frameTimes.maximum()));
+    qInfo("commit to present latency: samples %d, p50 %lld us, p90 %lld us, p99 %lld us, max %lld us",
+          m_commitLatencies.count(),
+          toMicroseconds(m_commitLatencies.percentile(50)),
+          toMicroseconds(m_commitLatencies.percentile(90)),
+          toMicroseconds(m_commitLatencies.percentile(99)),
+          toMicroseconds(m_commitLatencies.maximum()));
+    qInfo("resident memory: %lld KiB, delta %lld KiB", residentMemory(), residentMemory() - m_residentMemory);
+
+    // The median frame time is the headline number so it ends up in the benchmark log.
+    QTest::setBenchmarkResult(m_frameTimes.percentile(50).count(), QTest::WalltimeNanoseconds);
+}
+
+void GenericCompositingBenchmark::benchmarkManyWindows_data()
+{
+    QTest::addColumn<int>("windowCount");
+
+    QTest::newRow("10 windows") << 10;
+    QTest::newRow("50 windows") << 50;
+    QTest::newRow("100 windows") << 100;
+}
+
+void GenericCompositingBenchmark::benchmarkManyWindows()
+{
+    // This benchmark measures how the cost of a frame scales with the number of windows.
+    QFETCH(int, windowCount);
+
+    startRecording();
+
+    std::vector<std::unique_ptr<KWayland::Client::Surface>> surfaces;
+    std::vector<std::unique_ptr<Test::XdgToplevel>> shellSurfaces;
+    for (int i = 0; i < windowCount; ++i) {
+        std::unique_ptr<KWayland::Client::Surface> surface(Test::createSurface());
+        QVERIFY(surface);
+        std::unique_ptr<Test::XdgToplevel> shellSurface(Test::createXdgToplevelSurface(surface.get()));
+        QVERIFY(shellSurface);
+        Window *window = Test::renderAndWaitForShown(surface.get(), QSize(200, 150), frameColor(i));
+        QVERIFY(window);
+        window->move(QPoint((i * 37) % 1080, (i * 53) % 874));
+        surfaces.push_back(std::move(surface));
+        shellSurfaces.push_back(std::move(shellSurface));
+    }
+
+    // Let every window update its contents in turn while the compositor repaints the screen.
+    for (int frame = 0; frame < s_frameCount; ++frame) {
+        KWayland::Client::Surface *surface = surfaces[frame % windowCount].get();
+        renderBuffer(surface, QSize(200, 150), frameColor(frame));
+        commitAndWaitForFrame(surface);
+    }
+    renderFrames(s_frameCount);
+
+    report();
+}
+
+void GenericCompositingBenchmark::benchmarkRapidResize_data()
+{
+    QTest::addColumn<QSize>("minimumSize");
+    QTest::addColumn<QSize>("maximumSize");
+
+    QTest::newRow("small") << QSize(100, 50) << QSize(400, 300);
+    QTest::newRow("large") << QSize(400, 300) << QSize(1200, 900);
+}
+
+void GenericCompositingBenchmark::benchmarkRapidResize()
+{
+    // This benchmark attaches a buffer with a different size every frame, which forces
+    // the compositor to reallocate textures and to recompute the window geometry.
+    QFETCH(QSize, minimumSize);
+    QFETCH(QSize, maximumSize);
+
+    startRecording();
+
+    std::unique_ptr<KWayland::Client::Surface> surface(Test::createSurface());
+    QVERIFY(surface);
+    std::unique_ptr<Test::XdgToplevel> shellSurface(Test::createXdgToplevelSurface(surface.get()));
+    QVERIFY(shellSurface);
+    Window *window = Test::renderAndWaitForShown(surface.get(), minimumSize, Qt::blue);
+    QVERIFY(window);
+
+    const QSize delta = maximumSize - minimumSize;
+    for (int frame = 0; frame < s_frameCount; ++frame) {
+        const qreal progress = qreal(frame % 30) / 29;
+        const QSize size(minimumSize.width() + delta.width() * progress,
+                         minimumSize.height() + delta.height() * progress);
+        renderBuffer(surface.get(), size, frameColor(frame));
+        commitAndWaitForFrame(surface.get());
+    }
+
+    report();
+}
+
+void GenericCompositingBenchmark::benchmarkSubsurfaces_data()
+{
+    QTest::addColumn<int>("subsurfaceCount");
+
+    QTest::newRow("16 subsurfaces") << 16;
+    QTest::newRow("64 subsurfaces") << 64;
+}
+
+void GenericCompositingBenchmark::benchmarkSubsurfaces()
+{
+    // This benchmark simulates a client that composes its contents out of many subsurfaces,
+    // e.g. a video player or a web browser, all of which are updated every frame.
+    QFETCH(int, subsurfaceCount);
+
+    startRecording();
+
+    std::unique_ptr<KWayland::Client::Surface> parentSurface(Test::createSurface());
+    QVERIFY(parentSurface);
+    std::unique_ptr<Test::XdgToplevel> shellSurface(Test::createXdgToplevelSurface(parentSurface.get()));
+    QVERIFY(shellSurface);
+
+    const int columns = 8;
+    const QSize tileSize(64, 64);
+    std::vector<std::unique_ptr<KWayland::Client::Surface>> childSurfaces;
+    std::vector<std::unique_ptr<KWayland::Client::SubSurface>> subsurfaces;
+    for (int i = 0; i < subsurfaceCount; ++i) {
+        std::unique_ptr<KWayland::Client::Surface> childSurface(Test::createSurface());
+        QVERIFY(childSurface);
+        std::unique_ptr<KWayland::Client::SubSurface> subsurface(Test::createSubSurface(childSurface.get(), parentSurface.get()));
+        QVERIFY(subsurface);
+        subsurface->setPosition(QPoint((i % columns) * tileSize.width(), (i / columns) * tileSize.height()));
+        Test::render(childSurface.get(), tileSize, frameColor(i));
+        childSurfaces.push_back(std::move(childSurface));
+        subsurfaces.push_back(std::move(subsurface));
+    }
+
+    const int rows = (subsurfaceCount + columns - 1) / columns;
+    const QSize parentSize(columns * tileSize.width(), rows * tileSize.height());
+    Window *window = Test::renderAndWaitForShown(parentSurface.get(), parentSize, Qt::black);
+    QVERIFY(window);
+
+    // The subsurfaces are synchronized, so their state is applied with the parent commit.
+    for (int frame = 0; frame < s_frameCount; ++frame) {
+        for (int i = 0; i < subsurfaceCount; ++i) {
+            Test::render(childSurfaces[i].get(), tileSize, frameColor(frame + i));
+        }
+        commitAndWaitForFrame(parentSurface.get());
+    }
+
+    report();
+}
+
+void GenericCompositingBenchmark::benchmarkEffectAnimations_data()
+{
+    QTest::addColumn<QString>("effectName");
+
+    QTest::newRow("Fade") << QStringLiteral("kwin4_effect_fade");
+    QTest::newRow("Glide") << QStringLiteral("glide");
+    QTest::newRow("Scale") << QStringLiteral("kwin4_effect_scale");
+}
+
+void GenericCompositingBenchmark::benchmarkEffectAnimations()
+{
+    // This benchmark opens and closes windows while an open/close animation effect
+    // is loaded, so most of the painted frames are animated.
+    QFETCH(QString, effectName);
+
+    auto effectsImpl = qobject_cast<EffectsHandlerImpl *>(effects);
+    QVERIFY(effectsImpl);
+    if (!effectsImpl->loadEffect(effectName)) {
+        QSKIP("The effect is not supported by the compositing type");
+    }
+    Effect *effect = effectsImpl->findEffect(effectName);
+    QVERIFY(effect);
+
+    startRecording();
+
+    for (int i = 0; i < 10; ++i) {
+        std::unique_ptr<KWayland::Client::Surface> surface(Test::createSurface());
+        QVERIFY(surface);
+        std::unique_ptr<Test::XdgToplevel> shellSurface(Test::createXdgToplevelSurface(surface.get()));
+        QVERIFY(shellSurface);
+        Window *window = Test::renderAndWaitForShown(surface.get(), QSize(400, 300), frameColor(i));
+        QVERIFY(window);
+
+        // Keep the window busy while it's being animated.
+        while (effect->isActive()) {
+            renderBuffer(surface.get(), QSize(400, 300), frameColor(i + m_commitLatencies.count()));
+            commitAndWaitForFrame(surface.get());
+        }
+
+        QSignalSpy windowClosedSpy(window, &Window::windowClosed);
+        QVERIFY(windowClosedSpy.isValid());
+        shellSurface.reset();
+        surface.reset();
+        QVERIFY(windowClosedSpy.wait());
+        QTRY_VERIFY(!effect->isActive());
+    }
+
+    report();
+}
+
+void GenericCompositingBenchmark::benchmarkEffectDispatch_data()
+{
+    QTest::addColumn<bool>("restricted");
+
+    QTest::newRow("unrestricted") << false;
+    QTest::newRow("restricted") << true;
+}
+
+void GenericCompositingBenchmark::benchmarkEffectDispatch()
+{
+    // This benchmark measures the cost of running the window passes of the effect chain
+    // with 100 windows and 15 active effects. The restricted effects only care about one
+    // window each, so the other windows skip them.
+    QFETCH(bool, restricted);
+    const int windowCount = 100;
+    const int effectCount = 15;
+
+    std::vector<std::unique_ptr<KWayland::Client::Surface>> surfaces;
+    std::vector<std::unique_ptr<Test::XdgToplevel>> shellSurfaces;
+    QVector<Window *> windows;
+    for (int i = 0; i < windowCount; ++i) {
+        std::unique_ptr<KWayland::Client::Surface> surface(Test::createSurface());
+        QVERIFY(surface);
+        std::unique_ptr<Test::XdgToplevel> shellSurface(Test::createXdgToplevelSurface(surface.get()));
+        QVERIFY(shellSurface);
+        Window *window = Test::renderAndWaitForShown(surface.get(), QSize(200, 150), frameColor(i));
+        QVERIFY(window);
+        window->move(QPoint((i * 37) % 1080, (i * 53) % 874));
+        windows.append(window);
+        surfaces.push_back(std::move(surface));
+        shellSurfaces.push_back(std::move(shellSurface));
+    }
+
+    auto effectsImpl = static_cast<EffectsHandlerImpl *>(effects);
+    for (int i = 0; i < effectCount; ++i) {
+        const QString name = QStringLiteral("passthrough%1").arg(i);
+        effectsImpl->addEffect(new PassThroughEffect(restricted ? windows[i]->effectWindow() : nullptr), name);
+        QVERIFY(effectsImpl->isEffectLoaded(name));
+    }
+
+    startRecording();
+    renderFrames(s_frameCount);
+    report();
+}
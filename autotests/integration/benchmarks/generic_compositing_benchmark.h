@@ -0,0 +1,72 @@
+/*
+    KWin - the KDE window manager
+    This file is part of the KDE project.
+
+    SPDX-FileCopyrightText: 2022 KWin contributors
+
+    SPDX-License-Identifier: GPL-2.0-or-later
+*/
+#pragma once
+#include "kwin_wayland_test.h"
+
+#include "renderjournal.h"
+
+#include <QObject>
+
+namespace KWayland
+{
+namespace Client
+{
+class Surface;
+}
+}
+
+/**
+ * The GenericCompositingBenchmark class boots kwin_wayland on the virtual backend with
+ * the compositing type specified by the KWIN_COMPOSE environment variable and runs a set
+ * of scripted Wayland clients against it.
+ *
+ * For every scenario, the benchmark reports the CPU time that the compositor spends
+ * painting a frame, the time between a surface commit and the frame callback, and
+ * the growth of the resident memory of the process.
+ */
+class GenericCompositingBenchmark : public QObject
+{
+    Q_OBJECT
+public:
+    ~GenericCompositingBenchmark() override;
+
+protected:
+    GenericCompositingBenchmark(const QByteArray &envVariable);
+
+private Q_SLOTS:
+    void initTestCase();
+    void init();
+    void cleanup();
+
+    void benchmarkManyWindows_data();
+    void benchmarkManyWindows();
+    void benchmarkRapidResize_data();
+    void benchmarkRapidResize();
+    void benchmarkSubsurfaces_data();
+    void benchmarkSubsurfaces();
+    void benchmarkEffectAnimations_data();
+    void benchmarkEffectAnimations();
+    void benchmarkEffectDispatch_data();
+    void benchmarkEffectDispatch();
+
+private:
+    void startRecording();
+    void stopRecording();
+    void renderFrames(int count);
+    void commitAndWaitForFrame(KWayland::Client::Surface *surface);
+    void report();
+
+    QByteArray m_envVariable;
+    KWin::FrameTimeHistory m_frameTimes;
+    KWin::FrameTimeHistory m_commitLatencies;
+    QMetaObject::Connection m_preFrameRenderConnection;
+    QMetaObject::Connection m_frameRenderedConnection;
+    QElapsedTimer m_frameTimer;
+    qint64 m_residentMemory = 0;
+};
@@ -0,0 +1,178 @@
+/*
+    KWin - the KDE window manager
+    This file is part of the KDE project.
+
+    SPDX-FileCopyrightText: 2022 KWin contributors
+
+    SPDX-License-Identifier: GPL-2.0-or-later
+*/
+#include "kwin_wayland_test.h"
+
+#include "composite.h"
+#include "effectloader.h"
+#include "effects.h"
+#include "platform.h"
+#include "renderbackend.h"
+#include "renderjournal.h"
+#include "scene.h"
+#include "wayland_server.h"
+
+#include <kwinglutils.h>
+
+#include <KConfigGroup>
+
+#include <QTemporaryDir>
+
+using namespace KWin;
+static const QString s_socketName = QStringLiteral("wayland_test_kwin_shadercache_benchmark-0");
+
+static const int s_iterations = 10;
+
+/**
+ * This benchmark measures how long it takes to restart the compositor and to render the
+ * first frame with and without the GL program binary cache, as well as how long it takes
+ * to generate the built-in shaders.
+ */
+class ShaderCacheBenchmark : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+    void initTestCase();
+    void cleanupTestCase();
+
+    void benchmarkStartup_data();
+    void benchmarkStartup();
+
+private:
+    void restartCompositor(std::chrono::nanoseconds *elapsed);
+    void generateShaders(std::chrono::nanoseconds *elapsed);
+
+    QTemporaryDir m_cacheDir;
+};
+
+void ShaderCacheBenchmark::initTestCase()
+{
+    QVERIFY(m_cacheDir.isValid());
+    // Start with an empty program cache.
+    qputenv("XDG_CACHE_HOME", QFile::encodeName(m_cacheDir.path()));
+
+    qRegisterMetaType<KWin::Window *>();
+    QSignalSpy applicationStartedSpy(kwinApp(), &Application::started);
+    QVERIFY(applicationStartedSpy.isValid());
+    kwinApp()->platform()->setInitialWindowSize(QSize(1280, 1024));
+    QVERIFY(waylandServer()->init(s_socketName));
+
+    auto config = KSharedConfig::openConfig(QString(), KConfig::SimpleConfig);
+    KConfigGroup plugins(config, QStringLiteral("Plugins"));
+    const auto builtinNames = EffectLoader().listOfKnownEffects();
+    for (const QString &name : builtinNames) {
+        plugins.writeEntry(name + QStringLiteral("Enabled"), false);
+    }
+    config->sync();
+    kwinApp()->setConfig(config);
+
+    qputenv("KWIN_COMPOSE", QByteArrayLiteral("O2"));
+
+    kwinApp()->start();
+    QVERIFY(applicationStartedSpy.wait());
+    QVERIFY(Compositor::self());
+
+    if (Compositor::self()->backend()->compositingType() != OpenGLCompositing) {
+        QSKIP("OpenGL compositing is not available");
+    }
+}
+
+void ShaderCacheBenchmark::cleanupTestCase()
+{
+    qunsetenv("KWIN_GL_PROGRAM_CACHE");
+}
+
+void ShaderCacheBenchmark::restartCompositor(std::chrono::nanoseconds *elapsed)
+{
+    QElapsedTimer timer;
+    timer.start();
+
+    Compositor::self()->reinitialize();
+    Scene *scene = Compositor::self()->scene();
+    QVERIFY(scene);
+
+    QSignalSpy frameRenderedSpy(scene, &Scene::frameRendered);
+    QVERIFY(frameRenderedSpy.isValid());
+    scene->addRepaintFull();
+    QVERIFY(frameRenderedSpy.wait());
+
+    *elapsed = std::chrono::nanoseconds(timer.nsecsElapsed());
+}
+
+void ShaderCacheBenchmark::generateShaders(std::chrono::nanoseconds *elapsed)
+{
+    QVERIFY(effects->makeOpenGLContextCurrent());
+
+    QElapsedTimer timer;
+    timer.start();
+
+    const ShaderTraits allTraits = ShaderTrait::MapTexture | ShaderTrait::UniformColor | ShaderTrait::Modulate | ShaderTrait::AdjustSaturation;
+    for (int traits = 0; traits <= int(allTraits); ++traits) {
+        ShaderManager::instance()->generateCustomShader(ShaderTraits(QFlag(traits)));
+    }
+
+    *elapsed = std::chrono::nanoseconds(timer.nsecsElapsed());
+}
+
+void ShaderCacheBenchmark::benchmarkStartup_data()
+{
+    QTest::addColumn<bool>("cached");
+
+    QTest::newRow("uncached") << false;
+    QTest::newRow("cached") << true;
+}
+
+void ShaderCacheBenchmark::benchmarkStartup()
+{
+    QFETCH(bool, cached);
+
+    if (cached) {
+        qunsetenv("KWIN_GL_PROGRAM_CACHE");
+        // Populate the cache.
+        std::chrono::nanoseconds elapsed;
+        restartCompositor(&elapsed);
+        generateShaders(&elapsed);
+    } else {
+        qputenv("KWIN_GL_PROGRAM_CACHE", QByteArrayLiteral("0"));
+    }
+
+    FrameTimeHistory startupTimes;
+    FrameTimeHistory generationTimes;
+    for (int i = 0; i < s_iterations; ++i) {
+        std::chrono::nanoseconds elapsed;
+        restartCompositor(&elapsed);
+        if (QTest::currentTestFailed()) {
+            return;
+        }
+        startupTimes.add(elapsed);
+
+        generateShaders(&elapsed);
+        if (QTest::currentTestFailed()) {
+            return;
+        }
+        generationTimes.add(elapsed);
+    }
+
+    const auto toMicroseconds = [](std::chrono::nanoseconds value) {
+        return qlonglong(std::chrono::duration_cast<std::chrono::microseconds>(value).count());
+    };
+    qInfo("restart to first frame: samples %d, p50 %lld us, max %lld us",
+          startupTimes.count(),
+          toMicroseconds(startupTimes.percentile(50)),
+          toMicroseconds(startupTimes.maximum()));
+    qInfo("built-in shader generation: samples %d, p50 %lld us, max %lld us",
+          generationTimes.count(),
+          toMicroseconds(generationTimes.percentile(50)),
+          toMicroseconds(generationTimes.maximum()));
+
+    QTest::setBenchmarkResult(startupTimes.percentile(50).count(), QTest::WalltimeNanoseconds);
+}
+
+WAYLANDTEST_MAIN(ShaderCacheBenchmark)
+#include "shadercache_benchmark.moc"
@@ -0,0 +1,160 @@
+/*
+    KWin - the KDE window manager
+    This file is part of the KDE project.
+
+    SPDX-FileCopyrightText: 2022 KWin contributors
+
+    SPDX-License-Identifier: GPL-2.0-or-later
+*/
+#include "kwin_wayland_test.h"
+
+#include "composite.h"
+#include "platform.h"
+#include "wayland_server.h"
+#include "workspace.h"
+#include "x11window.h"
+
+#include <netwm.h>
+#include <xcb/xcb_icccm.h>
+
+using namespace KWin;
+static const QString s_socketName = QStringLiteral("wayland_test_kwin_x11event_benchmark-0");
+
+static const int s_eventsPerRound = 5000;
+
+struct XcbConnectionDeleter
+{
+    void operator()(xcb_connection_t *pointer)
+    {
+        xcb_disconnect(pointer);
+    }
+};
+
+/**
+ * This benchmark measures how long it takes to dispatch a storm of X11 events, like the ones
+ * sent by a misbehaving application that keeps changing its properties and geometry, while
+ * many other X11 windows are managed.
+ */
+class X11EventBenchmark : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+    void initTestCase();
+
+    void benchmarkEventStorm_data();
+    void benchmarkEventStorm();
+
+private:
+    xcb_window_t createWindow(xcb_connection_t *connection, const QRect &geometry);
+};
+
+void X11EventBenchmark::initTestCase()
+{
+    qRegisterMetaType<KWin::Window *>();
+    QSignalSpy applicationStartedSpy(kwinApp(), &Application::started);
+    QVERIFY(applicationStartedSpy.isValid());
+    kwinApp()->platform()->setInitialWindowSize(QSize(1280, 1024));
+    QVERIFY(waylandServer()->init(s_socketName));
+    kwinApp()->setConfig(KSharedConfig::openConfig(QString(), KConfig::SimpleConfig));
+
+    kwinApp()->start();
+    QVERIFY(applicationStartedSpy.wait());
+    QVERIFY(Compositor::self());
+    Test::initWaylandWorkspace();
+}
+
+xcb_window_t X11EventBenchmark::createWindow(xcb_connection_t *connection, const QRect &geometry)
+{
+    const xcb_window_t windowId = xcb_generate_id(connection);
+    const uint32_t values[] = {XCB_EVENT_MASK_STRUCTURE_NOTIFY | XCB_EVENT_MASK_PROPERTY_CHANGE};
+    xcb_create_window(connection, XCB_COPY_FROM_PARENT, windowId, rootWindow(),
+                      geometry.x(),
+                      geometry.y(),
+                      geometry.width(),
+                      geometry.height(),
+                      0, XCB_WINDOW_CLASS_INPUT_OUTPUT, XCB_COPY_FROM_PARENT, XCB_CW_EVENT_MASK, values);
+    xcb_size_hints_t hints;
+    memset(&hints, 0, sizeof(hints));
+    xcb_icccm_size_hints_set_position(&hints, 1, geometry.x(), geometry.y());
+    xcb_icccm_size_hints_set_size(&hints, 1, geometry.width(), geometry.height());
+    xcb_icccm_set_wm_normal_hints(connection, windowId, &hints);
+    xcb_map_window(connection, windowId);
+    return windowId;
+}
+
+void X11EventBenchmark::benchmarkEventStorm_data()
+{
+    QTest::addColumn<int>("windowCount");
+
+    QTest::newRow("1 window") << 1;
+    QTest::newRow("50 windows") << 50;
+    QTest::newRow("200 windows") << 200;
+}
+
+void X11EventBenchmark::benchmarkEventStorm()
+{
+    QFETCH(int, windowCount);
+
+    std::unique_ptr<xcb_connection_t, XcbConnectionDeleter> c(xcb_connect(nullptr, nullptr));
+    QVERIFY(!xcb_connection_has_error(c.get()));
+
+    QSignalSpy windowAddedSpy(workspace(), &Workspace::windowAdded);
+    QVERIFY(windowAddedSpy.isValid());
+    QVector<xcb_window_t> windowIds;
+    for (int i = 0; i < windowCount; ++i) {
+        windowIds.append(createWindow(c.get(), QRect(i % 100, i % 100, 100, 100)));
+    }
+    xcb_flush(c.get());
+    while (windowAddedSpy.count() < windowCount) {
+        QVERIFY(windowAddedSpy.wait());
+    }
+
+    // The stormy window is the last one, so a linear lookup has to go through all others.
+    const xcb_window_t stormyWindowId = windowIds.last();
+    X11Window *stormyWindow = workspace()->findClient(Predicate::WindowMatch, stormyWindowId);
+    QVERIFY(stormyWindow);
+
+    const QByteArray atomName = QByteArrayLiteral("_KWIN_BENCHMARK_COUNTER");
+    xcb_intern_atom_reply_t *atomReply = xcb_intern_atom_reply(c.get(), xcb_intern_atom(c.get(), false, atomName.length(), atomName.constData()), nullptr);
+    QVERIFY(atomReply);
+    const xcb_atom_t counterAtom = atomReply->atom;
+    free(atomReply);
+
+    NETWinInfo info(c.get(), stormyWindowId, rootWindow(), NET::Properties(), NET::Properties2());
+    QSignalSpy captionChangedSpy(stormyWindow, &X11Window::captionChanged);
+    QVERIFY(captionChangedSpy.isValid());
+
+    int round = 0;
+    QBENCHMARK {
+        // Every property change results in a PropertyNotify, every configure request in a
+        // ConfigureRequest and usually a ConfigureNotify. Nothing in kwin cares about them.
+        for (int i = 0; i < s_eventsPerRound; ++i) {
+            const uint32_t value = i;
+            xcb_change_property(c.get(), XCB_PROP_MODE_REPLACE, stormyWindowId, counterAtom, XCB_ATOM_CARDINAL, 32, 1, &value);
+            if (i % 2) {
+                const uint32_t geometry[] = {100, 100};
+                xcb_configure_window(c.get(), stormyWindowId, XCB_CONFIG_WINDOW_WIDTH | XCB_CONFIG_WINDOW_HEIGHT, geometry);
+            }
+        }
+
+        // The events are processed in order, so kwin is done with the storm once it has
+        // noticed the caption change that follows it.
+        info.setName(QByteArray::number(++round));
+        xcb_flush(c.get());
+        QVERIFY(captionChangedSpy.wait());
+    }
+
+    QSignalSpy windowRemovedSpy(workspace(), &Workspace::windowRemoved);
+    QVERIFY(windowRemovedSpy.isValid());
+    for (xcb_window_t windowId : std::as_const(windowIds)) {
+        xcb_destroy_window(c.get(), windowId);
+    }
+    xcb_flush(c.get());
+    while (windowRemovedSpy.count() < windowCount) {
+        QVERIFY(windowRemovedSpy.wait());
+    }
+}
+
+WAYLANDTEST_MAIN(X11EventBenchmark)
+#include "x11event_benchmark.moc"
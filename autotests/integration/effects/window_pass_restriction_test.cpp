@@ -0,0 +1,189 @@
+/*
+    KWin - the KDE window manager
+    This file is part of the KDE project.
+
+    SPDX-FileCopyrightText: 2022 KWin contributors
+
+    SPDX-License-Identifier: GPL-2.0-or-later
+*/
+
+#include "kwin_wayland_test.h"
+
+#include "composite.h"
+#include "deleted.h"
+#include "effectloader.h"
+#include "effects.h"
+#include "platform.h"
+#include "renderbackend.h"
+#include "wayland_server.h"
+#include "window.h"
+#include "workspace.h"
+
+#include <kwinanimationeffect.h>
+
+#include <KWayland/Client/surface.h>
+
+using namespace KWin;
+
+static const QString s_socketName = QStringLiteral("wayland_test_effects_window_pass_restriction-0");
+
+/**
+ * Records the windows that go through the window passes of the effect.
+ */
+template<typename Base>
+class WindowPassRecorder : public Base
+{
+public:
+    bool isActive() const override
+    {
+        return true;
+    }
+
+    void prePaintWindow(EffectWindow *w, WindowPrePaintData &data, std::chrono::milliseconds presentTime) override
+    {
+        prePaintedWindows.insert(w);
+        Base::prePaintWindow(w, data, presentTime);
+    }
+
+    QSet<EffectWindow *> prePaintedWindows;
+};
+
+class WindowPassRestrictionTest : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+    void initTestCase();
+    void init();
+    void cleanup();
+
+    void testRestrictedEffect();
+    void testAnimationEffectIsNotRestricted();
+
+private:
+    bool paintFrame();
+};
+
+void WindowPassRestrictionTest::initTestCase()
+{
+    qRegisterMetaType<KWin::Window *>();
+    qRegisterMetaType<KWin::Deleted *>();
+    QSignalSpy applicationStartedSpy(kwinApp(), &Application::started);
+    QVERIFY(applicationStartedSpy.isValid());
+    kwinApp()->platform()->setInitialWindowSize(QSize(1280, 1024));
+    QVERIFY(waylandServer()->init(s_socketName));
+
+    auto config = KSharedConfig::openConfig(QString(), KConfig::SimpleConfig);
+    KConfigGroup plugins(config, QStringLiteral("Plugins"));
+    const auto builtinNames = EffectLoader().listOfKnownEffects();
+    for (const QString &name : builtinNames) {
+        plugins.writeEntry(name + QStringLiteral("Enabled"), false);
+    }
+    config->sync();
+    kwinApp()->setConfig(config);
+
+    qputenv("KWIN_COMPOSE", QByteArrayLiteral("O2"));
+
+    kwinApp()->start();
+    QVERIFY(applicationStartedSpy.wait());
+    Test::initWaylandWorkspace();
+
+    QCOMPARE(Compositor::self()->backend()->compositingType(), KWin::OpenGLCompositing);
+}
+
+void WindowPassRestrictionTest::init()
+{
+    QVERIFY(Test::setupWaylandConnection());
+}
+
+void WindowPassRestrictionTest::cleanup()
+{
+    auto effectsImpl = qobject_cast<EffectsHandlerImpl *>(effects);
+    QVERIFY(effectsImpl);
+    effectsImpl->unloadAllEffects();
+    QVERIFY(effectsImpl->loadedEffects().isEmpty());
+
+    Test::destroyWaylandConnection();
+}
+
+bool WindowPassRestrictionTest::paintFrame()
+{
+    QSignalSpy frameRenderedSpy(Compositor::self()->scene(), &Scene::frameRendered);
+    effects->addRepaintFull();
+    return frameRenderedSpy.wait();
+}
+
+void WindowPassRestrictionTest::testRestrictedEffect()
+{
+    // This test verifies that the window passes of a restricted effect are only called
+    // for the windows that have been enabled, while other effects see every window.
+
+    auto effectsImpl = qobject_cast<EffectsHandlerImpl *>(effects);
+    QVERIFY(effectsImpl);
+
+    std::unique_ptr<KWayland::Client::Surface> surface1(Test::createSurface());
+    std::unique_ptr<Test::XdgToplevel> shellSurface1(Test::createXdgToplevelSurface(surface1.get()));
+    Window *window1 = Test::renderAndWaitForShown(surface1.get(), QSize(100, 50), Qt::blue);
+    QVERIFY(window1);
+    std::unique_ptr<KWayland::Client::Surface> surface2(Test::createSurface());
+    std::unique_ptr<Test::XdgToplevel> shellSurface2(Test::createXdgToplevelSurface(surface2.get()));
+    Window *window2 = Test::renderAndWaitForShown(surface2.get(), QSize(100, 50), Qt::red);
+    QVERIFY(window2);
+
+    auto unrestricted = new WindowPassRecorder<Effect>();
+    effectsImpl->addEffect(unrestricted, QStringLiteral("unrestricted"));
+    auto restricted = new WindowPassRecorder<Effect>();
+    effectsImpl->addEffect(restricted, QStringLiteral("restricted"));
+    QVERIFY(effectsImpl->isEffectLoaded(QStringLiteral("unrestricted")));
+    QVERIFY(effectsImpl->isEffectLoaded(QStringLiteral("restricted")));
+    effects->setWindowPassesRestricted(restricted, true);
+
+    const QSet<EffectWindow *> allWindows{window1->effectWindow(), window2->effectWindow()};
+
+    // No window has been enabled for the restricted effect yet.
+    QVERIFY(paintFrame());
+    QVERIFY(unrestricted->prePaintedWindows.contains(allWindows));
+    QVERIFY(!restricted->prePaintedWindows.intersects(allWindows));
+
+    // Only the enabled window goes through the restricted effect.
+    unrestricted->prePaintedWindows.clear();
+    effects->setWindowPassesEnabled(restricted, window1->effectWindow(), true);
+    QVERIFY(paintFrame());
+    QVERIFY(unrestricted->prePaintedWindows.contains(allWindows));
+    QVERIFY(restricted->prePaintedWindows.contains(window1->effectWindow()));
+    QVERIFY(!restricted->prePaintedWindows.contains(window2->effectWindow()));
+
+    // Disabling the window takes it out again.
+    restricted->prePaintedWindows.clear();
+    effects->setWindowPassesEnabled(restricted, window1->effectWindow(), false);
+    QVERIFY(paintFrame());
+    QVERIFY(!restricted->prePaintedWindows.intersects(allWindows));
+
+    // Lifting the restriction lets every window through.
+    effects->setWindowPassesRestricted(restricted, false);
+    QVERIFY(paintFrame());
+    QVERIFY(restricted->prePaintedWindows.contains(allWindows));
+}
+
+void WindowPassRestrictionTest::testAnimationEffectIsNotRestricted()
+{
+    // This test verifies that subclasses of AnimationEffect see every window unless
+    // they restrict their window passes themselves.
+
+    std::unique_ptr<KWayland::Client::Surface> surface(Test::createSurface());
+    std::unique_ptr<Test::XdgToplevel> shellSurface(Test::createXdgToplevelSurface(surface.get()));
+    Window *window = Test::renderAndWaitForShown(surface.get(), QSize(100, 50), Qt::blue);
+    QVERIFY(window);
+
+    auto effectsImpl = qobject_cast<EffectsHandlerImpl *>(effects);
+    QVERIFY(effectsImpl);
+    auto effect = new WindowPassRecorder<AnimationEffect>();
+    effectsImpl->addEffect(effect, QStringLiteral("animation"));
+    QVERIFY(effectsImpl->isEffectLoaded(QStringLiteral("animation")));
+
+    QVERIFY(paintFrame());
+    QVERIFY(effect->prePaintedWindows.contains(window->effectWindow()));
+}
+
+WAYLANDTEST_MAIN(WindowPassRestrictionTest)
+#include "window_pass_restriction_test.moc"
@@ -0,0 +1,176 @@
+/*
+    KWin - the KDE window manager
+    This file is part of the KDE project.
+
+    SPDX-FileCopyrightText: 2022 KWin contributors
+
+    SPDX-License-Identifier: GPL-2.0-or-later
+*/
+#include "kwin_wayland_test.h"
+
+#include "effectloader.h"
+#include "framecallbackthrottler.h"
+#include "platform.h"
+#include "virtualdesktops.h"
+#include "wayland_server.h"
+#include "window.h"
+#include "workspace.h"
+
+#include <KWayland/Client/compositor.h>
+#include <KWayland/Client/region.h>
+#include <KWayland/Client/surface.h>
+
+using namespace KWin;
+
+static const QString s_socketName = QStringLiteral("wayland_test_kwin_frame_callback_throttling-0");
+
+class FrameCallbackThrottlingTest : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+    void initTestCase();
+    void init();
+    void cleanup();
+
+    void testVisible();
+    void testMinimized();
+    void testOtherDesktop();
+    void testOccluded();
+};
+
+void FrameCallbackThrottlingTest::initTestCase()
+{
+    qRegisterMetaType<KWin::Window *>();
+    QSignalSpy applicationStartedSpy(kwinApp(), &Application::started);
+    QVERIFY(applicationStartedSpy.isValid());
+    kwinApp()->platform()->setInitialWindowSize(QSize(1280, 1024));
+    QVERIFY(waylandServer()->init(s_socketName));
+
+    // disable all effects, a minimize animation would keep the window visible
+    auto config = KSharedConfig::openConfig(QString(), KConfig::SimpleConfig);
+    KConfigGroup plugins(config, QStringLiteral("Plugins"));
+    const auto builtinNames = EffectLoader().listOfKnownEffects();
+    for (const QString &name : builtinNames) {
+        plugins.writeEntry(name + QStringLiteral("Enabled"), false);
+    }
+    config->sync();
+    kwinApp()->setConfig(config);
+
+    kwinApp()->start();
+    QVERIFY(applicationStartedSpy.wait());
+    Test::initWaylandWorkspace();
+}
+
+void FrameCallbackThrottlingTest::init()
+{
+    QVERIFY(Test::setupWaylandConnection());
+    VirtualDesktopManager::self()->setCount(2);
+    VirtualDesktopManager::self()->setCurrent(1);
+    waylandServer()->frameCallbackThrottler()->setHiddenRate(0);
+}
+
+void FrameCallbackThrottlingTest::cleanup()
+{
+    Test::destroyWaylandConnection();
+    waylandServer()->frameCallbackThrottler()->setHiddenRate(1);
+}
+
+void FrameCallbackThrottlingTest::testVisible()
+{
+    // This test verifies that a visible window gets its frame callbacks when the output
+    // presents a frame, regardless of the hidden rate.
+
+    std::unique_ptr<KWayland::Client::Surface> surface(Test::createSurface());
+    std::unique_ptr<Test::XdgToplevel> shellSurface(Test::createXdgToplevelSurface(surface.get()));
+    Window *window = Test::renderAndWaitForShown(surface.get(), QSize(100, 50), Qt::blue);
+    QVERIFY(window);
+
+    QSignalSpy frameRenderedSpy(surface.get(), &KWayland::Client::Surface::frameRendered);
+    QVERIFY(frameRenderedSpy.isValid());
+    surface->damage(QRect(0, 0, 100, 50));
+    surface->commit(KWayland::Client::Surface::CommitFlag::FrameCallback);
+    QVERIFY(frameRenderedSpy.wait());
+}
+
+void FrameCallbackThrottlingTest::testMinimized()
+{
+    // This test verifies that a minimized window gets its frame callbacks at the hidden rate.
+
+    std::unique_ptr<KWayland::Client::Surface> surface(Test::createSurface());
+    std::unique_ptr<Test::XdgToplevel> shellSurface(Test::createXdgToplevelSurface(surface.get()));
+    Window *window = Test::renderAndWaitForShown(surface.get(), QSize(100, 50), Qt::blue);
+    QVERIFY(window);
+    window->minimize();
+    QVERIFY(window->isMinimized());
+
+    QSignalSpy frameRenderedSpy(surface.get(), &KWayland::Client::Surface::frameRendered);
+    QVERIFY(frameRenderedSpy.isValid());
+    surface->damage(QRect(0, 0, 100, 50));
+    surface->commit(KWayland::Client::Surface::CommitFlag::FrameCallback);
+    QVERIFY(!frameRenderedSpy.wait(500));
+
+    waylandServer()->frameCallbackThrottler()->setHiddenRate(10);
+    QVERIFY(frameRenderedSpy.wait());
+}
+
+void FrameCallbackThrottlingTest::testOtherDesktop()
+{
+    // This test verifies that a window on another virtual desktop gets its frame callbacks
+    // at the hidden rate.
+
+    std::unique_ptr<KWayland::Client::Surface> surface(Test::createSurface());
+    std::unique_ptr<Test::XdgToplevel> shellSurface(Test::createXdgToplevelSurface(surface.get()));
+    Window *window = Test::renderAndWaitForShown(surface.get(), QSize(100, 50), Qt::blue);
+    QVERIFY(window);
+    workspace()->sendWindowToDesktop(window, 2, true);
+    QVERIFY(!window->isOnCurrentDesktop());
+
+    QSignalSpy frameRenderedSpy(surface.get(), &KWayland::Client::Surface::frameRendered);
+    QVERIFY(frameRenderedSpy.isValid());
+    surface->damage(QRect(0, 0, 100, 50));
+    surface->commit(KWayland::Client::Surface::CommitFlag::FrameCallback);
+    QVERIFY(!frameRenderedSpy.wait(500));
+
+    waylandServer()->frameCallbackThrottler()->setHiddenRate(10);
+    QVERIFY(frameRenderedSpy.wait());
+}
+
+void FrameCallbackThrottlingTest::testOccluded()
+{
+    // This test verifies that a window covered by an opaque window gets its frame callbacks
+    // at the hidden rate, and at the output refresh rate again once it's uncovered.
+
+    std::unique_ptr<KWayland::Client::Surface> surface(Test::createSurface());
+    std::unique_ptr<Test::XdgToplevel> shellSurface(Test::createXdgToplevelSurface(surface.get()));
+    Window *window = Test::renderAndWaitForShown(surface.get(), QSize(100, 50), Qt::blue);
+    QVERIFY(window);
+    window->move(QPoint(100, 100));
+
+    std::unique_ptr<KWayland::Client::Surface> coverSurface(Test::createSurface());
+    std::unique_ptr<Test::XdgToplevel> coverShellSurface(Test::createXdgToplevelSurface(coverSurface.get()));
+    std::unique_ptr<KWayland::Client::Region> opaqueRegion(Test::waylandCompositor()->createRegion(QRegion(0, 0, 500, 500)));
+    coverSurface->setOpaqueRegion(opaqueRegion.get());
+    Window *coverWindow = Test::renderAndWaitForShown(coverSurface.get(), QSize(500, 500), Qt::red);
+    QVERIFY(coverWindow);
+    coverWindow->move(QPoint(0, 0));
+    QVERIFY(workspace()->stackingOrder().indexOf(coverWindow) > workspace()->stackingOrder().indexOf(window));
+
+    QSignalSpy frameRenderedSpy(surface.get(), &KWayland::Client::Surface::frameRendered);
+    QVERIFY(frameRenderedSpy.isValid());
+    surface->damage(QRect(0, 0, 100, 50));
+    surface->commit(KWayland::Client::Surface::CommitFlag::FrameCallback);
+    QVERIFY(!frameRenderedSpy.wait(500));
+
+    waylandServer()->frameCallbackThrottler()->setHiddenRate(10);
+    QVERIFY(frameRenderedSpy.wait());
+
+    waylandServer()->frameCallbackThrottler()->setHiddenRate(0);
+    coverWindow->move(QPoint(600, 0));
+    surface->damage(QRect(0, 0, 100, 50));
+    surface->commit(KWayland::Client::Surface::CommitFlag::FrameCallback);
+    QVERIFY(frameRenderedSpy.wait());
+}
+
+WAYLANDTEST_MAIN(FrameCallbackThrottlingTest)
+#include "frame_callback_throttling_test.moc"
@@ -16,6 +16,9 @@
 #include "wayland_server.h"
 #include "window.h"
 
+#include <kwingltexture.h>
+#include <kwinglrendertargetpool.h>
+
 #include <KConfigGroup>
 
 using namespace KWin;
@@ -86,3 +89,65 @@ void GenericSceneOpenGLTest::testRestart()
     // TODO: introduce frameRendered signal in SceneOpenGL
     QTest::qWait(100);
 }
+
+void GenericSceneOpenGLTest::testRenderTargetPool()
+{
+    QVERIFY(Compositor::self()->scene()->makeOpenGLContextCurrent());
+    GLRenderTargetPool *pool = GLRenderTargetPool::instance();
+    pool->trim();
+    const qint64 budget = pool->budget();
+
+    // Dimensions are rounded up to 64 pixels, or 1/8 of the next power of two.
+    QCOMPARE(pool->bucketSize(QSize(1, 1)), QSize(64, 64));
+    QCOMPARE(pool->bucketSize(QSize(64, 65)), QSize(64, 128));
+    QCOMPARE(pool->bucketSize(QSize(1000, 600)), QSize(1024, 640));
+
+    // The budget fits two render targets, the least recently released one is evicted.
+    const qint64 targetBytes = 64 * 64 * 4;
+    pool->setBudget(2 * targetBytes);
+    GLRenderTarget first = pool->acquire(QSize(64, 64));
+    if (!first.isValid()) {
+        pool->setBudget(budget);
+        QSKIP("Framebuffer objects are not supported");
+    }
+    GLRenderTarget second = pool->acquire(QSize(64, 64));
+    GLRenderTarget third = pool->acquire(QSize(64, 64));
+    QVERIFY(second.isValid());
+    QVERIFY(third.isValid());
+    const GLTexture *secondTexture = second.texture.get();
+    const GLTexture *thirdTexture = third.texture.get();
+
+    const GLRenderTargetPool::Statistics before = pool->statistics();
+    pool->release(std::move(first));
+    pool->release(std::move(second));
+    pool->release(std::move(third));
+    GLRenderTargetPool::Statistics statistics = pool->statistics();
+    QCOMPARE(statistics.pooledCount, 2);
+    QCOMPARE(statistics.pooledBytes, 2 * targetBytes);
+    QCOMPARE(statistics.evictions, before.evictions + 1);
+
+    // The most recently released render target of the right size and format is reused.
+    GLRenderTarget reused = pool->acquire(QSize(64, 64));
+    QCOMPARE(reused.texture.get(), thirdTexture);
+    QCOMPARE(pool->statistics().hits, before.hits + 1);
+    reused = pool->acquire(QSize(64, 64));
+    QCOMPARE(reused.texture.get(), secondTexture);
+    QCOMPARE(pool->statistics().pooledCount, 0);
+    pool->release(std::move(reused));
+
+    // Render targets larger than the budget are not pooled.
+    pool->release(pool->acquire(QSize(128, 128)));
+    statistics = pool->statistics();
+    QCOMPARE(statistics.rejections, before.rejections + 1);
+    QCOMPARE(statistics.pooledCount, 1);
+
+    // Render targets that have been in the pool for long enough are destroyed.
+    pool->trimUnused(std::chrono::hours(1));
+    QCOMPARE(pool->statistics().pooledCount, 1);
+    pool->trimUnused(std::chrono::milliseconds::zero());
+    QCOMPARE(pool->statistics().pooledCount, 0);
+    QCOMPARE(pool->statistics().pooledBytes, 0);
+
+    pool->setBudget(budget);
+    Compositor::self()->scene()->doneOpenGLContextCurrent();
+}
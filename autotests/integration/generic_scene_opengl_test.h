@@ -23,6 +23,7 @@ private Q_SLOTS:
     void initTestCase();
     void cleanup();
     void testRestart();
+    void testRenderTargetPool();
 
 private:
     QByteArray m_envVariable;
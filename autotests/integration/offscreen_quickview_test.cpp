@@ -0,0 +1,138 @@
+/*
+    KWin - the KDE window manager
+    This file is part of the KDE project.
+
+    SPDX-FileCopyrightText: 2022 KWin contributors
+
+    SPDX-License-Identifier: GPL-2.0-or-later
+*/
+#include "kwin_wayland_test.h"
+
+#include "composite.h"
+#include "effectloader.h"
+#include "platform.h"
+#include "renderbackend.h"
+#include "wayland_server.h"
+
+#include <kwingltexture.h>
+#include <kwinoffscreenquickview.h>
+
+#include <KConfigGroup>
+
+#include <QQuickWindow>
+
+using namespace KWin;
+
+static const QString s_socketName = QStringLiteral("wayland_test_kwin_offscreen_quickview-0");
+
+class OffscreenQuickViewTest : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+    void initTestCase();
+
+    void testResizeWhileRendering();
+    void testHideWhileRendering();
+};
+
+static QSize nativeSize(OffscreenQuickView *view)
+{
+    return view->size() * view->window()->effectiveDevicePixelRatio();
+}
+
+static QSize shownSize(OffscreenQuickView *view)
+{
+    if (!effects->makeOpenGLContextCurrent()) {
+        return QSize();
+    }
+    const GLTexture *texture = view->bufferAsTexture();
+    return texture ? texture->size() : QSize();
+}
+
+void OffscreenQuickViewTest::initTestCase()
+{
+    QSignalSpy applicationStartedSpy(kwinApp(), &Application::started);
+    QVERIFY(applicationStartedSpy.isValid());
+    kwinApp()->platform()->setInitialWindowSize(QSize(1280, 1024));
+    QVERIFY(waylandServer()->init(s_socketName));
+
+    // disable all effects, only the view under test should render
+    auto config = KSharedConfig::openConfig(QString(), KConfig::SimpleConfig);
+    KConfigGroup plugins(config, QStringLiteral("Plugins"));
+    const auto builtinNames = EffectLoader().listOfKnownEffects();
+    for (const QString &name : builtinNames) {
+        plugins.writeEntry(name + QStringLiteral("Enabled"), false);
+    }
+    config->sync();
+    kwinApp()->setConfig(config);
+
+    qputenv("KWIN_COMPOSE", QByteArrayLiteral("O2"));
+    qputenv("KWIN_OFFSCREENQUICKVIEW_THREADED", QByteArrayLiteral("1"));
+
+    kwinApp()->start();
+    QVERIFY(applicationStartedSpy.wait());
+    QCOMPARE(Compositor::self()->backend()->compositingType(), KWin::OpenGLCompositing);
+}
+
+void OffscreenQuickViewTest::testResizeWhileRendering()
+{
+    // This test verifies that a view rendered in a dedicated thread keeps showing its last
+    // frame while it's being resized, and shows a frame of the final size eventually.
+
+    OffscreenQuickView view(nullptr);
+    if (!view.isThreaded()) {
+        QSKIP("The scene graph can't be rendered in a dedicated thread");
+    }
+    view.setAutomaticRepaint(false);
+    view.setGeometry(QRect(0, 0, 100, 100));
+
+    QSignalSpy repaintNeededSpy(&view, &OffscreenQuickView::repaintNeeded);
+    QVERIFY(repaintNeededSpy.isValid());
+    view.update();
+    QVERIFY(repaintNeededSpy.wait());
+    QCOMPARE(shownSize(&view), nativeSize(&view));
+
+    // Resize the view while frames are in flight, it must never run out of frames to show.
+    for (int i = 1; i <= 20; ++i) {
+        view.setGeometry(QRect(0, 0, 100 + i * 10, 100 + i * 5));
+        view.update();
+        QVERIFY(shownSize(&view).isValid());
+        QCoreApplication::processEvents();
+        QVERIFY(shownSize(&view).isValid());
+    }
+
+    QTRY_COMPARE(shownSize(&view), nativeSize(&view));
+}
+
+void OffscreenQuickViewTest::testHideWhileRendering()
+{
+    // This test verifies that hiding a view while a frame is in flight releases its resources
+    // without pulling the shown frame from under the compositor, and that it renders again
+    // once it's shown.
+
+    OffscreenQuickView view(nullptr);
+    if (!view.isThreaded()) {
+        QSKIP("The scene graph can't be rendered in a dedicated thread");
+    }
+    view.setAutomaticRepaint(false);
+    view.setGeometry(QRect(0, 0, 100, 100));
+
+    QSignalSpy repaintNeededSpy(&view, &OffscreenQuickView::repaintNeeded);
+    QVERIFY(repaintNeededSpy.isValid());
+    view.update();
+    QVERIFY(repaintNeededSpy.wait());
+    QVERIFY(shownSize(&view).isValid());
+
+    view.setGeometry(QRect(0, 0, 200, 150));
+    view.update();
+    view.hide();
+    QTRY_VERIFY(!shownSize(&view).isValid());
+
+    view.show();
+    view.update();
+    QTRY_COMPARE(shownSize(&view), nativeSize(&view));
+}
+
+WAYLANDTEST_MAIN(OffscreenQuickViewTest)
+#include "offscreen_quickview_test.moc"
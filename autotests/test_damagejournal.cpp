@@ -0,0 +1,201 @@
+/*
+    KWin - the KDE window manager
+    This file is part of the KDE project.
+
+    SPDX-FileCopyrightText: 2022 KWin contributors
+
+    SPDX-License-Identifier: GPL-2.0-or-later
+*/
+
+#include <QTest>
+
+#include "utils/damagejournal.h"
+
+using namespace KWin;
+
+/**
+ * The list based damage journal that was used before the ring buffer, kept as a baseline
+ * for the benchmarks.
+ */
+class ListDamageJournal
+{
+public:
+    void add(const QRegion &region)
+    {
+        while (m_log.size() >= m_capacity) {
+            m_log.takeLast();
+        }
+        m_log.prepend(region);
+    }
+
+    QRegion accumulate(int bufferAge, const QRegion &fallback = QRegion()) const
+    {
+        QRegion region;
+        if (bufferAge > 0 && bufferAge <= m_log.size()) {
+            for (int i = 0; i < bufferAge - 1; ++i) {
+                region |= m_log[i];
+            }
+        } else {
+            region = fallback;
+        }
+        return region;
+    }
+
+private:
+    QList<QRegion> m_log;
+    int m_capacity = 10;
+};
+
+// Generates a region that resembles the damage of a chatty client, e.g. a terminal
+// emulator that damages every glyph cell separately.
+static QRegion chattyRegion(int seed, int rectCount)
+{
+    QRegion region;
+    for (int i = 0; i < rectCount; ++i) {
+        const int cell = (seed * 7919 + i * 104729) % 4096;
+        region += QRect((cell % 64) * 30, (cell / 64) * 17, 9, 15);
+    }
+    return region;
+}
+
+class TestDamageJournal : public QObject
+{
+    Q_OBJECT
+private Q_SLOTS:
+    void accumulate();
+    void fallback();
+    void capacity();
+    void clear();
+    void simplify();
+    void benchmarkList_data();
+    void benchmarkList();
+    void benchmarkRing_data();
+    void benchmarkRing();
+};
+
+void TestDamageJournal::accumulate()
+{
+    DamageJournal journal;
+    journal.add(QRect(0, 0, 10, 10));
+    journal.add(QRect(10, 0, 10, 10));
+    journal.add(QRect(20, 0, 10, 10));
+
+    QCOMPARE(journal.lastDamage(), QRegion(20, 0, 10, 10));
+    QCOMPARE(journal.accumulate(1), QRegion());
+    QCOMPARE(journal.accumulate(2), QRegion(20, 0, 10, 10));
+    QCOMPARE(journal.accumulate(3), QRegion(10, 0, 20, 10));
+    QCOMPARE(journal.accumulate(4), QRegion(0, 0, 30, 10));
+}
+
+void TestDamageJournal::fallback()
+{
+    DamageJournal journal;
+    QCOMPARE(journal.lastDamage(), QRegion());
+    QCOMPARE(journal.accumulate(1, QRegion(0, 0, 100, 100)), QRegion(0, 0, 100, 100));
+
+    journal.add(QRect(0, 0, 10, 10));
+    QCOMPARE(journal.accumulate(0, QRegion(0, 0, 100, 100)), QRegion(0, 0, 100, 100));
+    QCOMPARE(journal.accumulate(2, QRegion(0, 0, 100, 100)), QRegion(0, 0, 100, 100));
+}
+
+void TestDamageJournal::capacity()
+{
+    DamageJournal journal;
+    journal.setCapacity(2);
+    QCOMPARE(journal.capacity(), 2);
+
+    journal.add(QRect(0, 0, 10, 10));
+    journal.add(QRect(10, 0, 10, 10));
+    journal.add(QRect(20, 0, 10, 10));
+    QCOMPARE(journal.accumulate(2), QRegion(20, 0, 10, 10));
+    QCOMPARE(journal.accumulate(3, QRegion(0, 0, 100, 100)), QRegion(0, 0, 100, 100));
+
+    journal.setCapacity(DamageJournal::maximumCapacity + 1);
+    QCOMPARE(journal.capacity(), DamageJournal::maximumCapacity);
+}
+
+void TestDamageJournal::clear()
+{
+    DamageJournal journal;
+    journal.add(QRect(0, 0, 10, 10));
+    journal.add(QRect(10, 0, 10, 10));
+    journal.clear();
+    QCOMPARE(journal.lastDamage(), QRegion());
+    QCOMPARE(journal.accumulate(2, QRegion(0, 0, 100, 100)), QRegion(0, 0, 100, 100));
+}
+
+void TestDamageJournal::simplify()
+{
+    DamageJournal journal;
+    journal.setMaxRectCount(16);
+
+    const QRegion damage = chattyRegion(1, 500);
+    QVERIFY(damage.rectCount() > 16);
+
+    journal.add(damage);
+    const QRegion simplified = journal.lastDamage();
+    QVERIFY(simplified.rectCount() <= 16);
+    QVERIFY((damage - simplified).isEmpty());
+
+    journal.add(chattyRegion(2, 500));
+    const QRegion accumulated = journal.accumulate(3);
+    QVERIFY(accumulated.rectCount() <= 16);
+    QVERIFY((damage - accumulated).isEmpty());
+
+    journal.setMaxRectCount(0);
+    journal.add(damage);
+    QCOMPARE(journal.lastDamage(), damage);
+}
+
+void TestDamageJournal::benchmarkList_data()
+{
+    QTest::addColumn<int>("rectCount");
+
+    QTest::addRow("10 rects") << 10;
+    QTest::addRow("100 rects") << 100;
+    QTest::addRow("500 rects") << 500;
+}
+
+void TestDamageJournal::benchmarkList()
+{
+    QFETCH(int, rectCount);
+
+    QVector<QRegion> damage;
+    for (int i = 0; i < 10; ++i) {
+        damage.append(chattyRegion(i, rectCount));
+    }
+
+    ListDamageJournal journal;
+    int frame = 0;
+    QBENCHMARK {
+        journal.add(damage[frame++ % damage.count()]);
+        const QRegion region = journal.accumulate(3);
+        Q_UNUSED(region)
+    }
+}
+
+void TestDamageJournal::benchmarkRing_data()
+{
+    benchmarkList_data();
+}
+
+void TestDamageJournal::benchmarkRing()
+{
+    QFETCH(int, rectCount);
+
+    QVector<QRegion> damage;
+    for (int i = 0; i < 10; ++i) {
+        damage.append(chattyRegion(i, rectCount));
+    }
+
+    DamageJournal journal;
+    int frame = 0;
+    QBENCHMARK {
+        journal.add(damage[frame++ % damage.count()]);
+        const QRegion region = journal.accumulate(3);
+        Q_UNUSED(region)
+    }
+}
+
+QTEST_GUILESS_MAIN(TestDamageJournal)
+#include "test_damagejournal.moc"
@@ -0,0 +1,89 @@
+/*
+    KWin - the KDE window manager
+    This file is part of the KDE project.
+
+    SPDX-FileCopyrightText: 2022 KWin contributors
+
+    SPDX-License-Identifier: GPL-2.0-or-later
+*/
+
+#include <QTest>
+
+#include "effectprofiler.h"
+
+#include <thread>
+
+using namespace KWin;
+using namespace std::chrono_literals;
+
+class TestEffectProfiler : public QObject
+{
+    Q_OBJECT
+private Q_SLOTS:
+    void outsideFrame();
+    void passes();
+    void selfTime();
+};
+
+void TestEffectProfiler::outsideFrame()
+{
+    // Calls outside of a frame are not recorded.
+    EffectProfiler profiler(false);
+    profiler.begin(0, EffectProfiler::PaintScreen);
+    profiler.end();
+    profiler.endFrame();
+    QVERIFY(profiler.timings().isEmpty());
+}
+
+void TestEffectProfiler::passes()
+{
+    EffectProfiler profiler(false);
+    const QVector<QString> effects{QStringLiteral("blur"), QStringLiteral("slide")};
+
+    for (int frame = 0; frame < 3; ++frame) {
+        profiler.beginFrame(QStringLiteral("DP-1"), effects);
+        profiler.begin(0, EffectProfiler::PrePaintScreen);
+        profiler.begin(1, EffectProfiler::PrePaintScreen);
+        profiler.end();
+        profiler.end();
+
+        // The window passes are run for every window, but they're summed per frame.
+        for (int window = 0; window < 2; ++window) {
+            profiler.begin(1, EffectProfiler::PaintWindow);
+            profiler.begin(2, EffectProfiler::PaintWindow);
+            profiler.end();
+            profiler.end();
+        }
+        profiler.endFrame();
+    }
+
+    const auto &timings = profiler.timings();
+    QCOMPARE(timings.count(), 4);
+    QCOMPARE(timings.value({QStringLiteral("DP-1"), QStringLiteral("blur"), EffectProfiler::PrePaintScreen}).cpuTimes.count(), 3);
+    QCOMPARE(timings.value({QStringLiteral("DP-1"), QStringLiteral("slide"), EffectProfiler::PrePaintScreen}).cpuTimes.count(), 3);
+    QCOMPARE(timings.value({QStringLiteral("DP-1"), QStringLiteral("slide"), EffectProfiler::PaintWindow}).cpuTimes.count(), 3);
+    QCOMPARE(timings.value({QStringLiteral("DP-1"), QStringLiteral("(scene)"), EffectProfiler::PaintWindow}).cpuTimes.count(), 3);
+    QVERIFY(!timings.contains({QStringLiteral("DP-1"), QStringLiteral("blur"), EffectProfiler::PaintWindow}));
+}
+
+void TestEffectProfiler::selfTime()
+{
+    // The time spent further down the chain is not attributed to the effect.
+    EffectProfiler profiler(false);
+    profiler.beginFrame(QStringLiteral("DP-1"), {QStringLiteral("blur")});
+    profiler.begin(0, EffectProfiler::PaintScreen);
+    profiler.begin(1, EffectProfiler::PaintScreen);
+    std::this_thread::sleep_for(20ms);
+    profiler.end();
+    profiler.end();
+    profiler.endFrame();
+
+    const auto &timings = profiler.timings();
+    const auto effectTime = timings.value({QStringLiteral("DP-1"), QStringLiteral("blur"), EffectProfiler::PaintScreen}).cpuTimes.maximum();
+    const auto sceneTime = timings.value({QStringLiteral("DP-1"), QStringLiteral("(scene)"), EffectProfiler::PaintScreen}).cpuTimes.maximum();
+    QVERIFY(sceneTime >= 20ms);
+    QVERIFY(effectTime < 10ms);
+}
+
+QTEST_MAIN(TestEffectProfiler)
+#include "test_effectprofiler.moc"
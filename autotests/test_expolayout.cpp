@@ -0,0 +1,129 @@
+/*
+    KWin - the KDE window manager
+    This file is part of the KDE project.
+
+    SPDX-FileCopyrightText: 2022 KWin contributors
+
+    SPDX-License-Identifier: GPL-2.0-or-later
+*/
+#include "expolayout.h"
+
+#include <QRandomGenerator>
+#include <QtTest>
+
+#include <memory>
+#include <vector>
+
+// QQuickItem::ensurePolished() needs Qt 6.3, call updatePolish() directly instead.
+class PolishableExpoLayout : public ExpoLayout
+{
+public:
+    void polishNow()
+    {
+        updatePolish();
+    }
+};
+
+class TestExpoLayout : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+    void testLayout_data();
+    void testLayout();
+    void benchmarkLayout_data();
+    void benchmarkLayout();
+
+private:
+    void populate(ExpoLayout *layout, std::vector<std::unique_ptr<ExpoCell>> &cells, int count);
+};
+
+void TestExpoLayout::populate(ExpoLayout *layout, std::vector<std::unique_ptr<ExpoCell>> &cells, int count)
+{
+    // The windows are scattered over the screen, like on a busy desktop.
+    QRandomGenerator random(count);
+    layout->setSize(QSizeF(2560, 1440));
+    for (int i = 0; i < count; ++i) {
+        auto cell = std::make_unique<ExpoCell>();
+        cell->setNaturalX(random.bounded(0, 2200));
+        cell->setNaturalY(random.bounded(0, 1200));
+        cell->setNaturalWidth(random.bounded(200, 1400));
+        cell->setNaturalHeight(random.bounded(150, 900));
+        cell->setPersistentKey(QString::number(i));
+        cell->setLayout(layout);
+        cells.push_back(std::move(cell));
+    }
+}
+
+void TestExpoLayout::testLayout_data()
+{
+    QTest::addColumn<ExpoLayout::LayoutMode>("mode");
+    QTest::addColumn<bool>("fillGaps");
+    QTest::addColumn<int>("count");
+
+    QTest::newRow("closest, 1 cell") << ExpoLayout::LayoutClosest << false << 1;
+    QTest::newRow("closest, 37 cells") << ExpoLayout::LayoutClosest << false << 37;
+    QTest::newRow("natural, 1 cell") << ExpoLayout::LayoutNatural << false << 1;
+    QTest::newRow("natural, 37 cells") << ExpoLayout::LayoutNatural << false << 37;
+    QTest::newRow("natural, 37 cells, fill gaps") << ExpoLayout::LayoutNatural << true << 37;
+}
+
+void TestExpoLayout::testLayout()
+{
+    QFETCH(ExpoLayout::LayoutMode, mode);
+    QFETCH(bool, fillGaps);
+    QFETCH(int, count);
+
+    PolishableExpoLayout layout;
+    layout.setMode(mode);
+    layout.setFillGaps(fillGaps);
+    std::vector<std::unique_ptr<ExpoCell>> cells;
+    populate(&layout, cells, count);
+
+    layout.polishNow();
+    QVERIFY(layout.isReady());
+
+    // Every cell must be visible and no two cells may overlap.
+    const QRect area(0, 0, layout.width(), layout.height());
+    for (size_t i = 0; i < cells.size(); ++i) {
+        const QRect rect(cells[i]->x(), cells[i]->y(), cells[i]->width(), cells[i]->height());
+        QVERIFY(!rect.isEmpty());
+        QVERIFY(area.contains(rect));
+        for (size_t j = i + 1; j < cells.size(); ++j) {
+            const QRect other(cells[j]->x(), cells[j]->y(), cells[j]->width(), cells[j]->height());
+            QVERIFY(!rect.intersects(other));
+        }
+    }
+}
+
+void TestExpoLayout::benchmarkLayout_data()
+{
+    QTest::addColumn<ExpoLayout::LayoutMode>("mode");
+    QTest::addColumn<int>("count");
+
+    const int counts[] = {10, 50, 100, 250, 500};
+    for (int count : counts) {
+        QTest::addRow("closest, %d cells", count) << ExpoLayout::LayoutClosest << count;
+    }
+    for (int count : counts) {
+        QTest::addRow("natural, %d cells", count) << ExpoLayout::LayoutNatural << count;
+    }
+}
+
+void TestExpoLayout::benchmarkLayout()
+{
+    QFETCH(ExpoLayout::LayoutMode, mode);
+    QFETCH(int, count);
+
+    PolishableExpoLayout layout;
+    layout.setMode(mode);
+    std::vector<std::unique_ptr<ExpoCell>> cells;
+    populate(&layout, cells, count);
+
+    QBENCHMARK {
+        layout.polishNow();
+    }
+}
+
+QTEST_MAIN(TestExpoLayout)
+#include "test_expolayout.moc"
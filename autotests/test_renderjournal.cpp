@@ -0,0 +1,112 @@
+/*
+    KWin - the KDE window manager
+    This file is part of the KDE project.
+
+    SPDX-FileCopyrightText: 2022 KWin contributors
+
+    SPDX-License-Identifier: GPL-2.0-or-later
+*/
+
+#include <QTest>
+
+#include "renderjournal.h"
+
+using namespace KWin;
+using namespace std::chrono_literals;
+
+class TestRenderJournal : public QObject
+{
+    Q_OBJECT
+private Q_SLOTS:
+    void empty();
+    void statistics();
+    void wrapAround();
+    void percentile_data();
+    void percentile();
+    void toVariantMap();
+};
+
+void TestRenderJournal::empty()
+{
+    FrameTimeHistory history;
+    QCOMPARE(history.count(), 0);
+    QCOMPARE(history.minimum(), 0ns);
+    QCOMPARE(history.maximum(), 0ns);
+    QCOMPARE(history.average(), 0ns);
+    QCOMPARE(history.percentile(90), 0ns);
+}
+
+void TestRenderJournal::statistics()
+{
+    FrameTimeHistory history;
+    history.add(4ms);
+    history.add(2ms);
+    history.add(6ms);
+
+    QCOMPARE(history.count(), 3);
+    QCOMPARE(history.minimum(), std::chrono::nanoseconds(2ms));
+    QCOMPARE(history.maximum(), std::chrono::nanoseconds(6ms));
+    QCOMPARE(history.average(), std::chrono::nanoseconds(4ms));
+
+    // only the most recent samples are taken into account
+    QCOMPARE(history.minimum(2), std::chrono::nanoseconds(2ms));
+    QCOMPARE(history.maximum(2), std::chrono::nanoseconds(6ms));
+    QCOMPARE(history.average(2), std::chrono::nanoseconds(4ms));
+    QCOMPARE(history.average(1), std::chrono::nanoseconds(6ms));
+}
+
+void TestRenderJournal::wrapAround()
+{
+    FrameTimeHistory history;
+    for (int i = 1; i <= FrameTimeHistory::capacity * 2; ++i) {
+        history.add(std::chrono::milliseconds(i));
+    }
+
+    QCOMPARE(history.count(), FrameTimeHistory::capacity);
+    QCOMPARE(history.minimum(), std::chrono::nanoseconds(std::chrono::milliseconds(FrameTimeHistory::capacity + 1)));
+    QCOMPARE(history.maximum(), std::chrono::nanoseconds(std::chrono::milliseconds(FrameTimeHistory::capacity * 2)));
+    QCOMPARE(history.minimum(1), std::chrono::nanoseconds(std::chrono::milliseconds(FrameTimeHistory::capacity * 2)));
+}
+
+void TestRenderJournal::percentile_data()
+{
+    QTest::addColumn<int>("percent");
+    QTest::addColumn<std::chrono::nanoseconds>("expected");
+
+    QTest::addRow("p0") << 0 << std::chrono::nanoseconds(1ms);
+    QTest::addRow("p50") << 50 << std::chrono::nanoseconds(50ms);
+    QTest::addRow("p90") << 90 << std::chrono::nanoseconds(90ms);
+    QTest::addRow("p99") << 99 << std::chrono::nanoseconds(99ms);
+    QTest::addRow("p100") << 100 << std::chrono::nanoseconds(100ms);
+}
+
+void TestRenderJournal::percentile()
+{
+    FrameTimeHistory history;
+    // insert the samples in a shuffled order
+    for (int i = 0; i < 100; ++i) {
+        history.add(std::chrono::milliseconds((i * 37) % 100 + 1));
+    }
+
+    QFETCH(int, percent);
+    QFETCH(std::chrono::nanoseconds, expected);
+    QCOMPARE(history.percentile(percent), expected);
+}
+
+void TestRenderJournal::toVariantMap()
+{
+    FrameTimeHistory history;
+    history.add(4ms);
+    history.add(2ms);
+    history.add(6ms);
+
+    const QVariantMap map = history.toVariantMap();
+    QCOMPARE(map.value(QStringLiteral("samples")).toInt(), 3);
+    QCOMPARE(map.value(QStringLiteral("minimum")).toLongLong(), 2000);
+    QCOMPARE(map.value(QStringLiteral("average")).toLongLong(), 4000);
+    QCOMPARE(map.value(QStringLiteral("p50")).toLongLong(), 4000);
+    QCOMPARE(map.value(QStringLiteral("maximum")).toLongLong(), 6000);
+}
+
+QTEST_GUILESS_MAIN(TestRenderJournal)
+#include "test_renderjournal.moc"
@@ -0,0 +1,148 @@
+/*
+    KWin - the KDE window manager
+    This file is part of the KDE project.
+
+    SPDX-FileCopyrightText: 2022 KWin contributors
+
+    SPDX-License-Identifier: GPL-2.0-or-later
+*/
+#include "wobblymesh.h"
+
+#include <QtTest>
+
+#include <vector>
+
+using namespace KWin;
+
+static const WobblyMesh::Parameters s_parameters = {
+    0.10f, // stiffness
+    0.85f, // drag
+    0.10f, // move factor
+    0.0f, // min velocity
+    1000.0f, // max velocity
+    0.0f, // min acceleration
+    1000.0f, // max acceleration
+};
+
+class TestWobblyMesh : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+    void testRest();
+    void testSettle();
+    void testPinnedEdges();
+    void benchmarkDrag_data();
+    void benchmarkDrag();
+};
+
+void TestWobblyMesh::testRest()
+{
+    const QRectF geometry(100, 50, 800, 600);
+    WobblyMesh mesh;
+    mesh.reset(geometry);
+    mesh.step(geometry, 10, s_parameters);
+
+    QVERIFY(mesh.accelerationSum() < 0.01);
+    QVERIFY(mesh.velocitySum() < 0.01);
+
+    // A mesh at rest maps the unit square onto the window.
+    const WobblyMesh::Curve top = mesh.curveAt(0);
+    const WobblyMesh::Curve bottom = mesh.curveAt(1);
+    QCOMPARE(top.pointAt(0), geometry.topLeft());
+    QCOMPARE(top.pointAt(1), geometry.topRight());
+    QCOMPARE(bottom.pointAt(0), geometry.bottomLeft());
+    QCOMPARE(bottom.pointAt(1), geometry.bottomRight());
+}
+
+void TestWobblyMesh::testSettle()
+{
+    QRectF geometry(100, 50, 800, 600);
+    WobblyMesh mesh;
+    mesh.reset(geometry);
+    mesh.setConstrained(mesh.pointAt(geometry, QPointF(400, 60)), true);
+
+    for (int i = 0; i < 50; ++i) {
+        geometry.translate(7, 3);
+        mesh.step(geometry, 10, s_parameters);
+    }
+    QVERIFY(mesh.velocitySum() > 0.5);
+
+    // The mesh comes to rest once the window stops moving.
+    for (int i = 0; i < 500; ++i) {
+        mesh.step(geometry, 10, s_parameters);
+    }
+    QVERIFY(mesh.accelerationSum() < 0.5);
+    QVERIFY(mesh.velocitySum() < 0.5);
+
+    const QPointF center = mesh.curveAt(0.5).pointAt(0.5);
+    QVERIFY(std::abs(center.x() - geometry.center().x()) < 1);
+    QVERIFY(std::abs(center.y() - geometry.center().y()) < 1);
+}
+
+void TestWobblyMesh::testPinnedEdges()
+{
+    const QRectF geometry(0, 0, 300, 300);
+    WobblyMesh mesh;
+    mesh.reset(geometry);
+    for (int i = 0; i < WobblyMesh::Count; ++i) {
+        mesh.setVelocity(i, QPointF(50, 50));
+    }
+
+    mesh.step(geometry, 10, s_parameters, Qt::TopEdge | Qt::LeftEdge);
+
+    // The top edge can't move vertically and the left edge can't move horizontally.
+    const WobblyMesh::Curve top = mesh.curveAt(0);
+    QCOMPARE(top.pointAt(0.5).y(), 0.0);
+    QCOMPARE(mesh.curveAt(0.5).pointAt(0).x(), 0.0);
+    QVERIFY(top.pointAt(0.5).x() != 150.0);
+}
+
+void TestWobblyMesh::benchmarkDrag_data()
+{
+    QTest::addColumn<int>("windowCount");
+    QTest::addColumn<int>("tessellation");
+
+    const int windowCounts[] = {1, 8, 32, 128};
+    for (int windowCount : windowCounts) {
+        QTest::addRow("%d windows, 20x20", windowCount) << windowCount << 20;
+        QTest::addRow("%d windows, 40x40", windowCount) << windowCount << 40;
+    }
+}
+
+void TestWobblyMesh::benchmarkDrag()
+{
+    QFETCH(int, windowCount);
+    QFETCH(int, tessellation);
+
+    std::vector<WobblyMesh> meshes(windowCount);
+    std::vector<QRectF> geometries;
+    for (int i = 0; i < windowCount; ++i) {
+        const QRectF geometry(i * 10, i * 5, 800, 600);
+        meshes[i].reset(geometry);
+        meshes[i].setConstrained(meshes[i].pointAt(geometry, geometry.center()), true);
+        geometries.push_back(geometry);
+    }
+
+    // Every frame moves all windows, integrates 16ms worth of physics and maps the
+    // tessellated window onto the bezier surface, like the effect does.
+    qreal checksum = 0;
+    QBENCHMARK {
+        for (int i = 0; i < windowCount; ++i) {
+            geometries[i].translate(3, 2);
+            meshes[i].step(geometries[i], 10, s_parameters);
+            meshes[i].step(geometries[i], 6, s_parameters);
+
+            for (int y = 0; y <= tessellation; ++y) {
+                const WobblyMesh::Curve curve = meshes[i].curveAt(qreal(y) / tessellation);
+                for (int x = 0; x <= tessellation; ++x) {
+                    checksum += curve.pointAt(qreal(x) / tessellation).x();
+                }
+            }
+        }
+    }
+    QVERIFY(std::isfinite(checksum));
+}
+
+QTEST_MAIN(TestWobblyMesh)
+#include "test_wobblymesh.moc"
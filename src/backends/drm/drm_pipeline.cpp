@@ -23,6 +23,7 @@
 #include "drm_object_crtc.h"
 #include "drm_object_plane.h"
 #include "drm_output.h"
+#include "ftrace.h"
 #include "session.h"
 
 #include <drm_fourcc.h>
@@ -84,6 +85,7 @@ bool DrmPipeline::maybeModeset()
 DrmPipeline::Error DrmPipeline::commitPipelines(const QVector<DrmPipeline *> &pipelines, CommitMode mode, const QVector<DrmObject *> &unusedObjects)
 {
     Q_ASSERT(!pipelines.isEmpty());
+    fTraceScope("DrmCommit", pipelines.size());
     if (pipelines[0]->gpu()->atomicModeSetting()) {
         return commitPipelinesAtomic(pipelines, mode, unusedObjects);
     } else {
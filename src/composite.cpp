@@ -455,12 +455,17 @@ void Compositor::removeOutput(Output *output)
 void Compositor::addSuperLayer(RenderLayer *layer)
 {
     m_superlayers.insert(layer->loop(), layer);
+    if (const Output *output = findOutput(layer->loop())) {
+        // Interned once, the name of the output doesn't change.
+        m_paintTraceNames.insert(layer->loop(), FTraceLogger::self()->intern(QByteArrayLiteral("Paint (") + output->name().toUtf8() + ')'));
+    }
     connect(layer->loop(), &RenderLoop::frameRequested, this, &Compositor::handleFrameRequested);
 }
 
 void Compositor::removeSuperLayer(RenderLayer *layer)
 {
     m_superlayers.remove(layer->loop());
+    m_paintTraceNames.remove(layer->loop());
     disconnect(layer->loop(), &RenderLoop::frameRequested, this, &Compositor::handleFrameRequested);
     delete layer;
 }
@@ -620,7 +625,7 @@ void Compositor::composite(RenderLoop *renderLoop)
 
     Output *output = findOutput(renderLoop);
     OutputLayer *outputLayer = m_backend->primaryLayer(output);
-    fTraceDuration("Paint (", output->name(), ")");
+    fTraceScope(m_paintTraceNames.value(renderLoop, "Paint"));
 
     RenderLayer *superLayer = m_superlayers[renderLoop];
     prePaintPass(superLayer);
@@ -639,6 +644,9 @@ void Compositor::composite(RenderLoop *renderLoop)
         if (scanoutPossible && !output->directScanoutInhibited()) {
             directScanout = outputLayer->scanout(scanoutCandidate);
         }
+        if (directScanout) {
+            fTraceInstant("DirectScanout");
+        }
     }
 
     if (!directScanout) {
@@ -695,7 +703,8 @@ void Compositor::postPaintPass(RenderLayer *layer)
 
 void Compositor::preparePaintPass(RenderLayer *layer, QRegion *repaint)
 {
-    // TODO: Cull opaque region.
+    // Repaints under opaque windows and subsurfaces are culled by the scene. Render layers
+    // are not culled against each other, the cursor layer above the scene is translucent.
     *repaint += layer->mapToGlobal(layer->repaints() + layer->delegate()->repaints());
     layer->resetRepaints();
     const auto sublayers = layer->sublayers();
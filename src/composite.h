@@ -156,6 +156,7 @@ private:
     std::unique_ptr<Scene> m_scene;
     std::unique_ptr<RenderBackend> m_backend;
     QHash<RenderLoop *, RenderLayer *> m_superlayers;
+    QHash<RenderLoop *, const char *> m_paintTraceNames;
 };
 
 class KWIN_EXPORT WaylandCompositor final : public Compositor
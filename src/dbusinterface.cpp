@@ -24,6 +24,9 @@
 #include "platform.h"
 #include "pluginmanager.h"
 #include "renderbackend.h"
+#include "renderjournal.h"
+#include "renderloop.h"
+#include "scene.h"
 #include "unmanaged.h"
 #include "virtualdesktops.h"
 #include "window.h"
@@ -332,6 +335,11 @@ bool CompositorDBusInterface::platformRequiresCompositing() const
     return kwinApp()->platform()->requiresCompositing();
 }
 
+int CompositorDBusInterface::drawCallCount() const
+{
+    return m_compositor->scene() ? m_compositor->scene()->drawCallCount() : 0;
+}
+
 void CompositorDBusInterface::resume()
 {
     if (kwinApp()->operationMode() == Application::OperationModeX11) {
@@ -351,6 +359,20 @@ void CompositorDBusInterface::reinitialize()
     m_compositor->reinitialize();
 }
 
+QVariantMap CompositorDBusInterface::renderTimings() const
+{
+    QVariantMap timings;
+    const auto outputs = workspace()->outputs();
+    for (Output *output : outputs) {
+        const RenderJournal &journal = output->renderLoop()->renderJournal();
+        timings.insert(output->name(), QVariantMap{
+                                           {QStringLiteral("renderTime"), journal.renderTimes().toVariantMap()},
+                                           {QStringLiteral("presentationLatency"), journal.presentationLatencies().toVariantMap()},
+                                       });
+    }
+    return timings;
+}
+
 QStringList CompositorDBusInterface::supportedOpenGLPlatformInterfaces() const
 {
     QStringList interfaces;
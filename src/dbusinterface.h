@@ -150,6 +150,11 @@ class CompositorDBusInterface : public QObject
     Q_PROPERTY(QStringList supportedOpenGLPlatformInterfaces READ supportedOpenGLPlatformInterfaces)
 
     Q_PROPERTY(bool platformRequiresCompositing READ platformRequiresCompositing)
+
+    /**
+     * @brief The number of draw calls that were issued by the scene to paint the last frame of every output.
+     */
+    Q_PROPERTY(int drawCallCount READ drawCallCount)
 public:
     explicit CompositorDBusInterface(Compositor *parent);
     ~CompositorDBusInterface() override = default;
@@ -161,6 +166,7 @@ public:
     QString compositingType() const;
     QStringList supportedOpenGLPlatformInterfaces() const;
     bool platformRequiresCompositing() const;
+    int drawCallCount() const;
 
 public Q_SLOTS:
     /**
@@ -201,6 +207,15 @@ public Q_SLOTS:
      */
     void reinitialize();
 
+    /**
+     * @brief Returns the recent render times and presentation latencies of every output.
+     *
+     * The returned map is keyed by the output name. Each entry contains a "renderTime"
+     * and a "presentationLatency" map with the number of samples and the minimum, average,
+     * p50, p90, p99 and maximum values, in microseconds.
+     */
+    QVariantMap renderTimings() const;
+
 Q_SIGNALS:
     void compositingToggled(bool active);
 
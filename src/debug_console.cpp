@@ -8,11 +8,14 @@
 */
 #include "debug_console.h"
 #include "composite.h"
+#include "effects.h"
 #include "input_event.h"
 #include "inputdevice.h"
 #include "internalwindow.h"
 #include "keyboard_input.h"
 #include "main.h"
+#include "output.h"
+#include "renderloop.h"
 #include "scene.h"
 #include "unmanaged.h"
 #include "utils/subsurfacemonitor.h"
@@ -43,6 +46,7 @@
 #include <QFutureWatcher>
 #include <QMetaProperty>
 #include <QMetaType>
+#include <QLocale>
 #include <QMouseEvent>
 #include <QScopeGuard>
 #include <QtConcurrentRun>
@@ -598,6 +602,21 @@ DebugConsole::DebugConsole()
     m_ui->primaryContent->setModel(new DataSourceModel(this));
     m_ui->inputDevicesView->setModel(new InputDeviceModel(this));
     m_ui->inputDevicesView->setItemDelegate(new DebugConsoleDelegate(this));
+    m_ui->renderTimingsView->setModel(new RenderTimingsModel(this));
+    m_ui->effectTimingsView->setModel(new EffectTimingsModel(this));
+    m_ui->waylandClientsView->setModel(new WaylandClientsModel(this));
+    auto effectsImpl = static_cast<EffectsHandlerImpl *>(effects);
+    m_ui->effectProfilingCheckBox->setEnabled(effectsImpl != nullptr);
+    m_ui->effectProfilingCheckBox->setChecked(effectsImpl && effectsImpl->isProfilingEnabled());
+    connect(m_ui->effectProfilingCheckBox, &QCheckBox::toggled, this, [](bool checked) {
+        if (effects) {
+            static_cast<EffectsHandlerImpl *>(effects)->setProfilingEnabled(checked);
+        }
+    });
+    if (effectsImpl) {
+        // The profiler can also be toggled over D-Bus.
+        connect(effectsImpl, &EffectsHandlerImpl::profilingEnabledChanged, m_ui->effectProfilingCheckBox, &QCheckBox::setChecked);
+    }
     m_ui->quitButton->setIcon(QIcon::fromTheme(QStringLiteral("application-exit")));
     m_ui->tabWidget->setTabIcon(0, QIcon::fromTheme(QStringLiteral("view-list-tree")));
     m_ui->tabWidget->setTabIcon(1, QIcon::fromTheme(QStringLiteral("view-list-tree")));
@@ -606,6 +625,7 @@ DebugConsole::DebugConsole()
         m_ui->tabWidget->setTabEnabled(1, false);
         m_ui->tabWidget->setTabEnabled(2, false);
         m_ui->tabWidget->setTabEnabled(6, false);
+        m_ui->tabWidget->setTabEnabled(9, false);
     }
 
     connect(m_ui->quitButton, &QAbstractButton::clicked, this, &DebugConsole::deleteLater);
@@ -1697,4 +1717,215 @@ void DataSourceModel::setSource(KWaylandServer::AbstractDataSource *source)
     }
     endResetModel();
 }
+
+StatisticsModel::StatisticsModel(const QStringList &columns, QObject *parent)
+    : QAbstractTableModel(parent)
+    , m_columns(columns)
+{
+    m_updateTimer.setInterval(1000);
+    connect(&m_updateTimer, &QTimer::timeout, this, &StatisticsModel::update);
+    m_updateTimer.start();
+}
+
+void StatisticsModel::update()
+{
+    beginResetModel();
+    gather();
+    endResetModel();
+}
+
+int StatisticsModel::rowCount(const QModelIndex &parent) const
+{
+    return parent.isValid() ? 0 : entryCount();
+}
+
+int StatisticsModel::columnCount(const QModelIndex &parent) const
+{
+    return parent.isValid() ? 0 : m_columns.count();
+}
+
+QVariant StatisticsModel::headerData(int section, Qt::Orientation orientation, int role) const
+{
+    if (role != Qt::DisplayRole || orientation != Qt::Horizontal) {
+        return QVariant();
+    }
+    return m_columns.value(section);
+}
+
+QVariant StatisticsModel::data(const QModelIndex &index, int role) const
+{
+    if (!checkIndex(index, CheckIndexOption::ParentIsInvalid | CheckIndexOption::IndexIsValid) || role != Qt::DisplayRole) {
+        return QVariant();
+    }
+    return entryData(index.row(), index.column());
+}
+
+RenderTimingsModel::RenderTimingsModel(QObject *parent)
+    : StatisticsModel({QStringLiteral("Output"), QStringLiteral("Metric"), QStringLiteral("Samples"), QStringLiteral("Minimum"),
+                       QStringLiteral("Average"), QStringLiteral("p50"), QStringLiteral("p90"), QStringLiteral("p99"),
+                       QStringLiteral("Maximum")},
+                      parent)
+{
+    update();
+}
+
+void RenderTimingsModel::gather()
+{
+    m_entries.clear();
+    const auto outputs = workspace()->outputs();
+    for (Output *output : outputs) {
+        const RenderJournal &journal = output->renderLoop()->renderJournal();
+        m_entries.append(Entry{output->name(), QStringLiteral("Render time"), journal.renderTimes()});
+        m_entries.append(Entry{output->name(), QStringLiteral("Presentation latency"), journal.presentationLatencies()});
+    }
+}
+
+int RenderTimingsModel::entryCount() const
+{
+    return m_entries.count();
+}
+
+QVariant RenderTimingsModel::entryData(int row, int column) const
+{
+    const Entry &entry = m_entries.at(row);
+    auto formatDuration = [](std::chrono::nanoseconds duration) {
+        return QStringLiteral("%1 ms").arg(std::chrono::duration<qreal, std::milli>(duration).count(), 0, 'f', 2);
+    };
+    switch (column) {
+    case 0:
+        return entry.output;
+    case 1:
+        return entry.metric;
+    case 2:
+        return entry.history.count();
+    case 3:
+        return formatDuration(entry.history.minimum());
+    case 4:
+        return formatDuration(entry.history.average());
+    case 5:
+        return formatDuration(entry.history.percentile(50));
+    case 6:
+        return formatDuration(entry.history.percentile(90));
+    case 7:
+        return formatDuration(entry.history.percentile(99));
+    case 8:
+        return formatDuration(entry.history.maximum());
+    default:
+        return QVariant();
+    }
+}
+
+EffectTimingsModel::EffectTimingsModel(QObject *parent)
+    : StatisticsModel({QStringLiteral("Output"), QStringLiteral("Effect"), QStringLiteral("Pass"), QStringLiteral("CPU p50"),
+                       QStringLiteral("CPU p90"), QStringLiteral("CPU Maximum"), QStringLiteral("GPU p50"), QStringLiteral("GPU p90"),
+                       QStringLiteral("GPU Maximum")},
+                      parent)
+{
+    update();
+}
+
+void EffectTimingsModel::gather()
+{
+    m_entries.clear();
+    const auto effectsImpl = static_cast<EffectsHandlerImpl *>(effects);
+    if (effectsImpl && effectsImpl->profiler()) {
+        const auto &timings = effectsImpl->profiler()->timings();
+        for (auto it = timings.constBegin(); it != timings.constEnd(); ++it) {
+            m_entries.append(Entry{it.key().output, it.key().effect, EffectProfiler::passName(it.key().pass), it.value().cpuTimes, it.value().gpuTimes});
+        }
+    }
+}
+
+int EffectTimingsModel::entryCount() const
+{
+    return m_entries.count();
+}
+
+QVariant EffectTimingsModel::entryData(int row, int column) const
+{
+    const Entry &entry = m_entries.at(row);
+    auto formatDuration = [](const FrameTimeHistory &history, std::chrono::nanoseconds duration) {
+        if (!history.count()) {
+            return QStringLiteral("-");
+        }
+        return QStringLiteral("%1 ms").arg(std::chrono::duration<qreal, std::milli>(duration).count(), 0, 'f', 3);
+    };
+    switch (column) {
+    case 0:
+        return entry.output;
+    case 1:
+        return entry.effect;
+    case 2:
+        return entry.pass;
+    case 3:
+        return formatDuration(entry.cpuTimes, entry.cpuTimes.percentile(50));
+    case 4:
+        return formatDuration(entry.cpuTimes, entry.cpuTimes.percentile(90));
+    case 5:
+        return formatDuration(entry.cpuTimes, entry.cpuTimes.maximum());
+    case 6:
+        return formatDuration(entry.gpuTimes, entry.gpuTimes.percentile(50));
+    case 7:
+        return formatDuration(entry.gpuTimes, entry.gpuTimes.percentile(90));
+    case 8:
+        return formatDuration(entry.gpuTimes, entry.gpuTimes.maximum());
+    default:
+        return QVariant();
+    }
+}
+
+WaylandClientsModel::WaylandClientsModel(QObject *parent)
+    : StatisticsModel({QStringLiteral("Executable"), QStringLiteral("PID"), QStringLiteral("Events"), QStringLiteral("Sent"),
+                       QStringLiteral("Pending"), QStringLiteral("Unread"), QStringLiteral("Peak Unread"),
+                       QStringLiteral("Flushes (Throttled)"), QStringLiteral("Slow For")},
+                      parent)
+{
+    update();
+}
+
+void WaylandClientsModel::gather()
+{
+    m_entries.clear();
+    if (waylandServer()) {
+        const auto connections = waylandServer()->display()->connections();
+        for (KWaylandServer::ClientConnection *connection : connections) {
+            m_entries.append(Entry{connection->executablePath(), connection->processId(), connection->flushStatistics()});
+        }
+    }
+}
+
+int WaylandClientsModel::entryCount() const
+{
+    return m_entries.count();
+}
+
+QVariant WaylandClientsModel::entryData(int row, int column) const
+{
+    const Entry &entry = m_entries.at(row);
+    switch (column) {
+    case 0:
+        return entry.executable;
+    case 1:
+        return entry.processId;
+    case 2:
+        return entry.statistics.messages;
+    case 3:
+        return QLocale().formattedDataSize(entry.statistics.bytes);
+    case 4:
+        return QLocale().formattedDataSize(entry.statistics.pendingBytes);
+    case 5:
+        return QLocale().formattedDataSize(entry.statistics.backlogBytes);
+    case 6:
+        return QLocale().formattedDataSize(entry.statistics.peakBacklogBytes);
+    case 7:
+        return QStringLiteral("%1 (%2)").arg(entry.statistics.flushes).arg(entry.statistics.throttledFlushes);
+    case 8:
+        if (entry.statistics.slowDuration.count() == 0) {
+            return QStringLiteral("-");
+        }
+        return QStringLiteral("%1 ms").arg(entry.statistics.slowDuration.count());
+    default:
+        return QVariant();
+    }
+}
 }
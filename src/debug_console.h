@@ -14,8 +14,12 @@
 #include <config-kwin.h>
 #include <kwin_export.h>
 
+#include "renderjournal.h"
+#include "wayland/clientconnection.h"
+
 #include <QAbstractItemModel>
 #include <QStyledItemDelegate>
+#include <QTimer>
 #include <QVector>
 #include <functional>
 #include <memory>
@@ -204,6 +208,102 @@ private:
     KWaylandServer::AbstractDataSource *m_source = nullptr;
     QVector<QByteArray> m_data;
 };
+
+/**
+ * The StatisticsModel class is the base class for the tables of statistics in the debug console.
+ * The rows are gathered again once a second, subclasses only have to provide the rows and the
+ * values in the columns.
+ */
+class StatisticsModel : public QAbstractTableModel
+{
+    Q_OBJECT
+public:
+    int rowCount(const QModelIndex &parent) const override;
+    int columnCount(const QModelIndex &parent) const override;
+    QVariant data(const QModelIndex &index, int role) const override;
+    QVariant headerData(int section, Qt::Orientation orientation, int role = Qt::DisplayRole) const override;
+
+protected:
+    StatisticsModel(const QStringList &columns, QObject *parent);
+
+    /**
+     * Gathers the rows again. Subclasses must call it once they have been constructed.
+     */
+    void update();
+
+    virtual void gather() = 0;
+    virtual int entryCount() const = 0;
+    virtual QVariant entryData(int row, int column) const = 0;
+
+private:
+    QStringList m_columns;
+    QTimer m_updateTimer;
+};
+
+class RenderTimingsModel : public StatisticsModel
+{
+    Q_OBJECT
+public:
+    explicit RenderTimingsModel(QObject *parent = nullptr);
+
+protected:
+    void gather() override;
+    int entryCount() const override;
+    QVariant entryData(int row, int column) const override;
+
+private:
+    struct Entry
+    {
+        QString output;
+        QString metric;
+        FrameTimeHistory history;
+    };
+    QVector<Entry> m_entries;
+};
+
+class EffectTimingsModel : public StatisticsModel
+{
+    Q_OBJECT
+public:
+    explicit EffectTimingsModel(QObject *parent = nullptr);
+
+protected:
+    void gather() override;
+    int entryCount() const override;
+    QVariant entryData(int row, int column) const override;
+
+private:
+    struct Entry
+    {
+        QString output;
+        QString effect;
+        QString pass;
+        FrameTimeHistory cpuTimes;
+        FrameTimeHistory gpuTimes;
+    };
+    QVector<Entry> m_entries;
+};
+
+class WaylandClientsModel : public StatisticsModel
+{
+    Q_OBJECT
+public:
+    explicit WaylandClientsModel(QObject *parent = nullptr);
+
+protected:
+    void gather() override;
+    int entryCount() const override;
+    QVariant entryData(int row, int column) const override;
+
+private:
+    struct Entry
+    {
+        QString executable;
+        pid_t processId;
+        KWaylandServer::ClientConnection::FlushStatistics statistics;
+    };
+    QVector<Entry> m_entries;
+};
 }
 
 #endif
@@ -141,7 +141,7 @@ DecorationItem::DecorationItem(KDecoration2::Decoration *decoration, Window *win
             this, &DecorationItem::discardQuads);
 
     connect(renderer(), &DecorationRenderer::damaged,
-            this, qOverload<const QRegion &>(&Item::scheduleRepaint));
+            this, &DecorationItem::handleDecorationDamaged);
 
     // this toSize is to match that DecoratedWindow also rounds
     setSize(window->size().toSize());
@@ -192,6 +192,12 @@ void DecorationItem::handleOutputScaleChanged()
     }
 }
 
+void DecorationItem::handleDecorationDamaged(const QRegion &region)
+{
+    invalidateSubtree();
+    scheduleRepaint(region);
+}
+
 void DecorationItem::handleFrameGeometryChanged()
 {
     setSize(m_window->size().toSize());
@@ -87,6 +87,7 @@ public:
     QRegion opaque() const override final;
 
 private Q_SLOTS:
+    void handleDecorationDamaged(const QRegion &region);
     void handleFrameGeometryChanged();
     void handleWindowClosed(Window *original, Deleted *deleted);
     void handleOutputChanged();
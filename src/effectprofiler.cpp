@@ -0,0 +1,236 @@
+/*
+    KWin - the KDE window manager
+    This file is part of the KDE project.
+
+    SPDX-FileCopyrightText: 2022 KWin contributors
+
+    SPDX-License-Identifier: GPL-2.0-or-later
+*/
+
+#include "effectprofiler.h"
+
+#include <algorithm>
+
+namespace KWin
+{
+
+// The number of frames whose timer queries may be in flight. If the GPU falls behind
+// further, the oldest frames are discarded instead of waiting for them.
+static const int s_maxPendingFrames = 8;
+
+EffectProfiler::EffectProfiler(bool gpuTimers)
+    : m_gpuTimers(gpuTimers)
+{
+}
+
+EffectProfiler::~EffectProfiler()
+{
+    for (const PendingFrame &frame : m_pendingFrames) {
+        for (const Span &span : frame.spans) {
+            if (span.beginQuery) {
+                m_freeQueries.append(span.beginQuery);
+                m_freeQueries.append(span.endQuery);
+            }
+        }
+    }
+    if (!m_freeQueries.isEmpty()) {
+        glDeleteQueries(m_freeQueries.count(), m_freeQueries.constData());
+    }
+}
+
+QString EffectProfiler::passName(Pass pass)
+{
+    switch (pass) {
+    case PrePaintScreen:
+        return QStringLiteral("prePaintScreen");
+    case PaintScreen:
+        return QStringLiteral("paintScreen");
+    case PostPaintScreen:
+        return QStringLiteral("postPaintScreen");
+    case PrePaintWindow:
+        return QStringLiteral("prePaintWindow");
+    case PaintWindow:
+        return QStringLiteral("paintWindow");
+    case PostPaintWindow:
+        return QStringLiteral("postPaintWindow");
+    case DrawWindow:
+        return QStringLiteral("drawWindow");
+    default:
+        return QString();
+    }
+}
+
+void EffectProfiler::beginFrame(const QString &outputName, const QVector<QString> &effects)
+{
+    if (m_gpuTimers) {
+        resolvePendingFrames();
+    }
+
+    m_inFrame = true;
+    m_output = outputName;
+    m_effects = effects;
+    m_spans.clear();
+    m_stack.clear();
+
+    const int slotCount = (effects.count() + 1) * PassCount;
+    m_cpuTimes.fill(std::chrono::nanoseconds::zero(), slotCount);
+    m_usedSlots.fill(false, slotCount);
+}
+
+void EffectProfiler::endFrame()
+{
+    if (!m_inFrame) {
+        return;
+    }
+    m_inFrame = false;
+
+    for (int slot = 0; slot < m_usedSlots.count(); ++slot) {
+        if (m_usedSlots[slot]) {
+            timingsFor(m_output, m_effects, slot).cpuTimes.add(m_cpuTimes[slot]);
+        }
+    }
+
+    if (m_gpuTimers && !m_spans.isEmpty()) {
+        m_pendingFrames.push_back(PendingFrame{m_output, m_effects, std::move(m_spans)});
+        m_spans = QVector<Span>();
+        while (m_pendingFrames.size() > s_maxPendingFrames) {
+            for (const Span &span : m_pendingFrames.front().spans) {
+                if (span.beginQuery) {
+                    m_freeQueries.append(span.beginQuery);
+                    m_freeQueries.append(span.endQuery);
+                }
+            }
+            m_pendingFrames.pop_front();
+        }
+    }
+}
+
+void EffectProfiler::begin(int effectIndex, Pass pass)
+{
+    if (!m_inFrame) {
+        return;
+    }
+
+    Span span;
+    span.slot = effectIndex * PassCount + pass;
+    span.parent = m_stack.isEmpty() ? -1 : m_stack.last();
+    span.childTime = std::chrono::nanoseconds::zero();
+    // Only the paint passes submit GL commands.
+    if (m_gpuTimers && (pass == PaintScreen || pass == PaintWindow || pass == DrawWindow)) {
+        span.beginQuery = allocateQuery();
+        span.endQuery = allocateQuery();
+        glQueryCounter(span.beginQuery, GL_TIMESTAMP);
+    }
+    span.start = std::chrono::steady_clock::now();
+
+    m_stack.append(m_spans.count());
+    m_spans.append(span);
+}
+
+void EffectProfiler::end()
+{
+    if (!m_inFrame || m_stack.isEmpty()) {
+        return;
+    }
+
+    const auto now = std::chrono::steady_clock::now();
+    const Span &span = m_spans[m_stack.takeLast()];
+    if (span.endQuery) {
+        glQueryCounter(span.endQuery, GL_TIMESTAMP);
+    }
+
+    const std::chrono::nanoseconds elapsed = now - span.start;
+    m_cpuTimes[span.slot] += elapsed - span.childTime;
+    m_usedSlots[span.slot] = true;
+    if (span.parent != -1) {
+        m_spans[span.parent].childTime += elapsed;
+    }
+}
+
+GLuint EffectProfiler::allocateQuery()
+{
+    if (m_freeQueries.isEmpty()) {
+        m_freeQueries.resize(64);
+        glGenQueries(m_freeQueries.count(), m_freeQueries.data());
+    }
+    return m_freeQueries.takeLast();
+}
+
+void EffectProfiler::resolvePendingFrames()
+{
+    while (!m_pendingFrames.empty()) {
+        const PendingFrame &frame = m_pendingFrames.front();
+
+        // Timestamps are written in submission order, so the frame is complete once the
+        // last query is available.
+        GLuint lastQuery = 0;
+        for (const Span &span : frame.spans) {
+            if (span.endQuery) {
+                lastQuery = span.endQuery;
+            }
+        }
+        if (lastQuery) {
+            GLuint available = GL_FALSE;
+            glGetQueryObjectuiv(lastQuery, GL_QUERY_RESULT_AVAILABLE, &available);
+            if (!available) {
+                return;
+            }
+            resolveFrame(frame);
+        }
+
+        for (const Span &span : frame.spans) {
+            if (span.beginQuery) {
+                m_freeQueries.append(span.beginQuery);
+                m_freeQueries.append(span.endQuery);
+            }
+        }
+        m_pendingFrames.pop_front();
+    }
+}
+
+void EffectProfiler::resolveFrame(const PendingFrame &frame)
+{
+    const int slotCount = (frame.effects.count() + 1) * PassCount;
+    QVector<std::chrono::nanoseconds> gpuTimes(slotCount, std::chrono::nanoseconds::zero());
+    QVector<std::chrono::nanoseconds> childTimes(frame.spans.count(), std::chrono::nanoseconds::zero());
+    QVector<std::chrono::nanoseconds> elapsedTimes(frame.spans.count(), std::chrono::nanoseconds::zero());
+    QVector<bool> usedSlots(slotCount, false);
+
+    for (int i = 0; i < frame.spans.count(); ++i) {
+        const Span &span = frame.spans[i];
+        if (!span.beginQuery) {
+            continue;
+        }
+        GLuint64 begin = 0;
+        GLuint64 end = 0;
+        glGetQueryObjectui64v(span.beginQuery, GL_QUERY_RESULT, &begin);
+        glGetQueryObjectui64v(span.endQuery, GL_QUERY_RESULT, &end);
+        elapsedTimes[i] = std::chrono::nanoseconds(end > begin ? end - begin : 0);
+        if (span.parent != -1) {
+            childTimes[span.parent] += elapsedTimes[i];
+        }
+    }
+
+    for (int i = 0; i < frame.spans.count(); ++i) {
+        const Span &span = frame.spans[i];
+        if (span.beginQuery) {
+            gpuTimes[span.slot] += std::max(std::chrono::nanoseconds::zero(), elapsedTimes[i] - childTimes[i]);
+            usedSlots[span.slot] = true;
+        }
+    }
+
+    for (int slot = 0; slot < slotCount; ++slot) {
+        if (usedSlots[slot]) {
+            timingsFor(frame.output, frame.effects, slot).gpuTimes.add(gpuTimes[slot]);
+        }
+    }
+}
+
+EffectProfiler::Timings &EffectProfiler::timingsFor(const QString &output, const QVector<QString> &effects, int slot)
+{
+    const int effectIndex = slot / PassCount;
+    const QString effect = effectIndex < effects.count() ? effects[effectIndex] : QStringLiteral("(scene)");
+    return m_timings[Key{output, effect, Pass(slot % PassCount)}];
+}
+
+} // namespace KWin
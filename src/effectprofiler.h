@@ -0,0 +1,160 @@
+/*
+    KWin - the KDE window manager
+    This file is part of the KDE project.
+
+    SPDX-FileCopyrightText: 2022 KWin contributors
+
+    SPDX-License-Identifier: GPL-2.0-or-later
+*/
+
+#pragma once
+
+#include "kwin_export.h"
+#include "renderjournal.h"
+
+#include <QMap>
+#include <QString>
+#include <QVector>
+
+#include <chrono>
+#include <deque>
+#include <tuple>
+#include <epoxy/gl.h>
+
+namespace KWin
+{
+
+/**
+ * The EffectProfiler class measures how much time every effect spends in every pass of the
+ * effect chain.
+ *
+ * The time that an effect spends in a pass excludes the time spent in the effects further
+ * down the chain and in the scene. The scene itself is reported as an effect called
+ * "(scene)". The CPU and the GPU time are summed per frame and aggregated per output.
+ *
+ * The GPU time is measured with timestamp queries, which are resolved a few frames later
+ * to avoid stalling the pipeline. It's only available with OpenGL compositing and if the
+ * driver supports timer queries.
+ */
+class KWIN_EXPORT EffectProfiler
+{
+public:
+    enum Pass {
+        PrePaintScreen,
+        PaintScreen,
+        PostPaintScreen,
+        PrePaintWindow,
+        PaintWindow,
+        PostPaintWindow,
+        DrawWindow,
+        PassCount,
+    };
+
+    struct Timings
+    {
+        FrameTimeHistory cpuTimes;
+        FrameTimeHistory gpuTimes;
+    };
+
+    struct Key
+    {
+        QString output;
+        QString effect;
+        Pass pass;
+
+        bool operator<(const Key &other) const
+        {
+            return std::tie(output, effect, pass) < std::tie(other.output, other.effect, other.pass);
+        }
+    };
+
+    /**
+     * Creates a profiler. If @a gpuTimers is @c true, the GPU time is measured too, which
+     * requires a current OpenGL context whenever the profiler is used.
+     */
+    explicit EffectProfiler(bool gpuTimers);
+    ~EffectProfiler();
+
+    static QString passName(Pass pass);
+
+    /**
+     * Starts a new frame for the output with the specified @a outputName. The @a effects
+     * list contains the names of the active effects, in the chain order.
+     */
+    void beginFrame(const QString &outputName, const QVector<QString> &effects);
+    void endFrame();
+
+    /**
+     * Marks the beginning of the specified @a pass of the effect at @a effectIndex. If the
+     * index is equal to the number of active effects, the time is attributed to the scene.
+     */
+    void begin(int effectIndex, Pass pass);
+    void end();
+
+    const QMap<Key, Timings> &timings() const
+    {
+        return m_timings;
+    }
+
+private:
+    struct Span
+    {
+        int slot;
+        int parent;
+        std::chrono::steady_clock::time_point start;
+        std::chrono::nanoseconds childTime;
+        GLuint beginQuery = 0;
+        GLuint endQuery = 0;
+    };
+
+    struct PendingFrame
+    {
+        QString output;
+        QVector<QString> effects;
+        QVector<Span> spans;
+    };
+
+    GLuint allocateQuery();
+    void resolvePendingFrames();
+    void resolveFrame(const PendingFrame &frame);
+    Timings &timingsFor(const QString &output, const QVector<QString> &effects, int slot);
+
+    const bool m_gpuTimers;
+    bool m_inFrame = false;
+    QString m_output;
+    QVector<QString> m_effects;
+    QVector<Span> m_spans;
+    QVector<int> m_stack;
+    QVector<std::chrono::nanoseconds> m_cpuTimes;
+    QVector<bool> m_usedSlots;
+    std::deque<PendingFrame> m_pendingFrames;
+    QVector<GLuint> m_freeQueries;
+    QMap<Key, Timings> m_timings;
+};
+
+/**
+ * Helper that measures the enclosing scope if the profiler is not @c null.
+ */
+class EffectProfilerScope
+{
+public:
+    EffectProfilerScope(EffectProfiler *profiler, int effectIndex, EffectProfiler::Pass pass)
+        : m_profiler(profiler)
+    {
+        if (m_profiler) {
+            m_profiler->begin(effectIndex, pass);
+        }
+    }
+
+    ~EffectProfilerScope()
+    {
+        if (m_profiler) {
+            m_profiler->end();
+        }
+    }
+
+private:
+    EffectProfiler *m_profiler;
+};
+
+} // namespace KWin
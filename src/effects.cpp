@@ -41,6 +41,7 @@
 #include "decorations/decorationbridge.h"
 #include "inputmethod.h"
 #include "inputpanelv1window.h"
+#include "kwinglplatform.h"
 #include "kwinglutils.h"
 #include "platform.h"
 #include "utils/xcbutils.h"
@@ -128,11 +129,7 @@ EffectsHandlerImpl::EffectsHandlerImpl(Compositor *compositor, Scene *scene)
 {
     qRegisterMetaType<QVector<KWin::EffectWindow *>>();
     qRegisterMetaType<KWin::SessionState>();
-    connect(m_effectLoader, &AbstractEffectLoader::effectLoaded, this, [this](Effect *effect, const QString &name) {
-        effect_order.insert(effect->requestedEffectChainPosition(), EffectPair(name, effect));
-        loaded_effects << EffectPair(name, effect);
-        effectsChanged();
-    });
+    connect(m_effectLoader, &AbstractEffectLoader::effectLoaded, this, &EffectsHandlerImpl::addEffect);
     m_effectLoader->setConfig(kwinApp()->config());
     new EffectsAdaptor(this);
     QDBusConnection dbus = QDBusConnection::sessionBus();
@@ -186,6 +183,9 @@ EffectsHandlerImpl::EffectsHandlerImpl(Compositor *compositor, Scene *scene)
     connect(ws, &Workspace::deletedRemoved, this, [this](KWin::Deleted *d) {
         Q_EMIT windowDeleted(d->effectWindow());
         elevated_windows.removeAll(d->effectWindow());
+        for (QSet<EffectWindow *> &windows : m_windowPassRestrictions) {
+            windows.remove(d->effectWindow());
+        }
     });
     connect(ws->sessionManager(), &SessionManager::stateChanged, this, &KWin::EffectsHandler::sessionStateChanged);
     connect(vds, &VirtualDesktopManager::countChanged, this, &EffectsHandler::numberDesktopsChanged);
@@ -273,6 +273,7 @@ EffectsHandlerImpl::EffectsHandlerImpl(Compositor *compositor, Scene *scene)
 
 EffectsHandlerImpl::~EffectsHandlerImpl()
 {
+    setProfilingEnabled(false);
     unloadAllEffects();
 }
 
@@ -368,6 +369,7 @@ void EffectsHandlerImpl::reconfigure()
 void EffectsHandlerImpl::prePaintScreen(ScreenPrePaintData &data, std::chrono::milliseconds presentTime)
 {
     if (m_currentPaintScreenIterator != m_activeEffects.constEnd()) {
+        EffectProfilerScope profilerScope(m_profiler.get(), m_currentPaintScreenIterator - m_activeEffects.constBegin(), EffectProfiler::PrePaintScreen);
         (*m_currentPaintScreenIterator++)->prePaintScreen(data, presentTime);
         --m_currentPaintScreenIterator;
     }
@@ -376,6 +378,7 @@ void EffectsHandlerImpl::prePaintScreen(ScreenPrePaintData &data, std::chrono::m
 
 void EffectsHandlerImpl::paintScreen(int mask, const QRegion &region, ScreenPaintData &data)
 {
+    EffectProfilerScope profilerScope(m_profiler.get(), m_currentPaintScreenIterator - m_activeEffects.constBegin(), EffectProfiler::PaintScreen);
     if (m_currentPaintScreenIterator != m_activeEffects.constEnd()) {
         (*m_currentPaintScreenIterator++)->paintScreen(mask, region, data);
         --m_currentPaintScreenIterator;
@@ -386,38 +389,107 @@ void EffectsHandlerImpl::paintScreen(int mask, const QRegion &region, ScreenPain
 
 void EffectsHandlerImpl::postPaintScreen()
 {
+    const bool lastPass = m_currentPaintScreenIterator == m_activeEffects.constBegin();
     if (m_currentPaintScreenIterator != m_activeEffects.constEnd()) {
+        EffectProfilerScope profilerScope(m_profiler.get(), m_currentPaintScreenIterator - m_activeEffects.constBegin(), EffectProfiler::PostPaintScreen);
         (*m_currentPaintScreenIterator++)->postPaintScreen();
         --m_currentPaintScreenIterator;
     }
-    // no special final code
+    // postPaintScreen() is the last pass of a frame
+    if (lastPass && m_profiler) {
+        m_profiler->endFrame();
+    }
+}
+
+EffectsHandlerImpl::EffectsIterator EffectsHandlerImpl::nextWindowPass(EffectsIterator it, EffectWindow *w) const
+{
+    if (m_windowPassRestrictions.isEmpty()) {
+        return it;
+    }
+    EffectWindowImpl *window = static_cast<EffectWindowImpl *>(w);
+    if (window->m_windowPassesGeneration != m_windowPassesGeneration) {
+        updateWindowPasses(window);
+    }
+    return m_activeEffects.constBegin() + window->m_windowPasses[it - m_activeEffects.constBegin()];
+}
+
+void EffectsHandlerImpl::updateWindowPasses(EffectWindowImpl *w) const
+{
+    const int count = m_activeEffects.count();
+    w->m_windowPasses.resize(count + 1);
+    w->m_windowPasses[count] = count;
+    for (int i = count - 1; i >= 0; --i) {
+        const auto restriction = m_windowPassRestrictions.constFind(m_activeEffects[i]);
+        if (restriction == m_windowPassRestrictions.constEnd() || restriction->contains(w)) {
+            w->m_windowPasses[i] = i;
+        } else {
+            w->m_windowPasses[i] = w->m_windowPasses[i + 1];
+        }
+    }
+    w->m_windowPassesGeneration = m_windowPassesGeneration;
+}
+
+void EffectsHandlerImpl::setWindowPassesRestricted(Effect *effect, bool restricted)
+{
+    if (!restricted) {
+        if (m_windowPassRestrictions.remove(effect)) {
+            m_windowPassesGeneration++;
+        }
+    } else if (!m_windowPassRestrictions.contains(effect)) {
+        m_windowPassRestrictions.insert(effect, QSet<EffectWindow *>());
+        m_windowPassesGeneration++;
+    }
+}
+
+void EffectsHandlerImpl::setWindowPassesEnabled(Effect *effect, EffectWindow *window, bool enabled)
+{
+    auto restriction = m_windowPassRestrictions.find(effect);
+    if (restriction == m_windowPassRestrictions.end()) {
+        return;
+    }
+    if (enabled) {
+        restriction->insert(window);
+    } else {
+        restriction->remove(window);
+    }
+    // Only the window pass list of this window is affected.
+    static_cast<EffectWindowImpl *>(window)->m_windowPassesGeneration = 0;
 }
 
 void EffectsHandlerImpl::prePaintWindow(EffectWindow *w, WindowPrePaintData &data, std::chrono::milliseconds presentTime)
 {
+    const EffectsIterator current = m_currentPaintWindowIterator;
+    m_currentPaintWindowIterator = nextWindowPass(current, w);
     if (m_currentPaintWindowIterator != m_activeEffects.constEnd()) {
+        EffectProfilerScope profilerScope(m_profiler.get(), m_currentPaintWindowIterator - m_activeEffects.constBegin(), EffectProfiler::PrePaintWindow);
         (*m_currentPaintWindowIterator++)->prePaintWindow(w, data, presentTime);
-        --m_currentPaintWindowIterator;
     }
+    m_currentPaintWindowIterator = current;
     // no special final code
 }
 
 void EffectsHandlerImpl::paintWindow(EffectWindow *w, int mask, const QRegion &region, WindowPaintData &data)
 {
+    const EffectsIterator current = m_currentPaintWindowIterator;
+    m_currentPaintWindowIterator = nextWindowPass(current, w);
+    EffectProfilerScope profilerScope(m_profiler.get(), m_currentPaintWindowIterator - m_activeEffects.constBegin(), EffectProfiler::PaintWindow);
     if (m_currentPaintWindowIterator != m_activeEffects.constEnd()) {
         (*m_currentPaintWindowIterator++)->paintWindow(w, mask, region, data);
-        --m_currentPaintWindowIterator;
     } else {
         m_scene->finalPaintWindow(static_cast<EffectWindowImpl *>(w), mask, region, data);
     }
+    m_currentPaintWindowIterator = current;
 }
 
 void EffectsHandlerImpl::postPaintWindow(EffectWindow *w)
 {
+    const EffectsIterator current = m_currentPaintWindowIterator;
+    m_currentPaintWindowIterator = nextWindowPass(current, w);
     if (m_currentPaintWindowIterator != m_activeEffects.constEnd()) {
+        EffectProfilerScope profilerScope(m_profiler.get(), m_currentPaintWindowIterator - m_activeEffects.constBegin(), EffectProfiler::PostPaintWindow);
         (*m_currentPaintWindowIterator++)->postPaintWindow(w);
-        --m_currentPaintWindowIterator;
     }
+    m_currentPaintWindowIterator = current;
     // no special final code
 }
 
@@ -433,12 +505,15 @@ Effect *EffectsHandlerImpl::provides(Effect::Feature ef)
 
 void EffectsHandlerImpl::drawWindow(EffectWindow *w, int mask, const QRegion &region, WindowPaintData &data)
 {
+    const EffectsIterator current = m_currentDrawWindowIterator;
+    m_currentDrawWindowIterator = nextWindowPass(current, w);
+    EffectProfilerScope profilerScope(m_profiler.get(), m_currentDrawWindowIterator - m_activeEffects.constBegin(), EffectProfiler::DrawWindow);
     if (m_currentDrawWindowIterator != m_activeEffects.constEnd()) {
         (*m_currentDrawWindowIterator++)->drawWindow(w, mask, region, data);
-        --m_currentDrawWindowIterator;
     } else {
         m_scene->finalDrawWindow(static_cast<EffectWindowImpl *>(w), mask, region, data);
     }
+    m_currentDrawWindowIterator = current;
 }
 
 bool EffectsHandlerImpl::hasDecorationShadows() const
@@ -452,18 +527,30 @@ bool EffectsHandlerImpl::decorationsHaveAlpha() const
 }
 
 // start another painting pass
-void EffectsHandlerImpl::startPaint()
+void EffectsHandlerImpl::startPaint(Output *output)
 {
-    m_activeEffects.clear();
-    m_activeEffects.reserve(loaded_effects.count());
+    EffectsList activeEffects;
+    activeEffects.reserve(loaded_effects.count());
+    m_activeEffectNames.clear();
     for (QVector<KWin::EffectPair>::const_iterator it = loaded_effects.constBegin(); it != loaded_effects.constEnd(); ++it) {
         if (it->second->isActive()) {
-            m_activeEffects << it->second;
+            activeEffects << it->second;
+            if (m_profiler) {
+                m_activeEffectNames << it->first;
+            }
         }
     }
+    if (activeEffects != m_activeEffects) {
+        m_activeEffects = activeEffects;
+        m_windowPassesGeneration++;
+    }
     m_currentDrawWindowIterator = m_activeEffects.constBegin();
     m_currentPaintWindowIterator = m_activeEffects.constBegin();
     m_currentPaintScreenIterator = m_activeEffects.constBegin();
+
+    if (m_profiler) {
+        m_profiler->beginFrame(output->name(), m_activeEffectNames);
+    }
 }
 
 void EffectsHandlerImpl::slotClientMaximized(Window *window, MaximizeMode maxMode)
@@ -1441,6 +1528,13 @@ bool EffectsHandlerImpl::loadEffect(const QString &name)
     return m_effectLoader->loadEffect(name);
 }
 
+void EffectsHandlerImpl::addEffect(Effect *effect, const QString &name)
+{
+    effect_order.insert(effect->requestedEffectChainPosition(), EffectPair(name, effect));
+    loaded_effects << EffectPair(name, effect);
+    effectsChanged();
+}
+
 void EffectsHandlerImpl::unloadEffect(const QString &name)
 {
     auto it = std::find_if(effect_order.begin(), effect_order.end(),
@@ -1480,6 +1574,9 @@ void EffectsHandlerImpl::destroyEffect(Effect *effect)
     }
 
     delete effect;
+    if (m_windowPassRestrictions.remove(effect)) {
+        m_windowPassesGeneration++;
+    }
 }
 
 void EffectsHandlerImpl::reconfigureEffect(const QString &name)
@@ -1547,6 +1644,7 @@ void EffectsHandlerImpl::effectsChanged()
 {
     loaded_effects.clear();
     m_activeEffects.clear(); // it's possible to have a reconfigure and a quad rebuild between two paint cycles - bug #308201
+    m_windowPassesGeneration++;
 
     loaded_effects.reserve(effect_order.count());
     std::copy(effect_order.constBegin(), effect_order.constEnd(),
@@ -1648,6 +1746,53 @@ QString EffectsHandlerImpl::debug(const QString &name, const QString &parameter)
     return QString();
 }
 
+bool EffectsHandlerImpl::isProfilingEnabled() const
+{
+    return m_profiler != nullptr;
+}
+
+void EffectsHandlerImpl::setProfilingEnabled(bool enabled)
+{
+    if (isProfilingEnabled() == enabled) {
+        return;
+    }
+
+    // The timer queries of the profiler belong to the OpenGL context.
+    const bool openGL = isOpenGLCompositing() && makeOpenGLContextCurrent();
+    if (enabled) {
+        const bool gpuTimers = openGL && !GLPlatform::instance()->isGLES()
+            && (hasGLVersion(3, 3) || hasGLExtension(QByteArrayLiteral("GL_ARB_timer_query")));
+        m_profiler = std::make_unique<EffectProfiler>(gpuTimers);
+    } else {
+        m_profiler.reset();
+    }
+    Q_EMIT profilingEnabledChanged(enabled);
+}
+
+QVariantMap EffectsHandlerImpl::effectTimings() const
+{
+    if (!m_profiler) {
+        return QVariantMap();
+    }
+
+    QVariantMap outputs;
+    const auto &timings = m_profiler->timings();
+    for (auto it = timings.constBegin(); it != timings.constEnd(); ++it) {
+        QVariantMap effectMap = outputs.value(it.key().output).toMap();
+        QVariantMap passMap = effectMap.value(it.key().effect).toMap();
+        QVariantMap timingsMap{
+            {QStringLiteral("cpu"), it.value().cpuTimes.toVariantMap()},
+        };
+        if (it.value().gpuTimes.count()) {
+            timingsMap.insert(QStringLiteral("gpu"), it.value().gpuTimes.toVariantMap());
+        }
+        passMap.insert(EffectProfiler::passName(it.key().pass), timingsMap);
+        effectMap.insert(it.key().effect, passMap);
+        outputs.insert(it.key().output, effectMap);
+    }
+    return outputs;
+}
+
 bool EffectsHandlerImpl::makeOpenGLContextCurrent()
 {
     return m_scene->makeOpenGLContextCurrent();
@@ -1822,6 +1967,11 @@ qreal EffectsHandlerImpl::renderTargetScale() const
     return m_scene->renderTargetScale();
 }
 
+QRegion EffectsHandlerImpl::renderTargetRepaints() const
+{
+    return m_scene->sceneRepaints();
+}
+
 KWin::EffectWindow *EffectsHandlerImpl::inputPanel() const
 {
     if (!kwinApp()->inputMethod() || !kwinApp()->inputMethod()->isEnabled()) {
@@ -13,11 +13,13 @@
 
 #include "kwineffects.h"
 
+#include "effectprofiler.h"
 #include "kwinoffscreenquickview.h"
 #include "scene.h"
 
 #include <QFont>
 #include <QHash>
+#include <QSet>
 
 #include <memory>
 
@@ -65,6 +67,8 @@ public:
     Effect *provides(Effect::Feature ef);
 
     void drawWindow(EffectWindow *w, int mask, const QRegion &region, WindowPaintData &data) override;
+    void setWindowPassesRestricted(Effect *effect, bool restricted) override;
+    void setWindowPassesEnabled(Effect *effect, EffectWindow *window, bool enabled) override;
 
     void activateWindow(EffectWindow *c) override;
     EffectWindow *activeWindow() const override;
@@ -180,7 +184,14 @@ public:
     xcb_window_t x11RootWindow() const override;
 
     // internal (used by kwin core or compositing code)
-    void startPaint();
+    void startPaint(Output *output);
+    /**
+     * Returns the effect profiler, or @c null if profiling is disabled.
+     */
+    const EffectProfiler *profiler() const
+    {
+        return m_profiler.get();
+    }
     void grabbedKeyboardEvent(QKeyEvent *e);
     bool hasKeyboardGrab() const;
 
@@ -188,6 +199,12 @@ public:
     QStringList loadedEffects() const;
     QStringList listOfEffects() const;
     void unloadAllEffects();
+    /**
+     * Adds the @a effect, which hasn't been created by the effect loader, to the loaded effects
+     * under the given @a name. The effects handler takes the ownership of the effect. This is
+     * meant for tests and benchmarks that provide their own effects.
+     */
+    void addEffect(Effect *effect, const QString &name);
 
     QList<EffectWindow *> elevatedWindows() const;
     QStringList activeEffects() const;
@@ -259,6 +276,7 @@ public:
     bool isCursorHidden() const override;
     QRect renderTargetRect() const override;
     qreal renderTargetScale() const override;
+    QRegion renderTargetRepaints() const override;
 
     KWin::EffectWindow *inputPanel() const override;
     bool isInputPanelOverlay() const override;
@@ -278,6 +296,15 @@ public Q_SLOTS:
     Q_SCRIPTABLE QList<bool> areEffectsSupported(const QStringList &names);
     Q_SCRIPTABLE QString supportInformation(const QString &name) const;
     Q_SCRIPTABLE QString debug(const QString &name, const QString &parameter = QString()) const;
+    Q_SCRIPTABLE bool isProfilingEnabled() const;
+    Q_SCRIPTABLE void setProfilingEnabled(bool enabled);
+    Q_SCRIPTABLE QVariantMap effectTimings() const;
+
+Q_SIGNALS:
+    /**
+     * This signal is emitted when the effect profiler has been enabled or disabled.
+     */
+    void profilingEnabledChanged(bool enabled);
 
 protected Q_SLOTS:
     void slotWindowShown(KWin::Window *);
@@ -339,6 +366,16 @@ private:
     EffectsIterator m_currentDrawWindowIterator;
     EffectsIterator m_currentPaintWindowIterator;
     EffectsIterator m_currentPaintScreenIterator;
+    EffectsIterator nextWindowPass(EffectsIterator it, EffectWindow *w) const;
+    void updateWindowPasses(EffectWindowImpl *w) const;
+
+    std::unique_ptr<EffectProfiler> m_profiler;
+    // The windows that the effects with restricted window passes are interested in
+    QHash<Effect *, QSet<EffectWindow *>> m_windowPassRestrictions;
+    // Bumped whenever the active effects or the restrictions change, the window pass lists
+    // of the windows are built again when they are used next.
+    quint64 m_windowPassesGeneration = 1;
+    QVector<QString> m_activeEffectNames;
     typedef QHash<QByteArray, QList<Effect *>> PropertyEffectMap;
     PropertyEffectMap m_propertiesForEffects;
     QHash<QByteArray, qulonglong> m_managedProperties;
@@ -514,6 +551,12 @@ private:
     bool managed = false;
     bool m_waylandWindow;
     bool m_x11Window;
+
+    // For every active effect, the index of the first effect from there on whose window passes
+    // are called for this window. Built by EffectsHandlerImpl::nextWindowPass() when it is stale.
+    QVector<int> m_windowPasses;
+    quint64 m_windowPassesGeneration = 0;
+    friend class EffectsHandlerImpl;
 };
 
 class EffectWindowGroupImpl
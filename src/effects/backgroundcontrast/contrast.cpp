@@ -14,6 +14,8 @@
 #include "wayland/display.h"
 #include "wayland/surface_interface.h"
 
+#include <kwinglrendertargetpool.h>
+
 #include <QCoreApplication>
 #include <QMatrix4x4>
 #include <QTimer>
@@ -423,9 +425,12 @@ void ContrastEffect::doContrast(EffectWindow *w, const QRegion &shape, const QRe
 
     // Create a scratch texture and copy the area in the back buffer that we're
     // going to blur into it
-    GLTexture scratch(GL_RGBA8, r.width() * scale, r.height() * scale);
-    scratch.setFilter(GL_LINEAR);
-    scratch.setWrapMode(GL_CLAMP_TO_EDGE);
+    GLRenderTarget scratchTarget = GLRenderTargetPool::instance()->acquire(QSize(r.width() * scale, r.height() * scale));
+    if (!scratchTarget.isValid()) {
+        vbo->unbindArrays();
+        return;
+    }
+    GLTexture &scratch = *scratchTarget.texture;
     scratch.bind();
 
     const QRect sg = effects->renderTargetRect();
@@ -449,7 +454,7 @@ void ContrastEffect::doContrast(EffectWindow *w, const QRegion &shape, const QRe
     vbo->draw(GL_TRIANGLES, 0, actualShape.rectCount() * 6);
 
     scratch.unbind();
-    scratch.discard();
+    GLRenderTargetPool::instance()->release(std::move(scratchTarget));
 
     vbo->unbindArrays();
 
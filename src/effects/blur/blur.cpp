@@ -69,6 +69,8 @@ BlurEffect::BlurEffect()
 
     connect(effects, &EffectsHandler::windowAdded, this, &BlurEffect::slotWindowAdded);
     connect(effects, &EffectsHandler::windowDeleted, this, &BlurEffect::slotWindowDeleted);
+    connect(effects, &EffectsHandler::windowMinimized, this, &BlurEffect::slotWindowHidden);
+    connect(effects, &EffectsHandler::desktopPresenceChanged, this, &BlurEffect::slotWindowHidden);
     connect(effects, &EffectsHandler::windowDecorationChanged, this, &BlurEffect::setupDecorationConnections);
     connect(effects, &EffectsHandler::propertyNotify, this, &BlurEffect::slotPropertyNotify);
     connect(effects, &EffectsHandler::virtualScreenGeometryChanged, this, &BlurEffect::slotScreenGeometryChanged);
@@ -117,6 +119,8 @@ bool BlurEffect::renderTargetsValid() const
 
 void BlurEffect::deleteFBOs()
 {
+    releaseAllBlurCaches();
+
     qDeleteAll(m_renderTargets);
     qDeleteAll(m_renderTextures);
 
@@ -344,6 +348,8 @@ void BlurEffect::slotWindowAdded(EffectWindow *w)
 
 void BlurEffect::slotWindowDeleted(EffectWindow *w)
 {
+    slotWindowHidden(w);
+
     auto it = windowBlurChangedConnections.find(w);
     if (it == windowBlurChangedConnections.end()) {
         return;
@@ -352,6 +358,16 @@ void BlurEffect::slotWindowDeleted(EffectWindow *w)
     windowBlurChangedConnections.erase(it);
 }
 
+void BlurEffect::slotWindowHidden(EffectWindow *w)
+{
+    // The blurred background of a window that isn't painted goes stale, don't keep it around.
+    if (m_blurCaches.find(w) != m_blurCaches.end()) {
+        effects->makeOpenGLContextCurrent();
+        releaseBlurCaches(w);
+        effects->doneOpenGLContextCurrent();
+    }
+}
+
 void BlurEffect::slotPropertyNotify(EffectWindow *w, long atom)
 {
     if (w && atom == net_wm_blur_region && net_wm_blur_region != XCB_ATOM_NONE) {
@@ -525,6 +541,7 @@ void BlurEffect::prePaintScreen(ScreenPrePaintData &data, std::chrono::milliseco
 {
     m_paintedArea = QRegion();
     m_currentBlur = QRegion();
+    m_changedArea = QRegion();
 
     effects->prePaintScreen(data, presentTime);
 }
@@ -539,6 +556,19 @@ void BlurEffect::prePaintWindow(EffectWindow *w, WindowPrePaintData &data, std::
         return;
     }
 
+    // The cached blurred background of this window is outdated where the windows below have changed.
+    const QRegion damage = data.paint;
+    auto cacheIt = m_blurCaches.find(w);
+    if (cacheIt != m_blurCaches.end()) {
+        const QRect renderTargetRect = effects->renderTargetRect();
+        for (BlurCache &cache : cacheIt->second) {
+            if (cache.screen == renderTargetRect) {
+                cache.prePainted = true;
+            }
+            cache.damage += m_changedArea & expand(cache.shape);
+        }
+    }
+
     const QRegion oldOpaque = data.opaque;
     if (data.opaque.intersects(m_currentBlur)) {
         // to blur an area partially we have to shrink the opaque area of a window
@@ -578,6 +608,27 @@ void BlurEffect::prePaintWindow(EffectWindow *w, WindowPrePaintData &data, std::
 
     m_paintedArea -= data.opaque;
     m_paintedArea |= data.paint;
+
+    m_changedArea -= data.opaque;
+    m_changedArea |= damage;
+}
+
+void BlurEffect::paintScreen(int mask, const QRegion &region, ScreenPaintData &data)
+{
+    releaseStaleBlurCaches(effects->renderTargetRect());
+
+    // Windows that have been moved, closed, restacked or animated don't always damage the
+    // windows below them, so the blurred backgrounds need to be checked against the repaints.
+    const QRegion repaints = effects->renderTargetRepaints();
+    if (!repaints.isEmpty()) {
+        for (auto &entry : m_blurCaches) {
+            for (BlurCache &cache : entry.second) {
+                cache.damage += repaints & expand(cache.shape);
+            }
+        }
+    }
+
+    effects->paintScreen(mask, region, data);
 }
 
 bool BlurEffect::shouldBlur(const EffectWindow *w, int mask, const WindowPaintData &data) const
@@ -641,7 +692,15 @@ void BlurEffect::drawWindow(EffectWindow *w, int mask, const QRegion &region, Wi
         const bool transientForIsDock = (modal ? modal->isDock() : false);
 
         if (!shape.isEmpty()) {
-            doBlur(shape, screen, data.opacity(), data.screenProjectionMatrix(), w->isDock() || transientForIsDock, w->frameGeometry().toRect());
+            const bool isDock = w->isDock() || transientForIsDock;
+
+            // The blurred background can be reused only if the window is painted where it is.
+            BlurCache *cache = nullptr;
+            if (!scaled && !translated && !(mask & PAINT_WINDOW_TRANSFORMED)) {
+                cache = blurCache(w, screen, isDock);
+            }
+
+            doBlur(shape, screen, data.opacity(), data.screenProjectionMatrix(), isDock, w->frameGeometry().toRect(), cache);
         }
     }
 
@@ -676,17 +735,206 @@ void BlurEffect::generateNoiseTexture()
     m_noiseTexture->setWrapMode(GL_REPEAT);
 }
 
-void BlurEffect::doBlur(const QRegion &shape, const QRect &screen, const float opacity, const QMatrix4x4 &screenProjection, bool isDock, QRect windowRect)
+/**
+ * Maps the specified @a rect in the coordinates of the full resolution render texture to
+ * the half resolution render texture, rounding outwards.
+ */
+static QRect downscaledRect(const QRect &rect)
+{
+    const int left = std::floor(rect.x() / 2.0);
+    const int top = std::floor(rect.y() / 2.0);
+    const int right = std::ceil((rect.x() + rect.width()) / 2.0);
+    const int bottom = std::ceil((rect.y() + rect.height()) / 2.0);
+    return QRect(left, top, right - left, bottom - top);
+}
+
+static int alignDown(int value, int alignment)
+{
+    return std::floor(value / double(alignment)) * alignment;
+}
+
+static int alignUp(int value, int alignment)
+{
+    return std::ceil(value / double(alignment)) * alignment;
+}
+
+static void releaseRenderTarget(GLRenderTarget &target)
+{
+    GLRenderTargetPool *pool = GLRenderTargetPool::existingInstance();
+    if (pool && target.isValid()) {
+        pool->release(std::move(target));
+    } else {
+        target = GLRenderTarget();
+    }
+}
+
+BlurEffect::BlurCache *BlurEffect::blurCache(EffectWindow *w, const QRect &screen, bool isDock)
+{
+    const QRegion shape = blurRegion(w).translated(w->pos().toPoint()) & screen;
+
+    std::vector<BlurCache> &caches = m_blurCaches[w];
+    auto it = std::find_if(caches.begin(), caches.end(), [&screen](const BlurCache &cache) {
+        return cache.screen == screen;
+    });
+    if (it == caches.end()) {
+        caches.push_back(BlurCache{});
+        it = caches.end() - 1;
+        it->screen = screen;
+    }
+
+    if (it->shape != shape || it->isDock != isDock) {
+        releaseRenderTarget(it->target);
+        it->shape = shape;
+        it->isDock = isDock;
+    }
+
+    return &*it;
+}
+
+void BlurEffect::releaseBlurCaches(EffectWindow *w)
+{
+    auto it = m_blurCaches.find(w);
+    if (it == m_blurCaches.end()) {
+        return;
+    }
+    for (BlurCache &cache : it->second) {
+        releaseRenderTarget(cache.target);
+    }
+    m_blurCaches.erase(it);
+}
+
+void BlurEffect::releaseAllBlurCaches()
+{
+    for (auto &entry : m_blurCaches) {
+        for (BlurCache &cache : entry.second) {
+            releaseRenderTarget(cache.target);
+        }
+    }
+    m_blurCaches.clear();
+}
+
+void BlurEffect::releaseStaleBlurCaches(const QRect &screen)
+{
+    // Windows that are not pre-painted, e.g. because they are minimized or on another virtual
+    // desktop, don't see the damage of the windows below them, so their caches can't be trusted
+    // once they are shown again.
+    for (auto it = m_blurCaches.begin(); it != m_blurCaches.end();) {
+        std::vector<BlurCache> &caches = it->second;
+        for (auto cacheIt = caches.begin(); cacheIt != caches.end();) {
+            if (cacheIt->screen != screen) {
+                ++cacheIt;
+            } else if (cacheIt->prePainted) {
+                cacheIt->prePainted = false;
+                ++cacheIt;
+            } else {
+                releaseRenderTarget(cacheIt->target);
+                cacheIt = caches.erase(cacheIt);
+            }
+        }
+        if (caches.empty()) {
+            it = m_blurCaches.erase(it);
+        } else {
+            ++it;
+        }
+    }
+}
+
+QRegion BlurEffect::damagedBlurShape(const BlurCache *cache, const QRect &screen, const QPoint &translation) const
+{
+    // The damage is snapped to a grid in the render texture coordinates, so the damaged
+    // tiles map to whole pixels in the half resolution render texture.
+    static const int tileSize = 64;
+
+    const QRegion cacheArea = expand(cache->shape) & expand(screen);
+    const QRegion affected = (expand(cache->damage) & cacheArea).translated(translation);
+
+    QRegion tiles;
+    for (const QRect &rect : affected) {
+        tiles += QRect(QPoint(alignDown(rect.x(), tileSize), alignDown(rect.y(), tileSize)),
+                       QPoint(alignUp(rect.x() + rect.width(), tileSize) - 1, alignUp(rect.y() + rect.height(), tileSize) - 1));
+    }
+
+    return tiles.translated(-translation) & cacheArea;
+}
+
+void BlurEffect::updateBlurCache(BlurCache *cache, const QRect &cacheRect, const QRegion &restoreRegion, const QRect &saveRect)
+{
+    GLFramebuffer *target = m_renderTargets[1];
+
+    if (!restoreRegion.isEmpty()) {
+        GLFramebuffer::pushFramebuffer(cache->target.framebuffer.get());
+        for (const QRect &rect : restoreRegion) {
+            const QRect destination = downscaledRect(rect) & cacheRect;
+            if (!destination.isEmpty()) {
+                target->blitFromFramebuffer(destination.translated(-cacheRect.topLeft()), destination, GL_NEAREST);
+            }
+        }
+        GLFramebuffer::popFramebuffer();
+    }
+
+    if (!saveRect.isEmpty()) {
+        GLFramebuffer::pushFramebuffer(target);
+        cache->target.framebuffer->blitFromFramebuffer(saveRect, saveRect.translated(-cacheRect.topLeft()), GL_NEAREST);
+        GLFramebuffer::popFramebuffer();
+    }
+}
+
+void BlurEffect::doBlur(const QRegion &shape, const QRect &screen, const float opacity, const QMatrix4x4 &screenProjection, bool isDock, QRect windowRect, BlurCache *cache)
 {
     // Blur would not render correctly on a secondary monitor because of wrong coordinates
     // BUG: 393723
     const int xTranslate = -screen.x();
     const int yTranslate = effects->virtualScreenSize().height() - screen.height() - screen.y();
 
-    const QRegion expandedBlurRegion = expand(shape) & expand(screen);
-
     const bool useSRGB = m_renderTextures.constFirst()->internalFormat() == GL_SRGB8_ALPHA8;
 
+    // If the blurred background of the window is cached, only the parts of the background
+    // that have changed since the last frame are blurred again, the rest is copied from
+    // the cache into the half resolution render texture.
+    QRegion blurShape = shape;
+    QRect cacheRect;
+    QRegion restoreRegion;
+    QRect saveRect;
+    if (cache) {
+        const QRegion cacheArea = expand(cache->shape) & expand(screen);
+        const QRect textureRect(QPoint(0, 0), m_renderTextures[1]->size());
+        cacheRect = downscaledRect(cacheArea.boundingRect().translated(xTranslate, yTranslate)) & textureRect;
+
+        bool fullUpdate = false;
+        if (!cache->target.isValid()) {
+            cache->target = GLRenderTargetPool::instance()->acquire(cacheRect.size(), m_renderTextures[1]->internalFormat());
+            fullUpdate = true;
+        }
+
+        if (!cache->target.isValid()) {
+            cache = nullptr;
+        } else if (!fullUpdate && cache->damage.isEmpty()) {
+            blurShape = QRegion();
+            restoreRegion = cacheArea.boundingRect().translated(xTranslate, yTranslate);
+        } else {
+            const QRegion damagedShape = fullUpdate ? cacheArea : damagedBlurShape(cache, screen, QPoint(xTranslate, yTranslate));
+            const QRect damagedRect = damagedShape.boundingRect();
+            const QRect cacheBounds = cacheArea.boundingRect();
+
+            // Blurring many small tiles isn't cheaper than blurring the whole window.
+            if (fullUpdate || damagedShape.rectCount() > 16
+                || qint64(damagedRect.width()) * damagedRect.height() * 4 > qint64(cacheBounds.width()) * cacheBounds.height() * 3) {
+                blurShape = cache->shape;
+                saveRect = cacheRect;
+            } else {
+                blurShape = damagedShape;
+                restoreRegion = (QRegion(cacheBounds) - damagedShape).translated(xTranslate, yTranslate);
+                saveRect = downscaledRect(damagedRect.translated(xTranslate, yTranslate)) & cacheRect;
+            }
+        }
+
+        if (cache) {
+            cache->damage = QRegion();
+        }
+    }
+
+    const QRegion expandedBlurRegion = expand(blurShape) & expand(screen);
+
     // Upload geometry for the down and upsample iterations
     GLVertexBuffer *vbo = GLVertexBuffer::streamingBuffer();
     vbo->reset();
@@ -698,40 +946,54 @@ void BlurEffect::doBlur(const QRegion &shape, const QRect &screen, const float o
     const QRect destRect = sourceRect.translated(xTranslate, yTranslate);
     int blurRectCount = expandedBlurRegion.rectCount() * 6;
 
-    /*
-     * If the window is a dock or panel we avoid the "extended blur" effect.
-     * Extended blur is when windows that are not under the blurred area affect
-     * the final blur result.
-     * We want to avoid this on panels, because it looks really weird and ugly
-     * when maximized windows or windows near the panel affect the dock blur.
-     */
-    if (isDock) {
-        m_renderTargets.last()->blitFromFramebuffer(effects->mapToRenderTarget(sourceRect), destRect);
-        GLFramebuffer::pushFramebuffers(m_renderTargetStack);
+    if (!blurShape.isEmpty()) {
+        /*
+         * If the window is a dock or panel we avoid the "extended blur" effect.
+         * Extended blur is when windows that are not under the blurred area affect
+         * the final blur result.
+         * We want to avoid this on panels, because it looks really weird and ugly
+         * when maximized windows or windows near the panel affect the dock blur.
+         */
+        if (isDock) {
+            m_renderTargets.last()->blitFromFramebuffer(effects->mapToRenderTarget(sourceRect), destRect);
+            GLFramebuffer::pushFramebuffers(m_renderTargetStack);
+
+            if (useSRGB) {
+                glEnable(GL_FRAMEBUFFER_SRGB);
+            }
 
-        if (useSRGB) {
-            glEnable(GL_FRAMEBUFFER_SRGB);
+            const QRect screenRect = effects->virtualScreenGeometry();
+            QMatrix4x4 mvp;
+            mvp.ortho(0, screenRect.width(), screenRect.height(), 0, 0, 65535);
+            const QRegion clampShape = cache ? cache->shape : shape;
+            copyScreenSampleTexture(vbo, blurRectCount, clampShape.translated(xTranslate, yTranslate), mvp);
+        } else {
+            m_renderTargets.first()->blitFromFramebuffer(effects->mapToRenderTarget(sourceRect), destRect);
+            GLFramebuffer::pushFramebuffers(m_renderTargetStack);
+
+            if (useSRGB) {
+                glEnable(GL_FRAMEBUFFER_SRGB);
+            }
+
+            // Remove the m_renderTargets[0] from the top of the stack that we will not use
+            GLFramebuffer::popFramebuffer();
         }
 
-        const QRect screenRect = effects->virtualScreenGeometry();
-        QMatrix4x4 mvp;
-        mvp.ortho(0, screenRect.width(), screenRect.height(), 0, 0, 65535);
-        copyScreenSampleTexture(vbo, blurRectCount, shape.translated(xTranslate, yTranslate), mvp);
-    } else {
-        m_renderTargets.first()->blitFromFramebuffer(effects->mapToRenderTarget(sourceRect), destRect);
-        GLFramebuffer::pushFramebuffers(m_renderTargetStack);
+        downSampleTexture(vbo, blurRectCount);
+        upSampleTexture(vbo, blurRectCount);
+    }
 
+    if (cache) {
+        // The cached texels are copied as is, without any color space conversion.
+        if (useSRGB) {
+            glDisable(GL_FRAMEBUFFER_SRGB);
+        }
+        updateBlurCache(cache, cacheRect, restoreRegion, saveRect);
         if (useSRGB) {
             glEnable(GL_FRAMEBUFFER_SRGB);
         }
-
-        // Remove the m_renderTargets[0] from the top of the stack that we will not use
-        GLFramebuffer::popFramebuffer();
     }
 
-    downSampleTexture(vbo, blurRectCount);
-    upSampleTexture(vbo, blurRectCount);
-
     // Modulate the blurred texture with the window opacity if the window isn't opaque
     if (opacity < 1.0) {
         glEnable(GL_BLEND);
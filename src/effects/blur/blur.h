@@ -10,12 +10,16 @@
 
 #include <kwineffects.h>
 #include <kwinglplatform.h>
+#include <kwinglrendertargetpool.h>
 #include <kwinglutils.h>
 
 #include <QStack>
 #include <QVector2D>
 #include <QVector>
 
+#include <map>
+#include <vector>
+
 namespace KWaylandServer
 {
 class BlurManagerInterface;
@@ -42,6 +46,7 @@ public:
     void reconfigure(ReconfigureFlags flags) override;
     void prePaintScreen(ScreenPrePaintData &data, std::chrono::milliseconds presentTime) override;
     void prePaintWindow(EffectWindow *w, WindowPrePaintData &data, std::chrono::milliseconds presentTime) override;
+    void paintScreen(int mask, const QRegion &region, ScreenPaintData &data) override;
     void drawWindow(EffectWindow *w, int mask, const QRegion &region, WindowPaintData &data) override;
 
     bool provides(Feature feature) override;
@@ -59,11 +64,26 @@ public:
 public Q_SLOTS:
     void slotWindowAdded(KWin::EffectWindow *w);
     void slotWindowDeleted(KWin::EffectWindow *w);
+    void slotWindowHidden(KWin::EffectWindow *w);
     void slotPropertyNotify(KWin::EffectWindow *w, long atom);
     void slotScreenGeometryChanged();
     void setupDecorationConnections(EffectWindow *w);
 
 private:
+    /**
+     * The blurred background of a window on a given screen, i.e. the contents of the half
+     * resolution render texture that the final upsample pass reads from.
+     */
+    struct BlurCache
+    {
+        QRect screen;
+        bool isDock = false;
+        QRegion shape; // the blurred area of the window, in the global coordinates
+        GLRenderTarget target;
+        QRegion damage; // the background that has changed since the cache was updated
+        bool prePainted = false; // whether the window has been pre-painted in the current frame
+    };
+
     QRect expand(const QRect &rect) const;
     QRegion expand(const QRegion &region) const;
     bool renderTargetsValid() const;
@@ -75,7 +95,13 @@ private:
     bool decorationSupportsBlurBehind(const EffectWindow *w) const;
     bool shouldBlur(const EffectWindow *w, int mask, const WindowPaintData &data) const;
     void updateBlurRegion(EffectWindow *w) const;
-    void doBlur(const QRegion &shape, const QRect &screen, const float opacity, const QMatrix4x4 &screenProjection, bool isDock, QRect windowRect);
+    BlurCache *blurCache(EffectWindow *w, const QRect &screen, bool isDock);
+    void releaseBlurCaches(EffectWindow *w);
+    void releaseAllBlurCaches();
+    void releaseStaleBlurCaches(const QRect &screen);
+    QRegion damagedBlurShape(const BlurCache *cache, const QRect &screen, const QPoint &translation) const;
+    void updateBlurCache(BlurCache *cache, const QRect &cacheRect, const QRegion &restoreRegion, const QRect &saveRect);
+    void doBlur(const QRegion &shape, const QRect &screen, const float opacity, const QMatrix4x4 &screenProjection, bool isDock, QRect windowRect, BlurCache *cache);
     void uploadRegion(QVector2D *&map, const QRegion &region, const int downSampleIterations);
     void uploadGeometry(GLVertexBuffer *vbo, const QRegion &blurRegion, const QRegion &windowRegion);
     void generateNoiseTexture();
@@ -98,6 +124,8 @@ private:
     long net_wm_blur_region = 0;
     QRegion m_paintedArea; // keeps track of all painted areas (from bottom to top)
     QRegion m_currentBlur; // keeps track of the currently blured area of the windows(from bottom to top)
+    QRegion m_changedArea; // keeps track of the areas whose contents have changed (from bottom to top)
+    std::map<EffectWindow *, std::vector<BlurCache>> m_blurCaches;
 
     int m_downSampleIterations; // number of times the texture will be downsized to half size
     int m_offset;
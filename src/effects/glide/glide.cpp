@@ -38,6 +38,9 @@ GlideEffect::GlideEffect()
     connect(effects, &EffectsHandler::windowClosed, this, &GlideEffect::windowClosed);
     connect(effects, &EffectsHandler::windowDeleted, this, &GlideEffect::windowDeleted);
     connect(effects, &EffectsHandler::windowDataChanged, this, &GlideEffect::windowDataChanged);
+
+    // Windows that are not animated don't need to go through this effect.
+    effects->setWindowPassesRestricted(this, true);
 }
 
 GlideEffect::~GlideEffect() = default;
@@ -164,6 +167,7 @@ void GlideEffect::postPaintScreen()
     auto animationIt = m_animations.begin();
     while (animationIt != m_animations.end()) {
         if ((*animationIt).timeLine.done()) {
+            effects->setWindowPassesEnabled(this, animationIt.key(), false);
             animationIt = m_animations.erase(animationIt);
         } else {
             ++animationIt;
@@ -206,6 +210,7 @@ void GlideEffect::windowAdded(EffectWindow *w)
 
     w->setData(WindowAddedGrabRole, QVariant::fromValue(static_cast<void *>(this)));
 
+    effects->setWindowPassesEnabled(this, w, true);
     GlideAnimation &animation = m_animations[w];
     animation.timeLine.reset();
     animation.timeLine.setDirection(TimeLine::Forward);
@@ -236,6 +241,7 @@ void GlideEffect::windowClosed(EffectWindow *w)
 
     w->setData(WindowClosedGrabRole, QVariant::fromValue(static_cast<void *>(this)));
 
+    effects->setWindowPassesEnabled(this, w, true);
     GlideAnimation &animation = m_animations[w];
     animation.deletedRef = EffectWindowDeletedRef(w);
     animation.visibleRef = EffectWindowVisibleRef(w, EffectWindow::PAINT_DISABLED_BY_DELETE);
@@ -250,6 +256,7 @@ void GlideEffect::windowClosed(EffectWindow *w)
 void GlideEffect::windowDeleted(EffectWindow *w)
 {
     m_animations.remove(w);
+    effects->setWindowPassesEnabled(this, w, false);
 }
 
 void GlideEffect::windowDataChanged(EffectWindow *w, int role)
@@ -265,6 +272,7 @@ void GlideEffect::windowDataChanged(EffectWindow *w, int role)
     auto animationIt = m_animations.find(w);
     if (animationIt != m_animations.end()) {
         m_animations.erase(animationIt);
+        effects->setWindowPassesEnabled(this, w, false);
     }
 }
 
@@ -39,6 +39,9 @@ HighlightWindowEffect::HighlightWindowEffect()
                                                  this,
                                                  QDBusConnection::ExportScriptableContents);
     QDBusConnection::sessionBus().registerService(QStringLiteral("org.kde.KWin.HighlightWindow"));
+
+    // Only the windows whose opacity is being animated need to be painted by this effect.
+    effects->setWindowPassesRestricted(this, true);
 }
 
 HighlightWindowEffect::~HighlightWindowEffect()
@@ -10,7 +10,9 @@
 
 #include "expolayout.h"
 
+#include <algorithm>
 #include <cmath>
+#include <limits>
 
 ExpoCell::ExpoCell(QObject *parent)
     : QObject(parent)
@@ -342,11 +344,205 @@ void ExpoLayout::geometryChange(const QRectF &newGeometry, const QRectF &oldGeom
 #endif
 }
 
-static int distance(const QPoint &a, const QPoint &b)
+static qreal distance(const QPoint &a, const QPoint &b)
 {
-    const int xdiff = a.x() - b.x();
-    const int ydiff = a.y() - b.y();
-    return int(std::sqrt(qreal(xdiff * xdiff + ydiff * ydiff)));
+    return std::hypot(qreal(a.x() - b.x()), qreal(a.y() - b.y()));
+}
+
+/**
+ * Solves the assignment problem for a @a rows by @a columns cost matrix, where @a rows is
+ * not greater than @a columns, using the Hungarian algorithm. Returns the column assigned
+ * to every row, so that the sum of the costs is minimal.
+ */
+static QVector<int> solveAssignment(const QVector<qreal> &costs, int rows, int columns)
+{
+    Q_ASSERT(rows <= columns);
+    const qreal infinity = std::numeric_limits<qreal>::infinity();
+
+    // The potentials and the matching are 1-based, the column 0 is a fake one that is used
+    // to start the search for an augmenting path.
+    std::vector<qreal> u(rows + 1, 0);
+    std::vector<qreal> v(columns + 1, 0);
+    std::vector<int> matching(columns + 1, 0);
+    std::vector<int> way(columns + 1, 0);
+    std::vector<qreal> minimum(columns + 1);
+    std::vector<char> used(columns + 1);
+
+    for (int row = 1; row <= rows; ++row) {
+        matching[0] = row;
+        int column0 = 0;
+        std::fill(minimum.begin(), minimum.end(), infinity);
+        std::fill(used.begin(), used.end(), false);
+        do {
+            used[column0] = true;
+            const int row0 = matching[column0];
+            const qreal *rowCosts = costs.constData() + (row0 - 1) * columns;
+            qreal delta = infinity;
+            int column1 = 0;
+            for (int column = 1; column <= columns; ++column) {
+                if (used[column]) {
+                    continue;
+                }
+                const qreal reduced = rowCosts[column - 1] - u[row0] - v[column];
+                if (reduced < minimum[column]) {
+                    minimum[column] = reduced;
+                    way[column] = column0;
+                }
+                if (minimum[column] < delta) {
+                    delta = minimum[column];
+                    column1 = column;
+                }
+            }
+            for (int column = 0; column <= columns; ++column) {
+                if (used[column]) {
+                    u[matching[column]] += delta;
+                    v[column] -= delta;
+                } else {
+                    minimum[column] -= delta;
+                }
+            }
+            column0 = column1;
+        } while (matching[column0] != 0);
+
+        do {
+            const int column1 = way[column0];
+            matching[column0] = matching[column1];
+            column0 = column1;
+        } while (column0 != 0);
+    }
+
+    QVector<int> assignment(rows, -1);
+    for (int column = 1; column <= columns; ++column) {
+        if (matching[column]) {
+            assignment[matching[column] - 1] = column - 1;
+        }
+    }
+    return assignment;
+}
+
+/**
+ * The CellGrid class is a uniform grid that indexes the target rects of the cells, grown by
+ * a margin, so the cells that overlap a given rect can be found without looking at every
+ * other cell. The index must be kept up to date with update() whenever a target rect changes.
+ */
+class CellGrid
+{
+public:
+    CellGrid(const QVector<QRect> &rects, int margin);
+
+    void update(int index, const QRect &rect);
+
+    /**
+     * Returns the smallest index greater than @a after of a cell other than @a index whose
+     * rect overlaps @a rect, or -1 if there is no such cell.
+     */
+    int nextOverlapping(int index, const QRect &rect, int after) const;
+
+private:
+    QRect bucketRange(const QRect &rect) const;
+
+    QMargins m_margins;
+    QPoint m_origin;
+    int m_bucketSize = 1;
+    int m_columns = 1;
+    int m_rows = 1;
+    QVector<QRect> m_rects;
+    QVector<QRect> m_ranges;
+    std::vector<std::vector<int>> m_buckets;
+};
+
+CellGrid::CellGrid(const QVector<QRect> &rects, int margin)
+    : m_margins(margin, margin, margin, margin)
+    , m_rects(rects.count())
+    , m_ranges(rects.count())
+{
+    QRect bounds;
+    qint64 totalSize = 0;
+    for (const QRect &rect : rects) {
+        const QRect grown = rect.marginsAdded(m_margins);
+        bounds |= grown;
+        totalSize += std::max(grown.width(), grown.height());
+    }
+
+    // Buckets roughly as large as an average cell keep the number of candidates low. Cells
+    // that move out of the bounds end up in the buckets along the edges, which is still correct.
+    const int maxBucketCount = 128;
+    m_origin = bounds.topLeft();
+    m_bucketSize = std::max<qint64>(1, totalSize / std::max(1, int(rects.count())));
+    m_bucketSize = std::max(m_bucketSize, (std::max(bounds.width(), bounds.height()) + maxBucketCount - 1) / maxBucketCount);
+    m_columns = std::max(1, (bounds.width() + m_bucketSize - 1) / m_bucketSize);
+    m_rows = std::max(1, (bounds.height() + m_bucketSize - 1) / m_bucketSize);
+    m_buckets.resize(m_columns * m_rows);
+
+    for (int i = 0; i < rects.count(); ++i) {
+        m_rects[i] = rects[i].marginsAdded(m_margins);
+        m_ranges[i] = bucketRange(m_rects[i]);
+        for (int y = m_ranges[i].top(); y <= m_ranges[i].bottom(); ++y) {
+            for (int x = m_ranges[i].left(); x <= m_ranges[i].right(); ++x) {
+                m_buckets[x + y * m_columns].push_back(i);
+            }
+        }
+    }
+}
+
+QRect CellGrid::bucketRange(const QRect &rect) const
+{
+    const auto column = [this](int x) {
+        return std::clamp((x - m_origin.x()) / m_bucketSize, 0, m_columns - 1);
+    };
+    const auto row = [this](int y) {
+        return std::clamp((y - m_origin.y()) / m_bucketSize, 0, m_rows - 1);
+    };
+    return QRect(QPoint(column(rect.left()), row(rect.top())), QPoint(column(rect.right()), row(rect.bottom())));
+}
+
+void CellGrid::update(int index, const QRect &rect)
+{
+    m_rects[index] = rect.marginsAdded(m_margins);
+
+    const QRect range = bucketRange(m_rects[index]);
+    const QRect oldRange = m_ranges[index];
+    if (range == oldRange) {
+        return;
+    }
+
+    for (int y = oldRange.top(); y <= oldRange.bottom(); ++y) {
+        for (int x = oldRange.left(); x <= oldRange.right(); ++x) {
+            if (!range.contains(x, y)) {
+                std::vector<int> &bucket = m_buckets[x + y * m_columns];
+                bucket.erase(std::find(bucket.begin(), bucket.end(), index));
+            }
+        }
+    }
+    for (int y = range.top(); y <= range.bottom(); ++y) {
+        for (int x = range.left(); x <= range.right(); ++x) {
+            if (!oldRange.contains(x, y)) {
+                m_buckets[x + y * m_columns].push_back(index);
+            }
+        }
+    }
+    m_ranges[index] = range;
+}
+
+int CellGrid::nextOverlapping(int index, const QRect &rect, int after) const
+{
+    const QRect grown = rect.marginsAdded(m_margins);
+    const QRect range = bucketRange(grown);
+
+    int next = -1;
+    for (int y = range.top(); y <= range.bottom(); ++y) {
+        for (int x = range.left(); x <= range.right(); ++x) {
+            for (int candidate : m_buckets[x + y * m_columns]) {
+                if (candidate <= after || candidate == index || (next != -1 && candidate >= next)) {
+                    continue;
+                }
+                if (grown.intersects(m_rects[candidate])) {
+                    next = candidate;
+                }
+            }
+        }
+    }
+    return next;
 }
 
 static QRect centered(ExpoCell *cell, const QRect &bounds)
@@ -383,31 +579,19 @@ void ExpoLayout::calculateWindowTransformationsClosest()
         }
     }
 
-    // Assign each window to the closest available slot
-    QList<ExpoCell *> tmpList = m_cells; // use a QLinkedList copy instead?
-    while (!tmpList.isEmpty()) {
-        ExpoCell *cell = tmpList.first();
-        int slotCandidate = -1, slotCandidateDistance = INT_MAX;
-        const QPoint pos = cell->naturalRect().center();
-
-        for (int i = 0; i < columns * rows; ++i) { // all slots
-            const int dist = distance(pos, slotCenters[i]);
-            if (dist < slotCandidateDistance) { // window is interested in this slot
-                ExpoCell *occupier = takenSlots[i];
-                Q_ASSERT(occupier != cell);
-                if (!occupier || dist < distance(occupier->naturalRect().center(), slotCenters[i])) {
-                    // either nobody lives here, or we're better - takeover the slot if it's our best
-                    slotCandidate = i;
-                    slotCandidateDistance = dist;
-                }
-            }
+    // Assign the windows to the slots so that the total distance they travel is minimal
+    const int slotCount = columns * rows;
+    QVector<qreal> costs(m_cells.count() * slotCount);
+    for (int i = 0; i < m_cells.count(); ++i) {
+        const QPoint pos = m_cells[i]->naturalRect().center();
+        for (int slot = 0; slot < slotCount; ++slot) {
+            costs[i * slotCount + slot] = distance(pos, slotCenters[slot]);
         }
-        Q_ASSERT(slotCandidate != -1);
-        if (takenSlots[slotCandidate]) {
-            tmpList << takenSlots[slotCandidate]; // occupier needs a new home now :p
-        }
-        tmpList.removeAll(cell);
-        takenSlots[slotCandidate] = cell; // ...and we rumble in =)
+    }
+
+    const QVector<int> assignment = solveAssignment(costs, m_cells.count(), slotCount);
+    for (int i = 0; i < m_cells.count(); ++i) {
+        takenSlots[assignment[i]] = m_cells[i];
     }
 
     for (int slot = 0; slot < columns * rows; ++slot) {
@@ -451,33 +635,17 @@ void ExpoLayout::calculateWindowTransformationsClosest()
     }
 }
 
-static inline int heightForWidth(ExpoCell *cell, int width)
+static inline int heightForWidth(const ExpoCell *cell, int width)
 {
     return int((width / qreal(cell->naturalWidth())) * cell->naturalHeight());
 }
 
-static bool isOverlappingAny(ExpoCell *w, const QHash<ExpoCell *, QRect> &targets, const QRegion &border, int spacing)
+static bool isOverlappingAny(int index, const QVector<QRect> &targets, const CellGrid &grid, const QRegion &border)
 {
-    QHash<ExpoCell *, QRect>::const_iterator winTarget = targets.find(w);
-    if (winTarget == targets.constEnd()) {
-        return false;
-    }
-    if (border.intersects(*winTarget)) {
+    if (border.intersects(targets[index])) {
         return true;
     }
-    const QMargins halfSpacing(spacing / 2, spacing / 2, spacing / 2, spacing / 2);
-
-    // Is there a better way to do this?
-    QHash<ExpoCell *, QRect>::const_iterator target;
-    for (target = targets.constBegin(); target != targets.constEnd(); ++target) {
-        if (target == winTarget) {
-            continue;
-        }
-        if (winTarget->marginsAdded(halfSpacing).intersects(target->marginsAdded(halfSpacing))) {
-            return true;
-        }
-    }
-    return false;
+    return grid.nextOverlapping(index, targets[index], -1) != -1;
 }
 
 void ExpoLayout::calculateWindowTransformationsNatural()
@@ -492,15 +660,16 @@ void ExpoLayout::calculateWindowTransformationsNatural()
 
     QRect bounds;
     int direction = 0;
-    QHash<ExpoCell *, QRect> targets;
-    QHash<ExpoCell *, int> directions;
+    QVector<QRect> targets(m_cells.count());
+    QVector<int> directions(m_cells.count());
 
-    for (ExpoCell *cell : qAsConst(m_cells)) {
+    for (int i = 0; i < m_cells.count(); ++i) {
+        const ExpoCell *cell = m_cells[i];
         const QRect cellRect(cell->naturalX(), cell->naturalY(), cell->naturalWidth(), cell->naturalHeight());
-        targets[cell] = cellRect;
+        targets[i] = cellRect;
         // Reuse the unused "slot" as a preferred direction attribute. This is used when the window
         // is on the edge of the screen to try to use as much screen real estate as possible.
-        directions[cell] = direction;
+        directions[i] = direction;
         bounds = bounds.united(cellRect);
         direction++;
         if (direction == 4) {
@@ -509,82 +678,80 @@ void ExpoLayout::calculateWindowTransformationsNatural()
     }
 
     // Iterate over all windows, if two overlap push them apart _slightly_ as we try to
-    // brute-force the most optimal positions over many iterations.
+    // brute-force the most optimal positions over many iterations. The overlapping windows
+    // are looked up in a grid, which is rebuilt every iteration as the bounding rect grows.
     const int halfSpacing = m_spacing / 2;
     bool overlap;
     do {
         overlap = false;
-        for (ExpoCell *cell : qAsConst(m_cells)) {
-            QRect *target_w = &targets[cell];
-            for (ExpoCell *e : qAsConst(m_cells)) {
-                if (cell == e) {
-                    continue;
+        CellGrid grid(targets, halfSpacing);
+        for (int i = 0; i < m_cells.count(); ++i) {
+            QRect *target_w = &targets[i];
+            for (int j = grid.nextOverlapping(i, *target_w, -1); j != -1; j = grid.nextOverlapping(i, *target_w, j)) {
+                QRect *target_e = &targets[j];
+                overlap = true;
+
+                // Determine pushing direction
+                QPoint diff(target_e->center() - target_w->center());
+                // Prevent dividing by zero and non-movement
+                if (diff.x() == 0 && diff.y() == 0) {
+                    diff.setX(1);
                 }
-
-                QRect *target_e = &targets[e];
-                if (target_w->adjusted(-halfSpacing, -halfSpacing, halfSpacing, halfSpacing)
-                        .intersects(target_e->adjusted(-halfSpacing, -halfSpacing, halfSpacing, halfSpacing))) {
-                    overlap = true;
-
-                    // Determine pushing direction
-                    QPoint diff(target_e->center() - target_w->center());
-                    // Prevent dividing by zero and non-movement
-                    if (diff.x() == 0 && diff.y() == 0) {
-                        diff.setX(1);
-                    }
-                    // Try to keep screen aspect ratio
-                    // if (bounds.height() / bounds.width() > area.height() / area.width())
-                    //    diff.setY(diff.y() / 2);
-                    // else
-                    //    diff.setX(diff.x() / 2);
-                    // Approximate a vector of between 10px and 20px in magnitude in the same direction
-                    diff *= m_accuracy / qreal(diff.manhattanLength());
-                    // Move both windows apart
-                    target_w->translate(-diff);
-                    target_e->translate(diff);
-
-                    // Try to keep the bounding rect the same aspect as the screen so that more
-                    // screen real estate is utilised. We do this by splitting the screen into nine
-                    // equal sections, if the window center is in any of the corner sections pull the
-                    // window towards the outer corner. If it is in any of the other edge sections
-                    // alternate between each corner on that edge. We don't want to determine it
-                    // randomly as it will not produce consistant locations when using the filter.
-                    // Only move one window so we don't cause large amounts of unnecessary zooming
-                    // in some situations. We need to do this even when expanding later just in case
-                    // all windows are the same size.
-                    // (We are using an old bounding rect for this, hopefully it doesn't matter)
-                    int xSection = (target_w->x() - bounds.x()) / (bounds.width() / 3);
-                    int ySection = (target_w->y() - bounds.y()) / (bounds.height() / 3);
-                    diff = QPoint(0, 0);
-                    if (xSection != 1 || ySection != 1) { // Remove this if you want the center to pull as well
-                        if (xSection == 1) {
-                            xSection = (directions[cell] / 2 ? 2 : 0);
-                        }
-                        if (ySection == 1) {
-                            ySection = (directions[cell] % 2 ? 2 : 0);
-                        }
-                    }
-                    if (xSection == 0 && ySection == 0) {
-                        diff = QPoint(bounds.topLeft() - target_w->center());
-                    }
-                    if (xSection == 2 && ySection == 0) {
-                        diff = QPoint(bounds.topRight() - target_w->center());
+                // Try to keep screen aspect ratio
+                // if (bounds.height() / bounds.width() > area.height() / area.width())
+                //    diff.setY(diff.y() / 2);
+                // else
+                //    diff.setX(diff.x() / 2);
+                // Approximate a vector of between 10px and 20px in magnitude in the same direction
+                diff *= m_accuracy / qreal(diff.manhattanLength());
+                // Move both windows apart
+                target_w->translate(-diff);
+                target_e->translate(diff);
+
+                // Try to keep the bounding rect the same aspect as the screen so that more
+                // screen real estate is utilised. We do this by splitting the screen into nine
+                // equal sections, if the window center is in any of the corner sections pull the
+                // window towards the outer corner. If it is in any of the other edge sections
+                // alternate between each corner on that edge. We don't want to determine it
+                // randomly as it will not produce consistant locations when using the filter.
+                // Only move one window so we don't cause large amounts of unnecessary zooming
+                // in some situations. We need to do this even when expanding later just in case
+                // all windows are the same size.
+                // (We are using an old bounding rect for this, hopefully it doesn't matter)
+                int xSection = (target_w->x() - bounds.x()) / (bounds.width() / 3);
+                int ySection = (target_w->y() - bounds.y()) / (bounds.height() / 3);
+                diff = QPoint(0, 0);
+                if (xSection != 1 || ySection != 1) { // Remove this if you want the center to pull as well
+                    if (xSection == 1) {
+                        xSection = (directions[i] / 2 ? 2 : 0);
                     }
-                    if (xSection == 2 && ySection == 2) {
-                        diff = QPoint(bounds.bottomRight() - target_w->center());
+                    if (ySection == 1) {
+                        ySection = (directions[i] % 2 ? 2 : 0);
                     }
-                    if (xSection == 0 && ySection == 2) {
-                        diff = QPoint(bounds.bottomLeft() - target_w->center());
-                    }
-                    if (diff.x() != 0 || diff.y() != 0) {
-                        diff *= m_accuracy / qreal(diff.manhattanLength());
-                        target_w->translate(diff);
-                    }
-
-                    // Update bounding rect
-                    bounds = bounds.united(*target_w);
-                    bounds = bounds.united(*target_e);
                 }
+                if (xSection == 0 && ySection == 0) {
+                    diff = QPoint(bounds.topLeft() - target_w->center());
+                }
+                if (xSection == 2 && ySection == 0) {
+                    diff = QPoint(bounds.topRight() - target_w->center());
+                }
+                if (xSection == 2 && ySection == 2) {
+                    diff = QPoint(bounds.bottomRight() - target_w->center());
+                }
+                if (xSection == 0 && ySection == 2) {
+                    diff = QPoint(bounds.bottomLeft() - target_w->center());
+                }
+                if (diff.x() != 0 || diff.y() != 0) {
+                    diff *= m_accuracy / qreal(diff.manhattanLength());
+                    target_w->translate(diff);
+                }
+
+                // Update bounding rect
+                bounds = bounds.united(*target_w);
+                bounds = bounds.united(*target_e);
+
+                grid.update(i, *target_w);
+                grid.update(j, *target_e);
             }
         }
     } while (overlap);
@@ -605,13 +772,11 @@ void ExpoLayout::calculateWindowTransformationsNatural()
                    area.height() / scale);
 
     // Move all windows back onto the screen and set their scale
-    QHash<ExpoCell *, QRect>::iterator target = targets.begin();
-    while (target != targets.end()) {
-        target->setRect((target->x() - bounds.x()) * scale + area.x(),
-                        (target->y() - bounds.y()) * scale + area.y(),
-                        target->width() * scale,
-                        target->height() * scale);
-        ++target;
+    for (QRect &target : targets) {
+        target.setRect((target.x() - bounds.x()) * scale + area.x(),
+                       (target.y() - bounds.y()) * scale + area.y(),
+                       target.width() * scale,
+                       target.height() * scale);
     }
 
     // Try to fill the gaps by enlarging windows if they have the space
@@ -620,12 +785,14 @@ void ExpoLayout::calculateWindowTransformationsNatural()
         QRegion borderRegion(area.adjusted(-200, -200, 200, 200));
         borderRegion ^= area;
 
+        CellGrid grid(targets, halfSpacing);
         bool moved;
         do {
             moved = false;
-            for (ExpoCell *cell : qAsConst(m_cells)) {
+            for (int i = 0; i < m_cells.count(); ++i) {
+                const ExpoCell *cell = m_cells[i];
                 QRect oldRect;
-                QRect *target = &targets[cell];
+                QRect *target = &targets[i];
                 // This may cause some slight distortion if the windows are enlarged a large amount
                 int widthDiff = m_accuracy;
                 int heightDiff = heightForWidth(cell, target->width() + widthDiff) - target->height();
@@ -641,9 +808,10 @@ void ExpoLayout::calculateWindowTransformationsNatural()
                                 target->y() - yDiff - heightDiff,
                                 target->width() + widthDiff,
                                 target->height() + heightDiff);
-                if (isOverlappingAny(cell, targets, borderRegion, m_spacing)) {
+                if (isOverlappingAny(i, targets, grid, borderRegion)) {
                     *target = oldRect;
                 } else {
+                    grid.update(i, *target);
                     moved = true;
                     heightDiff = heightForWidth(cell, target->width() + widthDiff) - target->height();
                     yDiff = heightDiff / 2;
@@ -655,9 +823,10 @@ void ExpoLayout::calculateWindowTransformationsNatural()
                                 target->y() + yDiff,
                                 target->width() + widthDiff,
                                 target->height() + heightDiff);
-                if (isOverlappingAny(cell, targets, borderRegion, m_spacing)) {
+                if (isOverlappingAny(i, targets, grid, borderRegion)) {
                     *target = oldRect;
                 } else {
+                    grid.update(i, *target);
                     moved = true;
                     heightDiff = heightForWidth(cell, target->width() + widthDiff) - target->height();
                     yDiff = heightDiff / 2;
@@ -669,9 +838,10 @@ void ExpoLayout::calculateWindowTransformationsNatural()
                                 target->y() + yDiff,
                                 target->width() + widthDiff,
                                 target->height() + heightDiff);
-                if (isOverlappingAny(cell, targets, borderRegion, m_spacing)) {
+                if (isOverlappingAny(i, targets, grid, borderRegion)) {
                     *target = oldRect;
                 } else {
+                    grid.update(i, *target);
                     moved = true;
                     heightDiff = heightForWidth(cell, target->width() + widthDiff) - target->height();
                     yDiff = heightDiff / 2;
@@ -683,9 +853,10 @@ void ExpoLayout::calculateWindowTransformationsNatural()
                                 target->y() - yDiff - heightDiff,
                                 target->width() + widthDiff,
                                 target->height() + heightDiff);
-                if (isOverlappingAny(cell, targets, borderRegion, m_spacing)) {
+                if (isOverlappingAny(i, targets, grid, borderRegion)) {
                     *target = oldRect;
                 } else {
+                    grid.update(i, *target);
                     moved = true;
                 }
             }
@@ -694,8 +865,9 @@ void ExpoLayout::calculateWindowTransformationsNatural()
         // The expanding code above can actually enlarge windows over 1.0/2.0 scale, we don't like this
         // We can't add this to the loop above as it would cause a never-ending loop so we have to make
         // do with the less-than-optimal space usage with using this method.
-        for (ExpoCell *cell : qAsConst(m_cells)) {
-            QRect *target = &targets[cell];
+        for (int i = 0; i < m_cells.count(); ++i) {
+            const ExpoCell *cell = m_cells[i];
+            QRect *target = &targets[i];
             qreal scale = target->width() / qreal(cell->naturalWidth());
             if (scale > 2.0 || (scale > 1.0 && (cell->naturalWidth() > 300 || cell->naturalHeight() > 300))) {
                 scale = (cell->naturalWidth() > 300 || cell->naturalHeight() > 300) ? 1.0 : 2.0;
@@ -707,8 +879,9 @@ void ExpoLayout::calculateWindowTransformationsNatural()
         }
     }
 
-    for (ExpoCell *cell : qAsConst(m_cells)) {
-        const QRect rect = centered(cell, targets.value(cell).marginsRemoved(cell->margins()));
+    for (int i = 0; i < m_cells.count(); ++i) {
+        ExpoCell *cell = m_cells[i];
+        const QRect rect = centered(cell, targets[i].marginsRemoved(cell->margins()));
 
         cell->setX(rect.x());
         cell->setY(rect.y());
@@ -13,6 +13,7 @@
 #include "screenshotdbusinterface2.h"
 
 #include <kwinglplatform.h>
+#include <kwinglrendertargetpool.h>
 #include <kwinglutils.h>
 
 #include <QPainter>
@@ -234,14 +235,10 @@ void ScreenShotEffect::takeScreenShot(ScreenShotWindowData *screenshot)
         }
     }
     bool validTarget = true;
-    std::unique_ptr<GLTexture> offscreenTexture;
-    std::unique_ptr<GLFramebuffer> target;
+    GLRenderTarget target;
     if (effects->isOpenGLCompositing()) {
-        offscreenTexture.reset(new GLTexture(GL_RGBA8, QSizeF(geometry.size() * devicePixelRatio).toSize()));
-        offscreenTexture->setFilter(GL_LINEAR);
-        offscreenTexture->setWrapMode(GL_CLAMP_TO_EDGE);
-        target.reset(new GLFramebuffer(offscreenTexture.get()));
-        validTarget = target->valid();
+        target = GLRenderTargetPool::instance()->acquire(QSizeF(geometry.size() * devicePixelRatio).toSize());
+        validTarget = target.isValid();
     }
     if (validTarget) {
         d.setXTranslation(-geometry.x());
@@ -251,7 +248,7 @@ void ScreenShotEffect::takeScreenShot(ScreenShotWindowData *screenshot)
         int mask = PAINT_WINDOW_TRANSFORMED | PAINT_WINDOW_TRANSLUCENT;
         QImage img;
         if (effects->isOpenGLCompositing()) {
-            GLFramebuffer::pushFramebuffer(target.get());
+            GLFramebuffer::pushFramebuffer(target.framebuffer.get());
             glClearColor(0.0, 0.0, 0.0, 0.0);
             glClear(GL_COLOR_BUFFER_BIT);
             glClearColor(0.0, 0.0, 0.0, 1.0);
@@ -263,11 +260,12 @@ void ScreenShotEffect::takeScreenShot(ScreenShotWindowData *screenshot)
             effects->drawWindow(window, mask, infiniteRegion(), d);
 
             // copy content from framebuffer into image
-            img = QImage(offscreenTexture->size(), QImage::Format_ARGB32);
+            img = QImage(target.texture->size(), QImage::Format_ARGB32);
             img.setDevicePixelRatio(devicePixelRatio);
             glReadnPixels(0, 0, img.width(), img.height(), GL_RGBA, GL_UNSIGNED_BYTE, img.sizeInBytes(),
                           static_cast<GLvoid *>(img.bits()));
             GLFramebuffer::popFramebuffer();
+            GLRenderTargetPool::instance()->release(std::move(target));
             convertFromGLImage(img, img.width(), img.height());
         }
 
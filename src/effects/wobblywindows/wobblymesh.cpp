@@ -0,0 +1,267 @@
+/*
+    KWin - the KDE window manager
+    This file is part of the KDE project.
+
+    SPDX-FileCopyrightText: 2022 KWin contributors
+
+    SPDX-License-Identifier: GPL-2.0-or-later
+*/
+
+#include "wobblymesh.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace KWin
+{
+
+using Values = WobblyMesh::Values;
+
+static constexpr int Width = WobblyMesh::Width;
+static constexpr int Height = WobblyMesh::Height;
+static constexpr int Count = WobblyMesh::Count;
+
+// Whether every point has a neighbour at the specified offset, as 1 or 0, so the kernels can
+// multiply by it instead of branching.
+static constexpr Values neighbourMask(int dx, int dy)
+{
+    Values mask{};
+    for (int j = 0; j < Height; ++j) {
+        for (int i = 0; i < Width; ++i) {
+            const bool inside = i + dx >= 0 && i + dx < Width && j + dy >= 0 && j + dy < Height;
+            mask[j * Width + i] = inside ? 1.0f : 0.0f;
+        }
+    }
+    return mask;
+}
+
+static constexpr Values s_left = neighbourMask(-1, 0);
+static constexpr Values s_right = neighbourMask(1, 0);
+static constexpr Values s_up = neighbourMask(0, -1);
+static constexpr Values s_down = neighbourMask(0, 1);
+static constexpr Values s_upLeft = neighbourMask(-1, -1);
+static constexpr Values s_upRight = neighbourMask(1, -1);
+static constexpr Values s_downLeft = neighbourMask(-1, 1);
+static constexpr Values s_downRight = neighbourMask(1, 1);
+
+static constexpr Values neighbourCount(bool diagonal)
+{
+    Values count{};
+    for (int i = 0; i < Count; ++i) {
+        count[i] = s_left[i] + s_right[i] + s_up[i] + s_down[i];
+        if (diagonal) {
+            count[i] += s_upLeft[i] + s_upRight[i] + s_downLeft[i] + s_downRight[i];
+        }
+    }
+    return count;
+}
+
+static constexpr Values s_springCount = neighbourCount(false);
+static constexpr Values s_ringCount = neighbourCount(true);
+
+// sum[i] += mask[i] * data[i + Offset], the mask is 0 for the points with no such neighbour.
+template<int Offset>
+static inline void accumulate(Values &sum, const Values &data, const Values &mask)
+{
+    constexpr int begin = std::max(0, -Offset);
+    constexpr int end = std::min(Count, Count - Offset);
+    for (int i = begin; i < end; ++i) {
+        sum[i] += mask[i] * data[i + Offset];
+    }
+}
+
+// Replaces every value with the weighted mean of the value and its eight neighbours, the value
+// itself weighs as much as all the neighbours together.
+static inline void ringLinearMean(const Values &data, Values &result)
+{
+    result.fill(0.0f);
+    accumulate<-1>(result, data, s_left);
+    accumulate<1>(result, data, s_right);
+    accumulate<-Width>(result, data, s_up);
+    accumulate<Width>(result, data, s_down);
+    accumulate<-Width - 1>(result, data, s_upLeft);
+    accumulate<-Width + 1>(result, data, s_upRight);
+    accumulate<Width - 1>(result, data, s_downLeft);
+    accumulate<Width + 1>(result, data, s_downRight);
+    for (int i = 0; i < Count; ++i) {
+        result[i] = (result[i] + s_ringCount[i] * data[i]) / (2.0f * s_ringCount[i]);
+    }
+}
+
+// Values below the minimum are snapped to zero, values above the maximum are clamped.
+static inline float fixBounds(float value, float min, float max)
+{
+    return std::abs(value) < min ? 0.0f : std::clamp(value, -max, max);
+}
+
+QPointF WobblyMesh::Curve::pointAt(float u) const
+{
+    const float p[Width] = {
+        (1 - u) * (1 - u) * (1 - u),
+        3 * (1 - u) * (1 - u) * u,
+        3 * (1 - u) * u * u,
+        u * u * u,
+    };
+
+    float resultX = 0;
+    float resultY = 0;
+    for (int i = 0; i < Width; ++i) {
+        resultX += p[i] * x[i];
+        resultY += p[i] * y[i];
+    }
+    return QPointF(resultX, resultY);
+}
+
+void WobblyMesh::reset(const QRectF &geometry)
+{
+    updateOrigin(geometry);
+    m_positionX = m_originX;
+    m_positionY = m_originY;
+    m_velocityX.fill(0.0f);
+    m_velocityY.fill(0.0f);
+    m_constraint.fill(0.0f);
+    m_accelerationSum = 0;
+    m_velocitySum = 0;
+}
+
+void WobblyMesh::updateOrigin(const QRectF &geometry)
+{
+    const float xLength = geometry.width() / (Width - 1.0);
+    const float yLength = geometry.height() / (Height - 1.0);
+    for (int j = 0; j < Height; ++j) {
+        // The last row and column are snapped to the edges to avoid accumulating rounding errors.
+        const float y = j == Height - 1 ? geometry.y() + geometry.height() : geometry.y() + j * yLength;
+        for (int i = 0; i < Width; ++i) {
+            const float x = i == Width - 1 ? geometry.x() + geometry.width() : geometry.x() + i * xLength;
+            m_originX[j * Width + i] = x;
+            m_originY[j * Width + i] = y;
+        }
+    }
+}
+
+int WobblyMesh::pointAt(const QRectF &geometry, const QPointF &pos) const
+{
+    const qreal xIncrement = geometry.width() / (Width - 1.0);
+    const qreal yIncrement = geometry.height() / (Height - 1.0);
+    const int x = (pos.x() - geometry.x()) / xIncrement + 0.5;
+    const int y = (pos.y() - geometry.y()) / yIncrement + 0.5;
+    return std::clamp(y * Width + x, 0, Count - 1);
+}
+
+void WobblyMesh::setConstrained(int index, bool constrained)
+{
+    m_constraint[index] = constrained ? 1.0f : 0.0f;
+}
+
+void WobblyMesh::setVelocity(int index, const QPointF &velocity)
+{
+    m_velocityX[index] = velocity.x();
+    m_velocityY[index] = velocity.y();
+}
+
+void WobblyMesh::step(const QRectF &geometry, float time, const Parameters &parameters, Qt::Edges pinnedEdges)
+{
+    updateOrigin(geometry);
+
+    const float xLength = geometry.width() / (Width - 1.0);
+    const float yLength = geometry.height() / (Height - 1.0);
+    const float stiffness = parameters.stiffness;
+
+    // The springs pull every point towards its neighbours at their rest distance, while the
+    // constrained points are only pulled towards their place in the window.
+    m_scratchX.fill(0.0f);
+    m_scratchY.fill(0.0f);
+    accumulate<-1>(m_scratchX, m_positionX, s_left);
+    accumulate<1>(m_scratchX, m_positionX, s_right);
+    accumulate<-Width>(m_scratchX, m_positionX, s_up);
+    accumulate<Width>(m_scratchX, m_positionX, s_down);
+    accumulate<-1>(m_scratchY, m_positionY, s_left);
+    accumulate<1>(m_scratchY, m_positionY, s_right);
+    accumulate<-Width>(m_scratchY, m_positionY, s_up);
+    accumulate<Width>(m_scratchY, m_positionY, s_down);
+    for (int i = 0; i < Count; ++i) {
+        const float springX = (m_scratchX[i] - s_springCount[i] * m_positionX[i] + (s_left[i] - s_right[i]) * xLength) / s_springCount[i];
+        const float springY = (m_scratchY[i] - s_springCount[i] * m_positionY[i] + (s_up[i] - s_down[i]) * yLength) / s_springCount[i];
+        const float pullX = m_originX[i] - m_positionX[i];
+        const float pullY = m_originY[i] - m_positionY[i];
+        m_scratchX[i] = (m_constraint[i] != 0.0f ? pullX : springX) * stiffness;
+        m_scratchY[i] = (m_constraint[i] != 0.0f ? pullY : springY) * stiffness;
+    }
+    ringLinearMean(m_scratchX, m_accelerationX);
+    ringLinearMean(m_scratchY, m_accelerationY);
+
+    float accelerationSum = 0;
+    for (int i = 0; i < Count; ++i) {
+        const float accelerationX = fixBounds(m_accelerationX[i], parameters.minAcceleration, parameters.maxAcceleration);
+        const float accelerationY = fixBounds(m_accelerationY[i], parameters.minAcceleration, parameters.maxAcceleration);
+        m_scratchX[i] = accelerationX * time + m_velocityX[i] * parameters.drag;
+        m_scratchY[i] = accelerationY * time + m_velocityY[i] * parameters.drag;
+        accelerationSum += std::abs(accelerationX) + std::abs(accelerationY);
+    }
+    ringLinearMean(m_scratchX, m_velocityX);
+    ringLinearMean(m_scratchY, m_velocityY);
+
+    float velocitySum = 0;
+    const float distanceFactor = time * parameters.moveFactor;
+    for (int i = 0; i < Count; ++i) {
+        m_velocityX[i] = fixBounds(m_velocityX[i], parameters.minVelocity, parameters.maxVelocity);
+        m_velocityY[i] = fixBounds(m_velocityY[i], parameters.minVelocity, parameters.maxVelocity);
+        m_positionX[i] += m_velocityX[i] * distanceFactor;
+        m_positionY[i] += m_velocityY[i] * distanceFactor;
+        velocitySum += std::abs(m_velocityX[i]) + std::abs(m_velocityY[i]);
+    }
+
+    // All the rows but the opposite one follow the window if an edge can't wobble.
+    if (pinnedEdges & Qt::TopEdge) {
+        std::copy_n(m_originY.begin(), Count - Width, m_positionY.begin());
+    }
+    if (pinnedEdges & Qt::BottomEdge) {
+        std::copy_n(m_originY.begin() + Width, Count - Width, m_positionY.begin() + Width);
+    }
+    if (pinnedEdges & Qt::LeftEdge) {
+        for (int j = 0; j < Height; ++j) {
+            std::copy_n(m_originX.begin() + j * Width, Width - 1, m_positionX.begin() + j * Width);
+        }
+    }
+    if (pinnedEdges & Qt::RightEdge) {
+        for (int j = 0; j < Height; ++j) {
+            std::copy_n(m_originX.begin() + j * Width + 1, Width - 1, m_positionX.begin() + j * Width + 1);
+        }
+    }
+
+    m_accelerationSum = accelerationSum;
+    m_velocitySum = velocitySum;
+}
+
+float WobblyMesh::accelerationSum() const
+{
+    return m_accelerationSum;
+}
+
+float WobblyMesh::velocitySum() const
+{
+    return m_velocitySum;
+}
+
+WobblyMesh::Curve WobblyMesh::curveAt(float v) const
+{
+    const float p[Height] = {
+        (1 - v) * (1 - v) * (1 - v),
+        3 * (1 - v) * (1 - v) * v,
+        3 * (1 - v) * v * v,
+        v * v * v,
+    };
+
+    Curve curve;
+    curve.x.fill(0.0f);
+    curve.y.fill(0.0f);
+    for (int j = 0; j < Height; ++j) {
+        for (int i = 0; i < Width; ++i) {
+            curve.x[i] += p[j] * m_positionX[j * Width + i];
+            curve.y[i] += p[j] * m_positionY[j * Width + i];
+        }
+    }
+    return curve;
+}
+
+} // namespace KWin
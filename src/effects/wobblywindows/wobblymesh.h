@@ -0,0 +1,120 @@
+/*
+    KWin - the KDE window manager
+    This file is part of the KDE project.
+
+    SPDX-FileCopyrightText: 2022 KWin contributors
+
+    SPDX-License-Identifier: GPL-2.0-or-later
+*/
+
+#pragma once
+
+#include <QPointF>
+#include <QRectF>
+
+#include <array>
+
+namespace KWin
+{
+
+/**
+ * The WobblyMesh class simulates the spring mesh of a wobbly window.
+ *
+ * The mesh points are the control points of the bicubic bezier surface the window is mapped
+ * onto. Every component of the mesh state is stored in its own contiguous float array, and
+ * the integration is a sequence of straight loops over these arrays with no branches on the
+ * kind of point, so the compiler can vectorise them.
+ */
+class WobblyMesh
+{
+public:
+    static constexpr int Width = 4;
+    static constexpr int Height = 4;
+    static constexpr int Count = Width * Height;
+
+    using Values = std::array<float, Count>;
+
+    struct Parameters
+    {
+        float stiffness = 0;
+        float drag = 0;
+        float moveFactor = 0;
+        float minVelocity = 0;
+        float maxVelocity = 0;
+        float minAcceleration = 0;
+        float maxAcceleration = 0;
+    };
+
+    /**
+     * The Curve struct is a row of the bezier surface, i.e. a cubic bezier curve. Evaluating
+     * the surface row by row is four times cheaper than evaluating every point on its own.
+     */
+    struct Curve
+    {
+        QPointF pointAt(float u) const;
+
+        std::array<float, Width> x;
+        std::array<float, Width> y;
+    };
+
+    /**
+     * Puts the mesh at rest in the specified @a geometry. All constraints are removed.
+     */
+    void reset(const QRectF &geometry);
+
+    /**
+     * Returns the index of the mesh point that is the closest to @a pos.
+     */
+    int pointAt(const QRectF &geometry, const QPointF &pos) const;
+
+    /**
+     * Sets whether the point with the specified @a index only follows the window geometry,
+     * ignoring its neighbours.
+     */
+    void setConstrained(int index, bool constrained);
+    void setVelocity(int index, const QPointF &velocity);
+
+    /**
+     * Advances the simulation by @a time milliseconds, the mesh is pulled towards the
+     * window @a geometry. The points along the @a pinnedEdges don't move in the direction
+     * perpendicular to the edge.
+     */
+    void step(const QRectF &geometry, float time, const Parameters &parameters, Qt::Edges pinnedEdges = Qt::Edges());
+
+    /**
+     * Returns the sum of the absolute accelerations in the last step.
+     */
+    float accelerationSum() const;
+
+    /**
+     * Returns the sum of the absolute velocities after the last step.
+     */
+    float velocitySum() const;
+
+    /**
+     * Returns the row of the bezier surface at the normalized vertical coordinate @a v.
+     */
+    Curve curveAt(float v) const;
+
+private:
+    void updateOrigin(const QRectF &geometry);
+
+    alignas(32) Values m_originX;
+    alignas(32) Values m_originY;
+    alignas(32) Values m_positionX;
+    alignas(32) Values m_positionY;
+    alignas(32) Values m_velocityX;
+    alignas(32) Values m_velocityY;
+    alignas(32) Values m_constraint;
+
+    // Scratch space for the integration, kept here to avoid reallocating it for every step.
+    alignas(32) Values m_scratchX;
+    alignas(32) Values m_scratchY;
+    alignas(32) Values m_accelerationX;
+    alignas(32) Values m_accelerationY;
+
+    float m_accelerationSum = 0;
+    float m_velocitySum = 0;
+};
+
+} // namespace KWin
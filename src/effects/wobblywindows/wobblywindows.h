@@ -13,6 +13,8 @@
 // Include with base class for effects.
 #include <kwinoffscreeneffect.h>
 
+#include "wobblymesh.h"
+
 namespace KWin
 {
 
@@ -61,12 +63,6 @@ public:
     void setVelocityThreshold(qreal velocityThreshold);
     void setMoveFactor(qreal factor);
 
-    struct Pair
-    {
-        qreal x;
-        qreal y;
-    };
-
     enum WindowStatus {
         Free,
         Moving,
@@ -101,28 +97,10 @@ public Q_SLOTS:
 private:
     void startMovedResized(EffectWindow *w);
     void stepMovedResized(EffectWindow *w);
-    bool updateWindowWobblyDatas(EffectWindow *w, qreal time);
 
     struct WindowWobblyInfos
     {
-        QVector<Pair> origin;
-        QVector<Pair> position;
-        QVector<Pair> velocity;
-        QVector<Pair> acceleration;
-        QVector<Pair> buffer;
-
-        // if true, the physics system moves this point based only on it "normal" destination
-        // given by the window position, ignoring neighbour points.
-        QVector<bool> constraint;
-
-        unsigned int width;
-        unsigned int height;
-        unsigned int count;
-
-        QVector<Pair> bezierSurface;
-        unsigned int bezierWidth;
-        unsigned int bezierHeight;
-        unsigned int bezierCount;
+        WobblyMesh mesh;
 
         WindowStatus status;
 
@@ -133,6 +111,8 @@ private:
         std::chrono::milliseconds clock;
     };
 
+    bool updateWindowWobblyDatas(EffectWindow *w, WindowWobblyInfos &wwi, qreal time);
+
     QHash<const EffectWindow *, WindowWobblyInfos> windows;
 
     QRegion m_updateRegion;
@@ -159,10 +139,6 @@ private:
 
     void initWobblyInfo(WindowWobblyInfos &wwi, QRectF geometry) const;
 
-    WobblyWindowsEffect::Pair computeBezierPoint(const WindowWobblyInfos &wwi, Pair point) const;
-
-    static void heightRingLinearMean(QVector<Pair> &data, WindowWobblyInfos &wwi);
-
     void setParameterSet(const ParameterSet &pset);
 };
 
@@ -0,0 +1,103 @@
+/*
+    KWin - the KDE window manager
+    This file is part of the KDE project.
+
+    SPDX-FileCopyrightText: 2022 KWin contributors
+
+    SPDX-License-Identifier: GPL-2.0-or-later
+*/
+
+#include "framecallbackthrottler.h"
+#include "output.h"
+#include "renderloop.h"
+#include "wayland/surface_interface.h"
+#include "window.h"
+#include "workspace.h"
+
+namespace KWin
+{
+
+FrameCallbackThrottler::FrameCallbackThrottler(QObject *parent)
+    : QObject(parent)
+{
+    m_hiddenTimer.setTimerType(Qt::CoarseTimer);
+    connect(&m_hiddenTimer, &QTimer::timeout, this, &FrameCallbackThrottler::sendHiddenFrames);
+}
+
+uint FrameCallbackThrottler::hiddenRate() const
+{
+    return m_hiddenRate;
+}
+
+void FrameCallbackThrottler::setHiddenRate(uint rate)
+{
+    m_hiddenRate = rate;
+    if (rate == 0) {
+        m_hiddenTimer.stop();
+    } else {
+        m_hiddenTimer.start(std::max(1000u / rate, 1u));
+    }
+}
+
+void FrameCallbackThrottler::frameRendered(Window *window, Output *output, std::chrono::milliseconds timestamp)
+{
+    if (output != window->output()) {
+        const auto it = m_lastFrames.constFind(window);
+        if (it != m_lastFrames.constEnd()) {
+            // The output the window is on presents its frames; don't fire the callbacks twice
+            // per refresh cycle just because the window spills onto another output.
+            const int refreshRate = output->renderLoop()->refreshRate();
+            const std::chrono::milliseconds refreshInterval(refreshRate > 0 ? 1000000 / refreshRate : 0);
+            if (timestamp - *it < refreshInterval) {
+                return;
+            }
+        }
+    }
+    sendFrame(window, timestamp);
+}
+
+void FrameCallbackThrottler::sendHiddenFrames()
+{
+    if (!workspace()) {
+        return;
+    }
+
+    const std::chrono::milliseconds now =
+        std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now().time_since_epoch());
+    // Allow for some timer slack, otherwise a window would skip every other tick.
+    const std::chrono::milliseconds threshold(m_hiddenTimer.interval() / 2);
+
+    const QList<Window *> windows = workspace()->stackingOrder();
+    for (Window *window : windows) {
+        if (window->isDeleted() || !window->surface()) {
+            continue;
+        }
+        const auto it = m_lastFrames.constFind(window);
+        if (it != m_lastFrames.constEnd() && now - *it < threshold) {
+            continue;
+        }
+        sendFrame(window, now);
+    }
+}
+
+void FrameCallbackThrottler::sendFrame(Window *window, std::chrono::milliseconds timestamp)
+{
+    KWaylandServer::SurfaceInterface *surface = window->surface();
+    if (!surface) {
+        return;
+    }
+
+    auto it = m_lastFrames.find(window);
+    if (it == m_lastFrames.end()) {
+        it = m_lastFrames.insert(window, timestamp);
+        connect(window, &QObject::destroyed, this, [this, window]() {
+            m_lastFrames.remove(window);
+        });
+    } else {
+        *it = timestamp;
+    }
+
+    surface->frameRendered(timestamp.count());
+}
+
+} // namespace KWin
@@ -0,0 +1,67 @@
+/*
+    KWin - the KDE window manager
+    This file is part of the KDE project.
+
+    SPDX-FileCopyrightText: 2022 KWin contributors
+
+    SPDX-License-Identifier: GPL-2.0-or-later
+*/
+
+#pragma once
+
+#include "kwin_export.h"
+
+#include <QHash>
+#include <QObject>
+#include <QTimer>
+
+#include <chrono>
+
+namespace KWin
+{
+
+class Output;
+class Window;
+
+/**
+ * The FrameCallbackThrottler class decides when the frame callbacks of a window are fired.
+ *
+ * A window that is visible on an output gets its frame callbacks when that output presents
+ * a frame. If the window spans several outputs, it is paced by the output it is on, the other
+ * outputs only step in if they present a frame while that one is idle.
+ *
+ * A window that is not visible, because it is minimized, on another virtual desktop, outside
+ * of all outputs or covered by opaque windows, doesn't get painted and gets its frame callbacks
+ * at the low hidden rate instead, so it can still make progress without rendering frames that
+ * nobody will see.
+ */
+class KWIN_EXPORT FrameCallbackThrottler : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit FrameCallbackThrottler(QObject *parent = nullptr);
+
+    /**
+     * Returns the rate, in Hz, at which hidden windows get their frame callbacks. If the rate
+     * is 0, hidden windows don't get frame callbacks at all.
+     */
+    uint hiddenRate() const;
+    void setHiddenRate(uint rate);
+
+    /**
+     * Notifies the throttler that the @a output has presented a frame at @a timestamp, with
+     * the @a window being visible on it.
+     */
+    void frameRendered(Window *window, Output *output, std::chrono::milliseconds timestamp);
+
+private:
+    void sendHiddenFrames();
+    void sendFrame(Window *window, std::chrono::milliseconds timestamp);
+
+    QTimer m_hiddenTimer;
+    uint m_hiddenRate = 0;
+    QHash<Window *, std::chrono::milliseconds> m_lastFrames;
+};
+
+} // namespace KWin
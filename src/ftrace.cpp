@@ -10,6 +10,7 @@
 
 #include "ftrace.h"
 
+#include <QCoreApplication>
 #include <QDBusConnection>
 #include <QDebug>
 #include <QDir>
@@ -18,10 +19,102 @@
 #include <QScopeGuard>
 #include <QTextStream>
 
+#include <array>
+#include <chrono>
+#include <fcntl.h>
+#include <unistd.h>
+#include <vector>
+
 namespace KWin
 {
 KWIN_SINGLETON_FACTORY(KWin::FTraceLogger)
 
+/**
+ * The FTraceBuffer class is a single producer single consumer ring buffer of binary trace
+ * events. Every thread records events in its own buffer, which is drained by the writer
+ * thread. If the buffer is full, new events are dropped rather than blocking the producer.
+ */
+class FTraceBuffer
+{
+public:
+    static constexpr quint32 capacity = 4096;
+
+    FTraceBuffer()
+        : threadId(quint64(quintptr(QThread::currentThreadId())))
+    {
+    }
+
+    void push(const FTraceEvent &event)
+    {
+        const quint32 head = m_head.load(std::memory_order_relaxed);
+        const quint32 tail = m_tail.load(std::memory_order_acquire);
+        if (head - tail == capacity) {
+            m_dropped.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+        m_events[head % capacity] = event;
+        m_head.store(head + 1, std::memory_order_release);
+    }
+
+    template<typename Func>
+    void drain(Func func)
+    {
+        const quint32 tail = m_tail.load(std::memory_order_relaxed);
+        const quint32 head = m_head.load(std::memory_order_acquire);
+        for (quint32 i = tail; i != head; ++i) {
+            func(m_events[i % capacity]);
+        }
+        m_tail.store(head, std::memory_order_release);
+    }
+
+    quint64 takeDropped()
+    {
+        return m_dropped.exchange(0, std::memory_order_relaxed);
+    }
+
+    const quint64 threadId;
+
+private:
+    std::array<FTraceEvent, capacity> m_events;
+    std::atomic<quint32> m_head = 0;
+    std::atomic<quint32> m_tail = 0;
+    std::atomic<quint64> m_dropped = 0;
+};
+
+// The buffers outlive the logger, so the thread local pointers never dangle.
+static QMutex s_buffersMutex;
+static std::vector<std::unique_ptr<FTraceBuffer>> s_buffers;
+
+static FTraceBuffer *threadBuffer()
+{
+    static thread_local FTraceBuffer *buffer = nullptr;
+    if (!buffer) {
+        QMutexLocker locker(&s_buffersMutex);
+        s_buffers.push_back(std::make_unique<FTraceBuffer>());
+        buffer = s_buffers.back().get();
+    }
+    return buffer;
+}
+
+static qint64 traceTimestamp()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static void writeJsonString(FILE *file, const char *string)
+{
+    fputc('"', file);
+    for (const char *c = string; *c; ++c) {
+        if (*c == '"' || *c == '\\') {
+            fputc('\\', file);
+        }
+        if (uchar(*c) >= 0x20) {
+            fputc(*c, file);
+        }
+    }
+    fputc('"', file);
+}
+
 FTraceLogger::FTraceLogger(QObject *parent)
     : QObject(parent)
 {
@@ -32,22 +125,26 @@ FTraceLogger::FTraceLogger(QObject *parent)
     }
 }
 
-bool FTraceLogger::isEnabled() const
+FTraceLogger::~FTraceLogger()
 {
-    return m_file.isOpen();
+    close();
+    if (m_markerFd != -1) {
+        ::close(m_markerFd);
+    }
 }
 
 void FTraceLogger::setEnabled(bool enabled)
 {
-    QMutexLocker lock(&m_mutex);
     if (enabled == isEnabled()) {
         return;
     }
 
     if (enabled) {
-        open();
+        if (!open()) {
+            return;
+        }
     } else {
-        m_file.close();
+        close();
     }
     Q_EMIT enabledChanged();
 }
@@ -59,13 +156,180 @@ bool FTraceLogger::open()
         return false;
     }
 
-    m_file.setFileName(path);
-    if (!m_file.open(QIODevice::WriteOnly)) {
-        qWarning() << "No access to trace marker file at:" << path;
+    if (path.endsWith(QLatin1String(".json"))) {
+        m_jsonFile = fopen(QFile::encodeName(path).constData(), "w");
+        if (!m_jsonFile) {
+            qWarning() << "Could not open trace file at:" << path;
+            return false;
+        }
+        fputs("{\"traceEvents\":[\n", m_jsonFile);
+        m_jsonFirstEvent = true;
+
+        // Discard the events that have been recorded during the previous session.
+        {
+            QMutexLocker locker(&s_buffersMutex);
+            for (const auto &buffer : s_buffers) {
+                buffer->drain([](const FTraceEvent &) {});
+                buffer->takeDropped();
+            }
+        }
+
+        m_sink = Sink::Json;
+        m_writerRunning = true;
+        m_writer.reset(QThread::create([this]() {
+            writerLoop();
+        }));
+        m_writer->setObjectName(QStringLiteral("KWinTraceWriter"));
+        m_writer->start(QThread::LowPriority);
+    } else {
+        // The marker file is kept open until the logger is destroyed because other threads
+        // may still be writing to it after tracing has been disabled.
+        if (m_markerFd == -1) {
+            m_markerFd = ::open(QFile::encodeName(path).constData(), O_WRONLY | O_CLOEXEC);
+        }
+        if (m_markerFd == -1) {
+            qWarning() << "No access to trace marker file at:" << path;
+            return false;
+        }
+        m_sink = Sink::Marker;
     }
+
+    m_enabled.store(true, std::memory_order_release);
     return true;
 }
 
+void FTraceLogger::close()
+{
+    m_enabled.store(false, std::memory_order_release);
+
+    if (m_writer) {
+        {
+            QMutexLocker locker(&m_writerMutex);
+            m_writerRunning = false;
+            m_writerCondition.wakeOne();
+        }
+        m_writer->wait();
+        m_writer.reset();
+    }
+
+    if (m_jsonFile) {
+        drain();
+        fputs("\n]}\n", m_jsonFile);
+        fclose(m_jsonFile);
+        m_jsonFile = nullptr;
+    }
+}
+
+void FTraceLogger::writeMarker(const char *data, int size)
+{
+    // A single write to the marker file is atomic, so no locking is needed.
+    if (::write(m_markerFd, data, size) == -1) {
+        return;
+    }
+}
+
+void FTraceLogger::record(FTraceEvent::Type type, const char *name, quint64 argument, quint32 context)
+{
+    if (m_sink.load(std::memory_order_relaxed) == Sink::Json) {
+        threadBuffer()->push(FTraceEvent{name, traceTimestamp(), argument, context, type});
+        return;
+    }
+
+    if (m_markerFd == -1) {
+        return;
+    }
+
+    // The kernel timestamps the marker when it's written, so there's no point in deferring it.
+    char buffer[256];
+    int size = 0;
+    switch (type) {
+    case FTraceEvent::Begin:
+        if (argument) {
+            size = snprintf(buffer, sizeof(buffer), "%s %llu begin_ctx=%u\n", name, qulonglong(argument), context);
+        } else {
+            size = snprintf(buffer, sizeof(buffer), "%s begin_ctx=%u\n", name, context);
+        }
+        break;
+    case FTraceEvent::End:
+        size = snprintf(buffer, sizeof(buffer), "%s end_ctx=%u\n", name, context);
+        break;
+    case FTraceEvent::Instant:
+        if (argument) {
+            size = snprintf(buffer, sizeof(buffer), "%s %llu\n", name, qulonglong(argument));
+        } else {
+            size = snprintf(buffer, sizeof(buffer), "%s\n", name);
+        }
+        break;
+    }
+    if (size > 0) {
+        writeMarker(buffer, std::min<int>(size, sizeof(buffer) - 1));
+    }
+}
+
+const char *FTraceLogger::intern(const QByteArray &string)
+{
+    QMutexLocker locker(&m_mutex);
+    return m_strings.insert(string)->constData();
+}
+
+quint32 FTraceLogger::nextContext()
+{
+    static QAtomicInteger<quint32> s_context = 0;
+    return ++s_context;
+}
+
+void FTraceLogger::writerLoop()
+{
+    QMutexLocker locker(&m_writerMutex);
+    while (m_writerRunning) {
+        m_writerCondition.wait(&m_writerMutex, 100);
+        drain();
+    }
+}
+
+void FTraceLogger::drain()
+{
+    const qint64 pid = QCoreApplication::applicationPid();
+
+    const auto beginEvent = [this]() {
+        fputs(m_jsonFirstEvent ? "" : ",\n", m_jsonFile);
+        m_jsonFirstEvent = false;
+    };
+
+    QMutexLocker locker(&s_buffersMutex);
+    for (const auto &buffer : s_buffers) {
+        buffer->drain([this, pid, &buffer, &beginEvent](const FTraceEvent &event) {
+            beginEvent();
+            fputs("{\"name\":", m_jsonFile);
+            writeJsonString(m_jsonFile, event.name);
+            switch (event.type) {
+            case FTraceEvent::Begin:
+                fputs(",\"ph\":\"B\"", m_jsonFile);
+                break;
+            case FTraceEvent::End:
+                fputs(",\"ph\":\"E\"", m_jsonFile);
+                break;
+            case FTraceEvent::Instant:
+                fputs(",\"ph\":\"i\",\"s\":\"t\"", m_jsonFile);
+                break;
+            }
+            fprintf(m_jsonFile, ",\"ts\":%lld.%03lld,\"pid\":%lld,\"tid\":%llu",
+                    event.timestamp / 1000, event.timestamp % 1000, pid, qulonglong(buffer->threadId));
+            if (event.argument) {
+                fprintf(m_jsonFile, ",\"args\":{\"value\":%llu}", qulonglong(event.argument));
+            }
+            fputc('}', m_jsonFile);
+        });
+
+        if (const quint64 dropped = buffer->takeDropped()) {
+            beginEvent();
+            fprintf(m_jsonFile, "{\"name\":\"Dropped events\",\"ph\":\"i\",\"s\":\"t\",\"ts\":%lld,\"pid\":%lld,\"tid\":%llu,\"args\":{\"value\":%llu}}",
+                    traceTimestamp() / 1000, pid, qulonglong(buffer->threadId), qulonglong(dropped));
+        }
+    }
+    fflush(m_jsonFile);
+}
+
 QString FTraceLogger::filePath()
 {
     if (qEnvironmentVariableIsSet("KWIN_PERF_FTRACE_FILE")) {
@@ -115,7 +379,9 @@ QString FTraceLogger::filePath()
 
 FTraceDuration::~FTraceDuration()
 {
-    FTraceLogger::self()->trace(m_message, " end_ctx=", m_context);
+    if (FTraceLogger::self()->isEnabled()) {
+        FTraceLogger::self()->trace(m_message, " end_ctx=", m_context);
+    }
 }
 
 }
@@ -11,14 +11,41 @@
 
 #include <kwinglobals.h>
 
-#include <QFile>
 #include <QMutex>
-#include <QMutexLocker>
 #include <QObject>
+#include <QSet>
 #include <QTextStream>
+#include <QThread>
+#include <QWaitCondition>
+
+#include <atomic>
+#include <memory>
+#include <optional>
 
 namespace KWin
 {
+
+/**
+ * The FTraceEvent struct describes a compact binary trace event.
+ *
+ * The name of an event is not copied, it must be either a string literal or a string
+ * returned by FTraceLogger::intern().
+ */
+struct FTraceEvent
+{
+    enum Type : quint8 {
+        Begin,
+        End,
+        Instant,
+    };
+
+    const char *name;
+    qint64 timestamp;
+    quint64 argument;
+    quint32 context;
+    Type type;
+};
+
 /**
  * FTraceLogger is a singleton utility for writing log messages using ftrace
  *
@@ -26,6 +53,14 @@ namespace KWin
  *  Set the KWIN_PERF_FTRACE environment variable before starting the application
  *  Calling on DBus /FTrace org.kde.kwin.FTrace.setEnabled true
  * After having created the ftrace mount
+ *
+ * If the KWIN_PERF_FTRACE_FILE environment variable points to a file with the .json suffix,
+ * binary events are written to that file in the Chrome trace event format instead, which
+ * can be loaded in Perfetto or chrome://tracing.
+ *
+ * Binary events (fTraceScope() and fTraceInstant()) are recorded in per thread lock-free
+ * ring buffers and drained by a background writer thread when writing a json trace. Text
+ * messages (fTrace() and fTraceDuration()) are only supported by the ftrace marker sink.
  */
 class KWIN_EXPORT FTraceLogger : public QObject
 {
@@ -34,10 +69,15 @@ class KWIN_EXPORT FTraceLogger : public QObject
     Q_PROPERTY(bool isEnabled READ isEnabled NOTIFY enabledChanged)
 
 public:
+    ~FTraceLogger() override;
+
     /**
      * Enabled through DBus and logging has started
      */
-    bool isEnabled() const;
+    bool isEnabled() const
+    {
+        return m_enabled.load(std::memory_order_relaxed);
+    }
 
     /**
      * Main log function
@@ -47,14 +87,33 @@ public:
     void trace(Args... args)
     {
         Q_ASSERT(isEnabled());
-        QMutexLocker lock(&m_mutex);
-        if (!m_file.isOpen()) {
+        if (m_sink.load(std::memory_order_relaxed) != Sink::Marker || m_markerFd == -1) {
             return;
         }
-        QTextStream stream(&m_file);
-        (stream << ... << args) << Qt::endl;
+        QByteArray message;
+        QTextStream stream(&message);
+        (stream << ... << args) << '\n';
+        stream.flush();
+        writeMarker(message.constData(), message.size());
     }
 
+    /**
+     * Records a binary event. This function doesn't lock or allocate memory after the first
+     * event has been recorded on the calling thread.
+     */
+    void record(FTraceEvent::Type type, const char *name, quint64 argument = 0, quint32 context = 0);
+
+    /**
+     * Returns a persistent copy of the specified @a string that can be used as the name
+     * of a binary event.
+     */
+    const char *intern(const QByteArray &string);
+
+    /**
+     * Returns a unique id that can be used to match the begin and the end events.
+     */
+    static quint32 nextContext();
+
 Q_SIGNALS:
     void enabledChanged();
 
@@ -62,10 +121,32 @@ public Q_SLOTS:
     Q_SCRIPTABLE void setEnabled(bool enabled);
 
 private:
+    enum class Sink {
+        Marker,
+        Json,
+    };
+
     static QString filePath();
     bool open();
-    QFile m_file;
+    void close();
+    void writeMarker(const char *data, int size);
+    void drain();
+    void writerLoop();
+
+    std::atomic<bool> m_enabled = false;
+    std::atomic<Sink> m_sink = Sink::Marker;
+    int m_markerFd = -1;
+
     QMutex m_mutex;
+    QSet<QByteArray> m_strings;
+
+    std::unique_ptr<QThread> m_writer;
+    QMutex m_writerMutex;
+    QWaitCondition m_writerCondition;
+    bool m_writerRunning = false;
+    FILE *m_jsonFile = nullptr;
+    bool m_jsonFirstEvent = true;
+
     KWIN_SINGLETON(FTraceLogger)
 };
 
@@ -75,11 +156,10 @@ public:
     template<typename... Args>
     FTraceDuration(Args... args)
     {
-        static QAtomicInteger<quint32> s_context = 0;
         QTextStream stream(&m_message);
         (stream << ... << args);
         stream.flush();
-        m_context = ++s_context;
+        m_context = FTraceLogger::nextContext();
         FTraceLogger::self()->trace(m_message, " begin_ctx=", m_context);
     }
 
@@ -90,13 +170,40 @@ private:
     quint32 m_context;
 };
 
+/**
+ * The FTraceScope class records a pair of binary begin and end events. Unlike FTraceDuration,
+ * it doesn't format any message, so it's cheap enough to be used in hot paths.
+ */
+class KWIN_EXPORT FTraceScope
+{
+public:
+    explicit FTraceScope(const char *name, quint64 argument = 0)
+        : m_name(name)
+        , m_context(FTraceLogger::nextContext())
+    {
+        FTraceLogger::self()->record(FTraceEvent::Begin, m_name, argument, m_context);
+    }
+
+    ~FTraceScope()
+    {
+        FTraceLogger::self()->record(FTraceEvent::End, m_name, 0, m_context);
+    }
+
+private:
+    const char *m_name;
+    quint32 m_context;
+};
+
 } // namespace KWin
 
+#define fTraceEnabled() \
+    (KWin::FTraceLogger::self() && KWin::FTraceLogger::self()->isEnabled())
+
 /**
  * Optimised macro, arguments are only copied if tracing is enabled
  */
-#define fTrace(...)                              \
-    if (KWin::FTraceLogger::self()->isEnabled()) \
+#define fTrace(...)      \
+    if (fTraceEnabled()) \
         KWin::FTraceLogger::self()->trace(__VA_ARGS__);
 
 /**
@@ -104,4 +211,21 @@ private:
  * In GPUVis this will appear as a timed block with begin_ctx and end_ctx markers
  */
 #define fTraceDuration(...) \
-    std::unique_ptr<KWin::FTraceDuration> _duration(KWin::FTraceLogger::self()->isEnabled() ? new KWin::FTraceDuration(__VA_ARGS__) : nullptr);
+    std::unique_ptr<KWin::FTraceDuration> _duration(fTraceEnabled() ? new KWin::FTraceDuration(__VA_ARGS__) : nullptr);
+
+/**
+ * Records binary begin and end events around the relevant block. The name must be a string
+ * literal or an interned string, the optional argument is an integer attached to the begin event.
+ */
+#define fTraceScope(...)                      \
+    std::optional<KWin::FTraceScope> _traceScope; \
+    if (fTraceEnabled()) {                        \
+        _traceScope.emplace(__VA_ARGS__);         \
+    }
+
+/**
+ * Records a binary instant event.
+ */
+#define fTraceInstant(...) \
+    if (fTraceEnabled())   \
+        KWin::FTraceLogger::self()->record(KWin::FTraceEvent::Instant, __VA_ARGS__);
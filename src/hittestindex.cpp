@@ -0,0 +1,162 @@
+/*
+    KWin - the KDE window manager
+    This file is part of the KDE project.
+
+    SPDX-FileCopyrightText: 2022 KWin contributors
+
+    SPDX-License-Identifier: GPL-2.0-or-later
+*/
+
+#include "hittestindex.h"
+#include "composite.h"
+#include "internalwindow.h"
+#include "unmanaged.h"
+#include "wayland/surface_interface.h"
+#include "window.h"
+#include "workspace.h"
+
+namespace KWin
+{
+
+HitTestIndex::HitTestIndex(Workspace *workspace)
+    : QObject(workspace)
+    , m_workspace(workspace)
+{
+    connect(workspace, &Workspace::stackingOrderChanged, this, &HitTestIndex::invalidateOrder);
+    connect(workspace, &Workspace::windowAdded, this, &HitTestIndex::watch);
+    connect(workspace, &Workspace::unmanagedAdded, this, &HitTestIndex::watch);
+    connect(workspace, &Workspace::internalWindowAdded, this, &HitTestIndex::watch);
+    connect(workspace, &Workspace::windowRemoved, this, &HitTestIndex::invalidateOrder);
+    connect(workspace, &Workspace::unmanagedRemoved, this, &HitTestIndex::invalidateOrder);
+    connect(workspace, &Workspace::internalWindowRemoved, this, &HitTestIndex::invalidateOrder);
+
+    // The window items, and thus the visible geometry, come and go with the compositing.
+    if (Compositor *compositor = Compositor::self()) {
+        connect(compositor, &Compositor::compositingToggled, this, &HitTestIndex::invalidateOrder);
+    }
+
+    const QList<Window *> windows = workspace->stackingOrder();
+    for (Window *window : windows) {
+        if (!window->isDeleted()) {
+            watch(window);
+        }
+    }
+    const QList<Unmanaged *> unmanaged = workspace->unmanagedList();
+    for (Unmanaged *window : unmanaged) {
+        if (!windows.contains(window)) {
+            watch(window);
+        }
+    }
+}
+
+void HitTestIndex::watch(Window *window)
+{
+    auto invalidate = [this, window]() {
+        invalidateBounds(window);
+    };
+    connect(window, &Window::frameGeometryChanged, this, invalidate);
+    connect(window, &Window::bufferGeometryChanged, this, invalidate);
+    connect(window, &Window::visibleGeometryChanged, this, invalidate);
+    connect(window, &Window::decorationChanged, this, invalidate);
+    connect(window, &Window::surfaceChanged, this, invalidate);
+    // Subsurfaces can grow without changing the geometry of the window.
+    connect(window, &Window::damaged, this, invalidate);
+
+    connect(window, &Window::windowClosed, this, &HitTestIndex::invalidateOrder);
+    connect(window, &QObject::destroyed, this, [this, window]() {
+        m_dirtyWindows.remove(window);
+        invalidateOrder();
+    });
+
+    invalidateOrder();
+}
+
+void HitTestIndex::invalidateOrder()
+{
+    m_orderDirty = true;
+}
+
+void HitTestIndex::invalidateBounds(Window *window)
+{
+    if (!m_orderDirty) {
+        m_dirtyWindows.insert(window);
+    }
+}
+
+QRectF HitTestIndex::inputBounds(const Window *window)
+{
+    QRectF bounds = window->inputGeometry() | window->frameGeometry();
+    if (const KWaylandServer::SurfaceInterface *surface = window->surface()) {
+        bounds |= surface->boundingRect().translated(window->bufferGeometry().topLeft());
+    }
+    return bounds | window->visibleGeometry();
+}
+
+void HitTestIndex::update()
+{
+    if (m_orderDirty) {
+        m_managed.clear();
+        m_unmanaged.clear();
+
+        const QList<Window *> &stacking = m_workspace->stackingOrder();
+        m_managed.reserve(stacking.count());
+        for (auto it = stacking.crbegin(); it != stacking.crend(); ++it) {
+            Window *window = *it;
+            // a deleted window doesn't get mouse events
+            if (!window->isDeleted()) {
+                m_managed.append(Entry{window, inputBounds(window)});
+            }
+        }
+
+        const QList<Unmanaged *> &unmanaged = m_workspace->unmanagedList();
+        m_unmanaged.reserve(unmanaged.count());
+        for (Unmanaged *window : unmanaged) {
+            m_unmanaged.append(Entry{window, inputBounds(window)});
+        }
+
+        m_dirtyWindows.clear();
+        m_orderDirty = false;
+        return;
+    }
+
+    if (!m_dirtyWindows.isEmpty()) {
+        for (QVector<Entry> *entries : {&m_managed, &m_unmanaged}) {
+            for (Entry &entry : *entries) {
+                if (m_dirtyWindows.contains(entry.window)) {
+                    entry.bounds = inputBounds(entry.window);
+                }
+            }
+        }
+        m_dirtyWindows.clear();
+    }
+}
+
+Window *HitTestIndex::topmostAt(const QVector<Entry> &entries, const QPointF &pos, const std::function<bool(Window *)> &filter)
+{
+    for (const Entry &entry : entries) {
+        if (!entry.bounds.contains(pos)) {
+            continue;
+        }
+        if (filter && !filter(entry.window)) {
+            continue;
+        }
+        if (entry.window->hitTest(pos)) {
+            return entry.window;
+        }
+    }
+    return nullptr;
+}
+
+Window *HitTestIndex::unmanagedAt(const QPointF &pos)
+{
+    update();
+    return topmostAt(m_unmanaged, pos, nullptr);
+}
+
+Window *HitTestIndex::managedAt(const QPointF &pos, const std::function<bool(Window *)> &filter)
+{
+    update();
+    return topmostAt(m_managed, pos, filter);
+}
+
+} // namespace KWin
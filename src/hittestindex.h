@@ -0,0 +1,75 @@
+/*
+    KWin - the KDE window manager
+    This file is part of the KDE project.
+
+    SPDX-FileCopyrightText: 2022 KWin contributors
+
+    SPDX-License-Identifier: GPL-2.0-or-later
+*/
+
+#pragma once
+
+#include <QObject>
+#include <QRectF>
+#include <QSet>
+#include <QVector>
+
+#include <functional>
+
+namespace KWin
+{
+
+class Window;
+class Workspace;
+
+/**
+ * The HitTestIndex class caches the input bounds of all windows in stacking order.
+ *
+ * The bounds of a window enclose everything that can possibly accept input: the input
+ * geometry, the decoration and all the subsurfaces. Finding the window under a point only
+ * runs the exact, comparatively expensive, hit test for the windows whose bounds contain
+ * the point, so the pointer motion doesn't walk the subsurface trees of every window.
+ *
+ * The order is rebuilt when the stacking order changes, the bounds of a window are only
+ * recomputed after the window has reported a geometry change.
+ */
+class HitTestIndex : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit HitTestIndex(Workspace *workspace);
+
+    /**
+     * Returns the topmost unmanaged window that accepts input at @a pos.
+     */
+    Window *unmanagedAt(const QPointF &pos);
+
+    /**
+     * Returns the topmost window in the stacking order that passes the @a filter and accepts
+     * input at @a pos. The filter is only invoked for the windows whose bounds contain @a pos.
+     */
+    Window *managedAt(const QPointF &pos, const std::function<bool(Window *)> &filter);
+
+private:
+    struct Entry
+    {
+        Window *window;
+        QRectF bounds;
+    };
+
+    void watch(Window *window);
+    void invalidateOrder();
+    void invalidateBounds(Window *window);
+    void update();
+    static QRectF inputBounds(const Window *window);
+    static Window *topmostAt(const QVector<Entry> &entries, const QPointF &pos, const std::function<bool(Window *)> &filter);
+
+    Workspace *m_workspace;
+    QVector<Entry> m_managed;
+    QVector<Entry> m_unmanaged;
+    QSet<Window *> m_dirtyWindows;
+    bool m_orderDirty = true;
+};
+
+} // namespace KWin
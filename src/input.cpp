@@ -16,6 +16,7 @@
 #include "effects.h"
 #include "gestures.h"
 #include "globalshortcuts.h"
+#include "hittestindex.h"
 #include "hide_cursor_spy.h"
 #include "idledetector.h"
 #include "input_event.h"
@@ -3211,6 +3212,14 @@ void InputRedirection::removeIdleInhibitor(Window *inhibitor)
     }
 }
 
+HitTestIndex *InputRedirection::hitTestIndex()
+{
+    if (!m_hitTestIndex) {
+        m_hitTestIndex = new HitTestIndex(Workspace::self());
+    }
+    return m_hitTestIndex;
+}
+
 Window *InputRedirection::findToplevel(const QPointF &pos)
 {
     if (!Workspace::self()) {
@@ -3223,11 +3232,8 @@ Window *InputRedirection::findToplevel(const QPointF &pos)
         if (effects && static_cast<EffectsHandlerImpl *>(effects)->isMouseInterception()) {
             return nullptr;
         }
-        const QList<Unmanaged *> &unmanaged = Workspace::self()->unmanagedList();
-        for (Unmanaged *u : unmanaged) {
-            if (u->hitTest(pos)) {
-                return u;
-            }
+        if (Window *window = hitTestIndex()->unmanagedAt(pos)) {
+            return window;
         }
     }
     return findManagedToplevel(pos);
@@ -3239,34 +3245,20 @@ Window *InputRedirection::findManagedToplevel(const QPointF &pos)
         return nullptr;
     }
     const bool isScreenLocked = waylandServer() && waylandServer()->isScreenLocked();
-    const QList<Window *> &stacking = Workspace::self()->stackingOrder();
-    if (stacking.isEmpty()) {
-        return nullptr;
-    }
-    auto it = stacking.end();
-    do {
-        --it;
-        Window *window = (*it);
-        if (window->isDeleted()) {
-            // a deleted window doesn't get mouse events
-            continue;
-        }
+    return hitTestIndex()->managedAt(pos, [isScreenLocked](Window *window) {
         if (!window->isOnCurrentActivity() || !window->isOnCurrentDesktop() || window->isMinimized() || window->isHiddenInternal()) {
-            continue;
+            return false;
         }
         if (!window->readyForPainting()) {
-            continue;
+            return false;
         }
         if (isScreenLocked) {
             if (!window->isLockScreen() && !window->isInputMethod()) {
-                continue;
+                return false;
             }
         }
-        if (window->hitTest(pos)) {
-            return window;
-        }
-    } while (it != stacking.begin());
-    return nullptr;
+        return true;
+    });
 }
 
 Qt::KeyboardModifiers InputRedirection::keyboardModifiers() const
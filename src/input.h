@@ -12,6 +12,8 @@
 #define KWIN_INPUT_H
 #include <config-kwin.h>
 
+#include "ftrace.h"
+
 #include <QAction>
 #include <QObject>
 #include <QPoint>
@@ -35,6 +37,7 @@ namespace KWin
 class IdleDetector;
 class Window;
 class GlobalShortcutsManager;
+class HitTestIndex;
 class InputEventFilter;
 class InputEventSpy;
 class KeyboardInputRedirection;
@@ -200,6 +203,7 @@ public:
     template<class UnaryPredicate>
     void processFilters(UnaryPredicate function)
     {
+        fTraceScope("InputFilters");
         std::any_of(m_filters.constBegin(), m_filters.constEnd(), function);
     }
 
@@ -323,11 +327,13 @@ private:
     void updateLeds(LEDs leds);
     void updateAvailableInputDevices();
     void addInputBackend(std::unique_ptr<InputBackend> &&inputBackend);
+    HitTestIndex *hitTestIndex();
     KeyboardInputRedirection *m_keyboard;
     PointerInputRedirection *m_pointer;
     TabletInputRedirection *m_tablet;
     TouchInputRedirection *m_touch;
     QObject *m_lastInputDevice = nullptr;
+    QPointer<HitTestIndex> m_hitTestIndex;
 
     GlobalShortcutsManager *m_shortcuts;
 
@@ -17,6 +17,8 @@
 namespace KWin
 {
 
+static quint64 s_subtreeSerial = 0;
+
 Item::Item(Item *parent)
 {
     setParentItem(parent);
@@ -42,6 +44,9 @@ void Item::setOpacity(qreal opacity)
 {
     if (m_opacity != opacity) {
         m_opacity = opacity;
+        if (m_parentItem) {
+            m_parentItem->invalidateSubtree();
+        }
         scheduleRepaint(boundingRect());
     }
 }
@@ -59,6 +64,7 @@ void Item::setZ(int z)
     m_z = z;
     if (m_parentItem) {
         m_parentItem->markSortedChildItemsDirty();
+        m_parentItem->invalidateSubtree();
     }
     scheduleRepaint(boundingRect());
 }
@@ -89,6 +95,7 @@ void Item::addChild(Item *item)
 
     m_childItems.append(item);
     markSortedChildItemsDirty();
+    invalidateSubtree();
 
     updateBoundingRect();
     scheduleRepaint(item->boundingRect().translated(item->position()));
@@ -101,6 +108,7 @@ void Item::removeChild(Item *item)
 
     m_childItems.removeOne(item);
     markSortedChildItemsDirty();
+    invalidateSubtree();
 
     updateBoundingRect();
 }
@@ -122,6 +130,7 @@ void Item::setPosition(const QPointF &point)
         m_position = point;
         if (m_parentItem) {
             m_parentItem->updateBoundingRect();
+            m_parentItem->invalidateSubtree();
         }
         scheduleRepaint(boundingRect());
         Q_EMIT positionChanged();
@@ -200,7 +209,13 @@ QMatrix4x4 Item::transform() const
 
 void Item::setTransform(const QMatrix4x4 &transform)
 {
+    if (m_transform == transform) {
+        return;
+    }
     m_transform = transform;
+    if (m_parentItem) {
+        m_parentItem->invalidateSubtree();
+    }
 }
 
 QRegion Item::mapToGlobal(const QRegion &region) const
@@ -249,7 +264,8 @@ void Item::stackBefore(Item *sibling)
     }
 
     m_parentItem->m_childItems.move(selfIndex, selfIndex > siblingIndex ? siblingIndex : siblingIndex - 1);
-    markSortedChildItemsDirty();
+    m_parentItem->markSortedChildItemsDirty();
+    m_parentItem->invalidateSubtree();
 
     scheduleRepaint(boundingRect());
     sibling->scheduleRepaint(sibling->boundingRect());
@@ -277,7 +293,8 @@ void Item::stackAfter(Item *sibling)
     }
 
     m_parentItem->m_childItems.move(selfIndex, selfIndex > siblingIndex ? siblingIndex + 1 : siblingIndex);
-    markSortedChildItemsDirty();
+    m_parentItem->markSortedChildItemsDirty();
+    m_parentItem->invalidateSubtree();
 
     scheduleRepaint(boundingRect());
     sibling->scheduleRepaint(sibling->boundingRect());
@@ -310,6 +327,9 @@ void Item::scheduleRepaintInternal(const QRegion &region)
 
 void Item::scheduleFrame()
 {
+    // A new frame is requested when the content changes without damage, e.g. when a new
+    // buffer is attached, the item needs to be processed again.
+    invalidateSubtree();
     if (!isVisible()) {
         return;
     }
@@ -338,6 +358,8 @@ WindowQuadList Item::buildQuads() const
 void Item::discardQuads()
 {
     m_quads.reset();
+    m_quadsSerial++;
+    invalidateSubtree();
 }
 
 WindowQuadList Item::quads() const
@@ -348,6 +370,24 @@ WindowQuadList Item::quads() const
     return m_quads.value();
 }
 
+quint64 Item::quadsSerial() const
+{
+    return m_quadsSerial;
+}
+
+quint64 Item::subtreeSerial() const
+{
+    return m_subtreeSerial;
+}
+
+void Item::invalidateSubtree()
+{
+    const quint64 serial = ++s_subtreeSerial;
+    for (Item *item = this; item; item = item->m_parentItem) {
+        item->m_subtreeSerial = serial;
+    }
+}
+
 QRegion Item::repaints(Output *output) const
 {
     return m_repaints.value(output);
@@ -377,6 +417,9 @@ void Item::setVisible(bool visible)
 {
     if (m_explicitVisible != visible) {
         m_explicitVisible = visible;
+        if (m_parentItem) {
+            m_parentItem->invalidateSubtree();
+        }
         updateEffectiveVisibility();
     }
 }
@@ -104,6 +104,18 @@ public:
     void resetRepaints(Output *output);
 
     WindowQuadList quads() const;
+    /**
+     * Returns a serial number that changes whenever the quads of this item are discarded.
+     * Renderers can use it to find out whether vertex data derived from quads() is stale.
+     */
+    quint64 quadsSerial() const;
+    /**
+     * Returns a serial number that changes whenever the content of this item or of any of its
+     * descendants changes. Changing the position, the transform, the opacity, the stacking
+     * order or the visibility of an item changes the serial of its parent instead. Renderers
+     * can use it to find out whether render data built for the subtree of this item is stale.
+     */
+    quint64 subtreeSerial() const;
     virtual void preprocess();
 
 Q_SIGNALS:
@@ -125,6 +137,10 @@ Q_SIGNALS:
 protected:
     virtual WindowQuadList buildQuads() const;
     void discardQuads();
+    /**
+     * Changes the subtree serial of this item and of all its ancestors.
+     */
+    void invalidateSubtree();
 
 private:
     void addChild(Item *item);
@@ -149,6 +165,8 @@ private:
     bool m_effectiveVisible = true;
     QMap<Output *, QRegion> m_repaints;
     mutable std::optional<WindowQuadList> m_quads;
+    quint64 m_quadsSerial = 0;
+    quint64 m_subtreeSerial = 0;
     mutable std::optional<QList<Item *>> m_sortedChildItems;
 };
 
@@ -14,9 +14,13 @@
 
 #include <QDateTime>
 #include <QTimer>
+#include <QVarLengthArray>
 #include <QVector3D>
 #include <QtDebug>
 
+#include <algorithm>
+#include <vector>
+
 namespace KWin
 {
 
@@ -28,23 +32,108 @@ QDebug operator<<(QDebug dbg, const KWin::FPx2 &fpx2)
 
 QElapsedTimer AnimationEffect::s_clock;
 
+struct AnimatedWindow
+{
+    QVector<int> slots; // in the order the animations were started
+    QRect layerRect;
+};
+
+/**
+ * The animations are stored in flat arrays indexed by slot, which are walked once per frame
+ * rather than per window and per paint pass. The easing curves are evaluated in one batch
+ * in prePaintScreen(), the paint passes only read the cached values.
+ *
+ * A freed slot is filled by moving the last animation into it, so slots are not stable. The
+ * animation ids are the stable handles and are mapped to slots with m_slots.
+ */
 class AnimationEffectPrivate
 {
 public:
     AnimationEffectPrivate()
     {
-        m_animationsTouched = m_isInitialized = false;
+        m_isInitialized = false;
         m_justEndedAnimation = 0;
     }
-    AnimationEffect::AniMap m_animations;
+
+    int slotOf(quint64 animationId) const;
+    int add(EffectWindow *window, const AniData &animation);
+    void remove(int slot);
+    void updateValue(int slot);
+    void updateValues();
+    bool hasOtherShader(EffectWindow *window, quint64 animationId) const;
+
+    std::vector<AniData> m_data;
+    std::vector<EffectWindow *> m_windows;
+    std::vector<float> m_values;
+    QHash<quint64, int> m_slots;
+    QHash<EffectWindow *, AnimatedWindow> m_animatedWindows;
+
     static quint64 m_animCounter;
     quint64 m_justEndedAnimation; // protect against cancel
     QWeakPointer<FullScreenEffectLock> m_fullScreenEffectLock;
-    bool m_needSceneRepaint, m_animationsTouched, m_isInitialized;
+    bool m_needSceneRepaint, m_isInitialized;
 };
 
 quint64 AnimationEffectPrivate::m_animCounter = 0;
 
+int AnimationEffectPrivate::slotOf(quint64 animationId) const
+{
+    return m_slots.value(animationId, -1);
+}
+
+int AnimationEffectPrivate::add(EffectWindow *window, const AniData &animation)
+{
+    const int slot = m_data.size();
+    m_data.push_back(animation);
+    m_windows.push_back(window);
+    m_values.push_back(animation.timeLine.value());
+    m_slots.insert(animation.id, slot);
+    m_animatedWindows[window].slots.append(slot);
+    return slot;
+}
+
+void AnimationEffectPrivate::remove(int slot)
+{
+    m_animatedWindows[m_windows[slot]].slots.removeOne(slot);
+    m_slots.remove(m_data[slot].id);
+
+    const int last = m_data.size() - 1;
+    if (slot != last) {
+        m_data[slot] = m_data[last];
+        m_windows[slot] = m_windows[last];
+        m_values[slot] = m_values[last];
+        m_slots[m_data[slot].id] = slot;
+
+        // The moved animation keeps its position in the list of its window.
+        QVector<int> &slots = m_animatedWindows[m_windows[slot]].slots;
+        std::replace(slots.begin(), slots.end(), last, slot);
+    }
+
+    m_data.pop_back();
+    m_windows.pop_back();
+    m_values.pop_back();
+}
+
+void AnimationEffectPrivate::updateValue(int slot)
+{
+    m_values[slot] = m_data[slot].timeLine.value();
+}
+
+void AnimationEffectPrivate::updateValues()
+{
+    for (size_t slot = 0; slot < m_data.size(); ++slot) {
+        m_values[slot] = m_data[slot].timeLine.value();
+    }
+}
+
+bool AnimationEffectPrivate::hasOtherShader(EffectWindow *window, quint64 animationId) const
+{
+    const QVector<int> &slots = m_animatedWindows[window].slots;
+    return std::any_of(slots.begin(), slots.end(), [this, animationId](int slot) {
+        return m_data[slot].id != animationId && m_data[slot].shader;
+    });
+}
+
 AnimationEffect::AnimationEffect()
     : d_ptr(new AnimationEffectPrivate())
 {
@@ -79,7 +168,7 @@ void AnimationEffect::init()
 bool AnimationEffect::isActive() const
 {
     Q_D(const AnimationEffect);
-    return !d->m_animations.isEmpty() && !effects->isScreenLocked();
+    return !d->m_data.empty() && !effects->isScreenLocked();
 }
 
 #define RELATIVE_XY(_FIELD_) const bool relative[2] = {static_cast<bool>(metaData(Relative##_FIELD_##X, meta)), \
@@ -215,14 +304,10 @@ quint64 AnimationEffect::p_animate(EffectWindow *w, Attribute a, uint meta, int
     if (!d->m_isInitialized) {
         init(); // needs to ensure the window gets removed if deleted in the same event cycle
     }
-    if (d->m_animations.isEmpty()) {
+    if (d->m_data.empty()) {
         connect(effects, &EffectsHandler::windowExpandedGeometryChanged,
                 this, &AnimationEffect::_windowExpandedGeometryChanged);
     }
-    AniMap::iterator it = d->m_animations.find(w);
-    if (it == d->m_animations.end()) {
-        it = d->m_animations.insert(w, QPair<QList<AniData>, QRect>(QList<AniData>(), QRect()));
-    }
 
     FullScreenEffectLockPtr fullscreen;
     if (fullScreenEffect) {
@@ -239,7 +324,7 @@ quint64 AnimationEffect::p_animate(EffectWindow *w, Attribute a, uint meta, int
         previousPixmap = PreviousWindowPixmapLockPtr::create(w);
     }
 
-    it->first.append(AniData(
+    AniData animation(
         a, // Attribute
         meta, // Metadata
         to, // Target
@@ -250,10 +335,9 @@ quint64 AnimationEffect::p_animate(EffectWindow *w, Attribute a, uint meta, int
         keepAlive, // Keep alive flag
         previousPixmap, // Previous window pixmap lock
         shader
-        ));
+        );
 
     const quint64 ret_id = ++d->m_animCounter;
-    AniData &animation = it->first.last();
     animation.id = ret_id;
 
     animation.visibleRef = EffectWindowVisibleRef(w, EffectWindow::PAINT_DISABLED_BY_MINIMIZE | EffectWindow::PAINT_DISABLED_BY_DESKTOP | EffectWindow::PAINT_DISABLED_BY_DELETE);
@@ -268,9 +352,9 @@ quint64 AnimationEffect::p_animate(EffectWindow *w, Attribute a, uint meta, int
         animation.terminationFlags |= TerminateAtTarget;
     }
 
-    it->second = QRect();
-
-    d->m_animationsTouched = true;
+    d->add(w, animation);
+    d->m_animatedWindows[w].layerRect = QRect();
+    effects->setWindowPassesEnabled(this, w, true);
 
     if (delay > 0) {
         QTimer::singleShot(delay, this, &AnimationEffect::triggerRepaint);
@@ -293,26 +377,22 @@ bool AnimationEffect::retarget(quint64 animationId, FPx2 newTarget, int newRemai
     if (animationId == d->m_justEndedAnimation) {
         return false; // this is just ending, do not try to retarget it
     }
-    for (AniMap::iterator entry = d->m_animations.begin(),
-                          mapEnd = d->m_animations.end();
-         entry != mapEnd; ++entry) {
-        for (QList<AniData>::iterator anim = entry->first.begin(),
-                                      animEnd = entry->first.end();
-             anim != animEnd; ++anim) {
-            if (anim->id == animationId) {
-                anim->from.set(interpolated(*anim, 0), interpolated(*anim, 1));
-                validate(anim->attribute, anim->meta, nullptr, &newTarget, entry.key());
-                anim->to.set(newTarget[0], newTarget[1]);
-
-                anim->timeLine.setDirection(TimeLine::Forward);
-                anim->timeLine.setDuration(std::chrono::milliseconds(newRemainingTime));
-                anim->timeLine.reset();
-
-                return true;
-            }
-        }
+    const int slot = d->slotOf(animationId);
+    if (slot == -1) {
+        return false; // no animation found
     }
-    return false; // no animation found
+
+    AniData &anim = d->m_data[slot];
+    anim.from.set(interpolated(slot, 0), interpolated(slot, 1));
+    validate(anim.attribute, anim.meta, nullptr, &newTarget, d->m_windows[slot]);
+    anim.to.set(newTarget[0], newTarget[1]);
+
+    anim.timeLine.setDirection(TimeLine::Forward);
+    anim.timeLine.setDuration(std::chrono::milliseconds(newRemainingTime));
+    anim.timeLine.reset();
+    d->updateValue(slot);
+
+    return true;
 }
 
 bool AnimationEffect::freezeInTime(quint64 animationId, qint64 frozenTime)
@@ -322,22 +402,18 @@ bool AnimationEffect::freezeInTime(quint64 animationId, qint64 frozenTime)
     if (animationId == d->m_justEndedAnimation) {
         return false; // this is just ending, do not try to retarget it
     }
-    for (AniMap::iterator entry = d->m_animations.begin(),
-                          mapEnd = d->m_animations.end();
-         entry != mapEnd; ++entry) {
-        for (QList<AniData>::iterator anim = entry->first.begin(),
-                                      animEnd = entry->first.end();
-             anim != animEnd; ++anim) {
-            if (anim->id == animationId) {
-                if (frozenTime >= 0) {
-                    anim->timeLine.setElapsed(std::chrono::milliseconds(frozenTime));
-                }
-                anim->frozenTime = frozenTime;
-                return true;
-            }
-        }
+    const int slot = d->slotOf(animationId);
+    if (slot == -1) {
+        return false; // no animation found
     }
-    return false; // no animation found
+
+    AniData &anim = d->m_data[slot];
+    if (frozenTime >= 0) {
+        anim.timeLine.setElapsed(std::chrono::milliseconds(frozenTime));
+        d->updateValue(slot);
+    }
+    anim.frozenTime = frozenTime;
+    return true;
 }
 
 bool AnimationEffect::redirect(quint64 animationId, Direction direction, TerminationFlags terminationFlags)
@@ -347,32 +423,26 @@ bool AnimationEffect::redirect(quint64 animationId, Direction direction, Termina
     if (animationId == d->m_justEndedAnimation) {
         return false;
     }
+    const int slot = d->slotOf(animationId);
+    if (slot == -1) {
+        return false;
+    }
 
-    for (auto entryIt = d->m_animations.begin(); entryIt != d->m_animations.end(); ++entryIt) {
-        auto animIt = std::find_if(entryIt->first.begin(), entryIt->first.end(),
-                                   [animationId](AniData &anim) {
-                                       return anim.id == animationId;
-                                   });
-        if (animIt == entryIt->first.end()) {
-            continue;
-        }
-
-        switch (direction) {
-        case Backward:
-            animIt->timeLine.setDirection(TimeLine::Backward);
-            break;
-
-        case Forward:
-            animIt->timeLine.setDirection(TimeLine::Forward);
-            break;
-        }
-
-        animIt->terminationFlags = terminationFlags & ~TerminateAtTarget;
+    AniData &anim = d->m_data[slot];
+    switch (direction) {
+    case Backward:
+        anim.timeLine.setDirection(TimeLine::Backward);
+        break;
 
-        return true;
+    case Forward:
+        anim.timeLine.setDirection(TimeLine::Forward);
+        break;
     }
 
-    return false;
+    anim.terminationFlags = terminationFlags & ~TerminateAtTarget;
+    d->updateValue(slot);
+
+    return true;
 }
 
 bool AnimationEffect::complete(quint64 animationId)
@@ -382,22 +452,16 @@ bool AnimationEffect::complete(quint64 animationId)
     if (animationId == d->m_justEndedAnimation) {
         return false;
     }
-
-    for (auto entryIt = d->m_animations.begin(); entryIt != d->m_animations.end(); ++entryIt) {
-        auto animIt = std::find_if(entryIt->first.begin(), entryIt->first.end(),
-                                   [animationId](AniData &anim) {
-                                       return anim.id == animationId;
-                                   });
-        if (animIt == entryIt->first.end()) {
-            continue;
-        }
-
-        animIt->timeLine.setElapsed(animIt->timeLine.duration());
-
-        return true;
+    const int slot = d->slotOf(animationId);
+    if (slot == -1) {
+        return false;
     }
 
-    return false;
+    AniData &anim = d->m_data[slot];
+    anim.timeLine.setElapsed(anim.timeLine.duration());
+    d->updateValue(slot);
+
+    return true;
 }
 
 bool AnimationEffect::cancel(quint64 animationId)
@@ -406,44 +470,41 @@ bool AnimationEffect::cancel(quint64 animationId)
     if (animationId == d->m_justEndedAnimation) {
         return true; // this is just ending, do not try to cancel it but fake success
     }
-    for (AniMap::iterator entry = d->m_animations.begin(), mapEnd = d->m_animations.end(); entry != mapEnd; ++entry) {
-        for (QList<AniData>::iterator anim = entry->first.begin(), animEnd = entry->first.end(); anim != animEnd; ++anim) {
-            if (anim->id == animationId) {
-                if (anim->shader && std::none_of(entry->first.begin(), entry->first.end(), [animationId] (const auto &anim) { return anim.id != animationId && anim.shader; })) {
-                    unredirect(entry.key());
-                }
-                entry->first.erase(anim); // remove the animation
-                if (entry->first.isEmpty()) { // no other animations on the window, release it.
-                    d->m_animations.erase(entry);
-                }
-                if (d->m_animations.isEmpty()) {
-                    disconnectGeometryChanges();
-                }
-                d->m_animationsTouched = true; // could be called from animationEnded
-                return true;
-            }
-        }
+    const int slot = d->slotOf(animationId);
+    if (slot == -1) {
+        return false;
+    }
+
+    EffectWindow *window = d->m_windows[slot];
+    if (d->m_data[slot].shader && !d->hasOtherShader(window, animationId)) {
+        unredirect(window);
     }
-    return false;
+    d->remove(slot); // remove the animation
+    if (d->m_animatedWindows[window].slots.isEmpty()) { // no other animations on the window, release it.
+        d->m_animatedWindows.remove(window);
+        effects->setWindowPassesEnabled(this, window, false);
+    }
+    if (d->m_data.empty()) {
+        disconnectGeometryChanges();
+    }
+    return true;
 }
 
 void AnimationEffect::prePaintScreen(ScreenPrePaintData &data, std::chrono::milliseconds presentTime)
 {
     Q_D(AnimationEffect);
-    if (d->m_animations.isEmpty()) {
+    if (d->m_data.empty()) {
         effects->prePaintScreen(data, presentTime);
         return;
     }
 
-    for (auto entry = d->m_animations.begin(); entry != d->m_animations.end(); ++entry) {
-        for (auto anim = entry->first.begin(); anim != entry->first.end(); ++anim) {
-            if (anim->startTime <= clock()) {
-                if (anim->frozenTime < 0) {
-                    anim->timeLine.advance(presentTime);
-                }
-            }
+    const qint64 now = clock();
+    for (AniData &anim : d->m_data) {
+        if (anim.startTime <= now && anim.frozenTime < 0) {
+            anim.timeLine.advance(presentTime);
         }
     }
+    d->updateValues();
 
     effects->prePaintScreen(data, presentTime);
 }
@@ -470,10 +531,12 @@ static qreal yCoord(const QRectF &r, int flag)
     }
 }
 
-QRect AnimationEffect::clipRect(const QRect &geo, const AniData &anim) const
+QRect AnimationEffect::clipRect(const QRect &geo, int slot) const
 {
+    Q_D(const AnimationEffect);
+    const AniData &anim = d->m_data[slot];
     QRect clip = geo;
-    FPx2 ratio = anim.from + progress(anim) * (anim.to - anim.from);
+    FPx2 ratio = anim.from + progress(slot) * (anim.to - anim.from);
     if (anim.from[0] < 1.0 || anim.to[0] < 1.0) {
         clip.setWidth(clip.width() * ratio[0]);
     }
@@ -500,9 +563,10 @@ void AnimationEffect::disconnectGeometryChanges()
 void AnimationEffect::prePaintWindow(EffectWindow *w, WindowPrePaintData &data, std::chrono::milliseconds presentTime)
 {
     Q_D(AnimationEffect);
-    AniMap::const_iterator entry = d->m_animations.constFind(w);
-    if (entry != d->m_animations.constEnd()) {
-        for (QList<AniData>::const_iterator anim = entry->first.constBegin(); anim != entry->first.constEnd(); ++anim) {
+    auto entry = d->m_animatedWindows.constFind(w);
+    if (entry != d->m_animatedWindows.constEnd()) {
+        for (int slot : entry->slots) {
+            const AniData *anim = &d->m_data[slot];
             if (anim->startTime > clock() && !anim->waitAtSource) {
                 continue;
             }
@@ -531,9 +595,20 @@ static inline float geometryCompensation(int flags, float v)
 void AnimationEffect::paintWindow(EffectWindow *w, int mask, QRegion region, WindowPaintData &data)
 {
     Q_D(AnimationEffect);
-    AniMap::const_iterator entry = d->m_animations.constFind(w);
-    if (entry != d->m_animations.constEnd()) {
-        for (QList<AniData>::const_iterator anim = entry->first.constBegin(); anim != entry->first.constEnd(); ++anim) {
+    auto entry = d->m_animatedWindows.constFind(w);
+    if (entry != d->m_animatedWindows.constEnd()) {
+        // genericAnimation() is user code and can cancel animations, which moves other animations
+        // to different slots. Walk the animation ids and look up their slots as we go.
+        QVarLengthArray<quint64, 4> animationIds;
+        for (int slot : entry->slots) {
+            animationIds.append(d->m_data[slot].id);
+        }
+        for (quint64 animationId : std::as_const(animationIds)) {
+            const int slot = d->slotOf(animationId);
+            if (slot == -1) {
+                continue; // cancelled by genericAnimation()
+            }
+            const AniData *anim = &d->m_data[slot];
 
             if (anim->startTime > clock() && !anim->waitAtSource) {
                 continue;
@@ -541,26 +616,26 @@ void AnimationEffect::paintWindow(EffectWindow *w, int mask, QRegion region, Win
 
             switch (anim->attribute) {
             case Opacity:
-                data.multiplyOpacity(interpolated(*anim));
+                data.multiplyOpacity(interpolated(slot));
                 break;
             case Brightness:
-                data.multiplyBrightness(interpolated(*anim));
+                data.multiplyBrightness(interpolated(slot));
                 break;
             case Saturation:
-                data.multiplySaturation(interpolated(*anim));
+                data.multiplySaturation(interpolated(slot));
                 break;
             case Scale: {
                 const QSizeF sz = w->frameGeometry().size();
                 float f1(1.0), f2(0.0);
                 if (anim->from[0] >= 0.0 && anim->to[0] >= 0.0) { // scale x
-                    f1 = interpolated(*anim, 0);
+                    f1 = interpolated(slot, 0);
                     f2 = geometryCompensation(anim->meta & AnimationEffect::Horizontal, f1);
                     data.translate(f2 * sz.width());
                     data.setXScale(data.xScale() * f1);
                 }
                 if (anim->from[1] >= 0.0 && anim->to[1] >= 0.0) { // scale y
                     if (!anim->isOneDimensional()) {
-                        f1 = interpolated(*anim, 1);
+                        f1 = interpolated(slot, 1);
                         f2 = geometryCompensation(anim->meta & AnimationEffect::Vertical, f1);
                     } else if (((anim->meta & AnimationEffect::Vertical) >> 1) != (anim->meta & AnimationEffect::Horizontal)) {
                         f2 = geometryCompensation(anim->meta & AnimationEffect::Vertical, f1);
@@ -571,13 +646,13 @@ void AnimationEffect::paintWindow(EffectWindow *w, int mask, QRegion region, Win
                 break;
             }
             case Clip:
-                region = clipRect(w->expandedGeometry().toAlignedRect(), *anim);
+                region = clipRect(w->expandedGeometry().toAlignedRect(), slot);
                 break;
             case Translation:
-                data += QPointF(interpolated(*anim, 0), interpolated(*anim, 1));
+                data += QPointF(interpolated(slot, 0), interpolated(slot, 1));
                 break;
             case Size: {
-                FPx2 dest = anim->from + progress(*anim) * (anim->to - anim->from);
+                FPx2 dest = anim->from + progress(slot) * (anim->to - anim->from);
                 const QSizeF sz = w->frameGeometry().size();
                 float f;
                 if (anim->from[0] >= 0.0 && anim->to[0] >= 0.0) { // resize x
@@ -594,15 +669,15 @@ void AnimationEffect::paintWindow(EffectWindow *w, int mask, QRegion region, Win
             }
             case Position: {
                 const QRectF geo = w->frameGeometry();
-                const float prgrs = progress(*anim);
+                const float prgrs = progress(slot);
                 if (anim->from[0] >= 0.0 && anim->to[0] >= 0.0) {
-                    float dest = interpolated(*anim, 0);
+                    float dest = interpolated(slot, 0);
                     const qreal x[2] = {xCoord(geo, metaData(SourceAnchor, anim->meta)),
                                         xCoord(geo, metaData(TargetAnchor, anim->meta))};
                     data.translate(dest - (x[0] + prgrs * (x[1] - x[0])));
                 }
                 if (anim->from[1] >= 0.0 && anim->to[1] >= 0.0) {
-                    float dest = interpolated(*anim, 1);
+                    float dest = interpolated(slot, 1);
                     const qreal y[2] = {yCoord(geo, metaData(SourceAnchor, anim->meta)),
                                         yCoord(geo, metaData(TargetAnchor, anim->meta))};
                     data.translate(0.0, dest - (y[0] + prgrs * (y[1] - y[0])));
@@ -611,7 +686,7 @@ void AnimationEffect::paintWindow(EffectWindow *w, int mask, QRegion region, Win
             }
             case Rotation: {
                 data.setRotationAxis((Qt::Axis)metaData(Axis, anim->meta));
-                const float prgrs = progress(*anim);
+                const float prgrs = progress(slot);
                 data.setRotationAngle(anim->from[0] + prgrs * (anim->to[0] - anim->from[0]));
 
                 const QRect geo = w->rect().toRect();
@@ -627,23 +702,23 @@ void AnimationEffect::paintWindow(EffectWindow *w, int mask, QRegion region, Win
                 break;
             }
             case Generic:
-                genericAnimation(w, data, progress(*anim), anim->meta);
+                genericAnimation(w, data, progress(slot), anim->meta);
                 break;
             case CrossFadePrevious:
-                data.setCrossFadeProgress(progress(*anim));
+                data.setCrossFadeProgress(progress(slot));
                 break;
             case Shader:
                 if (anim->shader && anim->shader->isValid()) {
                     ShaderBinder binder{anim->shader};
-                    anim->shader->setUniform("animationProgress", progress(*anim));
+                    anim->shader->setUniform("animationProgress", progress(slot));
                     setShader(w, anim->shader);
                 }
                 break;
             case ShaderUniform:
                 if (anim->shader && anim->shader->isValid()) {
                     ShaderBinder binder{anim->shader};
-                    anim->shader->setUniform("animationProgress", progress(*anim));
-                    anim->shader->setUniform(anim->meta, interpolated(*anim));
+                    anim->shader->setUniform("animationProgress", progress(slot));
+                    anim->shader->setUniform(anim->meta, interpolated(slot));
                     setShader(w, anim->shader);
                 }
                 break;
@@ -659,52 +734,49 @@ void AnimationEffect::paintWindow(EffectWindow *w, int mask, QRegion region, Win
 void AnimationEffect::postPaintScreen()
 {
     Q_D(AnimationEffect);
-    d->m_animationsTouched = false;
     bool damageDirty = false;
 
-    for (auto entry = d->m_animations.begin(); entry != d->m_animations.end();) {
-        bool invalidateLayerRect = false;
-        int animCounter = 0;
-        for (auto anim = entry->first.begin(); anim != entry->first.end();) {
-            if (anim->isActive() || (anim->startTime > clock() && !anim->waitAtSource)) {
-                ++anim;
-                ++animCounter;
-                continue;
-            }
-            EffectWindow *window = entry.key();
-            d->m_justEndedAnimation = anim->id;
-            if (anim->shader && std::none_of(entry->first.begin(), entry->first.end(), [anim] (const auto &other) { return anim->id != other.id && other.shader; })) {
-                unredirect(window);
-            }
-            animationEnded(window, anim->attribute, anim->meta);
-            d->m_justEndedAnimation = 0;
-            // NOTICE animationEnded is an external call and might have called "::animate"
-            // as a result our iterators could now point random junk on the heap
-            // so we've to restore the former states, ie. find our window list and animation
-            if (d->m_animationsTouched) {
-                d->m_animationsTouched = false;
-                entry = d->m_animations.begin();
-                while (entry.key() != window && entry != d->m_animations.end()) {
-                    ++entry;
-                }
-                Q_ASSERT(entry != d->m_animations.end()); // usercode should not delete animations from animationEnded (not even possible atm.)
-                anim = entry->first.begin();
-                Q_ASSERT(animCounter < entry->first.count());
-                for (int i = 0; i < animCounter; ++i) {
-                    ++anim;
-                }
-            }
-            anim = entry->first.erase(anim);
-            invalidateLayerRect = damageDirty = true;
+    // animationEnded() is an external call and might start or cancel animations, which moves
+    // them around, so collect the ids of the ended animations first.
+    QVarLengthArray<quint64, 16> endedAnimations;
+    const qint64 now = clock();
+    for (const AniData &anim : d->m_data) {
+        if (!anim.isActive() && !(anim.startTime > now && !anim.waitAtSource)) {
+            endedAnimations.append(anim.id);
+        }
+    }
+    std::sort(endedAnimations.begin(), endedAnimations.end());
+
+    for (quint64 animationId : std::as_const(endedAnimations)) {
+        int slot = d->slotOf(animationId);
+        if (slot == -1) {
+            continue;
+        }
+        EffectWindow *window = d->m_windows[slot];
+        const AniData &anim = d->m_data[slot];
+        if (anim.shader && !d->hasOtherShader(window, animationId)) {
+            unredirect(window);
         }
-        if (entry->first.isEmpty()) {
-            effects->addRepaint(entry->second);
-            entry = d->m_animations.erase(entry);
+        const Attribute attribute = anim.attribute;
+        const uint meta = anim.meta;
+
+        d->m_justEndedAnimation = animationId;
+        animationEnded(window, attribute, meta);
+        d->m_justEndedAnimation = 0;
+
+        // The ended animation can't be cancelled, but it could have been moved to another slot.
+        slot = d->slotOf(animationId);
+        Q_ASSERT(slot != -1);
+        d->remove(slot);
+        damageDirty = true;
+
+        AnimatedWindow &entry = d->m_animatedWindows[window];
+        if (entry.slots.isEmpty()) {
+            effects->addRepaint(entry.layerRect);
+            d->m_animatedWindows.remove(window);
+            effects->setWindowPassesEnabled(this, window, false);
         } else {
-            if (invalidateLayerRect) {
-                *const_cast<QRect *>(&(entry->second)) = QRect(); // invalidate
-            }
-            ++entry;
+            entry.layerRect = QRect(); // invalidate
         }
     }
 
@@ -714,13 +786,14 @@ void AnimationEffect::postPaintScreen()
     if (d->m_needSceneRepaint) {
         effects->addRepaintFull();
     } else {
-        for (auto entry = d->m_animations.constBegin(); entry != d->m_animations.constEnd(); ++entry) {
-            for (auto anim = entry->first.constBegin(); anim != entry->first.constEnd(); ++anim) {
-                if (anim->startTime > clock()) {
+        for (auto entry = d->m_animatedWindows.constBegin(); entry != d->m_animatedWindows.constEnd(); ++entry) {
+            for (int slot : entry->slots) {
+                const AniData &anim = d->m_data[slot];
+                if (anim.startTime > now) {
                     continue;
                 }
-                if (!anim->timeLine.done()) {
-                    entry.key()->addLayerRepaint(entry->second);
+                if (!anim.timeLine.done()) {
+                    entry.key()->addLayerRepaint(entry->layerRect);
                     break;
                 }
             }
@@ -728,21 +801,24 @@ void AnimationEffect::postPaintScreen()
     }
 
     // janitorial...
-    if (d->m_animations.isEmpty()) {
+    if (d->m_data.empty()) {
         disconnectGeometryChanges();
     }
 
     effects->postPaintScreen();
 }
 
-float AnimationEffect::interpolated(const AniData &a, int i) const
+float AnimationEffect::interpolated(int slot, int i) const
 {
-    return a.from[i] + a.timeLine.value() * (a.to[i] - a.from[i]);
+    Q_D(const AnimationEffect);
+    const AniData &a = d->m_data[slot];
+    return a.from[i] + d->m_values[slot] * (a.to[i] - a.from[i]);
 }
 
-float AnimationEffect::progress(const AniData &a) const
+float AnimationEffect::progress(int slot) const
 {
-    return a.startTime < clock() ? a.timeLine.value() : 0.0;
+    Q_D(const AnimationEffect);
+    return d->m_data[slot].startTime < clock() ? d->m_values[slot] : 0.0;
 }
 
 // TODO - get this out of the header - the functionpointer usage of QEasingCurve somehow sucks ;-)
@@ -809,16 +885,15 @@ void AnimationEffect::setMetaData(MetaType type, uint value, uint &meta)
 void AnimationEffect::triggerRepaint()
 {
     Q_D(AnimationEffect);
-    for (AniMap::const_iterator entry = d->m_animations.constBegin(), mapEnd = d->m_animations.constEnd(); entry != mapEnd; ++entry) {
-        *const_cast<QRect *>(&(entry->second)) = QRect();
+    for (AnimatedWindow &entry : d->m_animatedWindows) {
+        entry.layerRect = QRect();
     }
     updateLayerRepaints();
     if (d->m_needSceneRepaint) {
         effects->addRepaintFull();
     } else {
-        AniMap::const_iterator it = d->m_animations.constBegin(), end = d->m_animations.constEnd();
-        for (; it != end; ++it) {
-            it.key()->addLayerRepaint(it->second);
+        for (auto it = d->m_animatedWindows.constBegin(); it != d->m_animatedWindows.constEnd(); ++it) {
+            it.key()->addLayerRepaint(it->layerRect);
         }
     }
 }
@@ -841,119 +916,127 @@ static float fixOvershoot(float f, const AniData &d, short int dir, float s = 1.
     }
 }
 
-void AnimationEffect::updateLayerRepaints()
+bool AnimationEffect::computeLayerRect(EffectWindow *w, const QVector<int> &windowSlots, QRect *layerRect) const
 {
-    Q_D(AnimationEffect);
-    d->m_needSceneRepaint = false;
-    for (AniMap::const_iterator entry = d->m_animations.constBegin(), mapEnd = d->m_animations.constEnd(); entry != mapEnd; ++entry) {
-        if (!entry->second.isNull()) {
+    Q_D(const AnimationEffect);
+    float f[2] = {1.0, 1.0};
+    float t[2] = {0.0, 0.0};
+    bool createRegion = false;
+    QList<QRect> rects;
+    for (int slot : windowSlots) {
+        const AniData *anim = &d->m_data[slot];
+        if (anim->startTime > clock()) {
             continue;
         }
-        float f[2] = {1.0, 1.0};
-        float t[2] = {0.0, 0.0};
-        bool createRegion = false;
-        QList<QRect> rects;
-        QRect *layerRect = const_cast<QRect *>(&(entry->second));
-        for (QList<AniData>::const_iterator anim = entry->first.constBegin(), animEnd = entry->first.constEnd(); anim != animEnd; ++anim) {
-            if (anim->startTime > clock()) {
-                continue;
+        switch (anim->attribute) {
+        case Opacity:
+        case Brightness:
+        case Saturation:
+        case CrossFadePrevious:
+        case Shader:
+        case ShaderUniform:
+            createRegion = true;
+            break;
+        case Rotation:
+            *layerRect = QRect(QPoint(0, 0), effects->virtualScreenSize());
+            return true; // sic! no need to do anything else
+        case Generic:
+            return false; // we don't know whether this will change visual stacking order
+        case Translation:
+        case Position: {
+            createRegion = true;
+            QRect r(w->frameGeometry().toRect());
+            int x[2] = {0, 0};
+            int y[2] = {0, 0};
+            if (anim->attribute == Translation) {
+                x[0] = anim->from[0];
+                x[1] = anim->to[0];
+                y[0] = anim->from[1];
+                y[1] = anim->to[1];
+            } else {
+                if (anim->from[0] >= 0.0 && anim->to[0] >= 0.0) {
+                    x[0] = anim->from[0] - xCoord(r, metaData(SourceAnchor, anim->meta));
+                    x[1] = anim->to[0] - xCoord(r, metaData(TargetAnchor, anim->meta));
+                }
+                if (anim->from[1] >= 0.0 && anim->to[1] >= 0.0) {
+                    y[0] = anim->from[1] - yCoord(r, metaData(SourceAnchor, anim->meta));
+                    y[1] = anim->to[1] - yCoord(r, metaData(TargetAnchor, anim->meta));
+                }
             }
-            switch (anim->attribute) {
-            case Opacity:
-            case Brightness:
-            case Saturation:
-            case CrossFadePrevious:
-            case Shader:
-            case ShaderUniform:
-                createRegion = true;
-                break;
-            case Rotation:
-                createRegion = false;
-                *layerRect = QRect(QPoint(0, 0), effects->virtualScreenSize());
-                goto region_creation; // sic! no need to do anything else
-            case Generic:
-                d->m_needSceneRepaint = true; // we don't know whether this will change visual stacking order
-                return; // sic! no need to do anything else
-            case Translation:
-            case Position: {
-                createRegion = true;
-                QRect r(entry.key()->frameGeometry().toRect());
-                int x[2] = {0, 0};
-                int y[2] = {0, 0};
-                if (anim->attribute == Translation) {
-                    x[0] = anim->from[0];
-                    x[1] = anim->to[0];
-                    y[0] = anim->from[1];
-                    y[1] = anim->to[1];
-                } else {
-                    if (anim->from[0] >= 0.0 && anim->to[0] >= 0.0) {
-                        x[0] = anim->from[0] - xCoord(r, metaData(SourceAnchor, anim->meta));
-                        x[1] = anim->to[0] - xCoord(r, metaData(TargetAnchor, anim->meta));
-                    }
-                    if (anim->from[1] >= 0.0 && anim->to[1] >= 0.0) {
-                        y[0] = anim->from[1] - yCoord(r, metaData(SourceAnchor, anim->meta));
-                        y[1] = anim->to[1] - yCoord(r, metaData(TargetAnchor, anim->meta));
-                    }
+            r = w->expandedGeometry().toRect();
+            rects << r.translated(x[0], y[0]) << r.translated(x[1], y[1]);
+            break;
+        }
+        case Clip:
+            createRegion = true;
+            break;
+        case Size:
+        case Scale: {
+            createRegion = true;
+            const QSize sz = w->frameGeometry().size().toSize();
+            float fx = qMax(fixOvershoot(anim->from[0], *anim, 1), fixOvershoot(anim->to[0], *anim, 2));
+            //                     float fx = qMax(interpolated(*anim,0), anim->to[0]);
+            if (fx >= 0.0) {
+                if (anim->attribute == Size) {
+                    fx /= sz.width();
                 }
-                r = entry.key()->expandedGeometry().toRect();
-                rects << r.translated(x[0], y[0]) << r.translated(x[1], y[1]);
-                break;
+                f[0] *= fx;
+                t[0] += geometryCompensation(anim->meta & AnimationEffect::Horizontal, fx) * sz.width();
             }
-            case Clip:
-                createRegion = true;
-                break;
-            case Size:
-            case Scale: {
-                createRegion = true;
-                const QSize sz = entry.key()->frameGeometry().size().toSize();
-                float fx = qMax(fixOvershoot(anim->from[0], *anim, 1), fixOvershoot(anim->to[0], *anim, 2));
-                //                     float fx = qMax(interpolated(*anim,0), anim->to[0]);
-                if (fx >= 0.0) {
-                    if (anim->attribute == Size) {
-                        fx /= sz.width();
-                    }
-                    f[0] *= fx;
-                    t[0] += geometryCompensation(anim->meta & AnimationEffect::Horizontal, fx) * sz.width();
+            //                     float fy = qMax(interpolated(*anim,1), anim->to[1]);
+            float fy = qMax(fixOvershoot(anim->from[1], *anim, 1), fixOvershoot(anim->to[1], *anim, 2));
+            if (fy >= 0.0) {
+                if (anim->attribute == Size) {
+                    fy /= sz.height();
                 }
-                //                     float fy = qMax(interpolated(*anim,1), anim->to[1]);
-                float fy = qMax(fixOvershoot(anim->from[1], *anim, 1), fixOvershoot(anim->to[1], *anim, 2));
-                if (fy >= 0.0) {
-                    if (anim->attribute == Size) {
-                        fy /= sz.height();
-                    }
-                    if (!anim->isOneDimensional()) {
-                        f[1] *= fy;
-                        t[1] += geometryCompensation(anim->meta & AnimationEffect::Vertical, fy) * sz.height();
-                    } else if (((anim->meta & AnimationEffect::Vertical) >> 1) != (anim->meta & AnimationEffect::Horizontal)) {
-                        f[1] *= fx;
-                        t[1] += geometryCompensation(anim->meta & AnimationEffect::Vertical, fx) * sz.height();
-                    }
+                if (!anim->isOneDimensional()) {
+                    f[1] *= fy;
+                    t[1] += geometryCompensation(anim->meta & AnimationEffect::Vertical, fy) * sz.height();
+                } else if (((anim->meta & AnimationEffect::Vertical) >> 1) != (anim->meta & AnimationEffect::Horizontal)) {
+                    f[1] *= fx;
+                    t[1] += geometryCompensation(anim->meta & AnimationEffect::Vertical, fx) * sz.height();
                 }
-                break;
-            }
             }
+            break;
         }
-    region_creation:
-        if (createRegion) {
-            const QRect geo = entry.key()->expandedGeometry().toRect();
-            if (rects.isEmpty()) {
-                rects << geo;
-            }
-            QList<QRect>::const_iterator r, rEnd = rects.constEnd();
-            for (r = rects.constBegin(); r != rEnd; ++r) { // transform
-                const_cast<QRect *>(&(*r))->setSize(QSize(qRound(r->width() * f[0]), qRound(r->height() * f[1])));
-                const_cast<QRect *>(&(*r))->translate(t[0], t[1]); // "const_cast" - don't do that at home, kids ;-)
-            }
-            QRect rect = rects.at(0);
-            if (rects.count() > 1) {
-                for (r = rects.constBegin() + 1; r != rEnd; ++r) { // unite
-                    rect |= *r;
-                }
-                const int dx = 110 * (rect.width() - geo.width()) / 100 + 1 - rect.width() + geo.width();
-                const int dy = 110 * (rect.height() - geo.height()) / 100 + 1 - rect.height() + geo.height();
-                rect.adjust(-dx, -dy, dx, dy); // fix pot. overshoot
+        }
+    }
+    if (createRegion) {
+        const QRect geo = w->expandedGeometry().toRect();
+        if (rects.isEmpty()) {
+            rects << geo;
+        }
+        QList<QRect>::const_iterator r, rEnd = rects.constEnd();
+        for (r = rects.constBegin(); r != rEnd; ++r) { // transform
+            const_cast<QRect *>(&(*r))->setSize(QSize(qRound(r->width() * f[0]), qRound(r->height() * f[1])));
+            const_cast<QRect *>(&(*r))->translate(t[0], t[1]); // "const_cast" - don't do that at home, kids ;-)
+        }
+        QRect rect = rects.at(0);
+        if (rects.count() > 1) {
+            for (r = rects.constBegin() + 1; r != rEnd; ++r) { // unite
+                rect |= *r;
             }
-            *layerRect = rect;
+            const int dx = 110 * (rect.width() - geo.width()) / 100 + 1 - rect.width() + geo.width();
+            const int dy = 110 * (rect.height() - geo.height()) / 100 + 1 - rect.height() + geo.height();
+            rect.adjust(-dx, -dy, dx, dy); // fix pot. overshoot
+        }
+        *layerRect = rect;
+    }
+    return true;
+}
+
+void AnimationEffect::updateLayerRepaints()
+{
+    Q_D(AnimationEffect);
+    d->m_needSceneRepaint = false;
+    // Only the windows whose layer rect has been invalidated need to be looked at.
+    for (auto entry = d->m_animatedWindows.begin(); entry != d->m_animatedWindows.end(); ++entry) {
+        if (!entry->layerRect.isNull()) {
+            continue;
+        }
+        if (!computeLayerRect(entry.key(), entry->slots, &entry->layerRect)) {
+            d->m_needSceneRepaint = true;
+            return; // sic! no need to do anything else
         }
     }
 }
@@ -961,12 +1044,12 @@ void AnimationEffect::updateLayerRepaints()
 void AnimationEffect::_windowExpandedGeometryChanged(KWin::EffectWindow *w)
 {
     Q_D(AnimationEffect);
-    AniMap::const_iterator entry = d->m_animations.constFind(w);
-    if (entry != d->m_animations.constEnd()) {
-        *const_cast<QRect *>(&(entry->second)) = QRect();
+    auto entry = d->m_animatedWindows.find(w);
+    if (entry != d->m_animatedWindows.end()) {
+        entry->layerRect = QRect();
         updateLayerRepaints();
-        if (!entry->second.isNull()) { // actually got updated, ie. is in use - ensure it get's a repaint
-            w->addLayerRepaint(entry->second);
+        if (!entry->layerRect.isNull()) { // actually got updated, ie. is in use - ensure it get's a repaint
+            w->addLayerRepaint(entry->layerRect);
         }
     }
 }
@@ -975,15 +1058,15 @@ void AnimationEffect::_windowClosed(EffectWindow *w)
 {
     Q_D(AnimationEffect);
 
-    auto it = d->m_animations.find(w);
-    if (it == d->m_animations.end()) {
+    auto it = d->m_animatedWindows.constFind(w);
+    if (it == d->m_animatedWindows.constEnd()) {
         return;
     }
 
-    QList<AniData> &animations = (*it).first;
-    for (auto animationIt = animations.begin(); animationIt != animations.end(); ++animationIt) {
-        if (animationIt->keepAlive) {
-            animationIt->deletedRef = EffectWindowDeletedRef(w);
+    for (int slot : it->slots) {
+        AniData &animation = d->m_data[slot];
+        if (animation.keepAlive) {
+            animation.deletedRef = EffectWindowDeletedRef(w);
         }
     }
 }
@@ -991,26 +1074,39 @@ void AnimationEffect::_windowClosed(EffectWindow *w)
 void AnimationEffect::_windowDeleted(EffectWindow *w)
 {
     Q_D(AnimationEffect);
-    d->m_animations.remove(w);
+
+    auto it = d->m_animatedWindows.constFind(w);
+    if (it == d->m_animatedWindows.constEnd()) {
+        return;
+    }
+
+    // Removing an animation moves another one into its slot, so go through the ids.
+    QVarLengthArray<quint64, 8> ids;
+    for (int slot : it->slots) {
+        ids.append(d->m_data[slot].id);
+    }
+    for (quint64 id : std::as_const(ids)) {
+        d->remove(d->slotOf(id));
+    }
+    d->m_animatedWindows.remove(w);
+    effects->setWindowPassesEnabled(this, w, false);
 }
 
 QString AnimationEffect::debug(const QString & /*parameter*/) const
 {
     Q_D(const AnimationEffect);
     QString dbg;
-    if (d->m_animations.isEmpty()) {
+    if (d->m_animatedWindows.isEmpty()) {
         dbg = QStringLiteral("No window is animated");
     } else {
-        AniMap::const_iterator entry = d->m_animations.constBegin(), mapEnd = d->m_animations.constEnd();
-        for (; entry != mapEnd; ++entry) {
+        for (auto entry = d->m_animatedWindows.constBegin(); entry != d->m_animatedWindows.constEnd(); ++entry) {
             QString caption = entry.key()->isDeleted() ? QStringLiteral("[Deleted]") : entry.key()->caption();
             if (caption.isEmpty()) {
                 caption = QStringLiteral("[Untitled]");
             }
             dbg += QLatin1String("Animating window: ") + caption + QLatin1Char('\n');
-            QList<AniData>::const_iterator anim = entry->first.constBegin(), animEnd = entry->first.constEnd();
-            for (; anim != animEnd; ++anim) {
-                dbg += anim->debugInfo();
+            for (int slot : entry->slots) {
+                dbg += d->m_data[slot].debugInfo();
             }
         }
     }
@@ -1020,7 +1116,16 @@ QString AnimationEffect::debug(const QString & /*parameter*/) const
 AnimationEffect::AniMap AnimationEffect::state() const
 {
     Q_D(const AnimationEffect);
-    return d->m_animations;
+    AniMap animations;
+    for (auto entry = d->m_animatedWindows.constBegin(); entry != d->m_animatedWindows.constEnd(); ++entry) {
+        QList<AniData> windowAnimations;
+        windowAnimations.reserve(entry->slots.size());
+        for (int slot : entry->slots) {
+            windowAnimations.append(d->m_data[slot]);
+        }
+        animations.insert(entry.key(), qMakePair(windowAnimations, entry->layerRect));
+    }
+    return animations;
 }
 
 } // namespace KWin
@@ -189,6 +189,10 @@ class AnimationEffectPrivate;
  * You can provide your own implementation of the Generic attribute if none of the
  * standard attributes(e.g. size, position, etc) satisfy your requirements.
  *
+ * Subclasses that only paint the windows they animate can restrict their window passes
+ * with EffectsHandler::setWindowPassesRestricted(). AnimationEffect enables the windows
+ * for as long as they are animated.
+ *
  * @since 4.8
  */
 class KWINEFFECTS_EXPORT AnimationEffect : public OffscreenEffect
@@ -519,11 +523,12 @@ protected:
 
 private:
     quint64 p_animate(EffectWindow *w, Attribute a, uint meta, int ms, FPx2 to, const QEasingCurve &curve, int delay, FPx2 from, bool keepAtTarget, bool fullScreenEffect, bool keepAlive, GLShader *shader);
-    QRect clipRect(const QRect &windowRect, const AniData &) const;
-    float interpolated(const AniData &, int i = 0) const;
-    float progress(const AniData &) const;
+    QRect clipRect(const QRect &windowRect, int slot) const;
+    float interpolated(int slot, int i = 0) const;
+    float progress(int slot) const;
     void disconnectGeometryChanges();
     void updateLayerRepaints();
+    bool computeLayerRect(EffectWindow *w, const QVector<int> &windowSlots, QRect *layerRect) const;
     void validate(Attribute a, uint &meta, FPx2 *from, FPx2 *to, const EffectWindow *w) const;
 
 private Q_SLOTS:
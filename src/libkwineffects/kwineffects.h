@@ -158,7 +158,7 @@ typedef QList<KWin::EffectWindow *> EffectWindowList;
 
 #define KWIN_EFFECT_API_MAKE_VERSION(major, minor) ((major) << 8 | (minor))
 #define KWIN_EFFECT_API_VERSION_MAJOR 0
-#define KWIN_EFFECT_API_VERSION_MINOR 235
+#define KWIN_EFFECT_API_VERSION_MINOR 239
 #define KWIN_EFFECT_API_VERSION KWIN_EFFECT_API_MAKE_VERSION( \
     KWIN_EFFECT_API_VERSION_MAJOR, KWIN_EFFECT_API_VERSION_MINOR)
 
@@ -829,6 +829,24 @@ public:
     virtual void paintWindow(EffectWindow *w, int mask, const QRegion &region, WindowPaintData &data) = 0;
     virtual void postPaintWindow(EffectWindow *w) = 0;
     virtual void drawWindow(EffectWindow *w, int mask, const QRegion &region, WindowPaintData &data) = 0;
+    /**
+     * Sets whether the window passes of the @a effect are restricted. The prePaintWindow(),
+     * paintWindow(), drawWindow() and postPaintWindow() methods of a restricted effect are
+     * only called for the windows that have been enabled with setWindowPassesEnabled().
+     *
+     * This is an optimization for effects that only affect a few windows, e.g. the ones
+     * being animated. The restriction lasts until it is lifted or the effect is destroyed.
+     * @see setWindowPassesEnabled
+     * @since 5.26
+     */
+    virtual void setWindowPassesRestricted(Effect *effect, bool restricted) = 0;
+    /**
+     * Sets whether the window passes of the restricted @a effect are called for the @a window.
+     * Deleted windows are dropped automatically.
+     * @see setWindowPassesRestricted
+     * @since 5.26
+     */
+    virtual void setWindowPassesEnabled(Effect *effect, EffectWindow *window, bool enabled) = 0;
     virtual QVariant kwinOption(KWinOption kwopt) = 0;
     /**
      * Sets the cursor while the mouse is intercepted.
@@ -1415,6 +1433,17 @@ public:
      */
     virtual qreal renderTargetScale() const = 0;
 
+    /**
+     * Returns the part of the current render target that is repainted for reasons other
+     * than window damage, e.g. because a window has been restacked or closed, or an effect
+     * has called addRepaint(). The region is in the global screen coordinates.
+     *
+     * Together with the damage of the windows, it tells whether the contents of the screen
+     * may have changed since the last frame.
+     * @since 5.26
+     */
+    virtual QRegion renderTargetRepaints() const = 0;
+
     /**
      * Maps the given @a rect from the global screen cordinates to the render
      * target local coordinate system.
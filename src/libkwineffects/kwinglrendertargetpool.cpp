@@ -0,0 +1,197 @@
+/*
+    KWin - the KDE window manager
+    This file is part of the KDE project.
+
+    SPDX-FileCopyrightText: 2022 KWin contributors
+
+    SPDX-License-Identifier: GPL-2.0-or-later
+*/
+
+#include "kwinglrendertargetpool.h"
+#include "kwingltexture.h"
+#include "kwinglutils.h"
+#include "logging_p.h"
+
+#include <algorithm>
+
+namespace KWin
+{
+
+// Pooled render targets are idle, so there's no point in keeping more than a handful
+// of window sized textures around.
+static const qint64 s_defaultBudget = 64 * 1024 * 1024;
+
+static qint64 bytesPerPixel(GLenum internalFormat)
+{
+    switch (internalFormat) {
+    case GL_RGBA16F:
+    case GL_RGBA16:
+        return 8;
+    case GL_R8:
+        return 1;
+    default:
+        return 4;
+    }
+}
+
+static int bucketDimension(int value)
+{
+    // Small textures are rounded up to 64 pixels, large ones to 1/8 of the next power of two.
+    const int granularity = std::max(64, int(qNextPowerOfTwo(quint32(value))) / 8);
+    return (value + granularity - 1) / granularity * granularity;
+}
+
+GLRenderTarget::GLRenderTarget() = default;
+GLRenderTarget::GLRenderTarget(GLRenderTarget &&other) = default;
+GLRenderTarget::~GLRenderTarget() = default;
+GLRenderTarget &GLRenderTarget::operator=(GLRenderTarget &&other) = default;
+
+GLRenderTargetPool *GLRenderTargetPool::s_instance = nullptr;
+
+GLRenderTargetPool *GLRenderTargetPool::instance()
+{
+    if (!s_instance) {
+        s_instance = new GLRenderTargetPool();
+    }
+    return s_instance;
+}
+
+GLRenderTargetPool *GLRenderTargetPool::existingInstance()
+{
+    return s_instance;
+}
+
+void GLRenderTargetPool::cleanup()
+{
+    if (s_instance) {
+        const Statistics statistics = s_instance->statistics();
+        qCDebug(LIBKWINGLUTILS) << "Render target pool: hits" << statistics.hits << "misses" << statistics.misses
+                                << "evictions" << statistics.evictions << "rejections" << statistics.rejections;
+    }
+    delete s_instance;
+    s_instance = nullptr;
+}
+
+GLRenderTargetPool::GLRenderTargetPool()
+    : m_budget(s_defaultBudget)
+{
+    glGetIntegerv(GL_MAX_TEXTURE_SIZE, &m_maxTextureSize);
+}
+
+GLRenderTargetPool::~GLRenderTargetPool() = default;
+
+GLRenderTarget GLRenderTargetPool::acquire(const QSize &size, GLenum internalFormat)
+{
+    GLRenderTarget target;
+
+    auto it = std::find_if(m_entries.begin(), m_entries.end(), [&size, internalFormat](const Entry &entry) {
+        return entry.internalFormat == internalFormat && entry.target.texture->size() == size;
+    });
+    if (it != m_entries.end()) {
+        target = std::move(it->target);
+        m_statistics.pooledBytes -= it->bytes;
+        m_statistics.pooledCount--;
+        m_statistics.hits++;
+        m_entries.erase(it);
+    } else {
+        m_statistics.misses++;
+        if (!GLFramebuffer::supported() || size.isEmpty()) {
+            return target;
+        }
+        target = allocate(size, internalFormat);
+        if (!target.isValid() && !m_entries.empty()) {
+            // Video memory may be exhausted, give the pooled render targets back and retry.
+            trim();
+            target = allocate(size, internalFormat);
+        }
+        if (!target.isValid()) {
+            return target;
+        }
+    }
+
+    target.texture->setFilter(GL_LINEAR);
+    target.texture->setWrapMode(GL_CLAMP_TO_EDGE);
+    return target;
+}
+
+GLRenderTarget GLRenderTargetPool::allocate(const QSize &size, GLenum internalFormat)
+{
+    GLRenderTarget target;
+    target.texture.reset(new GLTexture(internalFormat, size));
+    target.framebuffer.reset(new GLFramebuffer(target.texture.get()));
+    if (!target.framebuffer->valid()) {
+        return GLRenderTarget();
+    }
+    return target;
+}
+
+void GLRenderTargetPool::release(GLRenderTarget &&target)
+{
+    if (!target.isValid()) {
+        return;
+    }
+
+    const QSize size = target.texture->size();
+    const GLenum internalFormat = target.texture->internalFormat();
+    const qint64 bytes = qint64(size.width()) * size.height() * bytesPerPixel(internalFormat);
+    if (bytes > m_budget) {
+        // The caller gave up the render target, destroy it rather than leaving it behind.
+        const GLRenderTarget rejected = std::move(target);
+        m_statistics.rejections++;
+        return;
+    }
+
+    m_entries.push_front(Entry{std::move(target), internalFormat, bytes, std::chrono::steady_clock::now()});
+    m_statistics.pooledBytes += bytes;
+    m_statistics.pooledCount++;
+    trim(m_budget);
+}
+
+void GLRenderTargetPool::trim(qint64 bytes)
+{
+    while (m_statistics.pooledBytes > bytes && !m_entries.empty()) {
+        m_statistics.pooledBytes -= m_entries.back().bytes;
+        m_statistics.pooledCount--;
+        m_statistics.evictions++;
+        m_entries.pop_back();
+    }
+}
+
+void GLRenderTargetPool::trimUnused(std::chrono::milliseconds age)
+{
+    // The entries are sorted by release time, the oldest one is at the back.
+    const auto deadline = std::chrono::steady_clock::now() - age;
+    while (!m_entries.empty() && m_entries.back().releaseTime <= deadline) {
+        m_statistics.pooledBytes -= m_entries.back().bytes;
+        m_statistics.pooledCount--;
+        m_statistics.evictions++;
+        m_entries.pop_back();
+    }
+}
+
+qint64 GLRenderTargetPool::budget() const
+{
+    return m_budget;
+}
+
+void GLRenderTargetPool::setBudget(qint64 bytes)
+{
+    m_budget = bytes;
+    trim(m_budget);
+}
+
+GLRenderTargetPool::Statistics GLRenderTargetPool::statistics() const
+{
+    return m_statistics;
+}
+
+QSize GLRenderTargetPool::bucketSize(const QSize &size) const
+{
+    const QSize bucket(bucketDimension(size.width()), bucketDimension(size.height()));
+    if (m_maxTextureSize > 0) {
+        return bucket.boundedTo(QSize(m_maxTextureSize, m_maxTextureSize)).expandedTo(size);
+    }
+    return bucket;
+}
+
+} // namespace KWin
@@ -0,0 +1,193 @@
+/*
+    KWin - the KDE window manager
+    This file is part of the KDE project.
+
+    SPDX-FileCopyrightText: 2022 KWin contributors
+
+    SPDX-License-Identifier: GPL-2.0-or-later
+*/
+
+#pragma once
+
+#include <kwinglutils_export.h>
+
+#include <QSize>
+
+#include <epoxy/gl.h>
+
+#include <chrono>
+#include <list>
+#include <memory>
+
+/** @addtogroup kwineffects */
+/** @{ */
+
+namespace KWin
+{
+
+class GLFramebuffer;
+class GLTexture;
+
+void KWINGLUTILS_EXPORT cleanupGL();
+
+/**
+ * The GLRenderTarget struct bundles an offscreen texture with the framebuffer object
+ * that renders into it.
+ *
+ * @since 5.26
+ */
+struct KWINGLUTILS_EXPORT GLRenderTarget
+{
+    GLRenderTarget();
+    GLRenderTarget(GLRenderTarget &&other);
+    ~GLRenderTarget();
+
+    GLRenderTarget &operator=(GLRenderTarget &&other);
+
+    bool isValid() const
+    {
+        return texture && framebuffer;
+    }
+
+    std::unique_ptr<GLTexture> texture;
+    std::unique_ptr<GLFramebuffer> framebuffer;
+};
+
+/**
+ * The GLRenderTargetPool class recycles offscreen textures and framebuffer objects.
+ *
+ * Effects that paint windows offscreen used to allocate a new texture and a new framebuffer
+ * object every time the size of a window changes, which is expensive while a window is being
+ * resized or animated. Render targets that are released to the pool are kept around and handed
+ * out again when a render target with the same size and format is requested.
+ *
+ * The pool doesn't hold more than budget() bytes, the least recently released render targets
+ * are destroyed first. The compositor periodically destroys the render targets that haven't
+ * been used for a while with trimUnused(), so they don't pin video memory when nothing
+ * animates. Callers that can paint into a part of a larger texture should round the requested
+ * size up with bucketSize(), which makes reuse far more likely.
+ *
+ * @since 5.26
+ */
+class KWINGLUTILS_EXPORT GLRenderTargetPool
+{
+public:
+    struct Statistics
+    {
+        /**
+         * The number of acquire() calls that were satisfied with a pooled render target.
+         */
+        quint64 hits = 0;
+        /**
+         * The number of acquire() calls that had to allocate a new render target.
+         */
+        quint64 misses = 0;
+        /**
+         * The number of pooled render targets that were destroyed to stay within the budget
+         * or because the pool was trimmed.
+         */
+        quint64 evictions = 0;
+        /**
+         * The number of released render targets that were destroyed right away because they
+         * are larger than the budget.
+         */
+        quint64 rejections = 0;
+        /**
+         * The number of render targets currently held by the pool.
+         */
+        int pooledCount = 0;
+        /**
+         * The estimated amount of video memory used by the pooled render targets, in bytes.
+         */
+        qint64 pooledBytes = 0;
+    };
+
+    /**
+     * Returns the render target pool, creating it if needed. There is one pool per process,
+     * it must only be used while the OpenGL context of the compositor is current.
+     */
+    static GLRenderTargetPool *instance();
+
+    /**
+     * Returns the render target pool, or @c nullptr if it has not been created yet or has
+     * already been destroyed by cleanupGL(). Unlike instance(), this never creates the pool.
+     */
+    static GLRenderTargetPool *existingInstance();
+
+    /**
+     * Returns a render target with a texture of the specified @a size and @a internalFormat.
+     * The texture uses linear filtering and clamps to the edge, its contents are undefined.
+     *
+     * If allocating a new render target fails, e.g. because video memory is scarce, the pool
+     * is emptied and the allocation is tried once more.
+     *
+     * The returned render target is invalid if framebuffer objects are not supported.
+     */
+    GLRenderTarget acquire(const QSize &size, GLenum internalFormat = GL_RGBA8);
+
+    /**
+     * Returns the @a target to the pool. The render target must not be used afterwards.
+     */
+    void release(GLRenderTarget &&target);
+
+    /**
+     * Destroys the least recently released render targets until the pool holds no more
+     * than @a bytes bytes, e.g. when video memory is scarce. The OpenGL context must be current.
+     */
+    void trim(qint64 bytes = 0);
+
+    /**
+     * Destroys the render targets that have been in the pool for longer than @a age.
+     * The OpenGL context must be current.
+     */
+    void trimUnused(std::chrono::milliseconds age);
+
+    /**
+     * Returns the maximum amount of memory that can be held by the pool, in bytes.
+     */
+    qint64 budget() const;
+
+    /**
+     * Sets the maximum amount of memory that can be held by the pool to @a bytes.
+     */
+    void setBudget(qint64 bytes);
+
+    /**
+     * Returns the number of hits, misses, evictions and rejections since the pool has been created.
+     */
+    Statistics statistics() const;
+
+    /**
+     * Returns the smallest bucket size that can fit @a size. Every dimension is rounded up
+     * to a granularity that grows with the dimension, so the wasted area stays small.
+     */
+    QSize bucketSize(const QSize &size) const;
+
+private:
+    GLRenderTargetPool();
+    ~GLRenderTargetPool();
+
+    struct Entry
+    {
+        GLRenderTarget target;
+        GLenum internalFormat;
+        qint64 bytes;
+        std::chrono::steady_clock::time_point releaseTime;
+    };
+
+    friend void KWin::cleanupGL();
+    static void cleanup();
+
+    GLRenderTarget allocate(const QSize &size, GLenum internalFormat);
+
+    std::list<Entry> m_entries;
+    Statistics m_statistics;
+    qint64 m_budget;
+    int m_maxTextureSize = 0;
+
+    static GLRenderTargetPool *s_instance;
+};
+
+} // namespace KWin
+
+/** @} */
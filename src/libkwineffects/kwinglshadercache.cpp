@@ -0,0 +1,211 @@
+/*
+    KWin - the KDE window manager
+    This file is part of the KDE project.
+
+    SPDX-FileCopyrightText: 2022 KWin contributors
+
+    SPDX-License-Identifier: GPL-2.0-or-later
+*/
+
+#include "kwinglshadercache_p.h"
+#include "kwinglplatform.h"
+#include "kwinglutils.h"
+#include "logging_p.h"
+
+#include <QCryptographicHash>
+#include <QDir>
+#include <QFile>
+#include <QSaveFile>
+#include <QStandardPaths>
+#include <QThreadPool>
+
+#include <algorithm>
+#include <cstring>
+
+namespace KWin
+{
+
+// The number of driver specific directories that are kept around, e.g. for multi-gpu setups.
+static const int s_maxDriverCount = 4;
+
+struct ProgramBinaryHeader
+{
+    char magic[4];
+    quint32 version;
+    quint32 format;
+    quint32 size;
+};
+
+static const char s_magic[4] = {'K', 'W', 'P', 'B'};
+static const quint32 s_version = 1;
+
+GLShaderCache *GLShaderCache::s_instance = nullptr;
+
+GLShaderCache::GLShaderCache(const QString &directory)
+    : m_directory(directory)
+{
+}
+
+void GLShaderCache::initStatic()
+{
+    if (qgetenv("KWIN_GL_PROGRAM_CACHE") == QByteArrayLiteral("0")) {
+        return;
+    }
+
+    const GLPlatform *platform = GLPlatform::instance();
+    bool supported;
+    if (platform->isGLES()) {
+        supported = hasGLVersion(3, 0);
+    } else {
+        supported = hasGLVersion(4, 1) || hasGLExtension(QByteArrayLiteral("GL_ARB_get_program_binary"));
+    }
+    if (!supported) {
+        return;
+    }
+
+    GLint formatCount = 0;
+    glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formatCount);
+    if (formatCount <= 0) {
+        return;
+    }
+
+    // Program binaries are only valid for the driver that produced them.
+    const QByteArray driver = platform->glVendorString() + '\n'
+        + platform->glRendererString() + '\n'
+        + platform->glVersionString() + '\n'
+        + platform->glShadingLanguageVersionString();
+    const QString driverHash = QString::fromLatin1(QCryptographicHash::hash(driver, QCryptographicHash::Sha1).toHex().left(16));
+
+    const QString root = QStandardPaths::writableLocation(QStandardPaths::GenericCacheLocation) + QStringLiteral("/kwin/glprograms");
+    const QString directory = root + QLatin1Char('/') + driverHash;
+    if (!QDir().mkpath(directory)) {
+        qCWarning(LIBKWINGLUTILS) << "Failed to create the GL program cache directory" << directory;
+        return;
+    }
+
+    // The stamp records when the driver has been used last, and what driver it is.
+    QFile stamp(directory + QStringLiteral("/stamp"));
+    if (stamp.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        stamp.write(driver);
+        stamp.close();
+    }
+    prune(root, driverHash);
+
+    s_instance = new GLShaderCache(directory);
+}
+
+void GLShaderCache::cleanup()
+{
+    delete s_instance;
+    s_instance = nullptr;
+}
+
+void GLShaderCache::prune(const QString &root, const QString &current)
+{
+    QFileInfoList stamps;
+    const QStringList directories = QDir(root).entryList(QDir::Dirs | QDir::NoDotAndDotDot);
+    for (const QString &directory : directories) {
+        if (directory != current) {
+            stamps.append(QFileInfo(root + QLatin1Char('/') + directory + QStringLiteral("/stamp")));
+        }
+    }
+    if (stamps.count() < s_maxDriverCount) {
+        return;
+    }
+
+    std::sort(stamps.begin(), stamps.end(), [](const QFileInfo &a, const QFileInfo &b) {
+        return a.lastModified() > b.lastModified();
+    });
+    for (int i = s_maxDriverCount - 1; i < stamps.count(); ++i) {
+        QDir(stamps[i].path()).removeRecursively();
+    }
+}
+
+QByteArray GLShaderCache::key(const QByteArray &vertexSource, const QByteArray &fragmentSource, const QByteArray &bindings) const
+{
+    QCryptographicHash hash(QCryptographicHash::Sha1);
+    hash.addData(vertexSource);
+    hash.addData("\0", 1);
+    hash.addData(fragmentSource);
+    hash.addData("\0", 1);
+    hash.addData(bindings);
+    return hash.result().toHex();
+}
+
+QString GLShaderCache::filePath(const QByteArray &key) const
+{
+    return m_directory + QLatin1Char('/') + QString::fromLatin1(key) + QStringLiteral(".bin");
+}
+
+bool GLShaderCache::load(GLuint program, const QByteArray &key)
+{
+    QFile file(filePath(key));
+    if (!file.open(QIODevice::ReadOnly)) {
+        return false;
+    }
+    const QByteArray contents = file.readAll();
+    file.close();
+
+    ProgramBinaryHeader header;
+    if (contents.size() < int(sizeof(header))) {
+        file.remove();
+        return false;
+    }
+    std::memcpy(&header, contents.constData(), sizeof(header));
+    if (std::memcmp(header.magic, s_magic, sizeof(s_magic)) || header.version != s_version
+        || header.size != contents.size() - sizeof(header)) {
+        file.remove();
+        return false;
+    }
+
+    glProgramBinary(program, header.format, contents.constData() + sizeof(header), header.size);
+
+    GLint status = GL_FALSE;
+    glGetProgramiv(program, GL_LINK_STATUS, &status);
+    if (status != GL_TRUE) {
+        // The driver may reject binaries, e.g. after an update that didn't change its version.
+        qCDebug(LIBKWINGLUTILS) << "Discarding rejected GL program binary" << file.fileName();
+        file.remove();
+        return false;
+    }
+    return true;
+}
+
+void GLShaderCache::store(GLuint program, const QByteArray &key)
+{
+    GLint length = 0;
+    glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+    if (length <= 0) {
+        return;
+    }
+
+    QByteArray contents(sizeof(ProgramBinaryHeader) + length, Qt::Uninitialized);
+    GLenum format = 0;
+    GLsizei written = 0;
+    glGetProgramBinary(program, length, &written, &format, contents.data() + sizeof(ProgramBinaryHeader));
+    if (written <= 0) {
+        return;
+    }
+
+    ProgramBinaryHeader header;
+    std::memcpy(header.magic, s_magic, sizeof(s_magic));
+    header.version = s_version;
+    header.format = format;
+    header.size = written;
+    std::memcpy(contents.data(), &header, sizeof(header));
+    contents.truncate(sizeof(header) + written);
+
+    // Only retrieving the binary needs the GL context, don't block the compositor on the disk.
+    QThreadPool::globalInstance()->start([fileName = filePath(key), contents]() {
+        QSaveFile file(fileName);
+        if (!file.open(QIODevice::WriteOnly)) {
+            return;
+        }
+        file.write(contents);
+        if (!file.commit()) {
+            qCWarning(LIBKWINGLUTILS) << "Failed to store GL program binary" << file.fileName() << file.errorString();
+        }
+    });
+}
+
+} // namespace KWin
@@ -0,0 +1,72 @@
+/*
+    KWin - the KDE window manager
+    This file is part of the KDE project.
+
+    SPDX-FileCopyrightText: 2022 KWin contributors
+
+    SPDX-License-Identifier: GPL-2.0-or-later
+*/
+
+#pragma once
+
+#include <QByteArray>
+#include <QString>
+#include <epoxy/gl.h>
+
+namespace KWin
+{
+
+/**
+ * The GLShaderCache class stores linked GL programs on disk, so shaders don't have to be
+ * compiled and linked again the next time kwin starts or the compositor is restarted.
+ *
+ * The programs are stored in a directory that is specific to the GL driver, every program
+ * is identified by the hash of its source code and attribute bindings. Programs rejected by
+ * the driver are removed, and the directories of drivers that haven't been used for a while
+ * are pruned.
+ *
+ * The cache can be disabled by setting the KWIN_GL_PROGRAM_CACHE environment variable to 0.
+ */
+class GLShaderCache
+{
+public:
+    /**
+     * Returns the program cache for the current GL context, or @c null if program binaries
+     * are not supported.
+     */
+    static GLShaderCache *instance()
+    {
+        return s_instance;
+    }
+
+    static void initStatic();
+    static void cleanup();
+
+    /**
+     * Returns the key that identifies a program with the specified sources and bindings.
+     */
+    QByteArray key(const QByteArray &vertexSource, const QByteArray &fragmentSource, const QByteArray &bindings) const;
+
+    /**
+     * Loads the cached binary with the specified @a key into the @a program. Returns
+     * @c true if the program has been loaded and linked successfully.
+     */
+    bool load(GLuint program, const QByteArray &key);
+
+    /**
+     * Stores the binary of the linked @a program under the specified @a key. The binary is
+     * written to the disk in a worker thread.
+     */
+    void store(GLuint program, const QByteArray &key);
+
+private:
+    explicit GLShaderCache(const QString &directory);
+    QString filePath(const QByteArray &key) const;
+    static void prune(const QString &directory, const QString &current);
+
+    QString m_directory;
+
+    static GLShaderCache *s_instance;
+};
+
+} // namespace KWin
@@ -16,6 +16,7 @@
 #include "kwinglutils_funcs.h"
 
 #include "kwingltexture_p.h"
+#include "logging_p.h"
 
 #include <QImage>
 #include <QPixmap>
@@ -23,6 +24,8 @@
 #include <QVector3D>
 #include <QVector4D>
 
+#include <cstring>
+
 namespace KWin
 {
 
@@ -38,6 +41,7 @@ bool GLTexturePrivate::s_supportsTextureSwizzle = false;
 bool GLTexturePrivate::s_supportsTextureFormatRG = false;
 bool GLTexturePrivate::s_supportsTexture16Bit = false;
 uint GLTexturePrivate::s_fbo = 0;
+GLPixelUploadBuffer *GLTexturePrivate::s_uploadBuffer = nullptr;
 
 // Table of GL formats/types associated with different values of QImage::Format.
 // Zero values indicate a direct upload is not feasible.
@@ -330,12 +334,59 @@ void GLTexturePrivate::initStatic()
 
         s_supportsUnpack = hasGLExtension(QByteArrayLiteral("GL_EXT_unpack_subimage"));
     }
+
+    bool havePixelBuffers;
+    bool haveBufferStorage;
+    bool haveSyncFences;
+    if (!GLPlatform::instance()->isGLES()) {
+        havePixelBuffers = hasGLVersion(2, 1) || hasGLExtension(QByteArrayLiteral("GL_ARB_pixel_buffer_object"));
+        haveBufferStorage = hasGLVersion(4, 4) || hasGLExtension(QByteArrayLiteral("GL_ARB_buffer_storage"));
+        haveSyncFences = hasGLVersion(3, 2) || hasGLExtension(QByteArrayLiteral("GL_ARB_sync"));
+    } else {
+        havePixelBuffers = hasGLVersion(3, 0);
+        haveBufferStorage = hasGLExtension(QByteArrayLiteral("GL_EXT_buffer_storage"));
+        haveSyncFences = hasGLVersion(3, 0);
+    }
+    if (havePixelBuffers && haveBufferStorage && haveSyncFences) {
+        if (qgetenv("KWIN_PERSISTENT_PBO") != QByteArrayLiteral("0")) {
+            s_uploadBuffer = new GLPixelUploadBuffer();
+        }
+    }
+}
+
+bool GLTexturePrivate::uploadFormat(QImage::Format format, GLenum *glFormat, GLenum *type, QImage::Format *uploadFormat)
+{
+    if (!GLPlatform::instance()->isGLES()) {
+        if (format < sizeof(formatTable) / sizeof(formatTable[0]) && formatTable[format].internalFormat
+            && !(formatTable[format].type == GL_UNSIGNED_SHORT && !s_supportsTexture16Bit)) {
+            *glFormat = formatTable[format].format;
+            *type = formatTable[format].type;
+            *uploadFormat = format;
+        } else {
+            *glFormat = GL_BGRA;
+            *type = GL_UNSIGNED_INT_8_8_8_8_REV;
+            *uploadFormat = QImage::Format_ARGB32_Premultiplied;
+        }
+    } else {
+        if (s_supportsARGB32) {
+            *glFormat = GL_BGRA_EXT;
+            *type = GL_UNSIGNED_BYTE;
+            *uploadFormat = QImage::Format_ARGB32_Premultiplied;
+        } else {
+            *glFormat = GL_RGBA;
+            *type = GL_UNSIGNED_BYTE;
+            *uploadFormat = QImage::Format_RGBA8888_Premultiplied;
+        }
+    }
+    return format == *uploadFormat;
 }
 
 void GLTexturePrivate::cleanup()
 {
     s_supportsFramebufferObjects = false;
     s_supportsARGB32 = false;
+    delete s_uploadBuffer;
+    s_uploadBuffer = nullptr;
     if (s_fbo) {
         glDeleteFramebuffers(1, &s_fbo);
         s_fbo = 0;
@@ -376,30 +427,8 @@ void GLTexture::update(const QImage &image, const QPoint &offset, const QRect &s
     GLenum glFormat;
     GLenum type;
     QImage::Format uploadFormat;
-    if (!GLPlatform::instance()->isGLES()) {
-        const QImage::Format index = image.format();
+    GLTexturePrivate::uploadFormat(image.format(), &glFormat, &type, &uploadFormat);
 
-        if (index < sizeof(formatTable) / sizeof(formatTable[0]) && formatTable[index].internalFormat
-            && !(formatTable[index].type == GL_UNSIGNED_SHORT && !d->s_supportsTexture16Bit)) {
-            glFormat = formatTable[index].format;
-            type = formatTable[index].type;
-            uploadFormat = index;
-        } else {
-            glFormat = GL_BGRA;
-            type = GL_UNSIGNED_INT_8_8_8_8_REV;
-            uploadFormat = QImage::Format_ARGB32_Premultiplied;
-        }
-    } else {
-        if (d->s_supportsARGB32) {
-            glFormat = GL_BGRA_EXT;
-            type = GL_UNSIGNED_BYTE;
-            uploadFormat = QImage::Format_ARGB32_Premultiplied;
-        } else {
-            glFormat = GL_RGBA;
-            type = GL_UNSIGNED_BYTE;
-            uploadFormat = QImage::Format_RGBA8888_Premultiplied;
-        }
-    }
     bool useUnpack = d->s_supportsUnpack && image.format() == uploadFormat && !src.isNull();
 
     QImage im;
@@ -440,6 +469,76 @@ void GLTexture::update(const QImage &image, const QPoint &offset, const QRect &s
     }
 }
 
+void GLTexture::update(const QImage &image, const QRegion &region)
+{
+    if (image.isNull() || isNull() || region.isEmpty()) {
+        return;
+    }
+
+    Q_D(GLTexture);
+    Q_ASSERT(!d->m_foreign);
+
+    GLenum glFormat;
+    GLenum type;
+    QImage::Format uploadFormat;
+    GLPixelUploadBuffer *uploadBuffer = GLTexturePrivate::s_uploadBuffer;
+    if (!uploadBuffer || !GLTexturePrivate::uploadFormat(image.format(), &glFormat, &type, &uploadFormat) || image.depth() % 8) {
+        for (const QRect &rect : region) {
+            update(image, rect.topLeft(), rect);
+        }
+        return;
+    }
+
+    const QRegion clipped = region & image.rect() & QRect(QPoint(0, 0), d->m_size);
+    if (clipped.isEmpty()) {
+        return;
+    }
+    const int bytesPerPixel = image.depth() / 8;
+    const auto alignedSize = [bytesPerPixel](const QRect &rect) {
+        return (size_t(rect.width()) * bytesPerPixel * rect.height() + 15) & ~size_t(15);
+    };
+
+    size_t size = 0;
+    for (const QRect &rect : clipped) {
+        size += alignedSize(rect);
+    }
+
+    intptr_t offset;
+    uint8_t *data = uploadBuffer->allocate(size, &offset);
+    if (!data) {
+        for (const QRect &rect : clipped) {
+            update(image, rect.topLeft(), rect);
+        }
+        return;
+    }
+
+    // Copy the pixels while the client buffer is accessible, the actual texture update
+    // is performed by the GPU from the pixel buffer at its own pace.
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, uploadBuffer->buffer());
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    bind();
+    for (const QRect &rect : clipped) {
+        const size_t rowSize = size_t(rect.width()) * bytesPerPixel;
+        const uchar *source = image.constScanLine(rect.y()) + rect.x() * bytesPerPixel;
+        uint8_t *destination = data;
+        for (int y = 0; y < rect.height(); ++y) {
+            std::memcpy(destination, source, rowSize);
+            source += image.bytesPerLine();
+            destination += rowSize;
+        }
+
+        glTexSubImage2D(d->m_target, 0, rect.x(), rect.y(), rect.width(), rect.height(), glFormat, type, reinterpret_cast<const GLvoid *>(offset));
+
+        data += alignedSize(rect);
+        offset += alignedSize(rect);
+    }
+    unbind();
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+
+    uploadBuffer->fence();
+}
+
 void GLTexture::discard()
 {
     d_ptr = new GLTexturePrivate();
@@ -739,4 +838,111 @@ QImage GLTexture::toImage() const
     return ret;
 }
 
+GLPixelUploadBuffer::~GLPixelUploadBuffer()
+{
+    for (const UploadFence &fence : m_fences) {
+        glDeleteSync(fence.sync);
+    }
+    if (m_buffer) {
+        glDeleteBuffers(1, &m_buffer);
+    }
+}
+
+uint8_t *GLPixelUploadBuffer::allocate(size_t size, intptr_t *offset)
+{
+    // Uploads that are bigger than this are rare enough to go through the slow path.
+    static const size_t maximumSize = 64 * 1024 * 1024;
+    if (size > m_size) {
+        if (size > maximumSize / 2 || !reallocate(std::min(std::max<size_t>(size * 2, 8 * 1024 * 1024), maximumSize))) {
+            return nullptr;
+        }
+    }
+
+    // Release the fences of the uploads that have already been completed.
+    while (!m_fences.empty()) {
+        GLint status;
+        glGetSynciv(m_fences.front().sync, GL_SYNC_STATUS, 1, nullptr, &status);
+        if (status != GL_SIGNALED) {
+            break;
+        }
+        m_consumed = m_fences.front().end;
+        glDeleteSync(m_fences.front().sync);
+        m_fences.pop_front();
+    }
+
+    // The ranges are never split at the end of the buffer, so skip to the beginning if needed.
+    quint64 position = (m_head + 15) & ~quint64(15);
+    if (position % m_size + size > m_size) {
+        position += m_size - position % m_size;
+    }
+    if (position + size > m_consumed + m_size && !awaitConsumed(position + size - m_size)) {
+        return nullptr;
+    }
+
+    m_head = position + size;
+    *offset = position % m_size;
+    return m_map + *offset;
+}
+
+void GLPixelUploadBuffer::fence()
+{
+    UploadFence fence;
+    fence.sync = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    fence.end = m_head;
+    m_fences.push_back(fence);
+}
+
+bool GLPixelUploadBuffer::awaitConsumed(quint64 position)
+{
+    while (m_consumed < position) {
+        if (m_fences.empty()) {
+            // All the uploads have been completed.
+            m_consumed = m_head;
+            return true;
+        }
+
+        const UploadFence &fence = m_fences.front();
+        const GLenum ret = glClientWaitSync(fence.sync, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000);
+        if (ret == GL_TIMEOUT_EXPIRED || ret == GL_WAIT_FAILED) {
+            qCCritical(LIBKWINGLUTILS) << "Waiting for a texture upload failed";
+            return false;
+        }
+
+        m_consumed = fence.end;
+        glDeleteSync(fence.sync);
+        m_fences.pop_front();
+    }
+    return true;
+}
+
+bool GLPixelUploadBuffer::reallocate(size_t size)
+{
+    if (!awaitConsumed(m_head)) {
+        return false;
+    }
+
+    if (m_buffer) {
+        glDeleteBuffers(1, &m_buffer);
+    }
+    glGenBuffers(1, &m_buffer);
+
+    const GLbitfield access = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, m_buffer);
+    glBufferStorage(GL_PIXEL_UNPACK_BUFFER, size, nullptr, access);
+    m_map = static_cast<uint8_t *>(glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, size, access));
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+
+    if (!m_map) {
+        glDeleteBuffers(1, &m_buffer);
+        m_buffer = 0;
+        m_size = 0;
+        return false;
+    }
+
+    m_size = size;
+    m_head = 0;
+    m_consumed = 0;
+    return true;
+}
+
 } // namespace KWin
@@ -99,6 +99,16 @@ public:
     QMatrix4x4 matrix(TextureCoordinateType type) const;
 
     void update(const QImage &image, const QPoint &offset = QPoint(0, 0), const QRect &src = QRect());
+    /**
+     * Uploads the specified @a region of the @a image to the same region of the texture.
+     *
+     * If persistent pixel buffers are supported, the pixels are staged in a pixel buffer and
+     * the texture is updated asynchronously, so the image can be released as soon as this
+     * function returns without waiting for the GPU.
+     *
+     * @since 5.26
+     */
+    void update(const QImage &image, const QRegion &region);
     virtual void discard();
     void bind();
     void unbind();
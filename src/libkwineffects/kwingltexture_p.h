@@ -22,11 +22,60 @@
 #include <QSize>
 #include <epoxy/gl.h>
 
+#include <deque>
+
 namespace KWin
 {
 // forward declarations
 class GLVertexBuffer;
 
+/**
+ * The GLPixelUploadBuffer class is a persistently mapped pixel unpack buffer that is used
+ * to stream texture uploads. The pixel data is copied into the buffer and the textures are
+ * updated from it asynchronously, so the GPU copy overlaps with the rendering instead of
+ * blocking the caller. The buffer is used as a ring, fences guard the ranges that are still
+ * being read by the GPU.
+ */
+class GLPixelUploadBuffer
+{
+public:
+    ~GLPixelUploadBuffer();
+
+    GLuint buffer() const
+    {
+        return m_buffer;
+    }
+
+    /**
+     * Returns a pointer to a range of @a size bytes that is not used by the GPU anymore and
+     * stores its offset in the buffer in @a offset. Returns @c nullptr if no such range can
+     * be provided, in which case the caller should fall back to a synchronous upload.
+     */
+    uint8_t *allocate(size_t size, intptr_t *offset);
+
+    /**
+     * Inserts a fence after the upload commands that read the allocated ranges.
+     */
+    void fence();
+
+private:
+    struct UploadFence
+    {
+        GLsync sync;
+        quint64 end;
+    };
+
+    bool reallocate(size_t size);
+    bool awaitConsumed(quint64 position);
+
+    GLuint m_buffer = 0;
+    uint8_t *m_map = nullptr;
+    size_t m_size = 0;
+    quint64 m_head = 0;
+    quint64 m_consumed = 0;
+    std::deque<UploadFence> m_fences;
+};
+
 class KWINGLUTILS_EXPORT GLTexturePrivate
     : public QSharedData
 {
@@ -61,6 +110,7 @@ public:
     QSize m_cachedSize;
 
     static void initStatic();
+    static bool uploadFormat(QImage::Format format, GLenum *glFormat, GLenum *type, QImage::Format *uploadFormat);
 
     static bool s_supportsFramebufferObjects;
     static bool s_supportsARGB32;
@@ -70,6 +120,7 @@ public:
     static bool s_supportsTextureFormatRG;
     static bool s_supportsTexture16Bit;
     static GLuint s_fbo;
+    static GLPixelUploadBuffer *s_uploadBuffer;
 
 private:
     friend void KWin::cleanupGL();
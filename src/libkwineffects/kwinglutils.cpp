@@ -15,6 +15,8 @@
 
 #include "kwineffects.h"
 #include "kwinglplatform.h"
+#include "kwinglrendertargetpool.h"
+#include "kwinglshadercache_p.h"
 #include "logging_p.h"
 
 #include <QFile>
@@ -154,11 +156,14 @@ void initGL(const std::function<resolveFuncPtr(const char *)> &resolveFunction)
     GLTexturePrivate::initStatic();
     GLFramebuffer::initStatic();
     GLVertexBuffer::initStatic();
+    GLShaderCache::initStatic();
 }
 
 void cleanupGL()
 {
     ShaderManager::cleanup();
+    GLShaderCache::cleanup();
+    GLRenderTargetPool::cleanup();
     GLTexturePrivate::cleanup();
     GLFramebuffer::cleanup();
     GLVertexBuffer::cleanup();
@@ -228,6 +233,24 @@ bool checkGLError(const char *txt)
 // GLShader
 //****************************************
 
+// The sources of a shader whose compilation is deferred until the program is linked, along with
+// the attribute and fragment data locations that have been bound, which are part of the shader
+// cache key. It only exists while the shader cache is in use and the program is not linked yet.
+struct GLShaderDeferredState
+{
+    QByteArray vertexSource;
+    QByteArray fragmentSource;
+    QByteArray bindings;
+};
+
+static GLShaderDeferredState *deferredState(std::unique_ptr<GLShaderDeferredState> &state)
+{
+    if (!state) {
+        state = std::make_unique<GLShaderDeferredState>();
+    }
+    return state.get();
+}
+
 GLShader::GLShader(unsigned int flags)
     : mValid(false)
     , mLocationsResolved(false)
@@ -273,6 +296,22 @@ bool GLShader::loadFromFiles(const QString &vertexFile, const QString &fragmentF
 
 bool GLShader::link()
 {
+    GLShaderCache *cache = GLShaderCache::instance();
+    QByteArray cacheKey;
+    const std::unique_ptr<GLShaderDeferredState> deferred = std::move(mDeferred);
+    if (cache && deferred && (!deferred->vertexSource.isEmpty() || !deferred->fragmentSource.isEmpty())) {
+        cacheKey = cache->key(deferred->vertexSource, deferred->fragmentSource, deferred->bindings);
+        if (cache->load(mProgram, cacheKey)) {
+            mValid = true;
+            return true;
+        }
+        if (!compile(deferred->vertexSource, deferred->fragmentSource)) {
+            mValid = false;
+            return false;
+        }
+        glProgramParameteri(mProgram, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+    }
+
     // Be optimistic
     mValid = true;
 
@@ -298,6 +337,10 @@ bool GLShader::link()
         qCDebug(LIBKWINGLUTILS) << "Shader link log:" << log;
     }
 
+    if (mValid && !cacheKey.isEmpty()) {
+        cache->store(mProgram, cacheKey);
+    }
+
     return mValid;
 }
 
@@ -368,6 +411,26 @@ bool GLShader::load(const QByteArray &vertexSource, const QByteArray &fragmentSo
 
     mValid = false;
 
+    if (GLShaderCache::instance()) {
+        // Compiling is deferred until the program is linked, so it can be skipped if
+        // the program binary has been cached.
+        GLShaderDeferredState *deferred = deferredState(mDeferred);
+        deferred->vertexSource = vertexSource;
+        deferred->fragmentSource = fragmentSource;
+    } else if (!compile(vertexSource, fragmentSource)) {
+        return false;
+    }
+
+    if (mExplicitLinking) {
+        return true;
+    }
+
+    // link() sets mValid
+    return link();
+}
+
+bool GLShader::compile(const QByteArray &vertexSource, const QByteArray &fragmentSource)
+{
     // Compile the vertex shader
     if (!vertexSource.isEmpty()) {
         bool success = compile(mProgram, GL_VERTEX_SHADER, vertexSource);
@@ -386,23 +449,24 @@ bool GLShader::load(const QByteArray &vertexSource, const QByteArray &fragmentSo
         }
     }
 
-    if (mExplicitLinking) {
-        return true;
-    }
-
-    // link() sets mValid
-    return link();
+    return true;
 }
 
 void GLShader::bindAttributeLocation(const char *name, int index)
 {
     glBindAttribLocation(mProgram, index, name);
+    if (GLShaderCache::instance()) {
+        deferredState(mDeferred)->bindings += "attribute " + QByteArray(name) + '=' + QByteArray::number(index) + '\n';
+    }
 }
 
 void GLShader::bindFragDataLocation(const char *name, int index)
 {
     if (!GLPlatform::instance()->isGLES() && (hasGLVersion(3, 0) || hasGLExtension(QByteArrayLiteral("GL_EXT_gpu_shader4")))) {
         glBindFragDataLocation(mProgram, index, name);
+        if (GLShaderCache::instance()) {
+            deferredState(mDeferred)->bindings += "fragdata " + QByteArray(name) + '=' + QByteArray::number(index) + '\n';
+        }
     }
 }
 
@@ -1960,6 +2024,30 @@ void GLVertexBuffer::unmap()
     d->mappedSize = 0;
 }
 
+void GLVertexBuffer::setSubData(size_t offset, const void *data, size_t size)
+{
+    Q_ASSERT(!d->persistent);
+
+    // A new data store doesn't keep the contents of the old one and copying between buffer
+    // objects is not available everywhere, so a copy of the data is kept in local memory.
+    const size_t end = offset + size;
+    if (size_t(d->dataStore.size()) < end) {
+        d->dataStore.resize(end);
+    }
+    memcpy(d->dataStore.data() + offset, data, size);
+
+    glBindBuffer(GL_ARRAY_BUFFER, d->buffer);
+    if (end > d->bufferSize) {
+        d->bufferSize = qMax(end, d->bufferSize * 2);
+        glBufferData(GL_ARRAY_BUFFER, d->bufferSize, nullptr, d->usage);
+        glBufferSubData(GL_ARRAY_BUFFER, 0, d->dataStore.size(), d->dataStore.constData());
+    } else {
+        glBufferSubData(GL_ARRAY_BUFFER, offset, size, data);
+    }
+
+    d->baseAddress = 0;
+}
+
 void GLVertexBuffer::setVertexCount(int count)
 {
     d->vertexCount = count;
@@ -20,6 +20,8 @@
 #include <QSize>
 #include <QStack>
 
+#include <memory>
+
 /** @addtogroup kwineffects */
 /** @{ */
 
@@ -36,6 +38,7 @@ namespace KWin
 
 class GLVertexBuffer;
 class GLVertexBufferPrivate;
+struct GLShaderDeferredState;
 
 // Initializes OpenGL stuff. This includes resolving function pointers as
 //  well as checking for GL version and extensions
@@ -152,6 +155,7 @@ protected:
     bool load(const QByteArray &vertexSource, const QByteArray &fragmentSource);
     const QByteArray prepareSource(GLenum shaderType, const QByteArray &sourceCode) const;
     bool compile(GLuint program, GLenum shaderType, const QByteArray &sourceCode) const;
+    bool compile(const QByteArray &vertexSource, const QByteArray &fragmentSource);
     void bind();
     void unbind();
     void resolveLocations();
@@ -167,6 +171,7 @@ private:
     int mFloatLocation[FloatUniformCount];
     int mIntLocation[IntUniformCount];
     int mColorLocation[ColorUniformCount];
+    std::unique_ptr<GLShaderDeferredState> mDeferred;
 
     friend class ShaderManager;
 };
@@ -609,6 +614,18 @@ public:
      */
     void unmap();
 
+    /**
+     * Uploads @a size bytes of @a data at the given @a offset in the data store and leaves
+     * the rest of the data store untouched. The data store grows if it is too small and keeps
+     * its contents. Unlike map(), this doesn't move the base address of the vertex arrays, so
+     * one buffer can hold many ranges of vertices that are updated and drawn independently.
+     *
+     * This must not be used together with map() on the same buffer.
+     *
+     * @since 5.26
+     */
+    void setSubData(size_t offset, const void *data, size_t size);
+
     /**
      * Binds the vertex arrays to the context.
      */
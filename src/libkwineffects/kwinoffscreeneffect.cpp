@@ -5,6 +5,7 @@
 */
 
 #include "kwinoffscreeneffect.h"
+#include "kwinglrendertargetpool.h"
 #include "kwingltexture.h"
 #include "kwinglutils.h"
 
@@ -13,12 +14,23 @@ namespace KWin
 
 struct OffscreenData
 {
-    std::unique_ptr<GLTexture> texture;
-    std::unique_ptr<GLFramebuffer> fbo;
+    ~OffscreenData();
+
+    GLRenderTarget target;
+    QSize contentSize;
     bool isDirty = true;
     GLShader *shader = nullptr;
 };
 
+OffscreenData::~OffscreenData()
+{
+    // The effect may outlive the pool, e.g. when compositing is being torn down, don't
+    // bring the pool back to life just to hand it a render target.
+    if (GLRenderTargetPool *pool = GLRenderTargetPool::existingInstance()) {
+        pool->release(std::move(target));
+    }
+}
+
 class OffscreenEffectPrivate
 {
 public:
@@ -26,7 +38,7 @@ public:
     QMetaObject::Connection windowDamagedConnection;
     QMetaObject::Connection windowDeletedConnection;
 
-    void paint(EffectWindow *window, GLTexture *texture, const QRegion &region,
+    void paint(EffectWindow *window, GLTexture *texture, const QSize &contentSize, const QRegion &region,
                const WindowPaintData &data, const WindowQuadList &quads, GLShader *offscreenShader);
 
     GLTexture *maybeRender(EffectWindow *window, OffscreenData *offscreenData);
@@ -89,6 +101,29 @@ void OffscreenEffect::apply(EffectWindow *window, int mask, WindowPaintData &dat
     Q_UNUSED(quads)
 }
 
+// Copies the rightmost column and the bottom row of the window into the padding of a bucket
+// sized render target, otherwise linear filtering would blend the edge of the window with the
+// cleared texels next to it whenever the texture is scaled. The window occupies the top-left
+// corner of the texture, which is at the top of the framebuffer in OpenGL coordinates.
+static void padEdges(const QSize &contentSize, const QSize &targetSize)
+{
+    const int top = targetSize.height();
+    const int bottom = targetSize.height() - contentSize.height();
+    const int right = contentSize.width();
+
+    if (right < targetSize.width()) {
+        glBlitFramebuffer(right - 1, bottom, right, top,
+                          right, bottom, right + 1, top,
+                          GL_COLOR_BUFFER_BIT, GL_NEAREST);
+    }
+    if (bottom > 0) {
+        const int paddedRight = std::min(right + 1, targetSize.width());
+        glBlitFramebuffer(0, bottom, paddedRight, bottom + 1,
+                          0, bottom - 1, paddedRight, bottom,
+                          GL_COLOR_BUFFER_BIT, GL_NEAREST);
+    }
+}
+
 GLTexture *OffscreenEffectPrivate::maybeRender(EffectWindow *window, OffscreenData *offscreenData)
 {
     const QRect geometry = window->expandedGeometry().toAlignedRect();
@@ -98,21 +133,37 @@ GLTexture *OffscreenEffectPrivate::maybeRender(EffectWindow *window, OffscreenDa
         textureSize *= screen->devicePixelRatio();
     }
 
-    if (!offscreenData->texture || offscreenData->texture->size() != textureSize) {
-        offscreenData->texture.reset(new GLTexture(GL_RGBA8, textureSize));
-        offscreenData->texture->setFilter(GL_LINEAR);
-        offscreenData->texture->setWrapMode(GL_CLAMP_TO_EDGE);
-        offscreenData->fbo.reset(new GLFramebuffer(offscreenData->texture.get()));
+    // The window is painted in the top-left corner of a bucket sized texture so the render
+    // target can be reused while the window is being resized. Custom shaders may rely on the
+    // texture coordinates spanning the whole texture, so they get a texture of the exact size.
+    // So does everyone if the edge of the window can't be replicated into the padding.
+    GLRenderTargetPool *pool = GLRenderTargetPool::instance();
+    const bool exactSize = offscreenData->shader || !GLFramebuffer::blitSupported();
+    const QSize targetSize = exactSize ? textureSize : pool->bucketSize(textureSize);
+
+    if (!offscreenData->target.isValid() || offscreenData->target.texture->size() != targetSize) {
+        pool->release(std::move(offscreenData->target));
+        offscreenData->target = pool->acquire(targetSize);
+        offscreenData->isDirty = true;
+    }
+    if (offscreenData->contentSize != textureSize) {
+        offscreenData->contentSize = textureSize;
         offscreenData->isDirty = true;
     }
+    if (!offscreenData->target.isValid()) {
+        return nullptr;
+    }
 
     if (offscreenData->isDirty) {
-        GLFramebuffer::pushFramebuffer(offscreenData->fbo.get());
+        GLFramebuffer::pushFramebuffer(offscreenData->target.framebuffer.get());
         glClearColor(0.0, 0.0, 0.0, 0.0);
         glClear(GL_COLOR_BUFFER_BIT);
 
+        const qreal scaleX = qreal(geometry.width()) / textureSize.width();
+        const qreal scaleY = qreal(geometry.height()) / textureSize.height();
+
         QMatrix4x4 projectionMatrix;
-        projectionMatrix.ortho(QRect(0, 0, geometry.width(), geometry.height()));
+        projectionMatrix.ortho(QRectF(0, 0, targetSize.width() * scaleX, targetSize.height() * scaleY));
 
         WindowPaintData data;
         data.setXTranslation(-geometry.x());
@@ -122,15 +173,18 @@ GLTexture *OffscreenEffectPrivate::maybeRender(EffectWindow *window, OffscreenDa
 
         const int mask = Effect::PAINT_WINDOW_TRANSFORMED | Effect::PAINT_WINDOW_TRANSLUCENT;
         effects->drawWindow(window, mask, infiniteRegion(), data);
+        if (targetSize != textureSize) {
+            padEdges(textureSize, targetSize);
+        }
 
         GLFramebuffer::popFramebuffer();
         offscreenData->isDirty = false;
     }
 
-    return offscreenData->texture.get();
+    return offscreenData->target.texture.get();
 }
 
-void OffscreenEffectPrivate::paint(EffectWindow *window, GLTexture *texture, const QRegion &region,
+void OffscreenEffectPrivate::paint(EffectWindow *window, GLTexture *texture, const QSize &contentSize, const QRegion &region,
                                 const WindowPaintData &data, const WindowQuadList &quads, GLShader *offscreenShader)
 {
     GLShader *shader = offscreenShader ? offscreenShader : ShaderManager::instance()->shader(ShaderTrait::MapTexture | ShaderTrait::Modulate | ShaderTrait::AdjustSaturation);
@@ -151,7 +205,11 @@ void OffscreenEffectPrivate::paint(EffectWindow *window, GLTexture *texture, con
     const size_t size = verticesPerQuad * quads.count() * sizeof(GLVertex2D);
     GLVertex2D *map = static_cast<GLVertex2D *>(vbo->map(size));
 
-    quads.makeInterleavedArrays(primitiveType, map, texture->matrix(NormalizedCoordinates));
+    // The window occupies only the top-left corner of the texture if it's bucket sized.
+    QMatrix4x4 textureMatrix = texture->matrix(NormalizedCoordinates);
+    textureMatrix.scale(qreal(contentSize.width()) / texture->width(), qreal(contentSize.height()) / texture->height());
+
+    quads.makeInterleavedArrays(primitiveType, map, textureMatrix);
     vbo->unmap();
     vbo->bindArrays();
 
@@ -212,7 +270,11 @@ void OffscreenEffect::drawWindow(EffectWindow *window, int mask, const QRegion &
     apply(window, mask, data, quads);
 
     GLTexture *texture = d->maybeRender(window, offscreenData);
-    d->paint(window, texture, region, data, quads, offscreenData->shader);
+    if (!texture) {
+        effects->drawWindow(window, mask, region, data);
+        return;
+    }
+    d->paint(window, texture, offscreenData->contentSize, region, data, quads, offscreenData->shader);
 }
 
 void OffscreenEffect::handleWindowDamaged(EffectWindow *window)
@@ -22,10 +22,16 @@
 #include <QQuickView>
 #include <QStyleHints>
 
+#include <QMutex>
 #include <QOffscreenSurface>
 #include <QOpenGLContext>
 #include <QOpenGLFramebufferObject>
+#include <QThread>
 #include <QTimer>
+
+#include <array>
+#include <vector>
+
 #if QT_VERSION >= QT_VERSION_CHECK(6, 0, 0)
 #include <QQuickOpenGLUtils>
 #include <QQuickRenderTarget>
@@ -64,6 +70,299 @@ private:
     QPointer<QWindow> m_renderWindow;
 };
 
+/**
+ * The OffscreenQuickRenderer class renders the scene graph of an OffscreenQuickView in a
+ * dedicated thread, so a slow QtQuick frame doesn't stall the compositor.
+ *
+ * The frames are rendered into a ring of three framebuffers. The compositor samples the most
+ * recent complete frame while the next one is being rendered into another framebuffer. Access
+ * to the textures is synchronized with fences, so neither thread waits for the other one.
+ *
+ * A framebuffer is never destroyed while the compositor may still be sampling it. When the view
+ * is resized, only the spare framebuffer is replaced, the compositor keeps showing the last frame
+ * until a frame with the new size is ready. Framebuffers that are replaced or released are kept
+ * around until the compositor's release fence has signaled.
+ */
+class OffscreenQuickRenderer : public QObject
+{
+    Q_OBJECT
+
+public:
+    struct Frame
+    {
+        int index = -1;
+        quint64 generation = 0;
+        GLuint texture = 0;
+        GLenum internalFormat = 0;
+        QSize size;
+    };
+
+    OffscreenQuickRenderer(QQuickWindow *view, QQuickRenderControl *renderControl, QOpenGLContext *context, QOffscreenSurface *surface);
+
+    // Called in the render thread.
+    void initialize();
+    void sync(const QSize &size);
+    void render();
+    void releaseResources();
+    void cleanup(QThread *mainThread);
+
+    // Called in the compositor thread, with the compositor's OpenGL context current.
+    Frame acquire();
+    void release();
+
+Q_SIGNALS:
+    void frameRendered();
+
+private:
+    struct Buffer
+    {
+        std::unique_ptr<QOpenGLFramebufferObject> fbo;
+        quint64 generation = 0;
+        GLsync renderFence = nullptr; // signaled once the frame has been rendered
+        GLsync releaseFence = nullptr; // signaled once the compositor is done sampling the frame
+    };
+
+    struct RetiredBuffer
+    {
+        std::unique_ptr<QOpenGLFramebufferObject> fbo;
+        GLsync releaseFence = nullptr;
+    };
+
+    void retireBuffer(Buffer *buffer);
+    void collectRetiredBuffers(bool wait);
+
+    QQuickWindow *m_view;
+    QQuickRenderControl *m_renderControl;
+    QOpenGLContext *m_context;
+    QOffscreenSurface *m_surface;
+
+    QMutex m_mutex; // guards the buffers
+    std::array<Buffer, 3> m_buffers;
+    Buffer *m_back = nullptr;
+    Buffer *m_published = nullptr;
+    Buffer *m_acquired = nullptr;
+    quint64 m_generation = 0;
+
+    std::vector<RetiredBuffer> m_retired; // only accessed in the render thread
+};
+
+OffscreenQuickRenderer::OffscreenQuickRenderer(QQuickWindow *view, QQuickRenderControl *renderControl, QOpenGLContext *context, QOffscreenSurface *surface)
+    : m_view(view)
+    , m_renderControl(renderControl)
+    , m_context(context)
+    , m_surface(surface)
+{
+}
+
+void OffscreenQuickRenderer::initialize()
+{
+    m_context->makeCurrent(m_surface);
+    m_renderControl->initialize(m_context);
+    m_context->doneCurrent();
+}
+
+void OffscreenQuickRenderer::retireBuffer(Buffer *buffer)
+{
+    if (buffer->renderFence) {
+        // A frame that has never been shown.
+        glDeleteSync(buffer->renderFence);
+        buffer->renderFence = nullptr;
+    }
+    if (buffer->releaseFence) {
+        // The compositor may not be done sampling the texture yet.
+        m_retired.push_back(RetiredBuffer{std::move(buffer->fbo), buffer->releaseFence});
+        buffer->releaseFence = nullptr;
+    } else {
+        buffer->fbo.reset();
+    }
+}
+
+void OffscreenQuickRenderer::collectRetiredBuffers(bool wait)
+{
+    // If asked to wait, give up after a second rather than hang, the compositor is long done
+    // with the frame by then unless the GPU is stuck anyway.
+    const GLuint64 timeout = wait ? 1000000000 : 0;
+
+    auto it = m_retired.begin();
+    while (it != m_retired.end()) {
+        const GLenum status = glClientWaitSync(it->releaseFence, 0, timeout);
+        if (status == GL_TIMEOUT_EXPIRED && !wait) {
+            ++it;
+            continue;
+        }
+        glDeleteSync(it->releaseFence);
+        it = m_retired.erase(it);
+    }
+}
+
+void OffscreenQuickRenderer::sync(const QSize &size)
+{
+    // The compositor thread is blocked while the scene graph is synchronized.
+    if (!m_context->makeCurrent(m_surface)) {
+        // probably a context loss event, kwin is about to reset all the effects anyway
+        return;
+    }
+
+    collectRetiredBuffers(false);
+
+    QMutexLocker locker(&m_mutex);
+
+    // With three buffers, there is always one that is neither shown nor about to be shown.
+    m_back = nullptr;
+    for (Buffer &buffer : m_buffers) {
+        if (&buffer != m_published && &buffer != m_acquired) {
+            m_back = &buffer;
+            break;
+        }
+    }
+    if (m_back->fbo && m_back->fbo->size() != size) {
+        // The view has been resized. The frames of the old size stay around, so the compositor
+        // has something to show until the first frame of the new size is ready.
+        retireBuffer(m_back);
+    }
+    if (!m_back->fbo) {
+        m_back->fbo.reset(new QOpenGLFramebufferObject(size, QOpenGLFramebufferObject::CombinedDepthStencil));
+        m_back->generation = ++m_generation;
+        if (!m_back->fbo->isValid()) {
+            m_back->fbo.reset();
+            m_back = nullptr;
+            locker.unlock();
+            m_context->doneCurrent();
+            return;
+        }
+    }
+    if (m_back->renderFence) {
+        // A frame that has never been shown.
+        glDeleteSync(m_back->renderFence);
+        m_back->renderFence = nullptr;
+    }
+    if (m_back->releaseFence) {
+        // Reusing the framebuffer is fine as long as the GPU doesn't render into it before the
+        // compositor is done sampling it.
+        glWaitSync(m_back->releaseFence, 0, GL_TIMEOUT_IGNORED);
+        glDeleteSync(m_back->releaseFence);
+        m_back->releaseFence = nullptr;
+    }
+    locker.unlock();
+
+#if QT_VERSION < QT_VERSION_CHECK(6, 0, 0)
+    m_view->setRenderTarget(m_back->fbo.get());
+#else
+    m_view->setRenderTarget(QQuickRenderTarget::fromOpenGLTexture(m_back->fbo->texture(), m_back->fbo->size()));
+#endif
+    m_renderControl->sync();
+}
+
+void OffscreenQuickRenderer::render()
+{
+    if (!m_back) {
+        Q_EMIT frameRendered();
+        return;
+    }
+
+    m_renderControl->render();
+#if QT_VERSION < QT_VERSION_CHECK(6, 0, 0)
+    m_view->resetOpenGLState();
+#else
+    QQuickOpenGLUtils::resetOpenGLState();
+#endif
+    QOpenGLFramebufferObject::bindDefault();
+
+    GLsync fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    // The fence has to be flushed, otherwise the compositor may wait for it forever.
+    glFlush();
+
+    {
+        QMutexLocker locker(&m_mutex);
+        if (m_published && m_published != m_acquired && m_published->renderFence) {
+            // The previous frame has been superseded before the compositor got to show it.
+            glDeleteSync(m_published->renderFence);
+            m_published->renderFence = nullptr;
+        }
+        m_back->renderFence = fence;
+        m_published = m_back;
+        m_back = nullptr;
+    }
+
+    m_context->doneCurrent();
+    Q_EMIT frameRendered();
+}
+
+void OffscreenQuickRenderer::releaseResources()
+{
+    if (!m_context->makeCurrent(m_surface)) {
+        return;
+    }
+    {
+        QMutexLocker locker(&m_mutex);
+        m_published = nullptr;
+        for (Buffer &buffer : m_buffers) {
+            // The frame is still being shown if the compositor didn't hand it back with release().
+            if (&buffer != m_acquired) {
+                retireBuffer(&buffer);
+            }
+        }
+    }
+    // This doesn't block the compositor, the render thread has nothing else to do.
+    collectRetiredBuffers(true);
+    m_context->doneCurrent();
+}
+
+void OffscreenQuickRenderer::cleanup(QThread *mainThread)
+{
+    m_context->makeCurrent(m_surface);
+    for (Buffer &buffer : m_buffers) {
+        retireBuffer(&buffer);
+    }
+    collectRetiredBuffers(true);
+    m_renderControl->invalidate();
+    m_context->doneCurrent();
+
+    // The view is torn down in the main thread.
+    m_context->moveToThread(mainThread);
+}
+
+OffscreenQuickRenderer::Frame OffscreenQuickRenderer::acquire()
+{
+    QMutexLocker locker(&m_mutex);
+    if (m_published && m_published != m_acquired) {
+        if (m_acquired) {
+            m_acquired->releaseFence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+            glFlush();
+        }
+        m_acquired = m_published;
+        if (m_acquired->renderFence) {
+            // Let the GPU, not the CPU, wait until the frame has been rendered.
+            glWaitSync(m_acquired->renderFence, 0, GL_TIMEOUT_IGNORED);
+            glDeleteSync(m_acquired->renderFence);
+            m_acquired->renderFence = nullptr;
+        }
+    }
+
+    Frame frame;
+    if (m_acquired) {
+        frame.index = m_acquired - m_buffers.data();
+        frame.generation = m_acquired->generation;
+        frame.texture = m_acquired->fbo->texture();
+        frame.internalFormat = m_acquired->fbo->format().internalTextureFormat();
+        frame.size = m_acquired->fbo->size();
+    }
+    return frame;
+}
+
+void OffscreenQuickRenderer::release()
+{
+    QMutexLocker locker(&m_mutex);
+    if (m_acquired) {
+        m_acquired->releaseFence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+        glFlush();
+        if (m_published == m_acquired) {
+            m_published = nullptr;
+        }
+        m_acquired = nullptr;
+    }
+}
+
 class Q_DECL_HIDDEN OffscreenQuickView::Private
 {
 public:
@@ -82,6 +381,14 @@ public:
     bool m_visible = true;
     bool m_automaticRepaint = true;
 
+    // Used if the scene graph is rendered in a dedicated thread.
+    std::unique_ptr<QThread> m_renderThread;
+    std::unique_ptr<OffscreenQuickRenderer> m_renderer;
+    std::array<std::unique_ptr<GLTexture>, 3> m_frameTextures;
+    std::array<quint64, 3> m_frameGenerations = {};
+    bool m_frameInFlight = false;
+    bool m_updatePending = false;
+
 #if QT_VERSION < QT_VERSION_CHECK(6, 0, 0)
     QList<QTouchEvent::TouchPoint> touchPoints;
     Qt::TouchPointStates touchState;
@@ -95,6 +402,8 @@ public:
     Qt::MouseButton lastMousePressButton = Qt::NoButton;
 
     void releaseResources();
+    void updateThreaded();
+    GLTexture *threadedBufferAsTexture();
 
     void updateTouchState(Qt::TouchPointState state, qint32 id, const QPointF &pos);
 };
@@ -164,16 +473,39 @@ OffscreenQuickView::OffscreenQuickView(QObject *parent, QWindow *renderWindow, E
         d->m_offscreenSurface->setFormat(d->m_glcontext->format());
         d->m_offscreenSurface->create();
 
-        d->m_glcontext->makeCurrent(d->m_offscreenSurface.get());
-        d->m_renderControl->initialize(d->m_glcontext.get());
-        d->m_glcontext->doneCurrent();
-
         // On Wayland, contexts are implicitly shared and QOpenGLContext::globalShareContext() is null.
         if (shareContext && !d->m_glcontext->shareContext()) {
             qCDebug(LIBKWINEFFECTS) << "Failed to create a shared context, falling back to raster rendering";
             // still render via GL, but blit for presentation
             d->m_useBlit = true;
         }
+
+        // The render thread needs to share textures with the compositor.
+        static const bool threadedRendering = qEnvironmentVariableIntValue("KWIN_OFFSCREENQUICKVIEW_THREADED") == 1;
+        if (threadedRendering && !d->m_useBlit) {
+            d->m_renderThread.reset(new QThread);
+            d->m_renderThread->setObjectName(QStringLiteral("OffscreenQuickView"));
+            d->m_renderer.reset(new OffscreenQuickRenderer(d->m_view, d->m_renderControl, d->m_glcontext.get(), d->m_offscreenSurface.get()));
+
+            d->m_renderControl->prepareThread(d->m_renderThread.get());
+            d->m_glcontext->moveToThread(d->m_renderThread.get());
+            d->m_renderer->moveToThread(d->m_renderThread.get());
+            d->m_renderThread->start();
+
+            QMetaObject::invokeMethod(d->m_renderer.get(), &OffscreenQuickRenderer::initialize, Qt::BlockingQueuedConnection);
+            connect(d->m_renderer.get(), &OffscreenQuickRenderer::frameRendered, this, [this]() {
+                d->m_frameInFlight = false;
+                Q_EMIT repaintNeeded();
+                if (d->m_updatePending) {
+                    d->m_updatePending = false;
+                    update();
+                }
+            });
+        } else {
+            d->m_glcontext->makeCurrent(d->m_offscreenSurface.get());
+            d->m_renderControl->initialize(d->m_glcontext.get());
+            d->m_glcontext->doneCurrent();
+        }
     }
 
     auto updateSize = [this]() {
@@ -203,6 +535,21 @@ OffscreenQuickView::OffscreenQuickView(QObject *parent, QWindow *renderWindow, E
 
 OffscreenQuickView::~OffscreenQuickView()
 {
+    if (d->m_renderThread) {
+        if (effects && effects->makeOpenGLContextCurrent()) {
+            d->m_renderer->release();
+        }
+        QThread *mainThread = thread();
+        QMetaObject::invokeMethod(
+            d->m_renderer.get(), [this, mainThread]() {
+                d->m_renderer->cleanup(mainThread);
+            },
+            Qt::BlockingQueuedConnection);
+        d->m_renderThread->quit();
+        d->m_renderThread->wait();
+        d->m_renderer.reset();
+    }
+
     if (d->m_glcontext) {
         // close the view whilst we have an active GL context
         d->m_glcontext->makeCurrent(d->m_offscreenSurface.get());
@@ -256,6 +603,10 @@ void OffscreenQuickView::update()
     if (d->m_view->size().isEmpty()) {
         return;
     }
+    if (d->m_renderThread) {
+        d->updateThreaded();
+        return;
+    }
 
     bool usingGl = d->m_glcontext != nullptr;
 
@@ -471,6 +822,9 @@ void OffscreenQuickView::hide()
 
 GLTexture *OffscreenQuickView::bufferAsTexture()
 {
+    if (d->m_renderThread) {
+        return d->threadedBufferAsTexture();
+    }
     if (d->m_useBlit) {
         if (d->m_image.isNull()) {
             return nullptr;
@@ -504,8 +858,58 @@ void OffscreenQuickView::setGeometry(const QRect &rect)
     Q_EMIT geometryChanged(oldGeometry, rect);
 }
 
+bool OffscreenQuickView::isThreaded() const
+{
+    return d->m_renderThread != nullptr;
+}
+
+void OffscreenQuickView::Private::updateThreaded()
+{
+    // Never wait for the render thread, the compositor keeps showing the last complete frame
+    // until the one in flight is done.
+    if (m_frameInFlight) {
+        m_updatePending = true;
+        return;
+    }
+
+    m_renderControl->polishItems();
+
+    const QSize nativeSize = m_view->size() * m_view->effectiveDevicePixelRatio();
+    m_frameInFlight = true;
+    QMetaObject::invokeMethod(
+        m_renderer.get(), [this, nativeSize]() {
+            m_renderer->sync(nativeSize);
+        },
+        Qt::BlockingQueuedConnection);
+    QMetaObject::invokeMethod(m_renderer.get(), &OffscreenQuickRenderer::render, Qt::QueuedConnection);
+}
+
+GLTexture *OffscreenQuickView::Private::threadedBufferAsTexture()
+{
+    const OffscreenQuickRenderer::Frame frame = m_renderer->acquire();
+    if (frame.index == -1) {
+        return nullptr;
+    }
+    std::unique_ptr<GLTexture> &texture = m_frameTextures[frame.index];
+    if (!texture || m_frameGenerations[frame.index] != frame.generation) {
+        texture.reset(new GLTexture(frame.texture, frame.internalFormat, frame.size));
+        m_frameGenerations[frame.index] = frame.generation;
+    }
+    return texture.get();
+}
+
 void OffscreenQuickView::Private::releaseResources()
 {
+    if (m_renderThread) {
+        // Hand the shown frame back first, the render thread must not destroy it while the
+        // compositor may still be sampling it.
+        if (effects && effects->makeOpenGLContextCurrent()) {
+            m_renderer->release();
+        }
+        QMetaObject::invokeMethod(m_renderer.get(), &OffscreenQuickRenderer::releaseResources, Qt::QueuedConnection);
+        m_view->releaseResources();
+        return;
+    }
     if (m_glcontext) {
         m_glcontext->makeCurrent(m_offscreenSurface.get());
         m_view->releaseResources();
@@ -126,6 +126,19 @@ public:
     bool automaticRepaint() const;
     void setAutomaticRepaint(bool set);
 
+    /**
+     * Returns @c true if the scene graph is rendered in a dedicated thread.
+     *
+     * Threaded rendering is enabled with the KWIN_OFFSCREENQUICKVIEW_THREADED environment
+     * variable. It's only available if the contents are exported as a texture and the OpenGL
+     * context of the view can be shared with the compositor. In that case, update() only
+     * polishes and synchronizes the scene graph, the frame is rendered asynchronously and
+     * repaintNeeded() is emitted once it can be shown.
+     *
+     * @since 5.26
+     */
+    bool isThreaded() const;
+
     /**
      * Returns the current output of the scene graph
      * @note The render context must valid at the time of calling
@@ -209,6 +209,14 @@ void ApplicationWayland::refreshSettings(const KConfigGroup &group, const QByteA
     if (group.name() == "Wayland" && names.contains("EnablePrimarySelection")) {
         waylandServer()->setEnablePrimarySelection(group.readEntry("EnablePrimarySelection", true));
     }
+
+    if (group.name() == "Wayland" && (names.contains("SlowClientPolicy") || names.contains("SlowClientThreshold") || names.contains("SlowClientTimeout"))) {
+        waylandServer()->updateSlowClientPolicy(group);
+    }
+
+    if (group.name() == "Wayland" && names.contains("HiddenFrameCallbackRate")) {
+        waylandServer()->updateFrameCallbackThrottling(group);
+    }
 }
 
 void ApplicationWayland::startSession()
@@ -60,6 +60,9 @@ enum RenderTimeEstimator {
     RenderTimeEstimatorMinimum,
     RenderTimeEstimatorMaximum,
     RenderTimeEstimatorAverage,
+    RenderTimeEstimatorMedian,
+    RenderTimeEstimatorPercentile90,
+    RenderTimeEstimatorPercentile99,
 };
 
 class Settings;
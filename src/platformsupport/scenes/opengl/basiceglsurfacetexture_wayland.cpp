@@ -96,10 +96,9 @@ void BasicEGLSurfaceTextureWayland::updateShmTexture(KWaylandServer::ShmClientBu
         return;
     }
 
-    const QRegion damage = mapRegion(m_pixmap->item()->surfaceToBufferMatrix(), region);
-    for (const QRect &rect : damage) {
-        m_texture->update(image, rect.topLeft(), rect);
-    }
+    // The pixels are staged in a pixel buffer when possible, so the shm buffer is released
+    // as soon as they're copied rather than after the driver has uploaded them.
+    m_texture->update(image, mapRegion(m_pixmap->item()->surfaceToBufferMatrix(), region));
 }
 
 bool BasicEGLSurfaceTextureWayland::loadEglTexture(KWaylandServer::DrmClientBuffer *buffer)
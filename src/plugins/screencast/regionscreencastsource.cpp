@@ -104,11 +104,13 @@ void RegionScreenCastSource::render(GLFramebuffer *target)
 
 void RegionScreenCastSource::render(QImage *image)
 {
-    GLTexture offscreenTexture(hasAlphaChannel() ? GL_RGBA8 : GL_RGB8, textureSize());
-    GLFramebuffer offscreenTarget(&offscreenTexture);
+    if (!m_offscreenTexture) {
+        m_offscreenTexture.reset(new GLTexture(hasAlphaChannel() ? GL_RGBA8 : GL_RGB8, textureSize()));
+        m_offscreenTarget.reset(new GLFramebuffer(m_offscreenTexture.get()));
+    }
 
-    render(&offscreenTarget);
-    grabTexture(&offscreenTexture, image);
+    render(m_offscreenTarget.get());
+    grabTexture(m_offscreenTexture.get(), image);
 }
 
 }
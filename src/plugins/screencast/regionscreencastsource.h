@@ -41,6 +41,8 @@ private:
     const qreal m_scale;
     std::unique_ptr<GLFramebuffer> m_target;
     std::unique_ptr<GLTexture> m_renderedTexture;
+    std::unique_ptr<GLTexture> m_offscreenTexture;
+    std::unique_ptr<GLFramebuffer> m_offscreenTarget;
     std::chrono::nanoseconds m_last;
 };
 
@@ -171,7 +171,7 @@ void ScreencastManager::streamRegion(KWaylandServer::ScreencastStreamV1Interface
                     const QRect streamRegion = source->region();
                     const QRegion region = output->pixelSize() != output->modeSize() ? output->geometry() : damagedRegion;
                     source->updateOutput(output);
-                    stream->recordFrame(region.translated(-streamRegion.topLeft()).intersected(streamRegion));
+                    stream->recordFrame(region.intersected(streamRegion).translated(-streamRegion.topLeft()));
                 };
                 connect(output, &Output::outputChange, stream, bufferToStream);
             }
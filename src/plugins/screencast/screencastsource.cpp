@@ -14,4 +14,10 @@ ScreenCastSource::ScreenCastSource(QObject *parent)
 {
 }
 
+std::optional<uint64_t> ScreenCastSource::preferredModifier(uint32_t drmFormat) const
+{
+    Q_UNUSED(drmFormat)
+    return std::nullopt;
+}
+
 } // namespace KWin
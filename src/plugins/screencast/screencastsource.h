@@ -8,6 +8,8 @@
 
 #include <QObject>
 
+#include <optional>
+
 namespace KWin
 {
 
@@ -26,6 +28,11 @@ public:
     virtual void render(GLFramebuffer *target) = 0;
     virtual void render(QImage *image) = 0;
     virtual std::chrono::nanoseconds clock() const = 0;
+    /**
+     * Returns the modifier that the dmabufs of the stream should have in the given @a drmFormat
+     * so that the source can copy its contents into them without converting the memory layout.
+     */
+    virtual std::optional<uint64_t> preferredModifier(uint32_t drmFormat) const;
 
 Q_SIGNALS:
     void closed();
@@ -30,6 +30,7 @@
 
 #include <spa/buffer/meta.h>
 
+#include <algorithm>
 #include <fcntl.h>
 #include <sys/mman.h>
 #include <unistd.h>
@@ -157,10 +158,20 @@ void ScreenCastStream::onStreamParamChanged(void *data, uint32_t id, const struc
         receivedModifiers = QVector<uint64_t>(modifiers, modifiers + modifiersCount);
     }
     if (modifierProperty && (!pw->m_dmabufParams || !receivedModifiers.contains(pw->m_dmabufParams->modifier))) {
+        const uint32_t drmFormat = spaVideoFormatToDrmFormat(pw->videoFormat.format);
         if (modifierProperty->flags & SPA_POD_PROP_FLAG_DONT_FIXATE) {
-            pw->m_dmabufParams = kwinApp()->platform()->testCreateDmaBuf(pw->m_resolution, spaVideoFormatToDrmFormat(pw->videoFormat.format), receivedModifiers);
+            // Prefer the modifier of the source so that it can be copied without a layout conversion.
+            const std::optional<uint64_t> preferredModifier = pw->m_source->preferredModifier(drmFormat);
+            if (preferredModifier && receivedModifiers.contains(*preferredModifier)) {
+                pw->m_dmabufParams = kwinApp()->platform()->testCreateDmaBuf(pw->m_resolution, drmFormat, {*preferredModifier});
+            } else {
+                pw->m_dmabufParams.reset();
+            }
+            if (!pw->m_dmabufParams) {
+                pw->m_dmabufParams = kwinApp()->platform()->testCreateDmaBuf(pw->m_resolution, drmFormat, receivedModifiers);
+            }
         } else {
-            pw->m_dmabufParams = kwinApp()->platform()->testCreateDmaBuf(pw->m_resolution, spaVideoFormatToDrmFormat(pw->videoFormat.format), {DRM_FORMAT_MOD_INVALID});
+            pw->m_dmabufParams = kwinApp()->platform()->testCreateDmaBuf(pw->m_resolution, drmFormat, {DRM_FORMAT_MOD_INVALID});
         }
 
         qCDebug(KWIN_SCREENCAST) << "Stream dmabuf modifiers received, offering our best suited modifier" << pw->m_dmabufParams.has_value();
@@ -248,6 +259,12 @@ void ScreenCastStream::onStreamRemoveBuffer(void *data, pw_buffer *buffer)
     ScreenCastStream *stream = static_cast<ScreenCastStream *>(data);
     stream->m_dmabufDataForPwBuffer.remove(buffer);
 
+    auto &pendingBuffers = stream->m_pendingBuffers;
+    pendingBuffers.erase(std::remove_if(pendingBuffers.begin(), pendingBuffers.end(), [buffer](const auto &pending) {
+                             return pending->buffer == buffer;
+                         }),
+                         pendingBuffers.end());
+
     struct spa_buffer *spa_buffer = buffer->buffer;
     struct spa_data *spa_data = spa_buffer->datas;
     if (spa_data && spa_data->type == SPA_DATA_MemFd) {
@@ -277,6 +294,9 @@ ScreenCastStream::ScreenCastStream(ScreenCastSource *source, QObject *parent)
 ScreenCastStream::~ScreenCastStream()
 {
     m_stopped = true;
+    qCDebug(KWIN_SCREENCAST) << "Screencast stream" << objectName() << "finished:"
+                             << m_statistics.queuedFrames << "queued," << m_statistics.skippedFrames << "skipped,"
+                             << m_statistics.droppedFrames << "dropped," << m_statistics.lateFrames << "late frames";
     if (pwStream) {
         pw_stream_destroy(pwStream);
     }
@@ -342,6 +362,12 @@ bool ScreenCastStream::createStream()
     const int drmFormat = spaVideoFormatToDrmFormat(format);
     m_hasDmaBuf = kwinApp()->platform()->testCreateDmaBuf(m_resolution, drmFormat, {DRM_FORMAT_MOD_INVALID}).has_value();
     m_modifiers = querySupportedModifiers(kwinApp()->platform()->sceneEglDisplay(), drmFormat);
+    if (const std::optional<uint64_t> preferredModifier = m_source->preferredModifier(drmFormat)) {
+        // Offer the modifier of the source first, consumers usually pick the first one they support.
+        if (m_modifiers.removeOne(*preferredModifier)) {
+            m_modifiers.prepend(*preferredModifier);
+        }
+    }
 
     char buffer[2048];
     QVector<const spa_pod *> params = buildFormats(false, buffer);
@@ -385,8 +411,22 @@ void ScreenCastStream::recordFrame(const QRegion &damagedRegion)
 {
     Q_ASSERT(!m_stopped);
 
-    if (m_pendingBuffer) {
-        qCWarning(KWIN_SCREENCAST) << "Dropping a screencast frame because the compositor is slow";
+    if (damagedRegion.isEmpty()) {
+        m_statistics.skippedFrames++;
+        return;
+    }
+
+    // The buffers that are still pending have not been finished by the GPU within a frame.
+    for (const auto &pending : m_pendingBuffers) {
+        if (pending->isFrame && !pending->ready && !pending->late) {
+            pending->late = true;
+            m_statistics.lateFrames++;
+        }
+    }
+
+    if (m_pendingBuffers.size() >= maxPendingBuffers) {
+        qCDebug(KWIN_SCREENCAST) << "Dropping a screencast frame because the compositor is slow";
+        m_statistics.droppedFrames++;
         return;
     }
 
@@ -408,6 +448,7 @@ void ScreenCastStream::recordFrame(const QRegion &damagedRegion)
     struct pw_buffer *buffer = pw_stream_dequeue_buffer(pwStream);
 
     if (!buffer) {
+        m_statistics.droppedFrames++;
         return;
     }
 
@@ -423,6 +464,7 @@ void ScreenCastStream::recordFrame(const QRegion &damagedRegion)
 
     const auto size = m_source->textureSize();
     spa_data->chunk->offset = 0;
+    bool rendered = false;
     if (data || spa_data[0].type == SPA_DATA_MemFd) {
         const bool hasAlpha = m_source->hasAlphaChannel();
         const int bpp = data && !hasAlpha ? 3 : 4;
@@ -446,6 +488,9 @@ void ScreenCastStream::recordFrame(const QRegion &damagedRegion)
             const auto position = (cursor->pos() - m_cursor.viewport.topLeft() - cursor->hotspot()) * m_cursor.scale;
             painter.drawImage(QRect{position, cursor->image().size()}, cursor->image());
         }
+
+        // The pixels have been read back already, so there's nothing to wait for.
+        rendered = true;
     } else {
         auto &buf = m_dmabufDataForPwBuffer[buffer];
         Q_ASSERT(buf);
@@ -500,7 +545,7 @@ void ScreenCastStream::recordFrame(const QRegion &damagedRegion)
 
     addDamage(spa_buffer, damagedRegion | QRect({0, 0}, size));
     addHeader(spa_buffer);
-    tryEnqueue(buffer);
+    tryEnqueue(buffer, true, rendered);
 }
 
 void ScreenCastStream::addHeader(spa_buffer *spaBuffer)
@@ -550,8 +595,8 @@ void ScreenCastStream::recordCursor()
 {
     Q_ASSERT(!m_stopped);
 
-    if (m_pendingBuffer) {
-        qCWarning(KWIN_SCREENCAST) << "Dropping a screencast cursor update because the compositor is slow";
+    if (m_pendingBuffers.size() >= maxPendingBuffers) {
+        qCDebug(KWIN_SCREENCAST) << "Dropping a screencast cursor update because the compositor is slow";
         return;
     }
 
@@ -568,61 +613,91 @@ void ScreenCastStream::recordCursor()
         return;
     }
 
-    m_pendingBuffer = pw_stream_dequeue_buffer(pwStream);
-    if (!m_pendingBuffer) {
+    pw_buffer *buffer = pw_stream_dequeue_buffer(pwStream);
+    if (!buffer) {
         return;
     }
 
-    struct spa_buffer *spa_buffer = m_pendingBuffer->buffer;
+    struct spa_buffer *spa_buffer = buffer->buffer;
     spa_buffer->datas[0].chunk->size = 0;
 
     sendCursorData(Cursors::self()->currentCursor(),
                    (spa_meta_cursor *)spa_buffer_find_meta_data(spa_buffer, SPA_META_Cursor, sizeof(spa_meta_cursor)));
     addHeader(spa_buffer);
     addDamage(spa_buffer, {});
-    enqueue();
+
+    // The cursor update must not overtake the frames that are still being rendered.
+    tryEnqueue(buffer, false, true);
 }
 
-void ScreenCastStream::tryEnqueue(pw_buffer *buffer)
+void ScreenCastStream::tryEnqueue(pw_buffer *buffer, bool isFrame, bool rendered)
 {
-    m_pendingBuffer = buffer;
+    auto pending = std::make_unique<PendingBuffer>();
+    pending->buffer = buffer;
+    pending->isFrame = isFrame;
+    pending->ready = rendered;
 
     // The GPU doesn't necessarily process draw commands as soon as they are issued. Thus,
     // we need to insert a fence into the command stream and enqueue the pipewire buffer
     // only after the fence is signaled; otherwise stream consumers will most likely see
-    // a corrupted buffer.
-    if (kwinApp()->platform()->supportsNativeFence()) {
-        Q_ASSERT_X(eglGetCurrentContext(), "tryEnqueue", "no current context");
-        m_pendingFence = new EGLNativeFence(kwinApp()->platform()->sceneEglDisplay());
-        if (!m_pendingFence->isValid()) {
-            qCWarning(KWIN_SCREENCAST) << "Failed to create a native EGL fence";
-            glFinish();
-            enqueue();
+    // a corrupted buffer. Meanwhile, the next frames can be recorded into other buffers.
+    if (!pending->ready) {
+        if (kwinApp()->platform()->supportsNativeFence()) {
+            Q_ASSERT_X(eglGetCurrentContext(), "tryEnqueue", "no current context");
+            pending->fence = std::make_unique<EGLNativeFence>(kwinApp()->platform()->sceneEglDisplay());
+            if (!pending->fence->isValid()) {
+                qCWarning(KWIN_SCREENCAST) << "Failed to create a native EGL fence";
+                glFinish();
+                pending->ready = true;
+            } else {
+                pending->notifier = std::make_unique<QSocketNotifier>(pending->fence->fileDescriptor(), QSocketNotifier::Read);
+                PendingBuffer *signaled = pending.get();
+                connect(pending->notifier.get(), &QSocketNotifier::activated, this, [this, signaled]() {
+                    // The GPU executes the commands in order, so the buffers that have been
+                    // recorded before the signaled one are finished too.
+                    for (const auto &pending : m_pendingBuffers) {
+                        pending->ready = true;
+                        if (pending.get() == signaled) {
+                            break;
+                        }
+                    }
+                    enqueue();
+                });
+            }
         } else {
-            m_pendingNotifier = new QSocketNotifier(m_pendingFence->fileDescriptor(),
-                                                    QSocketNotifier::Read, this);
-            connect(m_pendingNotifier, &QSocketNotifier::activated, this, &ScreenCastStream::enqueue);
+            // The compositing backend doesn't support native fences. We don't have any other choice
+            // but stall the graphics pipeline. Otherwise stream consumers may see an incomplete buffer.
+            glFinish();
+            pending->ready = true;
         }
-    } else {
-        // The compositing backend doesn't support native fences. We don't have any other choice
-        // but stall the graphics pipeline. Otherwise stream consumers may see an incomplete buffer.
-        glFinish();
-        enqueue();
     }
+
+    m_pendingBuffers.push_back(std::move(pending));
+    enqueue();
 }
 
 void ScreenCastStream::enqueue()
 {
-    Q_ASSERT_X(m_pendingBuffer, "enqueue", "pending buffer must be valid");
+    while (!m_pendingBuffers.empty() && m_pendingBuffers.front()->ready) {
+        std::unique_ptr<PendingBuffer> pending = std::move(m_pendingBuffers.front());
+        m_pendingBuffers.pop_front();
 
-    delete m_pendingFence;
-    delete m_pendingNotifier;
+        pw_stream_queue_buffer(pwStream, pending->buffer);
+        if (pending->isFrame) {
+            m_statistics.queuedFrames++;
+        }
 
-    pw_stream_queue_buffer(pwStream, m_pendingBuffer);
+        // The notifier may be the sender of the signal that is being handled.
+        if (pending->notifier) {
+            pending->notifier->setEnabled(false);
+            pending->notifier.release()->deleteLater();
+        }
+    }
+}
 
-    m_pendingBuffer = nullptr;
-    m_pendingFence = nullptr;
-    m_pendingNotifier = nullptr;
+ScreenCastStream::Statistics ScreenCastStream::statistics() const
+{
+    return m_statistics;
 }
 
 QVector<const spa_pod *> ScreenCastStream::buildFormats(bool fixate, char buffer[2048])
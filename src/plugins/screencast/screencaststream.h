@@ -19,6 +19,7 @@
 #include <QSize>
 #include <QSocketNotifier>
 #include <chrono>
+#include <deque>
 #include <memory>
 #include <optional>
 
@@ -40,6 +41,30 @@ class KWIN_EXPORT ScreenCastStream : public QObject
 {
     Q_OBJECT
 public:
+    /**
+     * The Statistics struct holds the frame counters of a stream.
+     */
+    struct Statistics
+    {
+        /**
+         * The number of frames that have been handed over to PipeWire.
+         */
+        quint64 queuedFrames = 0;
+        /**
+         * The number of frames that were not recorded because nothing has changed.
+         */
+        quint64 skippedFrames = 0;
+        /**
+         * The number of frames that were not recorded because there was no free buffer.
+         */
+        quint64 droppedFrames = 0;
+        /**
+         * The number of frames that the GPU hadn't finished rendering by the time the
+         * next frame was recorded.
+         */
+        quint64 lateFrames = 0;
+    };
+
     explicit ScreenCastStream(ScreenCastSource *source, QObject *parent);
     ~ScreenCastStream();
 
@@ -61,6 +86,8 @@ public:
 
     void setCursorMode(KWaylandServer::ScreencastV1Interface::CursorMode mode, qreal scale, const QRect &viewport);
 
+    Statistics statistics() const;
+
 public Q_SLOTS:
     void recordCursor();
 
@@ -83,7 +110,7 @@ private:
     void addHeader(spa_buffer *spaBuffer);
     void addDamage(spa_buffer *spaBuffer, const QRegion &damagedRegion);
     void newStreamParams();
-    void tryEnqueue(pw_buffer *buffer);
+    void tryEnqueue(pw_buffer *buffer, bool isFrame, bool rendered);
     void enqueue();
     spa_pod *buildFormat(struct spa_pod_builder *b, enum spa_video_format format, struct spa_rectangle *resolution,
                          struct spa_fraction *defaultFramerate, struct spa_fraction *minFramerate, struct spa_fraction *maxFramerate,
@@ -120,9 +147,23 @@ private:
 
     QHash<struct pw_buffer *, std::shared_ptr<DmaBufTexture>> m_dmabufDataForPwBuffer;
 
-    pw_buffer *m_pendingBuffer = nullptr;
-    QSocketNotifier *m_pendingNotifier = nullptr;
-    EGLNativeFence *m_pendingFence = nullptr;
+    /**
+     * A buffer that has been filled but is not handed over to PipeWire yet because the GPU
+     * may still be rendering into it. The buffers are queued in the order they were recorded.
+     */
+    struct PendingBuffer
+    {
+        pw_buffer *buffer = nullptr;
+        std::unique_ptr<EGLNativeFence> fence;
+        std::unique_ptr<QSocketNotifier> notifier;
+        bool isFrame = true;
+        bool ready = false;
+        bool late = false;
+    };
+    static constexpr size_t maxPendingBuffers = 3;
+    std::deque<std::unique_ptr<PendingBuffer>> m_pendingBuffers;
+    Statistics m_statistics;
+
     std::optional<std::chrono::nanoseconds> m_start;
     quint64 m_sequential = 0;
     bool m_hasDmaBuf = false;
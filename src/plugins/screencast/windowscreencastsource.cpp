@@ -13,12 +13,20 @@
 #include "kwineffects.h"
 #include "kwingltexture.h"
 #include "kwinglutils.h"
+#include "openglsurfacetexture.h"
 #include "output.h"
 #include "renderloop.h"
 #include "scene.h"
+#include "surfaceitem_wayland.h"
+#include "wayland/linuxdmabufv1clientbuffer.h"
+#include "wayland/shmclientbuffer.h"
 #include "window.h"
 #include "windowitem.h"
 
+#include <cstring>
+
+#include <libdrm/drm_fourcc.h>
+
 namespace KWin
 {
 
@@ -29,6 +37,8 @@ WindowScreenCastSource::WindowScreenCastSource(Window *window, QObject *parent)
     connect(m_window, &Window::windowClosed, this, &ScreenCastSource::closed);
 }
 
+WindowScreenCastSource::~WindowScreenCastSource() = default;
+
 bool WindowScreenCastSource::hasAlphaChannel() const
 {
     return true;
@@ -39,17 +49,145 @@ QSize WindowScreenCastSource::textureSize() const
     return m_window->clientGeometry().size().toSize();
 }
 
+SurfaceItem *WindowScreenCastSource::directSurfaceItem() const
+{
+    // The client buffer can be copied as is only if the main surface is the only thing that's
+    // visible in the client area, and it's neither scaled, transformed nor translucent.
+    SurfaceItem *surfaceItem = m_window->windowItem()->surfaceItem();
+    if (!surfaceItem || !surfaceItem->childItems().isEmpty() || !surfaceItem->surfaceToBufferMatrix().isIdentity()) {
+        return nullptr;
+    }
+    if (m_window->bufferGeometry() != m_window->clientGeometry() || m_window->opacity() != 1.0) {
+        return nullptr;
+    }
+    return surfaceItem;
+}
+
+KWaylandServer::ClientBuffer *WindowScreenCastSource::directClientBuffer() const
+{
+    const SurfaceItem *surfaceItem = directSurfaceItem();
+    if (!surfaceItem) {
+        return nullptr;
+    }
+    const auto pixmap = qobject_cast<SurfacePixmapWayland *>(surfaceItem->pixmap());
+    if (!pixmap) {
+        return nullptr;
+    }
+    return pixmap->buffer();
+}
+
+static bool hasSameLayout(uint32_t format, uint32_t otherFormat)
+{
+    // The padding byte of XRGB8888 takes the place of the alpha channel of ARGB8888.
+    auto opaque = [](uint32_t format) {
+        return format == DRM_FORMAT_ARGB8888 ? DRM_FORMAT_XRGB8888 : format;
+    };
+    return opaque(format) == opaque(otherFormat);
+}
+
+std::optional<uint64_t> WindowScreenCastSource::preferredModifier(uint32_t drmFormat) const
+{
+    const auto buffer = qobject_cast<KWaylandServer::LinuxDmaBufV1ClientBuffer *>(directClientBuffer());
+    if (!buffer || buffer->attributes().planeCount != 1 || !hasSameLayout(buffer->format(), drmFormat)) {
+        return std::nullopt;
+    }
+    return buffer->attributes().modifier;
+}
+
+bool WindowScreenCastSource::blitDmaBuffer(GLFramebuffer *target) const
+{
+    if (!GLFramebuffer::blitSupported()) {
+        return false;
+    }
+
+    SurfaceItem *surfaceItem = directSurfaceItem();
+    if (!surfaceItem) {
+        return false;
+    }
+    const auto pixmap = qobject_cast<SurfacePixmapWayland *>(surfaceItem->pixmap());
+    if (!pixmap || pixmap->isDiscarded()) {
+        return false;
+    }
+    const auto buffer = qobject_cast<KWaylandServer::LinuxDmaBufV1ClientBuffer *>(pixmap->buffer());
+    if (!buffer || buffer->attributes().planeCount != 1 || buffer->size() != target->size()) {
+        return false;
+    }
+
+    // The texture is brought up to date by the scene when the window is painted. If the window
+    // has not been painted since its last commit, render it as usual.
+    if (!surfaceItem->damage().isEmpty()) {
+        return false;
+    }
+    GLTexture *texture = static_cast<OpenGLSurfaceTexture *>(pixmap->texture())->texture();
+    if (!texture || !texture->isYInverted()) {
+        return false;
+    }
+
+    // The client buffer and the stream buffer both start with the top row of the window.
+    GLFramebuffer source(texture);
+    if (!source.valid()) {
+        return false;
+    }
+    const QRect rect(QPoint(), target->size());
+    GLFramebuffer::pushFramebuffer(&source);
+    target->blitFromFramebuffer(rect, rect, GL_NEAREST);
+    GLFramebuffer::popFramebuffer();
+    return true;
+}
+
+bool WindowScreenCastSource::copyShmBuffer(QImage *image) const
+{
+    const auto buffer = qobject_cast<KWaylandServer::ShmClientBuffer *>(directClientBuffer());
+    if (!buffer || buffer->size() != image->size()) {
+        return false;
+    }
+
+    // Both the stream and the ARGB8888/XRGB8888 shm formats store pixels as BGRA in memory.
+    const QImage data = buffer->data();
+    if (data.format() != QImage::Format_ARGB32_Premultiplied && data.format() != QImage::Format_RGB32) {
+        return false;
+    }
+    if (image->format() != QImage::Format_RGBA8888_Premultiplied) {
+        return false;
+    }
+
+    const int bytesPerLine = image->width() * 4;
+    for (int y = 0; y < image->height(); ++y) {
+        std::memcpy(image->scanLine(y), data.constScanLine(y), bytesPerLine);
+    }
+    if (data.format() == QImage::Format_RGB32) {
+        // The padding byte of XRGB8888 is undefined, but the stream advertises BGRA.
+        for (int y = 0; y < image->height(); ++y) {
+            quint32 *pixels = reinterpret_cast<quint32 *>(image->scanLine(y));
+            for (int x = 0; x < image->width(); ++x) {
+                pixels[x] |= 0xff000000;
+            }
+        }
+    }
+    return true;
+}
+
 void WindowScreenCastSource::render(QImage *image)
 {
-    GLTexture offscreenTexture(hasAlphaChannel() ? GL_RGBA8 : GL_RGB8, textureSize());
-    GLFramebuffer offscreenTarget(&offscreenTexture);
+    if (copyShmBuffer(image)) {
+        return;
+    }
+
+    if (!m_offscreenTexture || m_offscreenTexture->size() != image->size()) {
+        m_offscreenTexture.reset(new GLTexture(hasAlphaChannel() ? GL_RGBA8 : GL_RGB8, image->size()));
+        m_offscreenTarget.reset(new GLFramebuffer(m_offscreenTexture.get()));
+    }
 
-    render(&offscreenTarget);
-    grabTexture(&offscreenTexture, image);
+    render(m_offscreenTarget.get());
+    grabTexture(m_offscreenTexture.get(), image);
 }
 
 void WindowScreenCastSource::render(GLFramebuffer *target)
 {
+    if (blitDmaBuffer(target)) {
+        return;
+    }
+
     const QRectF geometry = m_window->clientGeometry();
     QMatrix4x4 projectionMatrix;
     projectionMatrix.ortho(geometry.x(), geometry.x() + geometry.width(),
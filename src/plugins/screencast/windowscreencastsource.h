@@ -10,9 +10,18 @@
 
 #include <QPointer>
 
+#include <memory>
+
+namespace KWaylandServer
+{
+class ClientBuffer;
+}
+
 namespace KWin
 {
 
+class GLTexture;
+class SurfaceItem;
 class Window;
 
 class WindowScreenCastSource : public ScreenCastSource
@@ -21,6 +30,7 @@ class WindowScreenCastSource : public ScreenCastSource
 
 public:
     explicit WindowScreenCastSource(Window *window, QObject *parent = nullptr);
+    ~WindowScreenCastSource() override;
 
     bool hasAlphaChannel() const override;
     QSize textureSize() const override;
@@ -28,9 +38,17 @@ public:
     void render(GLFramebuffer *target) override;
     void render(QImage *image) override;
     std::chrono::nanoseconds clock() const override;
+    std::optional<uint64_t> preferredModifier(uint32_t drmFormat) const override;
 
 private:
+    SurfaceItem *directSurfaceItem() const;
+    KWaylandServer::ClientBuffer *directClientBuffer() const;
+    bool copyShmBuffer(QImage *image) const;
+    bool blitDmaBuffer(GLFramebuffer *target) const;
+
     QPointer<Window> m_window;
+    std::unique_ptr<GLTexture> m_offscreenTexture;
+    std::unique_ptr<GLFramebuffer> m_offscreenTarget;
 };
 
 } // namespace KWin
@@ -6,9 +6,97 @@
 
 #include "renderjournal.h"
 
+#include <algorithm>
+
 namespace KWin
 {
 
+void FrameTimeHistory::add(std::chrono::nanoseconds sample)
+{
+    m_samples[m_head] = sample;
+    m_head = (m_head + 1) % capacity;
+    m_count = std::min(m_count + 1, capacity);
+}
+
+int FrameTimeHistory::count() const
+{
+    return m_count;
+}
+
+template<typename Func>
+void FrameTimeHistory::forEach(int window, Func func) const
+{
+    const int count = std::min(window, m_count);
+    for (int i = 1; i <= count; ++i) {
+        func(m_samples[(m_head - i + capacity) % capacity]);
+    }
+}
+
+std::chrono::nanoseconds FrameTimeHistory::minimum(int window) const
+{
+    if (!m_count) {
+        return std::chrono::nanoseconds::zero();
+    }
+    std::chrono::nanoseconds result = std::chrono::nanoseconds::max();
+    forEach(window, [&result](std::chrono::nanoseconds sample) {
+        result = std::min(result, sample);
+    });
+    return result;
+}
+
+std::chrono::nanoseconds FrameTimeHistory::maximum(int window) const
+{
+    std::chrono::nanoseconds result = std::chrono::nanoseconds::zero();
+    forEach(window, [&result](std::chrono::nanoseconds sample) {
+        result = std::max(result, sample);
+    });
+    return result;
+}
+
+std::chrono::nanoseconds FrameTimeHistory::average(int window) const
+{
+    const int count = std::min(window, m_count);
+    if (!count) {
+        return std::chrono::nanoseconds::zero();
+    }
+    std::chrono::nanoseconds result = std::chrono::nanoseconds::zero();
+    forEach(window, [&result](std::chrono::nanoseconds sample) {
+        result += sample;
+    });
+    return result / count;
+}
+
+std::chrono::nanoseconds FrameTimeHistory::percentile(int percent) const
+{
+    if (!m_count) {
+        return std::chrono::nanoseconds::zero();
+    }
+
+    // The samples are copied to the stack so the ring buffer is left untouched.
+    std::array<std::chrono::nanoseconds, capacity> sorted;
+    std::copy_n(m_samples.begin(), m_count, sorted.begin());
+
+    const int rank = std::clamp((percent * m_count + 99) / 100 - 1, 0, m_count - 1);
+    std::nth_element(sorted.begin(), sorted.begin() + rank, sorted.begin() + m_count);
+    return sorted[rank];
+}
+
+QVariantMap FrameTimeHistory::toVariantMap() const
+{
+    auto toMicroseconds = [](std::chrono::nanoseconds duration) {
+        return qlonglong(std::chrono::duration_cast<std::chrono::microseconds>(duration).count());
+    };
+    return QVariantMap{
+        {QStringLiteral("samples"), count()},
+        {QStringLiteral("minimum"), toMicroseconds(minimum())},
+        {QStringLiteral("average"), toMicroseconds(average())},
+        {QStringLiteral("p50"), toMicroseconds(percentile(50))},
+        {QStringLiteral("p90"), toMicroseconds(percentile(90))},
+        {QStringLiteral("p99"), toMicroseconds(percentile(99))},
+        {QStringLiteral("maximum"), toMicroseconds(maximum())},
+    };
+}
+
 RenderJournal::RenderJournal()
 {
 }
@@ -20,37 +108,47 @@ void RenderJournal::beginFrame()
 
 void RenderJournal::endFrame()
 {
-    std::chrono::nanoseconds duration(m_timer.nsecsElapsed());
-    if (m_log.count() >= m_size) {
-        m_log.dequeue();
+    m_renderTimes.add(std::chrono::nanoseconds(m_timer.nsecsElapsed()));
+    m_lastFrameEndTimestamp = std::chrono::steady_clock::now().time_since_epoch();
+}
+
+void RenderJournal::framePresented(std::chrono::nanoseconds timestamp)
+{
+    if (m_lastFrameEndTimestamp == std::chrono::nanoseconds::zero() || timestamp < m_lastFrameEndTimestamp) {
+        return;
     }
-    m_log.enqueue(duration);
+    m_presentationLatencies.add(timestamp - m_lastFrameEndTimestamp);
+    m_lastFrameEndTimestamp = std::chrono::nanoseconds::zero();
 }
 
 std::chrono::nanoseconds RenderJournal::minimum() const
 {
-    auto it = std::min_element(m_log.constBegin(), m_log.constEnd());
-    return it != m_log.constEnd() ? (*it) : std::chrono::nanoseconds::zero();
+    return m_renderTimes.minimum(m_size);
 }
 
 std::chrono::nanoseconds RenderJournal::maximum() const
 {
-    auto it = std::max_element(m_log.constBegin(), m_log.constEnd());
-    return it != m_log.constEnd() ? (*it) : std::chrono::nanoseconds::zero();
+    return m_renderTimes.maximum(m_size);
 }
 
 std::chrono::nanoseconds RenderJournal::average() const
 {
-    if (m_log.isEmpty()) {
-        return std::chrono::nanoseconds::zero();
-    }
+    return m_renderTimes.average(m_size);
+}
 
-    std::chrono::nanoseconds result = std::chrono::nanoseconds::zero();
-    for (const std::chrono::nanoseconds &entry : m_log) {
-        result += entry;
-    }
+std::chrono::nanoseconds RenderJournal::percentile(int percent) const
+{
+    return m_renderTimes.percentile(percent);
+}
+
+const FrameTimeHistory &RenderJournal::renderTimes() const
+{
+    return m_renderTimes;
+}
 
-    return result / m_log.count();
+const FrameTimeHistory &RenderJournal::presentationLatencies() const
+{
+    return m_presentationLatencies;
 }
 
 } // namespace KWin
@@ -9,14 +9,80 @@
 #include "kwinglobals.h"
 
 #include <QElapsedTimer>
-#include <QQueue>
+#include <QVariantMap>
+
+#include <array>
+#include <chrono>
 
 namespace KWin
 {
 
+/**
+ * The FrameTimeHistory class is a fixed size ring buffer of frame timings.
+ *
+ * Recording a sample never allocates memory; once the history is full, the oldest
+ * sample gets overwritten.
+ */
+class KWIN_EXPORT FrameTimeHistory
+{
+public:
+    static constexpr int capacity = 128;
+
+    /**
+     * Records the given @a sample, discarding the oldest sample if the history is full.
+     */
+    void add(std::chrono::nanoseconds sample);
+
+    /**
+     * Returns the number of recorded samples.
+     */
+    int count() const;
+
+    /**
+     * Returns the minimum of the last @a window samples.
+     */
+    std::chrono::nanoseconds minimum(int window = capacity) const;
+
+    /**
+     * Returns the maximum of the last @a window samples.
+     */
+    std::chrono::nanoseconds maximum(int window = capacity) const;
+
+    /**
+     * Returns the average of the last @a window samples.
+     */
+    std::chrono::nanoseconds average(int window = capacity) const;
+
+    /**
+     * Returns the value below which @a percent percent of the recorded samples fall,
+     * for example percentile(90) returns the 90th percentile. If there are no samples,
+     * zero is returned.
+     */
+    std::chrono::nanoseconds percentile(int percent) const;
+
+    /**
+     * Returns the statistics of the recorded samples as a map, e.g. to export them over D-Bus.
+     * The map contains the number of "samples" and the "minimum", "average", "p50", "p90",
+     * "p99" and "maximum" values in microseconds.
+     */
+    QVariantMap toVariantMap() const;
+
+private:
+    template<typename Func>
+    void forEach(int window, Func func) const;
+
+    std::array<std::chrono::nanoseconds, capacity> m_samples;
+    int m_head = 0;
+    int m_count = 0;
+};
+
 /**
  * The RenderJournal class measures how long it takes to render frames and estimates how
  * long it will take to render the next frame.
+ *
+ * Besides the render time, the RenderJournal also keeps track of the presentation latency,
+ * i.e. the time between the moment a frame has been submitted and the moment it has been
+ * actually presented on the screen.
  */
 class KWIN_EXPORT RenderJournal
 {
@@ -33,6 +99,12 @@ public:
      */
     void endFrame();
 
+    /**
+     * This function must be called when the last rendered frame has been presented
+     * on the screen at the specified @a timestamp.
+     */
+    void framePresented(std::chrono::nanoseconds timestamp);
+
     /**
      * Returns the maximum estimated amount of time that it takes to render a single frame.
      */
@@ -48,9 +120,27 @@ public:
      */
     std::chrono::nanoseconds average() const;
 
+    /**
+     * Returns the given @a percent percentile of the time that it takes to render a
+     * single frame.
+     */
+    std::chrono::nanoseconds percentile(int percent) const;
+
+    /**
+     * Returns the recorded render times.
+     */
+    const FrameTimeHistory &renderTimes() const;
+
+    /**
+     * Returns the recorded presentation latencies.
+     */
+    const FrameTimeHistory &presentationLatencies() const;
+
 private:
     QElapsedTimer m_timer;
-    QQueue<std::chrono::nanoseconds> m_log;
+    FrameTimeHistory m_renderTimes;
+    FrameTimeHistory m_presentationLatencies;
+    std::chrono::nanoseconds m_lastFrameEndTimestamp = std::chrono::nanoseconds::zero();
     int m_size = 15;
 };
 
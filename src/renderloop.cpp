@@ -84,6 +84,15 @@ void RenderLoopPrivate::scheduleRepaint()
     case RenderTimeEstimatorAverage:
         renderTime = std::max(renderTime, renderJournal.average());
         break;
+    case RenderTimeEstimatorMedian:
+        renderTime = std::max(renderTime, renderJournal.percentile(50));
+        break;
+    case RenderTimeEstimatorPercentile90:
+        renderTime = std::max(renderTime, renderJournal.percentile(90));
+        break;
+    case RenderTimeEstimatorPercentile99:
+        renderTime = std::max(renderTime, renderJournal.percentile(99));
+        break;
     }
 
     std::chrono::nanoseconds nextRenderTimestamp = nextPresentationTimestamp - renderTime - safetyMargin;
@@ -135,6 +144,8 @@ void RenderLoopPrivate::notifyFrameCompleted(std::chrono::nanoseconds timestamp)
         lastPresentationTimestamp = std::chrono::steady_clock::now().time_since_epoch();
     }
 
+    renderJournal.framePresented(lastPresentationTimestamp);
+
     if (!inhibitCount) {
         maybeScheduleRepaint();
     }
@@ -268,4 +279,9 @@ void RenderLoop::setVrrPolicy(VrrPolicy policy)
     d->vrrPolicy = policy;
 }
 
+const RenderJournal &RenderLoop::renderJournal() const
+{
+    return d->renderJournal;
+}
+
 } // namespace KWin
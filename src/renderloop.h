@@ -15,6 +15,7 @@ namespace KWin
 {
 
 class RenderLoopPrivate;
+class RenderJournal;
 class Item;
 
 /**
@@ -126,6 +127,12 @@ public:
      */
     void resetLatencyPolicy();
 
+    /**
+     * Returns the journal with the render times and presentation latencies of the
+     * frames that have been recently composited by this render loop.
+     */
+    const RenderJournal &renderJournal() const;
+
 Q_SIGNALS:
     /**
      * This signal is emitted when the refresh rate of this RenderLoop has changed.
@@ -56,6 +56,7 @@
 #include "composite.h"
 #include "deleted.h"
 #include "effects.h"
+#include "framecallbackthrottler.h"
 #include "internalwindow.h"
 #include "output.h"
 #include "platform.h"
@@ -159,6 +160,8 @@ void Scene::addRepaint(int x, int y, int width, int height)
 
 void Scene::addRepaint(const QRegion &region)
 {
+    m_pendingSceneRepaints += region & m_geometry;
+
     for (const auto &delegate : std::as_const(m_delegates)) {
         const QRect viewport = delegate->viewport();
         QRegion dirtyRegion = region & viewport;
@@ -174,6 +177,11 @@ QRegion Scene::damage() const
     return m_paintContext.damage;
 }
 
+QRegion Scene::sceneRepaints() const
+{
+    return m_paintContext.sceneRepaints;
+}
+
 QRect Scene::geometry() const
 {
     return m_geometry;
@@ -280,7 +288,7 @@ void Scene::prePaint(Output *output)
 
     // preparation step
     auto effectsImpl = static_cast<EffectsHandlerImpl *>(effects);
-    effectsImpl->startPaint();
+    effectsImpl->startPaint(painted_screen);
 
     ScreenPrePaintData prePaintData;
     prePaintData.mask = 0;
@@ -299,6 +307,10 @@ void Scene::prePaint(Output *output)
     } else {
         preparePaintSimpleScreen();
     }
+
+    // Repaints scheduled while painting this frame are picked up by the next one.
+    m_paintContext.sceneRepaints = m_pendingSceneRepaints & renderTargetRect();
+    m_pendingSceneRepaints -= renderTargetRect();
 }
 
 static void resetRepaintsHelper(Item *item, Output *output)
@@ -322,6 +334,23 @@ static void accumulateRepaints(Item *item, Output *output, QRegion *repaints)
     }
 }
 
+static void accumulateOpaque(const Item *item, QRegion *opaque)
+{
+    // Items that are translucent or transformed can't occlude anything below them.
+    if (!item->explicitVisible() || item->opacity() != 1.0 || !item->transform().isIdentity()) {
+        return;
+    }
+
+    *opaque += item->mapToGlobal(item->opaque());
+
+    // This also picks the opaque regions of subsurfaces, e.g. a video surface that
+    // covers a translucent main surface.
+    const auto childItems = item->childItems();
+    for (const Item *childItem : childItems) {
+        accumulateOpaque(childItem, opaque);
+    }
+}
+
 void Scene::preparePaintGenericScreen()
 {
     for (WindowItem *windowItem : std::as_const(stacking_order)) {
@@ -353,15 +382,7 @@ void Scene::preparePaintSimpleScreen()
 
         // Clip out the decoration for opaque windows; the decoration is drawn in the second pass.
         if (window->opacity() == 1.0) {
-            const SurfaceItem *surfaceItem = windowItem->surfaceItem();
-            if (Q_LIKELY(surfaceItem)) {
-                data.opaque = surfaceItem->mapToGlobal(surfaceItem->opaque());
-            }
-
-            const DecorationItem *decorationItem = windowItem->decorationItem();
-            if (decorationItem) {
-                data.opaque |= decorationItem->mapToGlobal(decorationItem->opaque());
-            }
+            accumulateOpaque(windowItem, &data.opaque);
         }
 
         effects->prePaintWindow(window->effectWindow(), data, m_expectedPresentTimestamp);
@@ -396,13 +417,30 @@ void Scene::postPaint()
         const std::chrono::milliseconds frameTime =
             std::chrono::duration_cast<std::chrono::milliseconds>(painted_screen->renderLoop()->lastPresentationTimestamp());
 
-        for (WindowItem *windowItem : std::as_const(stacking_order)) {
-            Window *window = windowItem->window();
-            if (!window->isOnOutput(painted_screen)) {
-                continue;
+        FrameCallbackThrottler *throttler = waylandServer()->frameCallbackThrottler();
+
+        // Windows that are covered by opaque windows get their frame callbacks at the hidden
+        // rate. Transformed windows can show up anywhere, so don't cull anything for them.
+        const bool cullOccluded = !(m_paintContext.mask & (PAINT_SCREEN_TRANSFORMED | PAINT_SCREEN_WITH_TRANSFORMED_WINDOWS));
+        QRegion opaque;
+        for (int i = m_paintContext.phase2Data.size() - 1; i >= 0; --i) {
+            const Phase2Data &paintData = m_paintContext.phase2Data.at(i);
+            Window *window = paintData.item->window();
+            const bool transformed = paintData.mask & PAINT_WINDOW_TRANSFORMED;
+
+            if (window->isOnOutput(painted_screen)) {
+                bool visible = true;
+                if (cullOccluded && !transformed) {
+                    const QRect bounds = paintData.item->mapToGlobal(paintData.item->boundingRect()).toAlignedRect();
+                    visible = !(QRegion(bounds & renderTargetRect()) - opaque).isEmpty();
+                }
+                if (visible) {
+                    throttler->frameRendered(window, painted_screen, frameTime);
+                }
             }
-            if (auto surface = window->surface()) {
-                surface->frameRendered(frameTime.count());
+
+            if (cullOccluded && !transformed && !(paintData.mask & PAINT_WINDOW_TRANSLUCENT)) {
+                opaque += paintData.opaque;
             }
         }
     }
@@ -620,6 +658,11 @@ QVector<QByteArray> Scene::openGLPlatformInterfaceExtensions() const
     return QVector<QByteArray>{};
 }
 
+int Scene::drawCallCount() const
+{
+    return 0;
+}
+
 std::unique_ptr<SurfaceTexture> Scene::createSurfaceTextureInternal(SurfacePixmapInternal *pixmap)
 {
     Q_UNUSED(pixmap)
@@ -157,6 +157,12 @@ public:
      */
     virtual QVector<QByteArray> openGLPlatformInterfaceExtensions() const;
 
+    /**
+     * Returns the number of draw calls that were issued by the Scene to paint the
+     * last frame of every output. Default implementation returns @c 0.
+     */
+    virtual int drawCallCount() const;
+
     virtual std::shared_ptr<GLTexture> textureForOutput(Output *output) const
     {
         Q_UNUSED(output);
@@ -175,6 +181,13 @@ public:
 
     QRegion mapToRenderTarget(const QRegion &region) const;
 
+    /**
+     * Returns the part of the current render target that is repainted for reasons other
+     * than damage of the window items, e.g. because a window has been restacked or closed,
+     * or an effect has scheduled a repaint.
+     */
+    QRegion sceneRepaints() const;
+
     virtual void render(Item *item, int mask, const QRegion &region, const WindowPaintData &data) = 0;
 
 Q_SIGNALS:
@@ -219,6 +232,7 @@ protected:
     struct PaintContext
     {
         QRegion damage;
+        QRegion sceneRepaints;
         int mask = 0;
         QVector<Phase2Data> phase2Data;
     };
@@ -239,6 +253,8 @@ private:
     // how many times finalPaintScreen() has been called
     int m_paintScreenCount = 0;
     PaintContext m_paintContext;
+    // repaints that haven't been picked up by an output yet
+    QRegion m_pendingSceneRepaints;
 };
 
 } // namespace
@@ -15,6 +15,7 @@
 #include "openglsurfacetexture.h"
 
 #include <kwinglplatform.h>
+#include <kwinglrendertargetpool.h>
 #include <kwinoffscreenquickview.h>
 
 #include "composite.h"
@@ -27,13 +28,17 @@
 #include "utils/common.h"
 #include "window.h"
 #include "windowitem.h"
+#include "workspace.h"
 
+#include <algorithm>
 #include <cmath>
 #include <cstddef>
+#include <optional>
 
 #include <QMatrix4x4>
 #include <QPainter>
 #include <QStringList>
+#include <QVarLengthArray>
 #include <QVector2D>
 #include <QVector4D>
 #include <QtMath>
@@ -60,6 +65,16 @@ SceneOpenGL::SceneOpenGL(OpenGLBackend *backend)
         glGenVertexArrays(1, &vao);
         glBindVertexArray(vao);
     }
+
+    // Pooled render targets are only useful while something animates, give the video memory
+    // of the ones that haven't been used for a while back.
+    m_renderTargetPoolTimer.setInterval(5000);
+    connect(&m_renderTargetPoolTimer, &QTimer::timeout, this, &SceneOpenGL::trimRenderTargetPool);
+    m_renderTargetPoolTimer.start();
+
+    connect(workspace(), &Workspace::outputRemoved, this, [this](Output *output) {
+        m_outputDrawCallCounts.remove(output);
+    });
 }
 
 SceneOpenGL::~SceneOpenGL()
@@ -86,9 +101,27 @@ bool SceneOpenGL::initFailed() const
 void SceneOpenGL::paint(RenderTarget *renderTarget, const QRegion &region)
 {
     Q_UNUSED(renderTarget)
+    // Only the draw calls issued while painting the screen are counted, windows that are
+    // rendered offscreen between frames, e.g. for thumbnails, are not part of the frame.
+    m_drawCallCount = 0;
+    m_countDrawCalls = true;
     GLVertexBuffer::streamingBuffer()->beginFrame();
     paintScreen(region);
     GLVertexBuffer::streamingBuffer()->endOfFrame();
+    m_countDrawCalls = false;
+    m_outputDrawCallCounts[painted_screen] = m_drawCallCount;
+}
+
+void SceneOpenGL::trimRenderTargetPool()
+{
+    GLRenderTargetPool *pool = GLRenderTargetPool::existingInstance();
+    if (!pool || !pool->statistics().pooledCount) {
+        return;
+    }
+    if (makeOpenGLContextCurrent()) {
+        pool->trimUnused(std::chrono::seconds(10));
+        doneOpenGLContextCurrent();
+    }
 }
 
 void SceneOpenGL::paintBackground(const QRegion &region)
@@ -181,6 +214,16 @@ QVector<QByteArray> SceneOpenGL::openGLPlatformInterfaceExtensions() const
     return m_backend->extensions().toVector();
 }
 
+int SceneOpenGL::drawCallCount() const
+{
+    // Every output is painted separately, a frame consists of the last paint of each output.
+    int count = 0;
+    for (int outputCount : m_outputDrawCallCounts) {
+        count += outputCount;
+    }
+    return count;
+}
+
 std::shared_ptr<GLTexture> SceneOpenGL::textureForOutput(Output *output) const
 {
     return m_backend->textureForOutput(output);
@@ -234,6 +277,9 @@ void SceneOpenGL::doPaintBackground(const QVector<float> &vertices)
     binder.shader()->setUniform(GLShader::ModelViewProjectionMatrix, renderTargetProjectionMatrix());
 
     vbo->render(GL_TRIANGLES);
+    if (m_countDrawCalls) {
+        m_drawCallCount++;
+    }
 }
 
 QVector4D SceneOpenGL::modulate(float opacity, float brightness) const
@@ -284,47 +330,332 @@ static GLTexture *bindSurfaceTexture(SurfaceItem *surfaceItem)
     return platformSurfaceTexture->texture();
 }
 
-static WindowQuadList clipQuads(const Item *item, const SceneOpenGL::RenderContext *context)
+/**
+ * Returns @c true if the @a rect lies entirely within one of the rects of the @a region.
+ */
+static bool containsRect(const QRegion &region, const QRect &rect)
 {
-    const WindowQuadList quads = item->quads();
-    if (context->clip != infiniteRegion() && !context->hardwareClipping) {
-        const QPoint offset = context->transformStack.top().map(QPoint(0, 0));
+    for (const QRect &r : region) {
+        if (r.contains(rect)) {
+            return true;
+        }
+    }
+    return false;
+}
 
-        WindowQuadList ret;
-        ret.reserve(quads.count());
+/**
+ * Splits the quads of the render @a node along the @a clip, the @a offset maps the quads to
+ * the coordinate system of the clip. Returns @c false if the render node is not clipped at
+ * all, in which case its cached vertices can be drawn as they are.
+ */
+static bool clipQuads(const SceneOpenGL::RenderNode &node, const QRegion &clip, const QPoint &offset, WindowQuadList *clippedQuads)
+{
+    // Most render nodes are either entirely inside a rect of the clip or entirely outside of
+    // it, checking their bounds avoids splitting the quads of those.
+    const QRect bounds = node.bounds.translated(offset);
+    if (!bounds.intersects(clip.boundingRect())) {
+        return true;
+    }
+    if (containsRect(clip, bounds)) {
+        return false;
+    }
 
-        // split all quads in bounding rect with the actual rects in the region
-        for (const WindowQuad &quad : qAsConst(quads)) {
-            for (const QRect &r : qAsConst(context->clip)) {
-                const QRectF rf(r.translated(-offset));
-                const QRectF quadRect(QPointF(quad.left(), quad.top()), QPointF(quad.right(), quad.bottom()));
-                const QRectF &intersected = rf.intersected(quadRect);
-                if (intersected.isValid()) {
-                    if (quadRect == intersected) {
-                        // case 1: completely contains, include and do not check other rects
-                        ret << quad;
-                        break;
-                    }
-                    // case 2: intersection
-                    ret << quad.makeSubQuad(intersected.left(), intersected.top(), intersected.right(), intersected.bottom());
+    clippedQuads->reserve(node.quads.count());
+
+    // split all quads in bounding rect with the actual rects in the region
+    for (const WindowQuad &quad : node.quads) {
+        for (const QRect &r : clip) {
+            const QRectF rf(r.translated(-offset));
+            const QRectF quadRect(QPointF(quad.left(), quad.top()), QPointF(quad.right(), quad.bottom()));
+            const QRectF &intersected = rf.intersected(quadRect);
+            if (intersected.isValid()) {
+                if (quadRect == intersected) {
+                    // case 1: completely contains, include and do not check other rects
+                    *clippedQuads << quad;
+                    break;
                 }
+                // case 2: intersection
+                *clippedQuads << quad.makeSubQuad(intersected.left(), intersected.top(), intersected.right(), intersected.bottom());
+            }
+        }
+    }
+    return true;
+}
+
+static ShaderTraits renderNodeShaderTraits(const SceneOpenGL::RenderNode &renderNode)
+{
+    ShaderTraits traits = ShaderTrait::MapTexture;
+    if (renderNode.opacity != 1.0) {
+        traits |= ShaderTrait::Modulate;
+    }
+    return traits;
+}
+
+/**
+ * Merges consecutive render nodes that can be drawn with the same state into batches. The
+ * vertices of the render nodes must be adjacent in the vertex buffer.
+ */
+static QVector<SceneOpenGL::RenderBatch> batchRenderNodes(const QVector<SceneOpenGL::RenderNode> &renderNodes)
+{
+    QVector<SceneOpenGL::RenderBatch> batches;
+    for (int i = 0; i < renderNodes.count(); i++) {
+        const SceneOpenGL::RenderNode &renderNode = renderNodes[i];
+        const ShaderTraits shaderTraits = renderNodeShaderTraits(renderNode);
+        const QRect bounds = renderNode.bounds.translated(renderNode.transformMatrix.map(QPoint(0, 0)));
+
+        if (!batches.isEmpty()) {
+            SceneOpenGL::RenderBatch &batch = batches.last();
+            if (batch.texture == renderNode.texture
+                && batch.shaderTraits == shaderTraits
+                && batch.hasAlpha == renderNode.hasAlpha
+                && batch.opacity == renderNode.opacity
+                && batch.transformMatrix == renderNode.transformMatrix
+                && batch.firstVertex + batch.vertexCount == renderNode.firstVertex) {
+                batch.bounds |= bounds;
+                batch.nodeCount++;
+                batch.vertexCount += renderNode.vertexCount;
+                continue;
+            }
+        }
+
+        batches.append(SceneOpenGL::RenderBatch{
+            .texture = renderNode.texture,
+            .transformMatrix = renderNode.transformMatrix,
+            .bounds = bounds,
+            .shaderTraits = shaderTraits,
+            .firstNode = i,
+            .nodeCount = 1,
+            .firstVertex = renderNode.firstVertex,
+            .vertexCount = renderNode.vertexCount,
+            .opacity = renderNode.opacity,
+            .hasAlpha = renderNode.hasAlpha,
+        });
+    }
+    return batches;
+}
+
+// Textures that are not bigger than a cell of the atlas, e.g. the ones of shadows, popups and
+// small subsurfaces, are copied into the atlas, so render nodes with different textures can
+// be batched. Every cell has a one pixel wide border to keep the cells apart when filtering.
+static const int s_atlasSize = 1024;
+static const int s_atlasCellSize = 256;
+
+std::optional<QMatrix4x4> SceneOpenGL::placeInAtlas(Item *item, GLTexture *texture, TextureCoordinateType coordinateType)
+{
+    auto it = m_atlasCells.find(item);
+    if (it == m_atlasCells.end()) {
+        it = m_atlasCells.emplace(item, -1).first;
+        connect(item, &QObject::destroyed, this, [this, item]() {
+            auto it = m_atlasCells.find(item);
+            if (it->second != -1) {
+                m_freeAtlasCells.append(it->second);
+            }
+            m_atlasCells.erase(it);
+        });
+    }
+
+    const int maximumSize = s_atlasCellSize - 2;
+    if (texture->width() > maximumSize || texture->height() > maximumSize || !GLFramebuffer::supported()) {
+        if (it->second != -1) {
+            m_freeAtlasCells.append(it->second);
+            it->second = -1;
+        }
+        return std::nullopt;
+    }
+
+    if (!m_atlasFramebuffer) {
+        m_atlasTexture = std::make_unique<GLTexture>(GL_RGBA8, s_atlasSize, s_atlasSize);
+        m_atlasTexture->setFilter(GL_LINEAR);
+        m_atlasTexture->setWrapMode(GL_CLAMP_TO_EDGE);
+        m_atlasFramebuffer = std::make_unique<GLFramebuffer>(m_atlasTexture.get());
+        if (m_atlasFramebuffer->valid()) {
+            const int cellsPerRow = s_atlasSize / s_atlasCellSize;
+            for (int cell = cellsPerRow * cellsPerRow - 1; cell >= 0; cell--) {
+                m_freeAtlasCells.append(cell);
+            }
+        }
+    }
+
+    if (it->second == -1) {
+        if (m_freeAtlasCells.isEmpty()) {
+            return std::nullopt;
+        }
+        it->second = m_freeAtlasCells.takeLast();
+    }
+
+    const int cellsPerRow = s_atlasSize / s_atlasCellSize;
+    const QPoint position((it->second % cellsPerRow) * s_atlasCellSize + 1,
+                          (it->second / cellsPerRow) * s_atlasCellSize + 1);
+    copyToAtlas(texture, position);
+
+    // The texture coordinates of the quads are relative to the top-left corner of the texture.
+    QMatrix4x4 matrix = m_atlasTexture->matrix(UnnormalizedCoordinates);
+    matrix.translate(position.x(), position.y());
+    if (coordinateType == NormalizedCoordinates) {
+        matrix.scale(texture->width(), texture->height());
+    }
+    return matrix;
+}
+
+void SceneOpenGL::copyToAtlas(GLTexture *texture, const QPoint &position)
+{
+    // The texture is drawn one pixel bigger on every side with clamped texture coordinates,
+    // which repeats its edges in the border of the cell like GL_CLAMP_TO_EDGE would do.
+    const QRectF target(position - QPoint(1, 1), texture->size() + QSize(2, 2));
+    const QMatrix4x4 textureMatrix = texture->matrix(UnnormalizedCoordinates);
+    const QPointF topLeft = textureMatrix.map(QPointF(-1, -1));
+    const QPointF bottomRight = textureMatrix.map(QPointF(texture->width() + 1, texture->height() + 1));
+
+    const float vertices[] = {
+        float(target.left()), float(target.top()),
+        float(target.left()), float(target.bottom()),
+        float(target.right()), float(target.top()),
+        float(target.right()), float(target.bottom()),
+    };
+    const float texcoords[] = {
+        float(topLeft.x()), float(topLeft.y()),
+        float(topLeft.x()), float(bottomRight.y()),
+        float(bottomRight.x()), float(topLeft.y()),
+        float(bottomRight.x()), float(bottomRight.y()),
+    };
+
+    GLVertexBuffer *vbo = GLVertexBuffer::streamingBuffer();
+    vbo->reset();
+    vbo->setData(4, 2, vertices, texcoords);
+
+    QMatrix4x4 projectionMatrix;
+    projectionMatrix.ortho(QRect(0, 0, s_atlasSize, s_atlasSize));
+
+    const bool scissorTest = glIsEnabled(GL_SCISSOR_TEST);
+    if (scissorTest) {
+        glDisable(GL_SCISSOR_TEST);
+    }
+    setBlendEnabled(false);
+
+    GLFramebuffer::pushFramebuffer(m_atlasFramebuffer.get());
+    ShaderBinder binder(ShaderTrait::MapTexture);
+    binder.shader()->setUniform(GLShader::ModelViewProjectionMatrix, projectionMatrix);
+    texture->setFilter(GL_NEAREST);
+    texture->setWrapMode(GL_CLAMP_TO_EDGE);
+    texture->bind();
+    vbo->render(GL_TRIANGLE_STRIP);
+    GLFramebuffer::popFramebuffer();
+
+    if (scissorTest) {
+        glEnable(GL_SCISSOR_TEST);
+    }
+    if (m_countDrawCalls) {
+        m_drawCallCount++;
+    }
+}
+
+int SceneOpenGL::allocateVertices(int count)
+{
+    for (auto it = m_freeVertexRanges.begin(); it != m_freeVertexRanges.end(); ++it) {
+        if (it->second >= count) {
+            const int first = it->first;
+            const int remaining = it->second - count;
+            m_freeVertexRanges.erase(it);
+            if (remaining) {
+                m_freeVertexRanges.emplace(first + count, remaining);
+            }
+            return first;
+        }
+    }
+
+    const int first = m_vertexBufferEnd;
+    m_vertexBufferEnd += count;
+    return first;
+}
+
+void SceneOpenGL::freeVertices(int first, int count)
+{
+    if (!count) {
+        return;
+    }
+
+    // Merge the range with the adjacent free ranges so the buffer doesn't get fragmented.
+    auto next = m_freeVertexRanges.lower_bound(first);
+    if (next != m_freeVertexRanges.end() && next->first == first + count) {
+        count += next->second;
+        next = m_freeVertexRanges.erase(next);
+    }
+    if (next != m_freeVertexRanges.begin()) {
+        const auto previous = std::prev(next);
+        if (previous->first + previous->second == first) {
+            first = previous->first;
+            count += previous->second;
+            m_freeVertexRanges.erase(previous);
+        }
+    }
+
+    if (first + count == m_vertexBufferEnd) {
+        m_vertexBufferEnd = first;
+    } else {
+        m_freeVertexRanges.emplace(first, count);
+    }
+}
+
+void SceneOpenGL::addRenderNode(Item *item, GLTexture *texture, TextureCoordinateType coordinateType, bool hasAlpha, RenderContext *context)
+{
+    WindowQuadList quads = item->quads();
+    if (quads.isEmpty() || !texture) {
+        return;
+    }
+
+    // Translations are applied to the quads, so the render nodes of a window usually share
+    // the transform and can be batched.
+    QMatrix4x4 transformMatrix = context->transformStack.top();
+    const QPointF offset = transformMatrix.map(QPointF(0, 0));
+    QMatrix4x4 translation;
+    translation.translate(offset.x(), offset.y());
+    if (transformMatrix == translation) {
+        for (WindowQuad &quad : quads) {
+            for (int i = 0; i < 4; i++) {
+                quad[i].move(quad[i].x() + offset.x(), quad[i].y() + offset.y());
             }
         }
-        return ret;
+        transformMatrix.setToIdentity();
     }
-    return quads;
+
+    QRectF bounds;
+    for (const WindowQuad &quad : qAsConst(quads)) {
+        bounds |= QRectF(QPointF(quad.left(), quad.top()), QPointF(quad.right(), quad.bottom()));
+    }
+
+    QMatrix4x4 textureMatrix = texture->matrix(coordinateType);
+    if (const std::optional<QMatrix4x4> atlasMatrix = placeInAtlas(item, texture, coordinateType)) {
+        texture = m_atlasTexture.get();
+        textureMatrix = *atlasMatrix;
+    }
+
+    context->renderNodes.append(RenderNode{
+        .texture = texture,
+        .quads = quads,
+        .textureMatrix = textureMatrix,
+        .transformMatrix = transformMatrix,
+        .bounds = bounds.toAlignedRect(),
+        .opacity = context->opacityStack.top(),
+        .hasAlpha = hasAlpha,
+    });
 }
 
 void SceneOpenGL::createRenderNode(Item *item, RenderContext *context)
 {
     const QList<Item *> sortedChildItems = item->sortedChildItems();
 
-    QMatrix4x4 matrix;
-    matrix.translate(item->position().x(), item->position().y());
-    matrix *= item->transform();
-    context->transformStack.push(context->transformStack.top() * matrix);
-
-    context->opacityStack.push(context->opacityStack.top() * item->opacity());
+    // The position, the transform and the opacity of the root item are applied when the
+    // render nodes are drawn, so they can change without rebuilding the render nodes.
+    if (item == context->rootItem) {
+        context->transformStack.push(context->transformStack.top());
+        context->opacityStack.push(context->opacityStack.top());
+    } else {
+        QMatrix4x4 matrix;
+        matrix.translate(item->position().x(), item->position().y());
+        matrix *= item->transform();
+        context->transformStack.push(context->transformStack.top() * matrix);
+        context->opacityStack.push(context->opacityStack.top() * item->opacity());
+    }
 
     for (Item *childItem : sortedChildItems) {
         if (childItem->z() >= 0) {
@@ -337,47 +668,22 @@ void SceneOpenGL::createRenderNode(Item *item, RenderContext *context)
 
     item->preprocess();
     if (auto shadowItem = qobject_cast<ShadowItem *>(item)) {
-        WindowQuadList quads = clipQuads(item, context);
-        if (!quads.isEmpty()) {
-            SceneOpenGLShadow *shadow = static_cast<SceneOpenGLShadow *>(shadowItem->shadow());
-            context->renderNodes.append(RenderNode{
-                .texture = shadow->shadowTexture(),
-                .quads = quads,
-                .transformMatrix = context->transformStack.top(),
-                .opacity = context->opacityStack.top(),
-                .hasAlpha = true,
-                .coordinateType = UnnormalizedCoordinates,
-            });
-        }
+        SceneOpenGLShadow *shadow = static_cast<SceneOpenGLShadow *>(shadowItem->shadow());
+        addRenderNode(item, shadow->shadowTexture(), UnnormalizedCoordinates, true, context);
     } else if (auto decorationItem = qobject_cast<DecorationItem *>(item)) {
-        WindowQuadList quads = clipQuads(item, context);
-        if (!quads.isEmpty()) {
-            auto renderer = static_cast<const SceneOpenGLDecorationRenderer *>(decorationItem->renderer());
-            context->renderNodes.append(RenderNode{
-                .texture = renderer->texture(),
-                .quads = quads,
-                .transformMatrix = context->transformStack.top(),
-                .opacity = context->opacityStack.top(),
-                .hasAlpha = true,
-                .coordinateType = UnnormalizedCoordinates,
-            });
-        }
+        auto renderer = static_cast<const SceneOpenGLDecorationRenderer *>(decorationItem->renderer());
+        addRenderNode(item, renderer->texture(), UnnormalizedCoordinates, true, context);
     } else if (auto surfaceItem = qobject_cast<SurfaceItem *>(item)) {
         SurfacePixmap *pixmap = surfaceItem->pixmap();
         if (pixmap) {
-            WindowQuadList quads = clipQuads(item, context);
-            if (!quads.isEmpty()) {
-                // Don't bother with blending if the entire surface is opaque
-                bool hasAlpha = pixmap->hasAlphaChannel() && !surfaceItem->shape().subtracted(surfaceItem->opaque()).isEmpty();
-                context->renderNodes.append(RenderNode{
-                    .texture = bindSurfaceTexture(surfaceItem),
-                    .quads = quads,
-                    .transformMatrix = context->transformStack.top(),
-                    .opacity = context->opacityStack.top(),
-                    .hasAlpha = hasAlpha,
-                    .coordinateType = NormalizedCoordinates,
-                });
+            // Don't bother with blending if the entire surface is opaque
+            bool hasAlpha = pixmap->hasAlphaChannel() && !surfaceItem->shape().subtracted(surfaceItem->opaque()).isEmpty();
+            GLTexture *texture = bindSurfaceTexture(surfaceItem);
+            if (!texture) {
+                // Try again next time even if nothing changes in the meantime.
+                context->complete = false;
             }
+            addRenderNode(item, texture, NormalizedCoordinates, hasAlpha, context);
         }
     }
 
@@ -394,6 +700,73 @@ void SceneOpenGL::createRenderNode(Item *item, RenderContext *context)
     context->opacityStack.pop();
 }
 
+const SceneOpenGL::RenderCache &SceneOpenGL::renderCache(Item *item)
+{
+    auto it = m_renderCaches.find(item);
+    if (it == m_renderCaches.end()) {
+        it = m_renderCaches.emplace(item, RenderCache{}).first;
+        connect(item, &QObject::destroyed, this, [this, item]() {
+            auto it = m_renderCaches.find(item);
+            freeVertices(it->second.firstVertex, it->second.vertexCount);
+            m_renderCaches.erase(it);
+        });
+    } else if (it->second.complete && it->second.subtreeSerial == item->subtreeSerial()) {
+        return it->second;
+    }
+
+    RenderContext context{
+        .rootItem = item,
+    };
+    context.transformStack.push(QMatrix4x4());
+    context.opacityStack.push(1.0);
+    createRenderNode(item, &context);
+
+    const bool indexedQuads = GLVertexBuffer::supportsIndexedQuads();
+    const GLenum primitiveType = indexedQuads ? GL_QUADS : GL_TRIANGLES;
+    const int verticesPerQuad = indexedQuads ? 4 : 6;
+
+    int vertexCount = 0;
+    for (const RenderNode &node : qAsConst(context.renderNodes)) {
+        vertexCount += node.quads.count() * verticesPerQuad;
+    }
+
+    RenderCache &cache = it->second;
+    if (cache.vertexCount != vertexCount) {
+        freeVertices(cache.firstVertex, cache.vertexCount);
+        cache.firstVertex = allocateVertices(vertexCount);
+        cache.vertexCount = vertexCount;
+    }
+
+    // The vertices of all items live in one vertex buffer, so unchanged items don't have to
+    // be uploaded again and drawing them doesn't need to bind another buffer.
+    if (vertexCount) {
+        if (!m_vertexBuffer) {
+            const GLVertexAttrib attribs[] = {
+                {VA_Position, 2, GL_FLOAT, offsetof(GLVertex2D, position)},
+                {VA_TexCoord, 2, GL_FLOAT, offsetof(GLVertex2D, texcoord)},
+            };
+            m_vertexBuffer = std::make_unique<GLVertexBuffer>(GLVertexBuffer::Static);
+            m_vertexBuffer->setAttribLayout(attribs, 2, sizeof(GLVertex2D));
+        }
+
+        QVector<GLVertex2D> vertices(vertexCount);
+        for (int i = 0, v = 0; i < context.renderNodes.count(); i++) {
+            RenderNode &renderNode = context.renderNodes[i];
+            renderNode.firstVertex = cache.firstVertex + v;
+            renderNode.vertexCount = renderNode.quads.count() * verticesPerQuad;
+            renderNode.quads.makeInterleavedArrays(primitiveType, &vertices[v], renderNode.textureMatrix);
+            v += renderNode.vertexCount;
+        }
+        m_vertexBuffer->setSubData(cache.firstVertex * sizeof(GLVertex2D), vertices.constData(), vertexCount * sizeof(GLVertex2D));
+    }
+
+    cache.renderNodes = context.renderNodes;
+    cache.renderBatches = batchRenderNodes(cache.renderNodes);
+    cache.subtreeSerial = item->subtreeSerial();
+    cache.complete = context.complete;
+    return cache;
+}
+
 QMatrix4x4 SceneOpenGL::modelViewProjectionMatrix(const WindowPaintData &data) const
 {
     // An effect may want to override the default projection matrix in some cases,
@@ -415,72 +788,130 @@ void SceneOpenGL::render(Item *item, int mask, const QRegion &region, const Wind
         return;
     }
 
-    RenderContext renderContext{
-        .clip = region,
-        .hardwareClipping = region != infiniteRegion() && ((mask & Scene::PAINT_WINDOW_TRANSFORMED) || (mask & Scene::PAINT_SCREEN_TRANSFORMED)),
-    };
-
-    renderContext.transformStack.push(QMatrix4x4());
-    renderContext.opacityStack.push(data.opacity());
+    const bool hardwareClipping = region != infiniteRegion() && ((mask & Scene::PAINT_WINDOW_TRANSFORMED) || (mask & Scene::PAINT_SCREEN_TRANSFORMED));
+    const bool softwareClipping = region != infiniteRegion() && !hardwareClipping;
 
     item->setTransform(data.toMatrix());
 
-    createRenderNode(item, &renderContext);
+    const RenderCache &cache = renderCache(item);
 
-    int quadCount = 0;
-    for (const RenderNode &node : qAsConst(renderContext.renderNodes)) {
-        quadCount += node.quads.count();
-    }
-    if (!quadCount) {
-        return;
-    }
+    QMatrix4x4 itemMatrix;
+    itemMatrix.translate(item->position().x(), item->position().y());
+    itemMatrix *= item->transform();
+    const qreal itemOpacity = data.opacity() * item->opacity();
 
     const bool indexedQuads = GLVertexBuffer::supportsIndexedQuads();
     const GLenum primitiveType = indexedQuads ? GL_QUADS : GL_TRIANGLES;
     const int verticesPerQuad = indexedQuads ? 4 : 6;
-    const size_t size = verticesPerQuad * quadCount * sizeof(GLVertex2D);
-
-    ShaderTraits shaderTraits = ShaderTrait::MapTexture;
-
-    if (data.brightness() != 1.0 || data.crossFadeProgress() != 1.0) {
-        shaderTraits |= ShaderTrait::Modulate;
-    }
-    if (data.saturation() != 1.0) {
-        shaderTraits |= ShaderTrait::AdjustSaturation;
-    }
 
-    const GLVertexAttrib attribs[] = {
-        {VA_Position, 2, GL_FLOAT, offsetof(GLVertex2D, position)},
-        {VA_TexCoord, 2, GL_FLOAT, offsetof(GLVertex2D, texcoord)},
+    struct RenderCommand
+    {
+        GLTexture *texture;
+        const QMatrix4x4 *transformMatrix;
+        const QMatrix4x4 *textureMatrix;
+        GLVertexBuffer *vertexBuffer;
+        int firstVertex;
+        int vertexCount;
+        qreal opacity;
+        ShaderTraits shaderTraits;
+        bool hasAlpha;
     };
 
     GLVertexBuffer *vbo = GLVertexBuffer::streamingBuffer();
-    vbo->reset();
-    vbo->setAttribLayout(attribs, 2, sizeof(GLVertex2D));
-
-    GLVertex2D *map = (GLVertex2D *)vbo->map(size);
+    QVarLengthArray<RenderCommand, 16> commands;
+    QVarLengthArray<std::pair<int, WindowQuadList>, 4> clippedNodes;
+    int streamedQuadCount = 0;
+
+    auto addRenderNodeCommand = [&](const RenderNode &renderNode, GLVertexBuffer *vertexBuffer) {
+        commands.append(RenderCommand{
+            .texture = renderNode.texture,
+            .transformMatrix = &renderNode.transformMatrix,
+            .textureMatrix = &renderNode.textureMatrix,
+            .vertexBuffer = vertexBuffer,
+            .firstVertex = renderNode.firstVertex,
+            .vertexCount = renderNode.vertexCount,
+            .opacity = renderNode.opacity,
+            .shaderTraits = renderNodeShaderTraits(renderNode),
+            .hasAlpha = renderNode.hasAlpha,
+        });
+    };
 
-    for (int i = 0, v = 0; i < renderContext.renderNodes.count(); i++) {
-        RenderNode &renderNode = renderContext.renderNodes[i];
-        if (renderNode.quads.isEmpty() || !renderNode.texture) {
-            continue;
+    // Batches that are partially clipped are broken up into their render nodes, the render
+    // nodes that are partially clipped are split along the clip and streamed. Everything else
+    // is drawn from the cached vertices.
+    const QPoint itemOffset = itemMatrix.map(QPoint(0, 0));
+    for (const RenderBatch &batch : cache.renderBatches) {
+        if (softwareClipping) {
+            const QRect bounds = batch.bounds.translated(itemOffset);
+            if (!bounds.intersects(region.boundingRect())) {
+                continue;
+            }
+            if (!containsRect(region, bounds)) {
+                for (int i = batch.firstNode; i < batch.firstNode + batch.nodeCount; i++) {
+                    const RenderNode &renderNode = cache.renderNodes[i];
+                    WindowQuadList quads;
+                    if (!clipQuads(renderNode, region, itemOffset + renderNode.transformMatrix.map(QPoint(0, 0)), &quads)) {
+                        addRenderNodeCommand(renderNode, m_vertexBuffer.get());
+                    } else if (!quads.isEmpty()) {
+                        streamedQuadCount += quads.count();
+                        clippedNodes.append(std::make_pair(commands.count(), quads));
+                        addRenderNodeCommand(renderNode, vbo);
+                    }
+                }
+                continue;
+            }
         }
+        commands.append(RenderCommand{
+            .texture = batch.texture,
+            .transformMatrix = &batch.transformMatrix,
+            .textureMatrix = nullptr,
+            .vertexBuffer = m_vertexBuffer.get(),
+            .firstVertex = batch.firstVertex,
+            .vertexCount = batch.vertexCount,
+            .opacity = batch.opacity,
+            .shaderTraits = batch.shaderTraits,
+            .hasAlpha = batch.hasAlpha,
+        });
+    }
+    if (commands.isEmpty()) {
+        return;
+    }
 
-        if (renderNode.opacity != 1.0) {
-            shaderTraits |= ShaderTrait::Modulate;
+    if (streamedQuadCount) {
+        const GLVertexAttrib attribs[] = {
+            {VA_Position, 2, GL_FLOAT, offsetof(GLVertex2D, position)},
+            {VA_TexCoord, 2, GL_FLOAT, offsetof(GLVertex2D, texcoord)},
+        };
+
+        vbo->reset();
+        vbo->setAttribLayout(attribs, 2, sizeof(GLVertex2D));
+
+        GLVertex2D *map = (GLVertex2D *)vbo->map(verticesPerQuad * streamedQuadCount * sizeof(GLVertex2D));
+        for (int i = 0, v = 0; i < clippedNodes.count(); i++) {
+            RenderCommand &command = commands[clippedNodes[i].first];
+            const WindowQuadList &quads = clippedNodes[i].second;
+            command.firstVertex = v;
+            command.vertexCount = quads.count() * verticesPerQuad;
+            quads.makeInterleavedArrays(primitiveType, &map[v], *command.textureMatrix);
+            v += command.vertexCount;
         }
+        vbo->unmap();
+    }
 
-        renderNode.firstVertex = v;
-        renderNode.vertexCount = renderNode.quads.count() * verticesPerQuad;
-
-        const QMatrix4x4 matrix = renderNode.texture->matrix(renderNode.coordinateType);
+    ShaderTraits shaderTraits = ShaderTrait::MapTexture;
 
-        renderNode.quads.makeInterleavedArrays(primitiveType, &map[v], matrix);
-        v += renderNode.quads.count() * verticesPerQuad;
+    if (data.brightness() != 1.0 || data.crossFadeProgress() != 1.0) {
+        shaderTraits |= ShaderTrait::Modulate;
+    }
+    if (data.saturation() != 1.0) {
+        shaderTraits |= ShaderTrait::AdjustSaturation;
+    }
+    if (itemOpacity != 1.0) {
+        shaderTraits |= ShaderTrait::Modulate;
+    }
+    for (const RenderCommand &command : qAsConst(commands)) {
+        shaderTraits |= command.shaderTraits;
     }
-
-    vbo->unmap();
-    vbo->bindArrays();
 
     GLShader *shader = data.shader;
     if (!shader) {
@@ -488,7 +919,7 @@ void SceneOpenGL::render(Item *item, int mask, const QRegion &region, const Wind
     }
     shader->setUniform(GLShader::Saturation, data.saturation());
 
-    if (renderContext.hardwareClipping) {
+    if (hardwareClipping) {
         glEnable(GL_SCISSOR_TEST);
     }
 
@@ -499,35 +930,55 @@ void SceneOpenGL::render(Item *item, int mask, const QRegion &region, const Wind
 
     // The scissor region must be in the render target local coordinate system.
     QRegion scissorRegion = infiniteRegion();
-    if (renderContext.hardwareClipping) {
+    if (hardwareClipping) {
         scissorRegion = mapToRenderTarget(region);
     }
 
-    const QMatrix4x4 projectionMatrix = modelViewProjectionMatrix(data);
-    for (int i = 0; i < renderContext.renderNodes.count(); i++) {
-        const RenderNode &renderNode = renderContext.renderNodes[i];
-        if (renderNode.vertexCount == 0) {
-            continue;
+    // Consecutive draws usually share the transform, the opacity and, thanks to the atlas,
+    // the texture, only update them when they change.
+    const QMatrix4x4 projectionMatrix = modelViewProjectionMatrix(data) * itemMatrix;
+    std::optional<QMatrix4x4> transformMatrix;
+    GLVertexBuffer *boundBuffer = nullptr;
+    GLTexture *boundTexture = nullptr;
+    for (const RenderCommand &command : qAsConst(commands)) {
+        if (boundBuffer != command.vertexBuffer) {
+            if (boundBuffer) {
+                boundBuffer->unbindArrays();
+            }
+            command.vertexBuffer->bindArrays();
+            boundBuffer = command.vertexBuffer;
         }
 
-        setBlendEnabled(renderNode.hasAlpha || renderNode.opacity < 1.0);
+        const qreal commandOpacity = itemOpacity * command.opacity;
+        setBlendEnabled(command.hasAlpha || commandOpacity < 1.0);
 
-        shader->setUniform(GLShader::ModelViewProjectionMatrix, projectionMatrix * renderNode.transformMatrix);
-        if (opacity != renderNode.opacity) {
+        if (transformMatrix != *command.transformMatrix) {
+            shader->setUniform(GLShader::ModelViewProjectionMatrix, projectionMatrix * *command.transformMatrix);
+            transformMatrix = *command.transformMatrix;
+        }
+        if (opacity != commandOpacity) {
             shader->setUniform(GLShader::ModulationConstant,
-                               modulate(renderNode.opacity, data.brightness()));
-            opacity = renderNode.opacity;
+                               modulate(commandOpacity, data.brightness()));
+            opacity = commandOpacity;
         }
 
-        renderNode.texture->setFilter(GL_LINEAR);
-        renderNode.texture->setWrapMode(GL_CLAMP_TO_EDGE);
-        renderNode.texture->bind();
+        if (boundTexture != command.texture) {
+            command.texture->setFilter(GL_LINEAR);
+            command.texture->setWrapMode(GL_CLAMP_TO_EDGE);
+            command.texture->bind();
+            boundTexture = command.texture;
+        }
 
-        vbo->draw(scissorRegion, primitiveType, renderNode.firstVertex,
-                  renderNode.vertexCount, renderContext.hardwareClipping);
+        command.vertexBuffer->draw(scissorRegion, primitiveType, command.firstVertex,
+                                   command.vertexCount, hardwareClipping);
+        if (m_countDrawCalls) {
+            m_drawCallCount += hardwareClipping ? scissorRegion.rectCount() : 1;
+        }
     }
 
-    vbo->unbindArrays();
+    if (boundBuffer) {
+        boundBuffer->unbindArrays();
+    }
 
     setBlendEnabled(false);
 
@@ -535,7 +986,7 @@ void SceneOpenGL::render(Item *item, int mask, const QRegion &region, const Wind
         ShaderManager::instance()->popShader();
     }
 
-    if (renderContext.hardwareClipping) {
+    if (hardwareClipping) {
         glDisable(GL_SCISSOR_TEST);
     }
 }
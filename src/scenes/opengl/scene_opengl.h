@@ -19,6 +19,12 @@
 
 #include "kwinglutils.h"
 
+#include <QTimer>
+
+#include <map>
+#include <optional>
+#include <unordered_map>
+
 namespace KWin
 {
 class OpenGLBackend;
@@ -32,21 +38,40 @@ public:
     {
         GLTexture *texture = nullptr;
         WindowQuadList quads;
+        QMatrix4x4 textureMatrix;
         QMatrix4x4 transformMatrix;
+        QRect bounds;
+        int firstVertex = 0;
+        int vertexCount = 0;
+        qreal opacity = 1;
+        bool hasAlpha = false;
+    };
+
+    /**
+     * A run of consecutive render nodes that share the texture, the transform, the opacity
+     * and the blend state. Their vertices are adjacent, so they are drawn at once.
+     */
+    struct RenderBatch
+    {
+        GLTexture *texture = nullptr;
+        QMatrix4x4 transformMatrix;
+        QRect bounds;
+        ShaderTraits shaderTraits = ShaderTrait::MapTexture;
+        int firstNode = 0;
+        int nodeCount = 0;
         int firstVertex = 0;
         int vertexCount = 0;
         qreal opacity = 1;
         bool hasAlpha = false;
-        TextureCoordinateType coordinateType = UnnormalizedCoordinates;
     };
 
     struct RenderContext
     {
+        const Item *rootItem = nullptr;
         QVector<RenderNode> renderNodes;
         QStack<QMatrix4x4> transformStack;
         QStack<qreal> opacityStack;
-        const QRegion clip;
-        const bool hardwareClipping;
+        bool complete = true;
     };
 
     explicit SceneOpenGL(OpenGLBackend *backend);
@@ -70,6 +95,7 @@ public:
     }
 
     QVector<QByteArray> openGLPlatformInterfaceExtensions() const override;
+    int drawCallCount() const override;
     std::shared_ptr<GLTexture> textureForOutput(Output *output) const override;
 
     static std::unique_ptr<SceneOpenGL> createScene(OpenGLBackend *backend);
@@ -85,11 +111,45 @@ private:
     QVector4D modulate(float opacity, float brightness) const;
     void setBlendEnabled(bool enabled);
     void createRenderNode(Item *item, RenderContext *context);
+    void addRenderNode(Item *item, GLTexture *texture, TextureCoordinateType coordinateType, bool hasAlpha, RenderContext *context);
+    void trimRenderTargetPool();
+
+    /**
+     * The render nodes of an item and its descendants. They are relative to the item and
+     * their vertices are stored in one contiguous range of m_vertexBuffer.
+     */
+    struct RenderCache
+    {
+        QVector<RenderNode> renderNodes;
+        QVector<RenderBatch> renderBatches;
+        quint64 subtreeSerial = 0;
+        int firstVertex = 0;
+        int vertexCount = 0;
+        bool complete = false;
+    };
+
+    const RenderCache &renderCache(Item *item);
+    int allocateVertices(int count);
+    void freeVertices(int first, int count);
+    std::optional<QMatrix4x4> placeInAtlas(Item *item, GLTexture *texture, TextureCoordinateType coordinateType);
+    void copyToAtlas(GLTexture *texture, const QPoint &position);
 
     bool init_ok = true;
     OpenGLBackend *m_backend;
     GLuint vao = 0;
     bool m_blendingEnabled = false;
+    bool m_countDrawCalls = false;
+    int m_drawCallCount = 0;
+    QHash<const Output *, int> m_outputDrawCallCounts;
+    std::unordered_map<const Item *, RenderCache> m_renderCaches;
+    std::unique_ptr<GLVertexBuffer> m_vertexBuffer;
+    std::map<int, int> m_freeVertexRanges;
+    int m_vertexBufferEnd = 0;
+    std::unique_ptr<GLTexture> m_atlasTexture;
+    std::unique_ptr<GLFramebuffer> m_atlasFramebuffer;
+    std::unordered_map<const Item *, int> m_atlasCells;
+    QVector<int> m_freeAtlasCells;
+    QTimer m_renderTargetPoolTimer;
 };
 
 /**
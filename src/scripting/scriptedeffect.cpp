@@ -196,6 +196,8 @@ ScriptedEffect::ScriptedEffect()
     , m_chainPosition(0)
 {
     Q_ASSERT(effects);
+    // Scripted effects only paint the windows they animate.
+    effects->setWindowPassesRestricted(this, true);
     connect(effects, &EffectsHandler::activeFullScreenEffectChanged, this, [this]() {
         Effect *fullScreenEffect = effects->activeFullScreenEffect();
         if (fullScreenEffect == m_activeFullScreenEffect) {
@@ -0,0 +1,238 @@
+/*
+    KWin - the KDE window manager
+    This file is part of the KDE project.
+
+    SPDX-FileCopyrightText: 2022 KWin contributors
+
+    SPDX-License-Identifier: GPL-2.0-or-later
+*/
+
+#include "windowthumbnailcache.h"
+#include "composite.h"
+#include "effects.h"
+#include "scene.h"
+#include "window.h"
+#include "windowitem.h"
+
+#include <kwingltexture.h>
+#include <kwinglutils.h>
+
+#include <cmath>
+
+namespace KWin
+{
+
+// Thumbnails are never smaller than 1/16 of the window, the mipmaps cover the rest.
+static const int s_maxLevel = 4;
+static const int s_mipLevels = 3;
+
+WindowThumbnail::WindowThumbnail(Window *window, const QSize &size)
+    : m_window(window)
+    , m_size(size)
+{
+    m_throttleTimer.setSingleShot(true);
+    connect(&m_throttleTimer, &QTimer::timeout, this, &WindowThumbnail::repaintNeeded);
+
+    connect(window, &Window::damaged, this, &WindowThumbnail::invalidate);
+    connect(window, &Window::frameGeometryChanged, this, &WindowThumbnail::invalidate);
+}
+
+WindowThumbnail::~WindowThumbnail()
+{
+    if (m_fence) {
+        glDeleteSync(m_fence);
+    }
+}
+
+Window *WindowThumbnail::window() const
+{
+    return m_window;
+}
+
+QSize WindowThumbnail::size() const
+{
+    return m_size;
+}
+
+std::shared_ptr<GLTexture> WindowThumbnail::texture() const
+{
+    return m_texture;
+}
+
+quint64 WindowThumbnail::serial() const
+{
+    return m_serial;
+}
+
+void WindowThumbnail::waitForRendering()
+{
+    if (m_fence) {
+        glClientWaitSync(m_fence, GL_SYNC_FLUSH_COMMANDS_BIT, 5000);
+    }
+}
+
+void WindowThumbnail::setMaximumRefreshRate(const QObject *consumer, int refreshRate)
+{
+    m_maximumRefreshRates[consumer] = std::max(0, refreshRate);
+}
+
+void WindowThumbnail::removeConsumer(const QObject *consumer)
+{
+    m_maximumRefreshRates.remove(consumer);
+}
+
+std::chrono::milliseconds WindowThumbnail::refreshInterval() const
+{
+    int refreshRate = 0;
+    for (int consumerRefreshRate : m_maximumRefreshRates) {
+        if (consumerRefreshRate == 0) {
+            return std::chrono::milliseconds::zero();
+        }
+        refreshRate = std::max(refreshRate, consumerRefreshRate);
+    }
+    if (refreshRate == 0) {
+        return std::chrono::milliseconds::zero();
+    }
+    return std::chrono::milliseconds(1000 / refreshRate);
+}
+
+void WindowThumbnail::invalidate()
+{
+    if (!m_dirty) {
+        m_dirty = true;
+        Q_EMIT repaintNeeded();
+    }
+}
+
+void WindowThumbnail::update()
+{
+    if (!m_dirty || !m_window) {
+        return;
+    }
+
+    const std::chrono::milliseconds interval = refreshInterval();
+    if (interval.count() > 0 && m_lastRenderTimer.isValid()) {
+        const qint64 remaining = interval.count() - m_lastRenderTimer.elapsed();
+        if (remaining > 0) {
+            // Come back once the consumers are allowed to see a new frame.
+            if (!m_throttleTimer.isActive()) {
+                m_throttleTimer.start(remaining);
+            }
+            return;
+        }
+    }
+
+    render();
+}
+
+void WindowThumbnail::render()
+{
+    if (!m_texture) {
+        const int levels = std::min(s_mipLevels, int(std::log2(std::max(m_size.width(), m_size.height()))) + 1);
+        m_texture.reset(new GLTexture(GL_RGBA8, m_size, levels));
+        m_texture->setFilter(GL_LINEAR_MIPMAP_LINEAR);
+        m_texture->setWrapMode(GL_CLAMP_TO_EDGE);
+        m_framebuffer.reset(new GLFramebuffer(m_texture.get()));
+    }
+
+    const QRectF geometry = m_window->visibleGeometry();
+
+    GLFramebuffer::pushFramebuffer(m_framebuffer.get());
+    glClearColor(0.0, 0.0, 0.0, 0.0);
+    glClear(GL_COLOR_BUFFER_BIT);
+
+    QMatrix4x4 projectionMatrix;
+    projectionMatrix.ortho(geometry.x(), geometry.x() + geometry.width(),
+                           geometry.y(), geometry.y() + geometry.height(), -1, 1);
+
+    WindowPaintData data;
+    data.setProjectionMatrix(projectionMatrix);
+
+    // The thumbnail must be rendered using kwin's opengl context as VAOs are not
+    // shared across contexts. Unfortunately, this also introduces a latency of 1
+    // frame, which is not ideal, but it is acceptable for things such as thumbnails.
+    const int mask = Scene::PAINT_WINDOW_TRANSFORMED;
+    Compositor::self()->scene()->render(m_window->windowItem(), mask, infiniteRegion(), data);
+    GLFramebuffer::popFramebuffer();
+
+    m_texture->bind();
+    m_texture->generateMipmaps();
+    m_texture->unbind();
+
+    // The fence is needed to avoid the case where qtquick renderer starts using
+    // the texture while all rendering commands to it haven't completed yet.
+    if (m_fence) {
+        glDeleteSync(m_fence);
+    }
+    m_fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+
+    m_dirty = false;
+    m_serial++;
+    m_lastRenderTimer.start();
+
+    Q_EMIT rendered();
+}
+
+WindowThumbnailCache *WindowThumbnailCache::s_self = nullptr;
+
+WindowThumbnailCache *WindowThumbnailCache::self()
+{
+    if (!s_self) {
+        s_self = new WindowThumbnailCache(Compositor::self());
+    }
+    return s_self;
+}
+
+WindowThumbnailCache::WindowThumbnailCache(QObject *parent)
+    : QObject(parent)
+{
+}
+
+WindowThumbnailCache::~WindowThumbnailCache()
+{
+    s_self = nullptr;
+}
+
+std::shared_ptr<WindowThumbnail> WindowThumbnailCache::thumbnail(Window *window, const QSize &size)
+{
+    for (auto it = m_thumbnails.find(window); it != m_thumbnails.end() && it.key() == window;) {
+        const std::shared_ptr<WindowThumbnail> thumbnail = it.value().lock();
+        // A destroyed window can leave a stale entry behind, which must not be handed out
+        // to a new window that happens to be allocated at the same address.
+        if (!thumbnail || thumbnail->window() != window) {
+            it = m_thumbnails.erase(it);
+            continue;
+        }
+        if (thumbnail->size() == size) {
+            return thumbnail;
+        }
+        ++it;
+    }
+
+    for (auto it = m_thumbnails.begin(); it != m_thumbnails.end();) {
+        if (it.value().expired()) {
+            it = m_thumbnails.erase(it);
+        } else {
+            ++it;
+        }
+    }
+
+    std::shared_ptr<WindowThumbnail> thumbnail = std::make_shared<WindowThumbnail>(window, size);
+    m_thumbnails.insert(window, thumbnail);
+    return thumbnail;
+}
+
+QSize WindowThumbnailCache::levelSize(const QSize &fullSize, const QSize &requestedSize)
+{
+    QSize size = fullSize;
+    for (int level = 0; level < s_maxLevel; ++level) {
+        const QSize next((size.width() + 1) / 2, (size.height() + 1) / 2);
+        if (next.width() < requestedSize.width() || next.height() < requestedSize.height()) {
+            break;
+        }
+        size = next;
+    }
+    return size;
+}
+
+} // namespace KWin
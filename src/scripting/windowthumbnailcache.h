@@ -0,0 +1,145 @@
+/*
+    KWin - the KDE window manager
+    This file is part of the KDE project.
+
+    SPDX-FileCopyrightText: 2022 KWin contributors
+
+    SPDX-License-Identifier: GPL-2.0-or-later
+*/
+
+#pragma once
+
+#include <QElapsedTimer>
+#include <QHash>
+#include <QMultiHash>
+#include <QObject>
+#include <QPointer>
+#include <QSize>
+#include <QTimer>
+
+#include <epoxy/gl.h>
+
+#include <chrono>
+#include <memory>
+
+namespace KWin
+{
+class Window;
+class GLFramebuffer;
+class GLTexture;
+
+/**
+ * The WindowThumbnail class represents an offscreen texture with the contents of a window
+ * at a particular size. A thumbnail is shared by all items that show the same window at
+ * the same size, it's rendered at most once per frame no matter how many items use it.
+ *
+ * The texture has mipmaps, so it can be sampled at smaller sizes without aliasing.
+ */
+class WindowThumbnail : public QObject
+{
+    Q_OBJECT
+
+public:
+    WindowThumbnail(Window *window, const QSize &size);
+    ~WindowThumbnail() override;
+
+    Window *window() const;
+    QSize size() const;
+
+    /**
+     * Returns the texture with the contents of the window, or @c null if the thumbnail
+     * hasn't been rendered yet.
+     */
+    std::shared_ptr<GLTexture> texture() const;
+
+    /**
+     * Returns a number that is incremented every time the texture is rendered.
+     */
+    quint64 serial() const;
+
+    /**
+     * Blocks until all rendering commands to the texture have completed.
+     */
+    void waitForRendering();
+
+    /**
+     * Limits the rate at which the thumbnail is re-rendered on behalf of the specified
+     * @a consumer to @a refreshRate frames per second, 0 means no limit. Since the texture
+     * is shared, the most demanding consumer determines the effective refresh rate.
+     */
+    void setMaximumRefreshRate(const QObject *consumer, int refreshRate);
+    void removeConsumer(const QObject *consumer);
+
+    /**
+     * Re-renders the thumbnail if the window has been damaged and the refresh rate allows
+     * it. This function must be called with kwin's OpenGL context current.
+     */
+    void update();
+
+Q_SIGNALS:
+    /**
+     * This signal is emitted when the thumbnail has to be re-rendered. The consumers
+     * should schedule a new frame in response.
+     */
+    void repaintNeeded();
+    /**
+     * This signal is emitted when the texture has been re-rendered.
+     */
+    void rendered();
+
+private:
+    void invalidate();
+    void render();
+    std::chrono::milliseconds refreshInterval() const;
+
+    QPointer<Window> m_window;
+    QSize m_size;
+    std::shared_ptr<GLTexture> m_texture;
+    std::unique_ptr<GLFramebuffer> m_framebuffer;
+    GLsync m_fence = 0;
+    quint64 m_serial = 0;
+    bool m_dirty = true;
+
+    QHash<const QObject *, int> m_maximumRefreshRates;
+    QElapsedTimer m_lastRenderTimer;
+    QTimer m_throttleTimer;
+};
+
+/**
+ * The WindowThumbnailCache class hands out shared window thumbnails.
+ *
+ * Thumbnails are keyed by the window and the texture size. In order to make sharing more
+ * likely and to avoid re-rendering a thumbnail every time the item showing it is resized,
+ * the requested size is rounded up to the nearest power-of-two fraction of the window size.
+ */
+class WindowThumbnailCache : public QObject
+{
+    Q_OBJECT
+
+public:
+    ~WindowThumbnailCache() override;
+
+    static WindowThumbnailCache *self();
+
+    /**
+     * Returns the thumbnail for the specified @a window with the specified texture @a size.
+     * The thumbnail is destroyed when the last reference to it is dropped, which must happen
+     * with kwin's OpenGL context current.
+     */
+    std::shared_ptr<WindowThumbnail> thumbnail(Window *window, const QSize &size);
+
+    /**
+     * Returns the smallest power-of-two fraction of @a fullSize that is at least as large
+     * as @a requestedSize. Thumbnails are never smaller than 1/16 of the window size.
+     */
+    static QSize levelSize(const QSize &fullSize, const QSize &requestedSize);
+
+private:
+    explicit WindowThumbnailCache(QObject *parent);
+
+    QMultiHash<Window *, std::weak_ptr<WindowThumbnail>> m_thumbnails;
+
+    static WindowThumbnailCache *s_self;
+};
+
+} // namespace KWin
@@ -15,6 +15,7 @@
 #include "virtualdesktops.h"
 #include "window.h"
 #include "windowitem.h"
+#include "windowthumbnailcache.h"
 #include "workspace.h"
 
 #include <kwingltexture.h>
@@ -25,6 +26,8 @@
 #include <QSGImageNode>
 #include <QSGTextureProvider>
 
+#include <cmath>
+
 namespace KWin
 {
 class ThumbnailTextureProvider : public QSGTextureProvider
@@ -61,13 +64,14 @@ void ThumbnailTextureProvider::setTexture(const std::shared_ptr<GLTexture> &nati
         m_texture.reset(m_window->createTextureFromNativeObject(QQuickWindow::NativeObjectTexture,
                                                                 &textureId, 0,
                                                                 nativeTexture->size(),
-                                                                QQuickWindow::TextureHasAlphaChannel));
+                                                                QQuickWindow::TextureHasAlphaChannel | QQuickWindow::TextureHasMipmaps));
 #else
         m_texture.reset(QNativeInterface::QSGOpenGLTexture::fromNative(textureId, m_window,
                                                                        nativeTexture->size(),
-                                                                       QQuickWindow::TextureHasAlphaChannel));
+                                                                       QQuickWindow::TextureHasAlphaChannel | QQuickWindow::TextureHasMipmaps));
 #endif
         m_texture->setFiltering(QSGTexture::Linear);
+        m_texture->setMipmapFiltering(QSGTexture::Linear);
         m_texture->setHorizontalWrapMode(QSGTexture::ClampToEdge);
         m_texture->setVerticalWrapMode(QSGTexture::ClampToEdge);
     }
@@ -112,6 +116,10 @@ WindowThumbnailItem::WindowThumbnailItem(QQuickItem *parent)
             this, &WindowThumbnailItem::updateFrameRenderingConnection);
     connect(this, &QQuickItem::windowChanged,
             this, &WindowThumbnailItem::updateFrameRenderingConnection);
+    connect(this, &QQuickItem::widthChanged,
+            this, &WindowThumbnailItem::invalidateOffscreenTexture);
+    connect(this, &QQuickItem::heightChanged,
+            this, &WindowThumbnailItem::invalidateOffscreenTexture);
 }
 
 WindowThumbnailItem::~WindowThumbnailItem()
@@ -183,6 +191,22 @@ void WindowThumbnailItem::setSourceSize(const QSize &sourceSize)
     }
 }
 
+int WindowThumbnailItem::maximumRefreshRate() const
+{
+    return m_maximumRefreshRate;
+}
+
+void WindowThumbnailItem::setMaximumRefreshRate(int refreshRate)
+{
+    if (m_maximumRefreshRate != refreshRate) {
+        m_maximumRefreshRate = refreshRate;
+        if (m_thumbnail) {
+            m_thumbnail->setMaximumRefreshRate(this, m_maximumRefreshRate);
+        }
+        Q_EMIT maximumRefreshRateChanged();
+    }
+}
+
 void WindowThumbnailItem::destroyOffscreenTexture()
 {
     if (!Compositor::compositing()) {
@@ -192,39 +216,51 @@ void WindowThumbnailItem::destroyOffscreenTexture()
         return;
     }
 
-    if (m_offscreenTexture) {
+    if (m_thumbnail) {
+        // The thumbnail may be the last reference to the offscreen texture.
         Scene *scene = Compositor::self()->scene();
         scene->makeOpenGLContextCurrent();
-        m_offscreenTarget.reset();
-        m_offscreenTexture.reset();
-
-        if (m_acquireFence) {
-            glDeleteSync(m_acquireFence);
-            m_acquireFence = 0;
-        }
+        setThumbnail(nullptr);
         scene->doneOpenGLContextCurrent();
     }
 }
 
+void WindowThumbnailItem::setThumbnail(const std::shared_ptr<WindowThumbnail> &thumbnail)
+{
+    if (m_thumbnail) {
+        m_thumbnail->removeConsumer(this);
+        disconnect(m_thumbnail.get(), nullptr, this, nullptr);
+    }
+
+    m_thumbnail = thumbnail;
+    m_thumbnailSerial = 0;
+
+    if (m_thumbnail) {
+        m_thumbnail->setMaximumRefreshRate(this, m_maximumRefreshRate);
+        connect(m_thumbnail.get(), &WindowThumbnail::repaintNeeded, this, &QQuickItem::update);
+        connect(m_thumbnail.get(), &WindowThumbnail::rendered, this, &QQuickItem::update);
+    }
+}
+
 QSGNode *WindowThumbnailItem::updatePaintNode(QSGNode *oldNode, QQuickItem::UpdatePaintNodeData *)
 {
-    if (Compositor::compositing() && !m_offscreenTexture) {
+    const std::shared_ptr<GLTexture> offscreenTexture = m_thumbnail ? m_thumbnail->texture() : nullptr;
+    if (Compositor::compositing() && !offscreenTexture) {
         return oldNode;
     }
 
     // Wait for rendering commands to the offscreen texture complete if there are any.
-    if (m_acquireFence) {
-        glClientWaitSync(m_acquireFence, GL_SYNC_FLUSH_COMMANDS_BIT, 5000);
-        glDeleteSync(m_acquireFence);
-        m_acquireFence = 0;
+    if (offscreenTexture && m_thumbnailSerial != m_thumbnail->serial()) {
+        m_thumbnail->waitForRendering();
+        m_thumbnailSerial = m_thumbnail->serial();
     }
 
     if (!m_provider) {
         m_provider = new ThumbnailTextureProvider(window());
     }
 
-    if (m_offscreenTexture) {
-        m_provider->setTexture(m_offscreenTexture);
+    if (offscreenTexture) {
+        m_provider->setTexture(offscreenTexture);
     } else {
         const QImage placeholderImage = fallbackImage();
         m_provider->setTexture(window()->createTextureFromImage(placeholderImage));
@@ -237,8 +273,9 @@ QSGNode *WindowThumbnailItem::updatePaintNode(QSGNode *oldNode, QQuickItem::Upda
         node->setFiltering(QSGTexture::Linear);
     }
     node->setTexture(m_provider->texture());
+    node->setMipmapFiltering(offscreenTexture ? QSGTexture::Linear : QSGTexture::None);
 
-    if (m_offscreenTexture && m_offscreenTexture->isYInverted()) {
+    if (offscreenTexture && offscreenTexture->isYInverted()) {
         node->setTextureCoordinatesTransform(QSGImageNode::MirrorVertically);
     } else {
         node->setTextureCoordinatesTransform(QSGImageNode::NoTransform);
@@ -316,8 +353,6 @@ void WindowThumbnailItem::setClient(Window *client)
     if (m_client) {
         disconnect(m_client, &Window::frameGeometryChanged,
                    this, &WindowThumbnailItem::invalidateOffscreenTexture);
-        disconnect(m_client, &Window::damaged,
-                   this, &WindowThumbnailItem::invalidateOffscreenTexture);
         disconnect(m_client, &Window::frameGeometryChanged,
                    this, &WindowThumbnailItem::updateImplicitSize);
     }
@@ -325,8 +360,6 @@ void WindowThumbnailItem::setClient(Window *client)
     if (m_client) {
         connect(m_client, &Window::frameGeometryChanged,
                 this, &WindowThumbnailItem::invalidateOffscreenTexture);
-        connect(m_client, &Window::damaged,
-                this, &WindowThumbnailItem::invalidateOffscreenTexture);
         connect(m_client, &Window::frameGeometryChanged,
                 this, &WindowThumbnailItem::updateImplicitSize);
         setWId(m_client->internalId());
@@ -368,7 +401,7 @@ QRectF WindowThumbnailItem::paintedRect() const
     if (!m_client) {
         return QRectF();
     }
-    if (!m_offscreenTexture) {
+    if (!m_thumbnail || !m_thumbnail->texture()) {
         const QSizeF iconSize = m_client->icon().actualSize(window(), boundingRect().size().toSize());
         return centeredSize(boundingRect(), iconSize);
     }
@@ -397,57 +430,51 @@ void WindowThumbnailItem::invalidateOffscreenTexture()
     update();
 }
 
-void WindowThumbnailItem::updateOffscreenTexture()
+QSize WindowThumbnailItem::thumbnailSize() const
 {
-    if (m_acquireFence || !m_dirty || !m_client) {
-        return;
-    }
-    Q_ASSERT(window());
-
     const QRectF geometry = m_client->visibleGeometry();
     QSize textureSize = geometry.toAlignedRect().size();
-    if (sourceSize().width() > 0) {
-        textureSize.setWidth(sourceSize().width());
-    }
-    if (sourceSize().height() > 0) {
-        textureSize.setHeight(sourceSize().height());
+    if (sourceSize().width() > 0 || sourceSize().height() > 0) {
+        if (sourceSize().width() > 0) {
+            textureSize.setWidth(sourceSize().width());
+        }
+        if (sourceSize().height() > 0) {
+            textureSize.setHeight(sourceSize().height());
+        }
+        return textureSize * m_devicePixelRatio;
     }
 
-    m_devicePixelRatio = window()->devicePixelRatio();
-    textureSize *= m_devicePixelRatio;
-
-    if (!m_offscreenTexture || m_offscreenTexture->size() != textureSize) {
-        m_offscreenTexture.reset(new GLTexture(GL_RGBA8, textureSize));
-        m_offscreenTexture->setFilter(GL_LINEAR);
-        m_offscreenTexture->setWrapMode(GL_CLAMP_TO_EDGE);
-        m_offscreenTarget.reset(new GLFramebuffer(m_offscreenTexture.get()));
+    // Without an explicit source size, render the window at the size it is displayed, rounded
+    // up to a fraction of the window size so the thumbnail can be shared with other items.
+    const QSizeF frameSize = m_client->frameGeometry().size();
+    if (frameSize.isEmpty()) {
+        return textureSize * m_devicePixelRatio;
     }
+    const QSizeF scaled = frameSize.scaled(boundingRect().size(), Qt::KeepAspectRatio);
+    const qreal scale = scaled.width() / frameSize.width() * m_devicePixelRatio;
+    const QSize requestedSize(std::ceil(geometry.width() * scale), std::ceil(geometry.height() * scale));
+    return WindowThumbnailCache::levelSize(textureSize * m_devicePixelRatio, requestedSize);
+}
 
-    GLFramebuffer::pushFramebuffer(m_offscreenTarget.get());
-    glClearColor(0.0, 0.0, 0.0, 0.0);
-    glClear(GL_COLOR_BUFFER_BIT);
-
-    QMatrix4x4 projectionMatrix;
-    projectionMatrix.ortho(geometry.x(), geometry.x() + geometry.width(),
-                           geometry.y(), geometry.y() + geometry.height(), -1, 1);
-
-    WindowPaintData data;
-    data.setProjectionMatrix(projectionMatrix);
+void WindowThumbnailItem::updateOffscreenTexture()
+{
+    if (!m_client) {
+        return;
+    }
+    Q_ASSERT(window());
 
-    // The thumbnail must be rendered using kwin's opengl context as VAOs are not
-    // shared across contexts. Unfortunately, this also introduces a latency of 1
-    // frame, which is not ideal, but it is acceptable for things such as thumbnails.
-    const int mask = Scene::PAINT_WINDOW_TRANSFORMED;
-    Compositor::self()->scene()->render(m_client->windowItem(), mask, infiniteRegion(), data);
-    GLFramebuffer::popFramebuffer();
+    if (m_dirty || !m_thumbnail) {
+        m_dirty = false;
+        m_devicePixelRatio = window()->devicePixelRatio();
 
-    // The fence is needed to avoid the case where qtquick renderer starts using
-    // the texture while all rendering commands to it haven't completed yet.
-    m_dirty = false;
-    m_acquireFence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+        const QSize textureSize = thumbnailSize();
+        if (!m_thumbnail || m_thumbnail->window() != m_client || m_thumbnail->size() != textureSize) {
+            setThumbnail(WindowThumbnailCache::self()->thumbnail(m_client, textureSize));
+        }
+    }
 
-    // We know that the texture has changed, so schedule an item update.
-    update();
+    // The thumbnail is shared, so it's rendered only once even if it's used by several items.
+    m_thumbnail->update();
 }
 
 } // namespace KWin
@@ -10,14 +10,13 @@
 #include <QQuickItem>
 #include <QUuid>
 
-#include <epoxy/gl.h>
+#include <memory>
 
 namespace KWin
 {
 class Window;
-class GLFramebuffer;
-class GLTexture;
 class ThumbnailTextureProvider;
+class WindowThumbnail;
 
 class WindowThumbnailItem : public QQuickItem
 {
@@ -26,6 +25,12 @@ class WindowThumbnailItem : public QQuickItem
     Q_PROPERTY(KWin::Window *client READ client WRITE setClient NOTIFY clientChanged)
 
     Q_PROPERTY(QSize sourceSize READ sourceSize WRITE setSourceSize NOTIFY sourceSizeChanged)
+    /**
+     * The maximum number of times per second the thumbnail is updated, 0 means no limit.
+     * Thumbnails of the same window are shared between items, so the item with the highest
+     * limit determines how often a shared thumbnail is updated. The default value is 0.
+     */
+    Q_PROPERTY(int maximumRefreshRate READ maximumRefreshRate WRITE setMaximumRefreshRate NOTIFY maximumRefreshRateChanged)
     /**
      * TODO Plasma 6: Remove.
      * @deprecated use a shader effect to change the brightness
@@ -64,6 +69,9 @@ public:
     QSize sourceSize() const;
     void setSourceSize(const QSize &sourceSize);
 
+    int maximumRefreshRate() const;
+    void setMaximumRefreshRate(int refreshRate);
+
     QSGTextureProvider *textureProvider() const override;
     bool isTextureProvider() const override;
     QSGNode *updatePaintNode(QSGNode *oldNode, QQuickItem::UpdatePaintNodeData *) override;
@@ -78,6 +86,7 @@ Q_SIGNALS:
     void saturationChanged();
     void clipToChanged();
     void sourceSizeChanged();
+    void maximumRefreshRateChanged();
 
 private:
     QImage fallbackImage() const;
@@ -85,6 +94,8 @@ private:
     void invalidateOffscreenTexture();
     void updateOffscreenTexture();
     void destroyOffscreenTexture();
+    void setThumbnail(const std::shared_ptr<WindowThumbnail> &thumbnail);
+    QSize thumbnailSize() const;
     void updateImplicitSize();
     void updateFrameRenderingConnection();
 
@@ -92,11 +103,11 @@ private:
     QUuid m_wId;
     QPointer<Window> m_client;
     bool m_dirty = false;
+    int m_maximumRefreshRate = 0;
 
     mutable ThumbnailTextureProvider *m_provider = nullptr;
-    std::shared_ptr<GLTexture> m_offscreenTexture;
-    std::unique_ptr<GLFramebuffer> m_offscreenTarget;
-    GLsync m_acquireFence = 0;
+    std::shared_ptr<WindowThumbnail> m_thumbnail;
+    quint64 m_thumbnailSerial = 0;
     qreal m_devicePixelRatio = 1;
 
     QMetaObject::Connection m_frameRenderingConnection;
@@ -41,6 +41,7 @@ void SurfaceItem::setSurfaceToBufferMatrix(const QMatrix4x4 &matrix)
 void SurfaceItem::addDamage(const QRegion &region)
 {
     m_damage += region;
+    invalidateSubtree();
     scheduleRepaint(region);
 
     Q_EMIT m_window->damaged(m_window, region);
@@ -87,6 +88,7 @@ void SurfaceItem::unreferencePreviousPixmap()
     m_referencePixmapCounter--;
     if (m_referencePixmapCounter == 0) {
         m_previousPixmap.reset();
+        invalidateSubtree();
     }
 }
 
@@ -8,18 +8,32 @@
 
 #include "kwin_export.h"
 
-#include <QList>
 #include <QRegion>
+#include <QVarLengthArray>
+
+#include <algorithm>
+#include <array>
 
 namespace KWin
 {
 
 /**
  * The DamageJournal class is a helper that tracks last N damage regions.
+ *
+ * The damage regions are stored in a fixed size ring buffer, so adding a damage region
+ * doesn't allocate memory for the journal itself. In order to keep scissoring and clipping
+ * cheap, damage regions that consist of more than maxRectCount() rectangles are coalesced
+ * into a smaller number of boxes. The coalesced region is always a superset of the original
+ * one, so it's safe to use it as a repaint region.
  */
 class KWIN_EXPORT DamageJournal
 {
 public:
+    /**
+     * The maximum capacity of a damage journal.
+     */
+    static constexpr int maximumCapacity = 16;
+
     /**
      * Returns the maximum number of damage regions that can be stored in the journal.
      */
@@ -30,11 +44,30 @@ public:
 
     /**
      * Sets the maximum number of damage regions that can be stored in the journal
-     * to @a capacity.
+     * to @a capacity. The capacity can't exceed maximumCapacity.
      */
     void setCapacity(int capacity)
     {
-        m_capacity = capacity;
+        m_capacity = std::clamp(capacity, 1, maximumCapacity);
+        m_count = std::min(m_count, m_capacity);
+    }
+
+    /**
+     * Returns the maximum number of rectangles in a damage region. If a region has more
+     * rectangles, it will be simplified. If the value is @c 0, the damage regions are never
+     * simplified.
+     */
+    int maxRectCount() const
+    {
+        return m_maxRectCount;
+    }
+
+    /**
+     * Sets the maximum number of rectangles in a damage region to @a count.
+     */
+    void setMaxRectCount(int count)
+    {
+        m_maxRectCount = count;
     }
 
     /**
@@ -42,10 +75,9 @@ public:
      */
     void add(const QRegion &region)
     {
-        while (m_log.size() >= m_capacity) {
-            m_log.takeLast();
-        }
-        m_log.prepend(region);
+        m_head = (m_head + 1) % maximumCapacity;
+        m_log[m_head] = simplified(region);
+        m_count = std::min(m_count + 1, m_capacity);
     }
 
     /**
@@ -54,7 +86,7 @@ public:
      */
     void clear()
     {
-        m_log.clear();
+        m_count = 0;
     }
 
     /**
@@ -66,10 +98,11 @@ public:
     QRegion accumulate(int bufferAge, const QRegion &fallback = QRegion()) const
     {
         QRegion region;
-        if (bufferAge > 0 && bufferAge <= m_log.size()) {
+        if (bufferAge > 0 && bufferAge <= m_count) {
             for (int i = 0; i < bufferAge - 1; ++i) {
-                region |= m_log[i];
+                region |= m_log[(m_head - i + maximumCapacity) % maximumCapacity];
             }
+            region = simplified(region);
         } else {
             region = fallback;
         }
@@ -78,12 +111,57 @@ public:
 
     QRegion lastDamage() const
     {
-        return m_log.first();
+        return m_count ? m_log[m_head] : QRegion();
     }
 
 private:
-    QList<QRegion> m_log;
+    /**
+     * Coalesces the rectangles of the specified @a region so the result has at most
+     * maxRectCount() rectangles. The rectangles in a QRegion are sorted in the y-x banded
+     * order, so neighbor rectangles are merged together in spatially coherent boxes.
+     */
+    QRegion simplified(const QRegion &region) const
+    {
+        const int rectCount = region.rectCount();
+        if (!m_maxRectCount || rectCount <= m_maxRectCount) {
+            return region;
+        }
+
+        const int groupSize = (rectCount + m_maxRectCount - 1) / m_maxRectCount;
+        QVarLengthArray<QRect, 64> boxes;
+
+        QRect box;
+        int groupIndex = 0;
+        for (const QRect &rect : region) {
+            box |= rect;
+            if (++groupIndex == groupSize) {
+                boxes.append(box);
+                box = QRect();
+                groupIndex = 0;
+            }
+        }
+        if (!box.isNull()) {
+            boxes.append(box);
+        }
+
+        QRegion result;
+        for (const QRect &rect : std::as_const(boxes)) {
+            result += rect;
+        }
+
+        // The boxes may overlap each other, in which case their union can be split into
+        // more rectangles than allowed.
+        if (result.rectCount() > m_maxRectCount) {
+            return region.boundingRect();
+        }
+        return result;
+    }
+
+    std::array<QRegion, maximumCapacity> m_log;
+    int m_head = 0;
+    int m_count = 0;
     int m_capacity = 10;
+    int m_maxRectCount = 64;
 };
 
 } // namespace KWin
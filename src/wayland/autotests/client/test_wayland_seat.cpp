@@ -44,6 +44,8 @@
 #include <linux/input.h>
 // System
 #include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 #include <unistd.h>
 
 class TestWaylandSeat : public QObject
@@ -78,6 +80,7 @@ private Q_SLOTS:
     void testDataDeviceForKeyboardSurface();
     void testTouch();
     void testKeymap();
+    void testSharedKeymap();
 
 private:
     KWaylandServer::Display *m_display;
@@ -2088,7 +2091,7 @@ void TestWaylandSeat::testKeymap()
     QVERIFY(keymapChangedSpy.wait());
     int fd = keymapChangedSpy.first().first().toInt();
     QVERIFY(fd != -1);
-    QCOMPARE(keymapChangedSpy.first().last().value<quint32>(), 3u);
+    QCOMPARE(keymapChangedSpy.first().last().value<quint32>(), 4u);
     QFile file;
     QVERIFY(file.open(fd, QIODevice::ReadOnly));
     const char *address = reinterpret_cast<char *>(file.map(0, keymapChangedSpy.first().last().value<quint32>()));
@@ -2102,12 +2105,98 @@ void TestWaylandSeat::testKeymap()
     QVERIFY(keymapChangedSpy.wait());
     fd = keymapChangedSpy.first().first().toInt();
     QVERIFY(fd != -1);
-    QCOMPARE(keymapChangedSpy.first().last().value<quint32>(), 3u);
+    QCOMPARE(keymapChangedSpy.first().last().value<quint32>(), 4u);
     QVERIFY(file.open(fd, QIODevice::ReadWrite));
     address = reinterpret_cast<char *>(file.map(0, keymapChangedSpy.first().last().value<quint32>()));
     QVERIFY(address);
     QCOMPARE(qstrcmp(address, "bar"), 0);
 }
 
+struct KeymapEvent
+{
+    int fd;
+    quint32 size;
+};
+
+static const wl_registry_listener s_registryListener = {
+    .global = [](void *data, wl_registry *, uint32_t name, const char *interface, uint32_t) {
+        if (qstrcmp(interface, wl_seat_interface.name) == 0) {
+            *static_cast<quint32 *>(data) = name;
+        }
+    },
+    .global_remove = [](void *, wl_registry *, uint32_t) {},
+};
+
+static const wl_keyboard_listener s_keyboardListener = {
+    .keymap = [](void *data, wl_keyboard *, uint32_t, int32_t fd, uint32_t size) {
+        static_cast<QVector<KeymapEvent> *>(data)->append(KeymapEvent{fd, size});
+    },
+    .enter = [](void *, wl_keyboard *, uint32_t, wl_surface *, wl_array *) {},
+    .leave = [](void *, wl_keyboard *, uint32_t, wl_surface *) {},
+    .key = [](void *, wl_keyboard *, uint32_t, uint32_t, uint32_t, uint32_t) {},
+    .modifiers = [](void *, wl_keyboard *, uint32_t, uint32_t, uint32_t, uint32_t, uint32_t) {},
+    .repeat_info = [](void *, wl_keyboard *, int32_t, int32_t) {},
+};
+
+void TestWaylandSeat::testSharedKeymap()
+{
+    // This test verifies that keyboards bound with version 7 of wl_seat get the same sealed
+    // keymap file. KWayland binds older versions, so the test goes through the raw protocol.
+    m_seatInterface->setHasKeyboard(true);
+    m_seatInterface->keyboard()->setKeymap(QByteArrayLiteral("foo"));
+
+    wl_registry *registry = wl_display_get_registry(m_connection->display());
+    m_queue->addProxy(registry);
+    quint32 seatName = 0;
+    wl_registry_add_listener(registry, &s_registryListener, &seatName);
+    m_connection->flush();
+    QTRY_VERIFY(seatName != 0);
+
+    auto seat = static_cast<wl_seat *>(wl_registry_bind(registry, seatName, &wl_seat_interface, 7));
+    QVector<KeymapEvent> keymaps;
+    wl_keyboard *keyboards[] = {wl_seat_get_keyboard(seat), wl_seat_get_keyboard(seat)};
+    for (wl_keyboard *keyboard : keyboards) {
+        wl_keyboard_add_listener(keyboard, &s_keyboardListener, &keymaps);
+    }
+    m_connection->flush();
+    QTRY_COMPARE(keymaps.count(), 2);
+
+    for (const KeymapEvent &keymap : std::as_const(keymaps)) {
+        // the advertised size includes the terminating null byte
+        QCOMPARE(keymap.size, 4u);
+        void *address = mmap(nullptr, keymap.size, PROT_READ, MAP_PRIVATE, keymap.fd, 0);
+        QVERIFY(address != MAP_FAILED);
+        QCOMPARE(static_cast<const char *>(address)[3], '\0');
+        QCOMPARE(qstrcmp(static_cast<const char *>(address), "foo"), 0);
+        munmap(address, keymap.size);
+
+#ifdef F_SEAL_SEAL
+        // the file is shared, so nobody may be able to modify it
+        const int seals = fcntl(keymap.fd, F_GET_SEALS);
+        QVERIFY(seals != -1);
+        QVERIFY(seals & F_SEAL_WRITE);
+        QVERIFY(seals & F_SEAL_SHRINK);
+        QCOMPARE(mmap(nullptr, keymap.size, PROT_READ | PROT_WRITE, MAP_SHARED, keymap.fd, 0), MAP_FAILED);
+#endif
+    }
+
+    struct stat first;
+    struct stat second;
+    QCOMPARE(fstat(keymaps[0].fd, &first), 0);
+    QCOMPARE(fstat(keymaps[1].fd, &second), 0);
+    QCOMPARE(first.st_dev, second.st_dev);
+    QCOMPARE(first.st_ino, second.st_ino);
+
+    for (const KeymapEvent &keymap : std::as_const(keymaps)) {
+        close(keymap.fd);
+    }
+    for (wl_keyboard *keyboard : keyboards) {
+        wl_keyboard_release(keyboard);
+    }
+    wl_seat_release(seat);
+    wl_registry_destroy(registry);
+    m_connection->flush();
+}
+
 QTEST_GUILESS_MAIN(TestWaylandSeat)
 #include "test_wayland_seat.moc"
@@ -30,6 +30,8 @@ private Q_SLOTS:
     void testConnectNoSocket();
     void testOutputManagement();
     void testAutoSocketName();
+    void testFlushStatistics();
+    void testDisconnectSlowClient();
 };
 
 void TestWaylandServerDisplay::testSocketName()
@@ -209,5 +211,77 @@ void TestWaylandServerDisplay::testAutoSocketName()
     QCOMPARE(socketNameChangedSpy1.count(), 1);
 }
 
+void TestWaylandServerDisplay::testFlushStatistics()
+{
+    KWaylandServer::Display display;
+    display.start();
+
+    int sv[2];
+    QVERIFY(socketpair(AF_UNIX, SOCK_STREAM, 0, sv) >= 0);
+    wl_client *client = wl_client_create(display, sv[0]);
+    QVERIFY(client);
+    ClientConnection *connection = display.getConnection(client);
+    QVERIFY(connection);
+
+    wl_resource *callback = wl_resource_create(client, &wl_callback_interface, 1, 0);
+    QVERIFY(callback);
+    wl_callback_send_done(callback, 42);
+
+    // The event consists of the header and one uint argument.
+    QCOMPARE(connection->flushStatistics().messages, quint64(1));
+    QCOMPARE(connection->flushStatistics().bytes, quint64(12));
+    QCOMPARE(connection->flushStatistics().pendingBytes, quint64(12));
+    QCOMPARE(connection->flushStatistics().flushes, quint64(0));
+
+    connection->flush();
+    QCOMPARE(connection->flushStatistics().pendingBytes, quint64(0));
+    QCOMPARE(connection->flushStatistics().flushes, quint64(1));
+#ifdef Q_OS_LINUX
+    // Nobody reads from the other end of the socket.
+    QVERIFY(connection->flushStatistics().backlogBytes > 0);
+    QVERIFY(connection->flushStatistics().peakBacklogBytes >= connection->flushStatistics().backlogBytes);
+#endif
+
+    wl_client_destroy(client);
+    close(sv[1]);
+}
+
+void TestWaylandServerDisplay::testDisconnectSlowClient()
+{
+#ifndef Q_OS_LINUX
+    QSKIP("The socket backlog can only be measured on Linux");
+#endif
+    KWaylandServer::Display display;
+    display.setSlowClientPolicy(KWaylandServer::Display::SlowClientPolicy::Disconnect);
+    display.setSlowClientThreshold(1);
+    display.setSlowClientTimeout(std::chrono::milliseconds(10));
+    display.start();
+
+    int sv[2];
+    QVERIFY(socketpair(AF_UNIX, SOCK_STREAM, 0, sv) >= 0);
+    wl_client *client = wl_client_create(display, sv[0]);
+    QVERIFY(client);
+    ClientConnection *connection = display.getConnection(client);
+    QVERIFY(connection);
+    QSignalSpy disconnectedSpy(&display, &KWaylandServer::Display::clientDisconnected);
+    QVERIFY(disconnectedSpy.isValid());
+
+    wl_resource *callback = wl_resource_create(client, &wl_callback_interface, 1, 0);
+    QVERIFY(callback);
+
+    // The client becomes slow as it never reads, but it's not disconnected right away.
+    wl_callback_send_done(callback, 1);
+    QVERIFY(QMetaObject::invokeMethod(&display, "flush"));
+    QVERIFY(disconnectedSpy.isEmpty());
+    QCOMPARE(connection->flushStatistics().flushes, quint64(1));
+
+    QTest::qWait(20);
+    wl_callback_send_done(callback, 2);
+    QVERIFY(QMetaObject::invokeMethod(&display, "flush"));
+    QCOMPARE(disconnectedSpy.count(), 1);
+
+    close(sv[1]);
+}
+
 QTEST_GUILESS_MAIN(TestWaylandServerDisplay)
 #include "test_display.moc"
@@ -4,38 +4,26 @@
     SPDX-License-Identifier: LGPL-2.1-only OR LGPL-3.0-only OR LicenseRef-KDE-Accepted-LGPL
 */
 #include "clientconnection.h"
+#include "clientconnection_p.h"
 #include "display.h"
+#include "display_p.h"
 #include "utils/executable_path.h"
 // Qt
 #include <QFileInfo>
+#include <QSocketNotifier>
 #include <QVector>
 // Wayland
 #include <wayland-server.h>
+// system
+#include <algorithm>
+#include <sys/ioctl.h>
+#include <sys/socket.h>
+#if defined(Q_OS_LINUX)
+#include <linux/sockios.h>
+#endif
 
 namespace KWaylandServer
 {
-class ClientConnectionPrivate
-{
-public:
-    ClientConnectionPrivate(wl_client *c, Display *display, ClientConnection *q);
-    ~ClientConnectionPrivate();
-
-    wl_client *client;
-    Display *display;
-    pid_t pid = 0;
-    uid_t user = 0;
-    gid_t group = 0;
-    QString executablePath;
-
-    qreal scaleOverride = 1.0;
-
-private:
-    static void destroyListenerCallback(wl_listener *listener, void *data);
-    ClientConnection *q;
-    wl_listener listener;
-    static QVector<ClientConnectionPrivate *> s_allClients;
-};
-
 QVector<ClientConnectionPrivate *> ClientConnectionPrivate::s_allClients;
 
 ClientConnectionPrivate::ClientConnectionPrivate(wl_client *c, Display *display, ClientConnection *q)
@@ -44,20 +32,100 @@ ClientConnectionPrivate::ClientConnectionPrivate(wl_client *c, Display *display,
     , q(q)
 {
     s_allClients << this;
-    listener.notify = destroyListenerCallback;
-    wl_client_add_destroy_listener(c, &listener);
+    destroyListener.listener.notify = destroyListenerCallback;
+    destroyListener.connection = this;
+    wl_client_add_destroy_listener(c, &destroyListener.listener);
     wl_client_get_credentials(client, &pid, &user, &group);
     executablePath = executablePathFromPid(pid);
+
+    socklen_t length = sizeof(sendBufferSize);
+    if (getsockopt(wl_client_get_fd(client), SOL_SOCKET, SO_SNDBUF, &sendBufferSize, &length) != 0) {
+        sendBufferSize = 0;
+    }
 }
 
 ClientConnectionPrivate::~ClientConnectionPrivate()
 {
     if (client) {
-        wl_list_remove(&listener.link);
+        wl_list_remove(&destroyListener.listener.link);
+        DisplayPrivate::get(display)->forgetConnection(this);
     }
     s_allClients.removeAt(s_allClients.indexOf(this));
 }
 
+ClientConnectionPrivate *ClientConnectionPrivate::get(ClientConnection *connection)
+{
+    return connection->d.get();
+}
+
+ClientConnectionPrivate *ClientConnectionPrivate::get(wl_client *client)
+{
+    wl_listener *listener = wl_client_get_destroy_listener(client, destroyListenerCallback);
+    if (!listener) {
+        return nullptr;
+    }
+    DestroyListener *destroyListener = wl_container_of(listener, destroyListener, listener);
+    return destroyListener->connection;
+}
+
+void ClientConnectionPrivate::flush()
+{
+    if (!client) {
+        return;
+    }
+
+    wl_client_flush(client);
+
+    // wl_client_flush() doesn't report whether everything has been written, libwayland keeps
+    // what doesn't fit in the socket buffer. Writing to a Unix socket only fails once the queued
+    // data reaches the send buffer size, so the client is blocked if SIOCOUTQ reports that much.
+    const int fd = wl_client_get_fd(client);
+    blocked = false;
+#ifdef SIOCOUTQ
+    int backlog = 0;
+    if (ioctl(fd, SIOCOUTQ, &backlog) == 0) {
+        statistics.backlogBytes = backlog;
+        statistics.peakBacklogBytes = std::max(statistics.peakBacklogBytes, statistics.backlogBytes);
+        blocked = sendBufferSize > 0 && backlog >= sendBufferSize;
+    }
+#endif
+
+    statistics.flushes++;
+    if (!blocked) {
+        statistics.pendingBytes = 0;
+    }
+    lastFlushTimer.start();
+
+    if (isSlow()) {
+        if (!slowTimer.isValid()) {
+            slowTimer.start();
+        }
+        statistics.slowDuration = std::chrono::milliseconds(slowTimer.elapsed());
+    } else {
+        slowTimer.invalidate();
+        statistics.slowDuration = std::chrono::milliseconds::zero();
+    }
+
+    // libwayland keeps what couldn't be written, try again once the client has read something.
+    if (blocked) {
+        DisplayPrivate::get(display)->scheduleFlush(this);
+        if (!writeNotifier) {
+            writeNotifier = new QSocketNotifier(fd, QSocketNotifier::Write, q);
+            QObject::connect(writeNotifier, &QSocketNotifier::activated, q, [this]() {
+                writeNotifier->setEnabled(false);
+            });
+        }
+        writeNotifier->setEnabled(true);
+    } else if (writeNotifier) {
+        writeNotifier->setEnabled(false);
+    }
+}
+
+bool ClientConnectionPrivate::isSlow() const
+{
+    return blocked || statistics.backlogBytes >= DisplayPrivate::get(display)->slowClientThreshold;
+}
+
 void ClientConnectionPrivate::destroyListenerCallback(wl_listener *listener, void *data)
 {
     Q_UNUSED(listener)
@@ -70,7 +138,11 @@ void ClientConnectionPrivate::destroyListenerCallback(wl_listener *listener, voi
     auto q = p->q;
     Q_EMIT q->aboutToBeDestroyed();
     p->client = nullptr;
-    wl_list_remove(&p->listener.link);
+    wl_list_remove(&p->destroyListener.listener.link);
+    DisplayPrivate::get(p->display)->forgetConnection(p);
+    if (p->writeNotifier) {
+        p->writeNotifier->setEnabled(false);
+    }
     Q_EMIT q->disconnected(q);
     q->deleteLater();
 }
@@ -85,10 +157,7 @@ ClientConnection::~ClientConnection() = default;
 
 void ClientConnection::flush()
 {
-    if (!d->client) {
-        return;
-    }
-    wl_client_flush(d->client);
+    d->flush();
 }
 
 void ClientConnection::destroy()
@@ -157,4 +226,9 @@ qreal ClientConnection::scaleOverride() const
 {
     return d->scaleOverride;
 }
+
+ClientConnection::FlushStatistics ClientConnection::flushStatistics() const
+{
+    return d->statistics;
+}
 }
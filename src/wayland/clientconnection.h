@@ -10,6 +10,7 @@
 #include <sys/types.h>
 
 #include <QObject>
+#include <chrono>
 #include <memory>
 
 struct wl_client;
@@ -125,6 +126,58 @@ public:
     void setScaleOverride(qreal scaleOverride);
     qreal scaleOverride() const;
 
+    /**
+     * The FlushStatistics struct describes how well the client keeps up with the events
+     * sent to it.
+     *
+     * @since 5.26
+     */
+    struct FlushStatistics
+    {
+        /**
+         * The number of events sent to the client.
+         */
+        quint64 messages = 0;
+        /**
+         * The number of bytes of events sent to the client.
+         */
+        quint64 bytes = 0;
+        /**
+         * The number of bytes of events queued since the client was last flushed.
+         */
+        quint64 pendingBytes = 0;
+        /**
+         * The socket memory taken by the events the client hadn't read after the last
+         * flush, in bytes. Only measured on Linux.
+         */
+        quint64 backlogBytes = 0;
+        /**
+         * The largest backlog seen so far.
+         */
+        quint64 peakBacklogBytes = 0;
+        /**
+         * The number of times the client has been flushed.
+         */
+        quint64 flushes = 0;
+        /**
+         * The number of flushes that have been postponed because the client is slow.
+         */
+        quint64 throttledFlushes = 0;
+        /**
+         * For how long the client has been slow, or zero if the client keeps up.
+         *
+         * @see Display::setSlowClientThreshold()
+         */
+        std::chrono::milliseconds slowDuration = std::chrono::milliseconds::zero();
+    };
+
+    /**
+     * Returns the statistics of the events sent to this client.
+     *
+     * @since 5.26
+     */
+    FlushStatistics flushStatistics() const;
+
 Q_SIGNALS:
     /**
      * This signal is emitted when the client is about to be destroyed.
@@ -139,6 +192,7 @@ Q_SIGNALS:
 
 private:
     friend class Display;
+    friend class ClientConnectionPrivate;
     explicit ClientConnection(wl_client *c, Display *parent);
     std::unique_ptr<ClientConnectionPrivate> d;
 };
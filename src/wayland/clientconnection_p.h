@@ -0,0 +1,74 @@
+/*
+    SPDX-FileCopyrightText: 2014 Martin Gräßlin <mgraesslin@kde.org>
+    SPDX-FileCopyrightText: 2022 KWin contributors
+
+    SPDX-License-Identifier: LGPL-2.1-only OR LGPL-3.0-only OR LicenseRef-KDE-Accepted-LGPL
+*/
+#pragma once
+
+#include "clientconnection.h"
+
+#include <QElapsedTimer>
+#include <QString>
+#include <QVector>
+
+#include <wayland-server-core.h>
+
+class QSocketNotifier;
+
+namespace KWaylandServer
+{
+class ClientConnectionPrivate
+{
+public:
+    ClientConnectionPrivate(wl_client *c, Display *display, ClientConnection *q);
+    ~ClientConnectionPrivate();
+
+    static ClientConnectionPrivate *get(ClientConnection *connection);
+    /**
+     * Returns the private data of the ClientConnection for the @a client, or @c null if none
+     * has been created for it yet.
+     */
+    static ClientConnectionPrivate *get(wl_client *client);
+
+    /**
+     * Flushes the events queued for the client and updates the flush statistics. If the
+     * socket is full, the client will be flushed again once it becomes writable.
+     */
+    void flush();
+    bool isSlow() const;
+
+    wl_client *client;
+    Display *display;
+    pid_t pid = 0;
+    uid_t user = 0;
+    gid_t group = 0;
+    QString executablePath;
+
+    qreal scaleOverride = 1.0;
+
+    ClientConnection::FlushStatistics statistics;
+    // Whether the client is waiting in the queue of the display to be flushed.
+    bool flushScheduled = false;
+    // Whether the last flush couldn't write everything because the socket was full.
+    bool blocked = false;
+    // The size of the send buffer of the socket, or 0 if unknown.
+    int sendBufferSize = 0;
+    QElapsedTimer lastFlushTimer;
+    QElapsedTimer slowTimer;
+
+    ClientConnection *q;
+
+private:
+    static void destroyListenerCallback(wl_listener *listener, void *data);
+    struct DestroyListener
+    {
+        wl_listener listener;
+        ClientConnectionPrivate *connection;
+    };
+    DestroyListener destroyListener;
+    QSocketNotifier *writeNotifier = nullptr;
+    static QVector<ClientConnectionPrivate *> s_allClients;
+};
+
+} // namespace KWaylandServer
@@ -6,6 +6,7 @@
 */
 #include "display.h"
 #include "clientbufferintegration.h"
+#include "clientconnection_p.h"
 #include "display_p.h"
 #include "drmclientbuffer.h"
 #include "output_interface.h"
@@ -16,6 +17,9 @@
 #include <QCoreApplication>
 #include <QDebug>
 #include <QRect>
+#include <QTimer>
+
+#include <utility>
 
 namespace KWaylandServer
 {
@@ -35,17 +39,139 @@ void DisplayPrivate::registerSocketName(const QString &socketName)
     Q_EMIT q->socketNamesChanged();
 }
 
+void DisplayPrivate::scheduleFlush(ClientConnectionPrivate *connection)
+{
+    if (!connection->flushScheduled) {
+        connection->flushScheduled = true;
+        scheduledFlushes.append(connection);
+    }
+}
+
+void DisplayPrivate::unscheduleFlush(ClientConnectionPrivate *connection)
+{
+    if (connection->flushScheduled) {
+        connection->flushScheduled = false;
+        scheduledFlushes.removeOne(connection);
+    }
+}
+
+void DisplayPrivate::forgetConnection(ClientConnectionPrivate *connection)
+{
+    unscheduleFlush(connection);
+    if (lastEventConnection == connection) {
+        lastEventClient = nullptr;
+        lastEventConnection = nullptr;
+    }
+}
+
+// Returns the size of the message on the wire if none of its arguments has a variable size,
+// otherwise -1. The file descriptors are sent separately.
+static qint64 fixedMessageSize(const wl_message *message)
+{
+    qint64 size = 8; // The header: object id, opcode and size.
+    for (const char *signature = message->signature; *signature; ++signature) {
+        switch (*signature) {
+        case 'i':
+        case 'u':
+        case 'f':
+        case 'o':
+        case 'n':
+            size += 4;
+            break;
+        case 's':
+        case 'a':
+            return -1;
+        default:
+            // The file descriptors, the version number and the nullable marker.
+            break;
+        }
+    }
+    return size;
+}
+
+// Returns the size of the message on the wire, the file descriptors are sent separately.
+static quint64 messageSize(const wl_protocol_logger_message *message)
+{
+    auto padded = [](quint64 size) {
+        return (size + 3) & ~quint64(3);
+    };
+
+    quint64 size = 8; // The header: object id, opcode and size.
+    int argument = 0;
+    for (const char *signature = message->message->signature; *signature && argument < message->arguments_count; ++signature) {
+        const wl_argument &value = message->arguments[argument];
+        switch (*signature) {
+        case 'i':
+        case 'u':
+        case 'f':
+        case 'o':
+        case 'n':
+            size += 4;
+            break;
+        case 's':
+            size += 4 + (value.s ? padded(qstrlen(value.s) + 1) : 0);
+            break;
+        case 'a':
+            size += 4 + (value.a ? padded(value.a->size) : 0);
+            break;
+        case 'h':
+            break;
+        default:
+            // The version number and the nullable marker aren't arguments.
+            continue;
+        }
+        ++argument;
+    }
+    return size;
+}
+
+void DisplayPrivate::logProtocolMessage(void *userData, wl_protocol_logger_type type, const wl_protocol_logger_message *message)
+{
+    if (type != WL_PROTOCOL_LOGGER_EVENT) {
+        return;
+    }
+
+    DisplayPrivate *display = static_cast<DisplayPrivate *>(userData);
+    wl_client *client = wl_resource_get_client(message->resource);
+    if (client != display->lastEventClient) {
+        ClientConnectionPrivate *connection = ClientConnectionPrivate::get(client);
+        if (!connection) {
+            display->untrackedFlushPending = true;
+            return;
+        }
+        display->lastEventClient = client;
+        display->lastEventConnection = connection;
+    }
+    ClientConnectionPrivate *connection = display->lastEventConnection;
+
+    auto it = display->eventSizes.constFind(message->message);
+    if (it == display->eventSizes.constEnd()) {
+        it = display->eventSizes.insert(message->message, fixedMessageSize(message->message));
+    }
+    const quint64 size = *it >= 0 ? quint64(*it) : messageSize(message);
+    connection->statistics.messages++;
+    connection->statistics.bytes += size;
+    connection->statistics.pendingBytes += size;
+    display->scheduleFlush(connection);
+}
+
 Display::Display(QObject *parent)
     : QObject(parent)
     , d(new DisplayPrivate(this))
 {
     d->display = wl_display_create();
     d->loop = wl_display_get_event_loop(d->display);
+    d->protocolLogger = wl_display_add_protocol_logger(d->display, DisplayPrivate::logProtocolMessage, d.get());
+
+    d->throttleTimer = new QTimer(this);
+    d->throttleTimer->setSingleShot(true);
+    connect(d->throttleTimer, &QTimer::timeout, this, &Display::flush);
 }
 
 Display::~Display()
 {
     wl_display_destroy_clients(d->display);
+    wl_protocol_logger_destroy(d->protocolLogger);
     wl_display_destroy(d->display);
 }
 
@@ -118,7 +244,70 @@ void Display::dispatchEvents()
 
 void Display::flush()
 {
-    wl_display_flush_clients(d->display);
+    // The clients without a ClientConnection can't be tracked, flush everyone in that case.
+    if (d->untrackedFlushPending) {
+        d->untrackedFlushPending = false;
+        wl_display_flush_clients(d->display);
+    }
+
+    const QVector<ClientConnectionPrivate *> connections = std::exchange(d->scheduledFlushes, {});
+    QVector<ClientConnection *> stalledConnections;
+    for (ClientConnectionPrivate *connection : connections) {
+        connection->flushScheduled = false;
+
+        if (d->slowClientPolicy == SlowClientPolicy::Throttle && connection->isSlow() && connection->lastFlushTimer.isValid()) {
+            const qint64 remaining = d->slowClientTimeout.count() - connection->lastFlushTimer.elapsed();
+            if (remaining > 0) {
+                connection->statistics.throttledFlushes++;
+                d->scheduleFlush(connection);
+                if (!d->throttleTimer->isActive() || d->throttleTimer->remainingTime() > remaining) {
+                    d->throttleTimer->start(remaining);
+                }
+                continue;
+            }
+        }
+
+        connection->flush();
+
+        if (d->slowClientPolicy == SlowClientPolicy::Disconnect && connection->statistics.slowDuration >= d->slowClientTimeout) {
+            stalledConnections.append(connection->q);
+        }
+    }
+
+    for (ClientConnection *connection : std::as_const(stalledConnections)) {
+        qCWarning(KWIN_CORE) << "Disconnecting" << connection->executablePath() << "because it doesn't read its events";
+        connection->destroy();
+    }
+}
+
+void Display::setSlowClientPolicy(SlowClientPolicy policy)
+{
+    d->slowClientPolicy = policy;
+}
+
+Display::SlowClientPolicy Display::slowClientPolicy() const
+{
+    return d->slowClientPolicy;
+}
+
+void Display::setSlowClientThreshold(quint64 bytes)
+{
+    d->slowClientThreshold = bytes;
+}
+
+quint64 Display::slowClientThreshold() const
+{
+    return d->slowClientThreshold;
+}
+
+void Display::setSlowClientTimeout(std::chrono::milliseconds timeout)
+{
+    d->slowClientTimeout = timeout;
+}
+
+std::chrono::milliseconds Display::slowClientTimeout() const
+{
+    return d->slowClientTimeout;
 }
 
 void Display::createShm()
@@ -11,6 +11,8 @@
 #include <QList>
 #include <QObject>
 
+#include <chrono>
+
 #include "clientconnection.h"
 
 struct wl_client;
@@ -146,6 +148,54 @@ public:
      */
     ClientBuffer *clientBufferForResource(wl_resource *resource) const;
 
+    /**
+     * This enum type specifies what happens to the clients that don't read the events sent
+     * to them fast enough.
+     *
+     * @since 5.26
+     */
+    enum class SlowClientPolicy {
+        /**
+         * Slow clients are flushed like all other clients.
+         */
+        Flush,
+        /**
+         * Slow clients are flushed at most once per slowClientTimeout(), so their events
+         * are written in batches.
+         */
+        Throttle,
+        /**
+         * Clients that have been slow for longer than slowClientTimeout() are disconnected.
+         */
+        Disconnect,
+    };
+
+    /**
+     * Sets the policy for the clients that don't keep up with their events. The default
+     * policy is SlowClientPolicy::Flush.
+     *
+     * @since 5.26
+     */
+    void setSlowClientPolicy(SlowClientPolicy policy);
+    SlowClientPolicy slowClientPolicy() const;
+
+    /**
+     * Sets how many bytes a client may leave unread in its socket before it's considered
+     * slow. A client is also slow if its socket is full. The default threshold is 64 KiB.
+     *
+     * @since 5.26
+     */
+    void setSlowClientThreshold(quint64 bytes);
+    quint64 slowClientThreshold() const;
+
+    /**
+     * Sets the timeout used by the slow client policy. The default timeout is one second.
+     *
+     * @since 5.26
+     */
+    void setSlowClientTimeout(std::chrono::milliseconds timeout);
+    std::chrono::milliseconds slowClientTimeout() const;
+
 private Q_SLOTS:
     void flush();
 
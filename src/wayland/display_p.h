@@ -7,6 +7,8 @@
 
 #pragma once
 
+#include "display.h"
+
 #include <wayland-server-core.h>
 
 #include <QHash>
@@ -17,6 +19,10 @@
 
 #include <EGL/egl.h>
 
+#include <chrono>
+
+class QTimer;
+
 struct wl_resource;
 
 namespace KWaylandServer
@@ -24,6 +30,7 @@ namespace KWaylandServer
 class ClientBufferIntegration;
 class ClientBuffer;
 class ClientConnection;
+class ClientConnectionPrivate;
 class Display;
 class OutputInterface;
 class OutputDeviceV2Interface;
@@ -41,6 +48,15 @@ public:
     void registerClientBuffer(ClientBuffer *clientBuffer);
     void unregisterClientBuffer(ClientBuffer *clientBuffer);
 
+    void scheduleFlush(ClientConnectionPrivate *connection);
+    void unscheduleFlush(ClientConnectionPrivate *connection);
+    /**
+     * Unschedules the flush of the @a connection and drops everything cached for it, called
+     * when the client is destroyed.
+     */
+    void forgetConnection(ClientConnectionPrivate *connection);
+    static void logProtocolMessage(void *userData, wl_protocol_logger_type type, const wl_protocol_logger_message *message);
+
     Display *q;
     QSocketNotifier *socketNotifier = nullptr;
     wl_display *display = nullptr;
@@ -55,6 +71,21 @@ public:
     QHash<::wl_resource *, ClientBuffer *> resourceToBuffer;
     QHash<ClientBuffer *, ClientBufferDestroyListener *> bufferToListener;
     QList<ClientBufferIntegration *> bufferIntegrations;
+
+    wl_protocol_logger *protocolLogger = nullptr;
+    // The clients that have events waiting to be flushed.
+    QVector<ClientConnectionPrivate *> scheduledFlushes;
+    // Whether events have been sent to clients that have no ClientConnection yet.
+    bool untrackedFlushPending = false;
+    // The connection of the client that got the last event, events usually come in bursts.
+    wl_client *lastEventClient = nullptr;
+    ClientConnectionPrivate *lastEventConnection = nullptr;
+    // The size of the events on the wire, or -1 if it depends on the arguments.
+    QHash<const wl_message *, qint64> eventSizes;
+    Display::SlowClientPolicy slowClientPolicy = Display::SlowClientPolicy::Flush;
+    quint64 slowClientThreshold = 64 * 1024;
+    std::chrono::milliseconds slowClientTimeout = std::chrono::seconds(1);
+    QTimer *throttleTimer = nullptr;
 };
 
 } // namespace KWaylandServer
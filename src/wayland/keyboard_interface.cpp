@@ -13,10 +13,16 @@
 #include <QTemporaryFile>
 #include <QVector>
 
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
 #include <unistd.h>
 
 namespace KWaylandServer
 {
+static const int s_privateKeymapVersion = 7;
+
 KeyboardInterfacePrivate::KeyboardInterfacePrivate(SeatInterface *s)
     : seat(s)
 {
@@ -72,30 +78,89 @@ void KeyboardInterfacePrivate::sendEnter(SurfaceInterface *surface, quint32 seri
     }
 }
 
-void KeyboardInterfacePrivate::sendKeymap(Resource *resource)
+// Writes the keymap, including the terminating null byte, into an anonymous file. If sealed, the
+// file can't be modified afterwards and is safe to share between all clients.
+static int createKeymapFile(const QByteArray &keymap, bool sealed)
 {
-    std::unique_ptr<QTemporaryFile> tmp(new QTemporaryFile());
-    if (!tmp->open()) {
-        qCWarning(KWIN_CORE) << "Failed to create keymap file:" << tmp->errorString();
-        return;
+    int fd = -1;
+#ifdef F_SEAL_SEAL // Disable memfd on systems that don't have it, like BSD < 12
+    fd = memfd_create("kwin-keymap", MFD_CLOEXEC | MFD_ALLOW_SEALING);
+#endif
+    if (fd == -1) {
+        if (sealed) {
+            return -1;
+        }
+        QTemporaryFile tmp;
+        if (!tmp.open()) {
+            qCWarning(KWIN_CORE) << "Failed to create keymap file:" << tmp.errorString();
+            return -1;
+        }
+        unlink(tmp.fileName().toUtf8().constData());
+        fd = fcntl(tmp.handle(), F_DUPFD_CLOEXEC, 0);
+        if (fd == -1) {
+            qCWarning(KWIN_CORE) << "Failed to duplicate keymap file descriptor";
+            return -1;
+        }
     }
 
-    unlink(tmp->fileName().toUtf8().constData());
-    if (!tmp->resize(keymap.size())) {
-        qCWarning(KWIN_CORE) << "Failed to resize keymap file:" << tmp->errorString();
-        return;
+    const char *data = keymap.constData();
+    qint64 remaining = keymap.size() + 1;
+    while (remaining > 0) {
+        const ssize_t written = write(fd, data, remaining);
+        if (written == -1) {
+            if (errno == EINTR) {
+                continue;
+            }
+            qCWarning(KWIN_CORE) << "Failed to write keymap file:" << strerror(errno);
+            close(fd);
+            return -1;
+        }
+        data += written;
+        remaining -= written;
     }
+    lseek(fd, 0, SEEK_SET);
 
-    uchar *address = tmp->map(0, keymap.size());
-    if (!address) {
-        qCWarning(KWIN_CORE) << "Failed to map keymap file:" << tmp->errorString();
-        return;
+#ifdef F_SEAL_SEAL
+    if (sealed && fcntl(fd, F_ADD_SEALS, F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_WRITE | F_SEAL_SEAL) == -1) {
+        qCWarning(KWIN_CORE) << "Failed to seal keymap file:" << strerror(errno);
+        close(fd);
+        return -1;
     }
+#endif
 
-    qstrncpy(reinterpret_cast<char *>(address), keymap.constData(), keymap.size() + 1);
-    tmp->unmap(address);
+    return fd;
+}
 
-    send_keymap(resource->handle, keymap_format::keymap_format_xkb_v1, tmp->handle(), tmp->size());
+KeyboardInterfacePrivate::~KeyboardInterfacePrivate()
+{
+    if (sharedKeymapFd != -1) {
+        close(sharedKeymapFd);
+    }
+}
+
+void KeyboardInterfacePrivate::updateSharedKeymap()
+{
+    if (sharedKeymapFd != -1) {
+        close(sharedKeymapFd);
+    }
+    sharedKeymapFd = createKeymapFile(keymap, true);
+}
+
+void KeyboardInterfacePrivate::sendKeymap(Resource *resource)
+{
+    // From version 7 on, clients must map the keymap privately, so all of them can be handed
+    // the same sealed file. Older clients might map it writable and get a copy of their own.
+    if (resource->version() >= s_privateKeymapVersion && sharedKeymapFd != -1) {
+        send_keymap(resource->handle, keymap_format::keymap_format_xkb_v1, sharedKeymapFd, keymap.size() + 1);
+        return;
+    }
+
+    const int fd = createKeymapFile(keymap, false);
+    if (fd == -1) {
+        return;
+    }
+    send_keymap(resource->handle, keymap_format::keymap_format_xkb_v1, fd, keymap.size() + 1);
+    close(fd);
 }
 
 void KeyboardInterface::setKeymap(const QByteArray &content)
@@ -105,6 +170,7 @@ void KeyboardInterface::setKeymap(const QByteArray &content)
     }
 
     d->keymap = content;
+    d->updateSharedKeymap();
 
     const auto keyboardResources = d->resourceMap();
     for (KeyboardInterfacePrivate::Resource *resource : keyboardResources) {
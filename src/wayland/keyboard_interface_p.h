@@ -20,7 +20,9 @@ class KeyboardInterfacePrivate : public QtWaylandServer::wl_keyboard
 {
 public:
     KeyboardInterfacePrivate(SeatInterface *s);
+    ~KeyboardInterfacePrivate() override;
 
+    void updateSharedKeymap();
     void sendKeymap(Resource *resource);
     void sendModifiers();
     void sendModifiers(quint32 depressed, quint32 latched, quint32 locked, quint32 group, quint32 serial);
@@ -38,6 +40,8 @@ public:
     SurfaceInterface *focusedSurface = nullptr;
     QMetaObject::Connection destroyConnection;
     QByteArray keymap;
+    // Sealed copy of the keymap, shared by all keyboards that map it privately.
+    int sharedKeymapFd = -1;
 
     struct
     {
@@ -9,6 +9,7 @@
 #include "clientconnection.h"
 #include "compositor_interface.h"
 #include "display.h"
+#include "ftrace.h"
 #include "idleinhibit_v1_interface_p.h"
 #include "linuxdmabufv1clientbuffer.h"
 #include "pointerconstraints_v1_interface_p.h"
@@ -309,7 +310,7 @@ void SurfaceInterfacePrivate::surface_set_input_region(Resource *resource, struc
 
 void SurfaceInterfacePrivate::surface_commit(Resource *resource)
 {
-    Q_UNUSED(resource)
+    fTraceScope("SurfaceCommit", wl_resource_get_id(resource->handle));
     if (subSurface) {
         commitSubSurface();
     } else {
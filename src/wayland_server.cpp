@@ -11,6 +11,7 @@
 #include <config-kwin.h>
 
 #include "composite.h"
+#include "framecallbackthrottler.h"
 #include "idle_inhibition.h"
 #include "inputpanelv1integration.h"
 #include "keyboard_input.h"
@@ -68,6 +69,9 @@
 #include "xdgshellintegration.h"
 #include "xdgshellwindow.h"
 
+// KDE
+#include <KConfigGroup>
+
 // Qt
 #include <QCryptographicHash>
 #include <QDir>
@@ -324,6 +328,26 @@ void WaylandServer::handleOutputDisabled(Output *output)
     }
 }
 
+void WaylandServer::updateSlowClientPolicy(const KConfigGroup &group)
+{
+    const QString policy = group.readEntry("SlowClientPolicy", QStringLiteral("Flush"));
+    if (policy == QLatin1String("Throttle")) {
+        m_display->setSlowClientPolicy(KWaylandServer::Display::SlowClientPolicy::Throttle);
+    } else if (policy == QLatin1String("Disconnect")) {
+        m_display->setSlowClientPolicy(KWaylandServer::Display::SlowClientPolicy::Disconnect);
+    } else {
+        m_display->setSlowClientPolicy(KWaylandServer::Display::SlowClientPolicy::Flush);
+    }
+    // The threshold is configured in KiB.
+    m_display->setSlowClientThreshold(quint64(std::max(1u, group.readEntry("SlowClientThreshold", 64u))) * 1024);
+    m_display->setSlowClientTimeout(std::chrono::milliseconds(std::max(1u, group.readEntry("SlowClientTimeout", 1000u))));
+}
+
+void WaylandServer::updateFrameCallbackThrottling(const KConfigGroup &group)
+{
+    m_frameCallbackThrottler->setHiddenRate(group.readEntry("HiddenFrameCallbackRate", 1u));
+}
+
 void WaylandServer::setEnablePrimarySelection(bool enable)
 {
     if (!enable && m_primarySelectionDeviceManager != nullptr) {
@@ -425,6 +449,9 @@ bool WaylandServer::init(InitializationFlags flags)
 
     const auto kwinConfig = kwinApp()->config();
     setEnablePrimarySelection(kwinConfig->group("Wayland").readEntry("EnablePrimarySelection", true));
+    updateSlowClientPolicy(kwinConfig->group("Wayland"));
+    m_frameCallbackThrottler = new FrameCallbackThrottler(this);
+    updateFrameCallbackThrottling(kwinConfig->group("Wayland"));
 
     m_idle = new IdleInterface(m_display, m_display);
     auto idleInhibition = new IdleInhibition(m_idle);
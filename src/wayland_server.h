@@ -15,6 +15,7 @@
 #include <QPointer>
 #include <QSet>
 
+class KConfigGroup;
 class QThread;
 class QProcess;
 class QWindow;
@@ -53,6 +54,7 @@ class PrimarySelectionDeviceManagerV1Interface;
 namespace KWin
 {
 
+class FrameCallbackThrottler;
 class Window;
 class Output;
 class XdgActivationV1Integration;
@@ -222,6 +224,20 @@ public:
         m_linuxDmabufBuffers.remove(buffer);
     }
     void setEnablePrimarySelection(bool enable);
+    /**
+     * Applies the policy for the clients that don't read their events, from the Wayland
+     * group of kwinrc.
+     */
+    void updateSlowClientPolicy(const KConfigGroup &group);
+    /**
+     * Applies the rate of the frame callbacks for hidden windows, from the Wayland group
+     * of kwinrc.
+     */
+    void updateFrameCallbackThrottling(const KConfigGroup &group);
+    FrameCallbackThrottler *frameCallbackThrottler() const
+    {
+        return m_frameCallbackThrottler;
+    }
 
     Output *findOutput(KWaylandServer::OutputInterface *output) const;
 
@@ -291,6 +307,7 @@ private:
     KWaylandServer::XdgForeignV2Interface *m_XdgForeign = nullptr;
     KWaylandServer::PrimaryOutputV1Interface *m_primary = nullptr;
     XdgActivationV1Integration *m_xdgActivationIntegration = nullptr;
+    FrameCallbackThrottler *m_frameCallbackThrottler = nullptr;
     KWaylandServer::PrimarySelectionDeviceManagerV1Interface *m_primarySelectionDeviceManager = nullptr;
     QList<Window *> m_windows;
     InitializationFlags m_initFlags;
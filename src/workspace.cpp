@@ -686,6 +686,9 @@ void Workspace::addX11Window(X11Window *window)
     }
     m_x11Clients.append(window);
     m_allClients.append(window);
+    // The client window id marks the window as known to updateX11WindowIds().
+    m_x11WindowIds.insert(window->window(), window);
+    updateX11WindowIds(window);
     addToStack(window);
     updateClientArea(); // This cannot be in manage(), because the window got added only now
     window->updateLayer();
@@ -705,9 +708,23 @@ void Workspace::addX11Window(X11Window *window)
     updateTabbox();
 }
 
+void Workspace::updateX11WindowIds(X11Window *window)
+{
+    if (m_x11WindowIds.value(window->window()) != window) {
+        return;
+    }
+    const xcb_window_t ids[] = {window->wrapperId(), window->frameId(), window->inputId()};
+    for (xcb_window_t id : ids) {
+        if (id != XCB_WINDOW_NONE) {
+            m_x11WindowIds.insert(id, window);
+        }
+    }
+}
+
 void Workspace::addUnmanaged(Unmanaged *window)
 {
     m_unmanaged.append(window);
+    m_unmanagedIds.insert(window->window(), window);
     addToStack(window);
 }
 
@@ -719,6 +736,13 @@ void Workspace::removeX11Window(X11Window *window)
     Q_ASSERT(m_x11Clients.contains(window));
     // TODO: if marked window is removed, notify the marked list
     m_x11Clients.removeAll(window);
+    for (auto it = m_x11WindowIds.begin(); it != m_x11WindowIds.end();) {
+        if (it.value() == window) {
+            it = m_x11WindowIds.erase(it);
+        } else {
+            ++it;
+        }
+    }
     Group *group = findGroup(window->window());
     if (group != nullptr) {
         group->lostLeader();
@@ -730,6 +754,13 @@ void Workspace::removeUnmanaged(Unmanaged *window)
 {
     Q_ASSERT(m_unmanaged.contains(window));
     m_unmanaged.removeAll(window);
+    for (auto it = m_unmanagedIds.begin(); it != m_unmanagedIds.end();) {
+        if (it.value() == window) {
+            it = m_unmanagedIds.erase(it);
+        } else {
+            ++it;
+        }
+    }
     removeFromStack(window);
     Q_EMIT unmanagedRemoved(window);
 }
@@ -1771,30 +1802,28 @@ Unmanaged *Workspace::findUnmanaged(std::function<bool(const Unmanaged *)> func)
 
 Unmanaged *Workspace::findUnmanaged(xcb_window_t w) const
 {
-    return findUnmanaged([w](const Unmanaged *u) {
-        return u->window() == w;
-    });
+    Unmanaged *window = m_unmanagedIds.value(w);
+    if (window && window->window() == w) {
+        return window;
+    }
+    return nullptr;
 }
 
 X11Window *Workspace::findClient(Predicate predicate, xcb_window_t w) const
 {
+    X11Window *window = m_x11WindowIds.value(w);
+    if (!window) {
+        return nullptr;
+    }
     switch (predicate) {
     case Predicate::WindowMatch:
-        return findClient([w](const X11Window *c) {
-            return c->window() == w;
-        });
+        return window->window() == w ? window : nullptr;
     case Predicate::WrapperIdMatch:
-        return findClient([w](const X11Window *c) {
-            return c->wrapperId() == w;
-        });
+        return window->wrapperId() == w ? window : nullptr;
     case Predicate::FrameIdMatch:
-        return findClient([w](const X11Window *c) {
-            return c->frameId() == w;
-        });
+        return window->frameId() == w ? window : nullptr;
     case Predicate::InputIdMatch:
-        return findClient([w](const X11Window *c) {
-            return c->inputId() == w;
-        });
+        return window->inputId() == w ? window : nullptr;
     }
     return nullptr;
 }
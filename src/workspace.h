@@ -359,6 +359,12 @@ public:
     bool showingDesktop() const;
 
     void removeX11Window(X11Window *); // Only called from X11Window::destroyWindow() or X11Window::releaseWindow()
+    /**
+     * Makes findClient(Predicate, xcb_window_t) find the @a window by the ids of all its X11
+     * windows. Must be called whenever the window creates a wrapper, frame or input window.
+     * Does nothing if the @a window has not been added to the workspace yet.
+     */
+    void updateX11WindowIds(X11Window *window);
     void setActiveWindow(Window *window);
     Group *findGroup(xcb_window_t leader) const;
     void addGroup(Group *group);
@@ -661,6 +667,11 @@ private:
     QList<Window *> m_allClients;
     QList<Unmanaged *> m_unmanaged;
     QList<Deleted *> deleted;
+    // Maps the client, wrapper, frame and input window ids to their owners. The ids of the windows
+    // that have been destroyed may linger until their owner is removed, so the lookups must check
+    // that the owner still uses the id.
+    QHash<xcb_window_t, X11Window *> m_x11WindowIds;
+    QHash<xcb_window_t, Unmanaged *> m_unmanagedIds;
     QList<InternalWindow *> m_internalWindows;
 
     QList<Window *> unconstrained_stacking_order; // Topmost last